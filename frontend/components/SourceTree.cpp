@@ -43,16 +43,37 @@ SourceTree::SourceTree(QWidget *parent_) : QListView(parent_)
 
 void SourceTree::UpdateIcons()
 {
-	SourceTreeModel *stm = GetStm();
-	stm->SceneChanged();
+	iconPixmaps.clear();
+	ResetWidgets();
 }
 
 void SourceTree::SetIconsVisible(bool visible)
 {
-	SourceTreeModel *stm = GetStm();
-
 	iconsVisible = visible;
-	stm->SceneChanged();
+	ResetWidgets();
+}
+
+/* icons are the same for every source of a type, so they are only rendered
+ * once per type */
+QPixmap SourceTree::GetIconPixmap(const char *id)
+{
+	auto it = iconPixmaps.constFind(id);
+	if (it != iconPixmaps.constEnd())
+		return *it;
+
+	OBSBasic *main = OBSBasic::Get();
+	QIcon icon;
+
+	if (strcmp(id, "scene") == 0)
+		icon = main->GetSceneIcon();
+	else if (strcmp(id, "group") == 0)
+		icon = main->GetGroupIcon();
+	else
+		icon = main->GetSourceIcon(id);
+
+	QPixmap pixmap = icon.pixmap(QSize(16, 16));
+	iconPixmaps.insert(id, pixmap);
+	return pixmap;
 }
 
 void SourceTree::ResetWidgets()
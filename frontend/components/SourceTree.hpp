@@ -3,6 +3,7 @@
 #include "SourceTreeItem.hpp"
 #include "SourceTreeModel.hpp"
 
+#include <QHash>
 #include <QListView>
 #include <QStaticText>
 #include <QSvgRenderer>
@@ -22,6 +23,9 @@ class SourceTree : public QListView {
 	OBSData undoSceneData;
 
 	bool iconsVisible = true;
+	QHash<QString, QPixmap> iconPixmaps;
+
+	QPixmap GetIconPixmap(const char *id);
 
 	void UpdateNoSourcesMessage();
 
@@ -57,7 +61,7 @@ public:
 	void SetIconsVisible(bool visible);
 
 public slots:
-	inline void ReorderItems() { GetStm()->ReorderItems(); }
+	inline void ReorderItems() { GetStm()->SceneChanged(); }
 	inline void RefreshItems() { GetStm()->SceneChanged(); }
 	void Remove(OBSSceneItem item, OBSScene scene);
 	void GroupSelectedItems();
@@ -47,22 +47,12 @@ SourceTreeItem::SourceTreeItem(SourceTree *tree_, OBSSceneItem sceneitem_) : tre
 		setStyleSheet("background: none");
 	}
 
-	OBSBasic *main = OBSBasic::Get();
 	const char *id = obs_source_get_id(source);
 
 	bool sourceVisible = obs_sceneitem_visible(sceneitem);
 
 	if (tree->iconsVisible) {
-		QIcon icon;
-
-		if (strcmp(id, "scene") == 0)
-			icon = main->GetSceneIcon();
-		else if (strcmp(id, "group") == 0)
-			icon = main->GetGroupIcon();
-		else
-			icon = main->GetSourceIcon(id);
-
-		QPixmap pixmap = icon.pixmap(QSize(16, 16));
+		QPixmap pixmap = tree->GetIconPixmap(id);
 
 		iconLabel = new QLabel();
 		iconLabel->setSizePolicy(QSizePolicy::Maximum, QSizePolicy::Maximum);
@@ -4,6 +4,8 @@
 
 #include <qt-wrappers.hpp>
 
+#include <QSet>
+
 #include "moc_SourceTreeModel.cpp"
 
 static inline OBSScene GetCurrentScene()
@@ -69,21 +71,30 @@ void SourceTreeModel::SceneChanged()
 {
 	OBSScene scene = GetCurrentScene();
 
-	beginResetModel();
-	items.clear();
-	obs_scene_enum_items(scene, enumItem, &items);
-	endResetModel();
+	QVector<OBSSceneItem> newitems;
+	obs_scene_enum_items(scene, enumItem, &newitems);
+
+	SyncItems(newitems);
 
+	bool hadGroups = hasGroups;
 	UpdateGroupState(false);
-	st->ResetWidgets();
+	st->UpdateWidgets(hadGroups != hasGroups);
 
+	/* select in one go, every selection change goes back to libobs */
+	QItemSelection selection;
 	for (int i = 0; i < items.count(); i++) {
-		bool select = obs_sceneitem_selected(items[i]);
-		QModelIndex index = createIndex(i, 0);
+		if (!obs_sceneitem_selected(items[i]))
+			continue;
 
-		st->selectionModel()->select(index,
-					     select ? QItemSelectionModel::Select : QItemSelectionModel::Deselect);
+		int last = i;
+		while (last + 1 < items.count() && obs_sceneitem_selected(items[last + 1]))
+			last++;
+
+		selection.select(createIndex(i, 0), createIndex(last, 0));
+		i = last;
 	}
+
+	st->selectionModel()->select(selection, QItemSelectionModel::ClearAndSelect);
 }
 
 /* moves a scene item index (blame linux distros for using older Qt builds) */
@@ -95,19 +106,8 @@ static inline void MoveItem(QVector<OBSSceneItem> &items, int oldIdx, int newIdx
 }
 
 /* reorders list optimally with model reorder funcs */
-void SourceTreeModel::ReorderItems()
+bool SourceTreeModel::ReorderItems(const QVector<OBSSceneItem> &newitems)
 {
-	OBSScene scene = GetCurrentScene();
-
-	QVector<OBSSceneItem> newitems;
-	obs_scene_enum_items(scene, enumItem, &newitems);
-
-	/* if item list has changed size, do full reset */
-	if (newitems.count() != items.count()) {
-		SceneChanged();
-		return;
-	}
-
 	for (;;) {
 		int idx1Old = 0;
 		int idx1New = 0;
@@ -140,10 +140,9 @@ void SourceTreeModel::ReorderItems()
 			}
 		}
 
-		/* if item could not be found, do full reset */
+		/* if item could not be found, fail */
 		if (i == newitems.count()) {
-			SceneChanged();
-			return;
+			return false;
 		}
 
 		/* get move count */
@@ -169,6 +168,70 @@ void SourceTreeModel::ReorderItems()
 		}
 		endMoveRows();
 	}
+
+	return true;
+}
+
+/* Turns the item list into newitems with row removals, moves and insertions
+ * rather than a model reset, so that rows which stay keep their widgets, and
+ * only new rows need widgets to be created. */
+void SourceTreeModel::SyncItems(const QVector<OBSSceneItem> &newitems)
+{
+	QSet<obs_sceneitem_t *> newSet;
+	newSet.reserve(newitems.count());
+	for (obs_sceneitem_t *item : newitems)
+		newSet.insert(item);
+
+	/* remove items that are gone, a range at a time */
+	for (int i = items.count() - 1; i >= 0; i--) {
+		if (newSet.contains(items[i]))
+			continue;
+
+		int last = i;
+		while (i > 0 && !newSet.contains(items[i - 1]))
+			i--;
+
+		beginRemoveRows(QModelIndex(), i, last);
+		items.remove(i, last - i + 1);
+		endRemoveRows();
+	}
+
+	/* put the remaining items in order */
+	QSet<obs_sceneitem_t *> oldSet;
+	oldSet.reserve(items.count());
+	for (obs_sceneitem_t *item : items)
+		oldSet.insert(item);
+
+	QVector<OBSSceneItem> kept;
+	kept.reserve(items.count());
+	for (obs_sceneitem_t *item : newitems) {
+		if (oldSet.contains(item))
+			kept << item;
+	}
+
+	if (!ReorderItems(kept)) {
+		beginResetModel();
+		items = newitems;
+		endResetModel();
+		return;
+	}
+
+	/* insert new items, a range at a time */
+	for (int i = 0; i < newitems.count(); i++) {
+		if (oldSet.contains(newitems[i]))
+			continue;
+
+		int last = i;
+		while (last + 1 < newitems.count() && !oldSet.contains(newitems[last + 1]))
+			last++;
+
+		beginInsertRows(QModelIndex(), i, last);
+		for (int j = i; j <= last; j++)
+			items.insert(j, newitems[j]);
+		endInsertRows();
+
+		i = last;
+	}
 }
 
 void SourceTreeModel::Add(obs_sceneitem_t *item)
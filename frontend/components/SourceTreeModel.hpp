@@ -20,7 +20,8 @@ class SourceTreeModel : public QAbstractListModel {
 	static void OBSFrontendEvent(enum obs_frontend_event event, void *ptr);
 	void Clear();
 	void SceneChanged();
-	void ReorderItems();
+	bool ReorderItems(const QVector<OBSSceneItem> &newitems);
+	void SyncItems(const QVector<OBSSceneItem> &newitems);
 
 	void Add(obs_sceneitem_t *item);
 	void Remove(obs_sceneitem_t *item);
@@ -76,6 +76,7 @@ bool opt_disable_missing_files_check = false;
 string opt_starting_collection;
 string opt_starting_profile;
 string opt_starting_scene;
+static string opt_profiler_socket;
 
 bool restart = false;
 bool restart_safe = false;
@@ -499,6 +500,9 @@ static int run_program(fstream &logFile, int argc, char *argv[])
 	profiler_start();
 	profile_register_root(run_program_init, 0);
 
+	if (!opt_profiler_socket.empty())
+		profiler_live_serve(opt_profiler_socket.c_str());
+
 	ScopeProfiler prof{run_program_init};
 
 #ifdef _WIN32
@@ -989,6 +993,10 @@ int main(int argc, char *argv[])
 		} else if (arg_is(argv[i], "--steam", nullptr)) {
 			steam = true;
 
+		} else if (arg_is(argv[i], "--profiler-socket", nullptr)) {
+			if (++i < argc)
+				opt_profiler_socket = argv[i];
+
 		} else if (arg_is(argv[i], "--help", "-h")) {
 			std::string help =
 				"--help, -h: Get list of available commands.\n\n"
@@ -1012,7 +1020,11 @@ int main(int argc, char *argv[])
 				"--always-on-top: Start in 'always on top' mode.\n\n"
 				"--unfiltered_log: Make log unfiltered.\n\n"
 				"--disable-updater: Disable built-in updater (Windows/Mac only)\n\n"
-				"--disable-missing-files-check: Disable the missing files dialog which can appear on startup.\n\n";
+				"--disable-missing-files-check: Disable the missing files dialog which can appear on startup.\n\n"
+#ifndef _WIN32
+				"--profiler-socket <path>: Stream live profiler metrics to clients of a unix socket.\n\n"
+#endif
+				;
 
 #ifdef _WIN32
 			MessageBoxA(NULL, help.c_str(), "Help", MB_OK | MB_ICONASTERISK);
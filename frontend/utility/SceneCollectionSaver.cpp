@@ -0,0 +1,124 @@
+/******************************************************************************
+    Copyright (C) 2025 by the OBS Project
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "SceneCollectionSaver.hpp"
+
+#include <util/platform.h>
+#include <util/threading.h>
+
+/* writes slower than this are logged as warnings */
+static constexpr uint64_t SLOW_SAVE_NS = 500000000ULL;
+
+SceneCollectionSaver::SceneCollectionSaver()
+{
+	thread = std::thread(&SceneCollectionSaver::Thread, this);
+}
+
+SceneCollectionSaver::~SceneCollectionSaver()
+{
+	{
+		std::unique_lock lock(mutex);
+		stopping = true;
+	}
+
+	cv.notify_one();
+	thread.join();
+}
+
+void SceneCollectionSaver::Queue(obs_data_t *data, const std::string &path)
+{
+	uint64_t startTime = os_gettime_ns();
+
+	/* obs_data_apply deep copies user values, which is far cheaper than
+	 * serializing, and detaches the snapshot from settings objects that
+	 * are shared with live sources */
+	OBSDataAutoRelease snapshot = obs_data_create();
+	obs_data_apply(snapshot, data);
+
+	uint64_t snapshotTime = os_gettime_ns() - startTime;
+
+	{
+		std::unique_lock lock(mutex);
+
+		/* only coalesce saves to the same file */
+		if (pending && pendingPath != path)
+			idleCv.wait(lock, [this] { return !pending; });
+
+		if (pending)
+			coalesced++;
+		else
+			pendingQueuedTime = startTime;
+
+		pending = snapshot.Get();
+		pendingPath = path;
+	}
+
+	cv.notify_one();
+
+	blog(LOG_DEBUG, "Scene collection snapshot took %.2f ms", (double)snapshotTime / 1000000.0);
+}
+
+void SceneCollectionSaver::Flush()
+{
+	std::unique_lock lock(mutex);
+	idleCv.wait(lock, [this] { return !pending && !writing; });
+}
+
+void SceneCollectionSaver::Thread()
+{
+	os_set_thread_name("scene collection saver");
+
+	std::unique_lock lock(mutex);
+
+	for (;;) {
+		cv.wait(lock, [this] { return pending || stopping; });
+		if (!pending)
+			break;
+
+		OBSData data = std::move(pending);
+		std::string path = std::move(pendingPath);
+		uint64_t queuedTime = pendingQueuedTime;
+		int skipped = coalesced;
+
+		pending = nullptr;
+		pendingPath.clear();
+		coalesced = 0;
+		writing = true;
+		lock.unlock();
+
+		uint64_t startTime = os_gettime_ns();
+		bool success = obs_data_save_json_pretty_safe(data, path.c_str(), "tmp", "bak");
+		uint64_t endTime = os_gettime_ns();
+
+		data = nullptr;
+
+		if (!success) {
+			blog(LOG_ERROR, "Could not save scene data to %s", path.c_str());
+		} else {
+			double writeMs = (double)(endTime - startTime) / 1000000.0;
+			double totalMs = (double)(endTime - queuedTime) / 1000000.0;
+
+			blog(endTime - startTime > SLOW_SAVE_NS ? LOG_WARNING : LOG_DEBUG,
+			     "Saved scene collection to %s: write %.2f ms, latency %.2f ms, %d save(s) coalesced",
+			     path.c_str(), writeMs, totalMs, skipped);
+		}
+
+		lock.lock();
+		writing = false;
+		idleCv.notify_all();
+	}
+}
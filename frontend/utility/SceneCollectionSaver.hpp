@@ -0,0 +1,54 @@
+/******************************************************************************
+    Copyright (C) 2025 by the OBS Project
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <obs.hpp>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/* Writes scene collections to disk on a background thread. Saves queued while
+ * a previous one is still being written are coalesced, only the latest data
+ * for a file is written. */
+class SceneCollectionSaver {
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::condition_variable idleCv;
+	std::thread thread;
+
+	OBSData pending;
+	std::string pendingPath;
+	uint64_t pendingQueuedTime = 0;
+	int coalesced = 0;
+	bool writing = false;
+	bool stopping = false;
+
+	void Thread();
+
+public:
+	SceneCollectionSaver();
+	~SceneCollectionSaver();
+
+	/* Takes a snapshot of data, so the caller may keep modifying it */
+	void Queue(obs_data_t *data, const std::string &path);
+
+	/* Blocks until every queued save has been written */
+	void Flush();
+};
@@ -31,6 +31,9 @@ protected:
 				break;
 			}
 			break;
+		case QEvent::Expose:
+			display->UpdateDisplayVisibility();
+			break;
 		default:
 			break;
 		}
@@ -17,6 +17,8 @@ void VolumeMeterTimer::RemoveVolControl(VolumeMeter *meter)
 void VolumeMeterTimer::timerEvent(QTimerEvent *)
 {
 	for (VolumeMeter *meter : volumeMeters) {
+		meter->pollLevels();
+
 		if (meter->needLayoutChange()) {
 			// Tell paintEvent to update layout and paint everything
 			meter->update();
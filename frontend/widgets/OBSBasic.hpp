@@ -26,6 +26,7 @@
 #include <utility/BasicOutputHandler.hpp>
 #include <utility/OBSCanvas.hpp>
 #include <utility/PreviewProgramSizeObserver.hpp>
+#include <utility/SceneCollectionSaver.hpp>
 #include <utility/VCamConfig.hpp>
 #include <utility/platform.hpp>
 #include <utility/undo_stack.hpp>
@@ -1073,6 +1074,7 @@ private:
 	OBSDataAutoRelease collectionModuleData;
 	long disableSaving = 1;
 	bool projectChanged = false;
+	SceneCollectionSaver collectionSaver;
 	bool clearingFailed = false;
 
 	QPointer<OBSMissingFiles> missDialog;
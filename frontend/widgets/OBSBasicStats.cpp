@@ -94,16 +94,19 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closable)
 	renderTime = new QLabel(this);
 	skippedFrames = new QLabel(this);
 	missedFrames = new QLabel(this);
+	displayMissedFrames = new QLabel(this);
 
 	str = MakeMissedFramesText(999999, 999999, 99.99);
 	textWidth = missedFrames->fontMetrics().boundingRect(str).width();
 	missedFrames->setMinimumWidth(textWidth);
+	displayMissedFrames->setMinimumWidth(textWidth);
 
 	row = 0;
 
 	newStatBare("FPS", fps, 2);
 	newStat("AverageTimeToRender", renderTime, 2);
 	newStat("MissedFrames", missedFrames, 2);
+	newStat("DisplayMissedFrames", displayMissedFrames, 2);
 	newStat("SkippedFrames", skippedFrames, 2);
 
 	/* --------------------------------------------- */
@@ -251,6 +254,7 @@ static uint32_t first_encoded = 0xFFFFFFFF;
 static uint32_t first_skipped = 0xFFFFFFFF;
 static uint32_t first_rendered = 0xFFFFFFFF;
 static uint32_t first_lagged = 0xFFFFFFFF;
+static uint32_t first_display_lagged = 0xFFFFFFFF;
 
 void OBSBasicStats::InitializeValues()
 {
@@ -259,6 +263,7 @@ void OBSBasicStats::InitializeValues()
 	first_skipped = video_output_get_skipped_frames(video);
 	first_rendered = obs_get_total_frames();
 	first_lagged = obs_get_lagged_frames();
+	first_display_lagged = obs_get_display_lagged_frames();
 }
 
 void OBSBasicStats::Update()
@@ -404,6 +409,27 @@ void OBSBasicStats::Update()
 	else
 		setClasses(missedFrames, "");
 
+	/* ------------------ */
+
+	uint32_t total_display_lagged = obs_get_display_lagged_frames();
+
+	if (total_display_lagged < first_display_lagged)
+		first_display_lagged = total_display_lagged;
+	total_display_lagged -= first_display_lagged;
+
+	num = total_rendered ? (long double)total_display_lagged / (long double)total_rendered : 0.0l;
+	num *= 100.0l;
+
+	str = MakeMissedFramesText(total_display_lagged, total_rendered, num);
+	displayMissedFrames->setText(str);
+
+	if (num > 5.0l)
+		setClasses(displayMissedFrames, "text-danger");
+	else if (num > 1.0l)
+		setClasses(displayMissedFrames, "text-warning");
+	else
+		setClasses(displayMissedFrames, "");
+
 	/* ------------------------------------------- */
 	/* recording/streaming stats                   */
 
@@ -465,6 +491,7 @@ void OBSBasicStats::Reset()
 	first_skipped = 0xFFFFFFFF;
 	first_rendered = 0xFFFFFFFF;
 	first_lagged = 0xFFFFFFFF;
+	first_display_lagged = 0xFFFFFFFF;
 
 	OBSOutputAutoRelease strOutput = obs_frontend_get_streaming_output();
 	OBSOutputAutoRelease recOutput = obs_frontend_get_recording_output();
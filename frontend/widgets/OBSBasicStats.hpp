@@ -23,6 +23,7 @@ class OBSBasicStats : public QFrame {
 	QLabel *renderTime = nullptr;
 	QLabel *skippedFrames = nullptr;
 	QLabel *missedFrames = nullptr;
+	QLabel *displayMissedFrames = nullptr;
 
 	QGridLayout *outputLayout = nullptr;
 
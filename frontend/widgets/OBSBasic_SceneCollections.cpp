@@ -985,12 +985,7 @@ void OBSBasic::Save(SceneCollection &collection)
 	int sceneCollectionVersion = collection.getVersion();
 	obs_data_set_int(saveData, "version", sceneCollectionVersion);
 
-	const std::string collectionFileName = collection.getFilePathString();
-	bool success = obs_data_save_json_pretty_safe(saveData, collectionFileName.c_str(), "tmp", "bak");
-
-	if (!success) {
-		blog(LOG_ERROR, "Could not save scene data to %s", collectionFileName.c_str());
-	}
+	collectionSaver.Queue(saveData, collection.getFilePathString());
 }
 
 void OBSBasic::DeferSaveBegin()
@@ -1502,6 +1497,7 @@ void OBSBasic::SaveProjectNow()
 
 	projectChanged = true;
 	SaveProjectDeferred();
+	collectionSaver.Flush();
 }
 
 void OBSBasic::SaveProject()
@@ -7,6 +7,7 @@
 #include <obs-nix-platform.h>
 #endif
 
+#include <QScreen>
 #include <QWindow>
 #ifdef ENABLE_WAYLAND
 #include <QApplication>
@@ -100,6 +101,7 @@ OBSQTDisplay::OBSQTDisplay(QWidget *parent, Qt::WindowFlags flags) : QWidget(par
 
 		QSize size = GetPixelSize(this);
 		obs_display_resize(display, size.width(), size.height());
+		UpdateDisplayMaxFPS();
 	};
 
 	connect(windowHandle(), &QWindow::visibleChanged, this, windowVisible);
@@ -128,6 +130,18 @@ void OBSQTDisplay::UpdateDisplayBackgroundColor()
 	obs_display_set_background_color(display, backgroundColor);
 }
 
+void OBSQTDisplay::UpdateDisplayVisibility()
+{
+	obs_display_set_visible(display, windowHandle()->isExposed());
+}
+
+void OBSQTDisplay::UpdateDisplayMaxFPS()
+{
+	/* no point in presenting more often than the monitor can show */
+	QScreen *screen = windowHandle()->screen();
+	obs_display_set_max_fps(display, screen ? screen->refreshRate() : 0.0);
+}
+
 void OBSQTDisplay::CreateDisplay()
 {
 	if (display)
@@ -151,6 +165,7 @@ void OBSQTDisplay::CreateDisplay()
 		return;
 
 	display = obs_display_create(&info, backgroundColor);
+	UpdateDisplayMaxFPS();
 
 	emit DisplayCreated(this);
 }
@@ -37,6 +37,8 @@ public:
 	QColor GetDisplayBackgroundColor() const;
 	void SetDisplayBackgroundColor(const QColor &color);
 	void UpdateDisplayBackgroundColor();
+	void UpdateDisplayVisibility();
+	void UpdateDisplayMaxFPS();
 	void CreateDisplay();
 	void DestroyDisplay()
 	{
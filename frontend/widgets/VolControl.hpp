@@ -31,8 +31,6 @@ private:
 	QMenu *contextMenu;
 
 	static void OBSVolumeChanged(void *param, float db);
-	static void OBSVolumeLevel(void *data, const float magnitude[MAX_AUDIO_CHANNELS],
-				   const float peak[MAX_AUDIO_CHANNELS], const float inputPeak[MAX_AUDIO_CHANNELS]);
 	static void OBSVolumeMuted(void *data, calldata_t *calldata);
 	static void OBSMixersOrMonitoringChanged(void *data, calldata_t *);
 
@@ -459,6 +459,19 @@ void VolumeMeter::setLevels(const float magnitude[MAX_AUDIO_CHANNELS], const flo
 	calculateBallistics(ts);
 }
 
+void VolumeMeter::pollLevels()
+{
+	struct obs_volmeter_levels levels;
+
+	if (!obs_volmeter || !obs_volmeter_get_levels(obs_volmeter, &levels))
+		return;
+	if (levels.timestamp == lastLevelsTimestamp)
+		return;
+
+	lastLevelsTimestamp = levels.timestamp;
+	setLevels(levels.magnitude, levels.peak, levels.input_peak);
+}
+
 inline void VolumeMeter::resetLevels()
 {
 	currentLastUpdateTime = 0;
@@ -142,6 +142,7 @@ private:
 	QColor p_foregroundErrorColor;
 
 	uint64_t lastRedrawTime = 0;
+	uint64_t lastLevelsTimestamp = 0;
 	int channels = 0;
 	bool clipping = false;
 	bool vertical;
@@ -153,6 +154,7 @@ public:
 
 	void setLevels(const float magnitude[MAX_AUDIO_CHANNELS], const float peak[MAX_AUDIO_CHANNELS],
 		       const float inputPeak[MAX_AUDIO_CHANNELS]);
+	void pollLevels();
 	QRect getBarRect() const;
 	bool needLayoutChange();
 
@@ -33,3 +33,8 @@ bool devices_match(const char *id1, const char *id2)
 	UNUSED_PARAMETER(id2);
 	return false;
 }
+
+uint64_t obs_get_audio_monitoring_latency_ns(void)
+{
+	return 0;
+}
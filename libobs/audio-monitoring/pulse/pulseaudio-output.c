@@ -1,13 +1,52 @@
 #include "obs-internal.h"
+#include "util/util_uint64.h"
 #include "pulseaudio-wrapper.h"
 
-#define PULSE_DATA(voidptr) struct audio_monitor *data = voidptr;
+#define PULSE_DATA(voidptr) struct monitor_bus *data = voidptr;
 #define blog(level, msg, ...) blog(level, "pulse-am: " msg, ##__VA_ARGS__)
 
+/*
+ * All monitored sources are mixed into a single bus, which is resampled once
+ * and played through one stream.  The stream pulls audio from the bus at the
+ * pace of the device, and every source is kept at a fixed latency target:
+ * the resampler is nudged to follow the drift between the sources and the
+ * device, and sources that get too far ahead are cut back to the target.
+ */
+
+#define BUS_BLOCK_MS 10
+#define BUS_TARGET_MS 30
+#define BUS_MAX_SKEW_MS 60
+#define BUS_STREAM_MS 20
+#define BUS_MAX_INPUT_MS 1000
+
+/* largest resampler correction, in 1/1000th of the sample rate */
+#define BUS_MAX_COMPENSATION 5
+
 struct audio_monitor {
 	obs_source_t *source;
-	pa_stream *stream;
+
+	/* OBS format audio waiting to be mixed, guarded by the bus data mutex */
+	struct deque buf[MAX_AUDIO_CHANNELS];
+	bool playing;
+
+	uint_fast32_t packets;
+	uint_fast64_t frames;
+
+	bool attached;
+	bool ignore;
+};
+
+struct monitor_bus {
+	/* stream lifetime and the input list */
+	pthread_mutex_t mutex;
+	/* input buffers, taken by sources and by the stream */
+	pthread_mutex_t data_mutex;
+
+	DARRAY(struct audio_monitor *) inputs;
+
+	char *device_id;
 	char *device;
+	pa_stream *stream;
 	pa_buffer_attr attr;
 	enum speaker_layout speakers;
 	pa_sample_format_t format;
@@ -15,14 +54,25 @@ struct audio_monitor {
 	uint_fast32_t bytes_per_frame;
 	uint_fast8_t channels;
 
-	uint_fast32_t packets;
-	uint_fast64_t frames;
+	size_t obs_channels;
+	uint32_t obs_rate;
+	size_t block_frames;
+	size_t target_frames;
+	size_t max_skew_frames;
+	size_t max_input_frames;
 
-	struct deque new_data;
 	audio_resampler_t *resampler;
+	float *mix[MAX_AUDIO_CHANNELS];
+	float *scratch;
+	struct deque out;
+	int compensation;
 
-	bool ignore;
-	pthread_mutex_t playback_mutex;
+	volatile long latency_us;
+};
+
+static struct monitor_bus bus = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.data_mutex = PTHREAD_MUTEX_INITIALIZER,
 };
 
 static enum speaker_layout pulseaudio_channels_to_obs_speakers(uint_fast32_t channels)
@@ -120,155 +170,6 @@ static pa_channel_map pulseaudio_channel_map(enum speaker_layout layout)
 	return ret;
 }
 
-static void process_byte(void *p, size_t frames, size_t channels, float vol)
-{
-	register uint8_t *cur = (uint8_t *)p;
-	register uint8_t *end = cur + frames * channels;
-
-	for (; cur < end; cur++)
-		*cur = ((int)*cur - 128) * vol + 128;
-}
-
-static void process_s16(void *p, size_t frames, size_t channels, float vol)
-{
-	register int16_t *cur = (int16_t *)p;
-	register int16_t *end = cur + frames * channels;
-
-	while (cur < end)
-		*(cur++) *= vol;
-}
-
-static void process_s32(void *p, size_t frames, size_t channels, float vol)
-{
-	register int32_t *cur = (int32_t *)p;
-	register int32_t *end = cur + frames * channels;
-
-	while (cur < end)
-		*(cur++) *= vol;
-}
-
-static void process_float(void *p, size_t frames, size_t channels, float vol)
-{
-	register float *cur = (float *)p;
-	register float *end = cur + frames * channels;
-
-	while (cur < end)
-		*(cur++) *= vol;
-}
-
-void process_volume(const struct audio_monitor *monitor, float vol, uint8_t *const *resample_data,
-		    uint32_t resample_frames)
-{
-	switch (monitor->format) {
-	case PA_SAMPLE_U8:
-		process_byte(resample_data[0], resample_frames, monitor->channels, vol);
-		break;
-	case PA_SAMPLE_S16LE:
-		process_s16(resample_data[0], resample_frames, monitor->channels, vol);
-		break;
-	case PA_SAMPLE_S32LE:
-		process_s32(resample_data[0], resample_frames, monitor->channels, vol);
-		break;
-	case PA_SAMPLE_FLOAT32LE:
-		process_float(resample_data[0], resample_frames, monitor->channels, vol);
-		break;
-	default:
-		// just ignore
-		break;
-	}
-}
-
-static void do_stream_write(void *param)
-{
-	PULSE_DATA(param);
-	uint8_t *buffer = NULL;
-
-	pulseaudio_lock();
-	pthread_mutex_lock(&data->playback_mutex);
-
-	// If we have grown a large buffer internally, grow the pulse buffer to match so we can write our data out.
-	if (data->new_data.size > data->attr.tlength * 2) {
-		data->attr.fragsize = (uint32_t)-1;
-		data->attr.maxlength = (uint32_t)-1;
-		data->attr.prebuf = (uint32_t)-1;
-		data->attr.minreq = (uint32_t)-1;
-		data->attr.tlength = data->new_data.size;
-		pa_stream_set_buffer_attr(data->stream, &data->attr, NULL, NULL);
-	}
-
-	// Buffer up enough data before we start playing.
-	if (pa_stream_is_corked(data->stream)) {
-		if (data->new_data.size >= data->attr.tlength) {
-			pa_stream_cork(data->stream, 0, NULL, NULL);
-		} else {
-			goto finish;
-		}
-	}
-
-	while (data->new_data.size > 0) {
-		size_t bytesToFill = data->new_data.size;
-		if (pa_stream_begin_write(data->stream, (void **)&buffer, &bytesToFill))
-			goto finish;
-
-		// PA may request we submit more or less data than we have.
-		// Wait for more data if we cannot perform a full write.
-		if (bytesToFill > data->new_data.size) {
-			pa_stream_cancel_write(data->stream);
-			goto finish;
-		}
-
-		deque_pop_front(&data->new_data, buffer, bytesToFill);
-
-		pa_stream_write(data->stream, buffer, bytesToFill, NULL, 0LL, PA_SEEK_RELATIVE);
-	}
-
-finish:
-	pthread_mutex_unlock(&data->playback_mutex);
-	pulseaudio_unlock();
-}
-
-static void on_audio_playback(void *param, obs_source_t *source, const struct audio_data *audio_data, bool muted)
-{
-	struct audio_monitor *monitor = param;
-	float vol = source->user_volume;
-	size_t bytes;
-
-	uint8_t *resample_data[MAX_AV_PLANES];
-	uint32_t resample_frames;
-	uint64_t ts_offset;
-	bool success;
-
-	if (pthread_mutex_trylock(&monitor->playback_mutex) != 0)
-		return;
-
-	if (os_atomic_load_long(&source->activate_refs) == 0)
-		goto unlock;
-
-	success = audio_resampler_resample(monitor->resampler, resample_data, &resample_frames, &ts_offset,
-					   (const uint8_t *const *)audio_data->data, (uint32_t)audio_data->frames);
-
-	if (!success)
-		goto unlock;
-
-	bytes = monitor->bytes_per_frame * resample_frames;
-
-	if (muted) {
-		memset(resample_data[0], 0, bytes);
-	} else {
-		if (!close_float(vol, 1.0f, EPSILON)) {
-			process_volume(monitor, vol, resample_data, resample_frames);
-		}
-	}
-
-	deque_push_back(&monitor->new_data, resample_data[0], bytes);
-	monitor->packets++;
-	monitor->frames += resample_frames;
-
-unlock:
-	pthread_mutex_unlock(&monitor->playback_mutex);
-	do_stream_write(param);
-}
-
 static void pulseaudio_server_info(pa_context *c, const pa_server_info *i, void *userdata)
 {
 	UNUSED_PARAMETER(c);
@@ -322,83 +223,223 @@ skip:
 	pulseaudio_signal(0);
 }
 
-static void pulseaudio_stop_playback(struct audio_monitor *monitor)
+/* -------------------------------------------------------------------------- */
+/* mixing, called from the stream with the data mutex held                    */
+
+/* mixes the next block of every input, returns the average backlog */
+static size_t bus_mix_block(void)
+{
+	size_t block = bus.block_frames;
+	size_t backlog = 0;
+	size_t playing = 0;
+
+	for (size_t ch = 0; ch < bus.obs_channels; ch++)
+		memset(bus.mix[ch], 0, block * sizeof(float));
+
+	for (size_t i = 0; i < bus.inputs.num; i++) {
+		struct audio_monitor *monitor = bus.inputs.array[i];
+		size_t avail = monitor->buf[0].size / sizeof(float);
+		float vol = monitor->source->user_volume;
+
+		/* (re)buffer up to the target before playing an input */
+		if (!monitor->playing) {
+			if (avail < bus.target_frames)
+				continue;
+			monitor->playing = true;
+		}
+
+		/* an input running ahead of the device is brought back to the
+		 * target rather than adding latency */
+		if (avail > bus.target_frames + bus.max_skew_frames) {
+			size_t drop = avail - bus.target_frames;
+			for (size_t ch = 0; ch < bus.obs_channels; ch++)
+				deque_pop_front(&monitor->buf[ch], NULL, drop * sizeof(float));
+			avail = bus.target_frames;
+		}
+
+		size_t frames = avail < block ? avail : block;
+		if (frames < block)
+			monitor->playing = false;
+
+		for (size_t ch = 0; ch < bus.obs_channels; ch++) {
+			float *mix = bus.mix[ch];
+
+			deque_pop_front(&monitor->buf[ch], bus.scratch, frames * sizeof(float));
+			for (size_t j = 0; j < frames; j++)
+				mix[j] += bus.scratch[j] * vol;
+		}
+
+		backlog += avail - frames;
+		playing++;
+	}
+
+	return playing ? backlog / playing : bus.target_frames;
+}
+
+/* steers the resampler so that the backlog of the inputs stays at the target,
+ * which follows the drift between the clocks of the sources and the device */
+static void bus_compensate(size_t backlog)
+{
+	int64_t error = (int64_t)backlog - (int64_t)bus.target_frames;
+	int64_t max = (int64_t)bus.samples_per_sec * BUS_MAX_COMPENSATION / 1000;
+	int64_t delta = 0;
+
+	if (error > (int64_t)bus.block_frames / 2 || error < -(int64_t)bus.block_frames / 2) {
+		/* correct the error within about two seconds */
+		delta = -error * (int64_t)bus.samples_per_sec / (int64_t)bus.obs_rate / 2;
+		if (delta > max)
+			delta = max;
+		else if (delta < -max)
+			delta = -max;
+	}
+
+	if ((int)delta == bus.compensation)
+		return;
+
+	if (audio_resampler_set_compensation(bus.resampler, (int)delta, (int)bus.samples_per_sec))
+		bus.compensation = (int)delta;
+}
+
+static void bus_update_latency(pa_stream *stream, size_t backlog)
+{
+	pa_usec_t usec = 0;
+	int negative = 0;
+	uint64_t total;
+
+	if (pa_stream_get_latency(stream, &usec, &negative) < 0 || negative)
+		usec = 0;
+
+	total = usec;
+	total += util_mul_div64(backlog, 1000000, bus.obs_rate);
+	total += util_mul_div64(bus.out.size / bus.bytes_per_frame, 1000000, bus.samples_per_sec);
+
+	os_atomic_set_long(&bus.latency_us, (long)total);
+}
+
+/* runs on the pulseaudio thread, which holds the mainloop lock */
+static void bus_stream_write(pa_stream *stream, size_t nbytes, void *userdata)
+{
+	size_t backlog = bus.target_frames;
+	uint8_t *buffer = NULL;
+	uint8_t *resample_data[MAX_AV_PLANES];
+	uint32_t resample_frames;
+	uint64_t ts_offset;
+
+	UNUSED_PARAMETER(userdata);
+
+	pthread_mutex_lock(&bus.data_mutex);
+
+	while (bus.out.size < nbytes) {
+		backlog = bus_mix_block();
+
+		if (!audio_resampler_resample(bus.resampler, resample_data, &resample_frames, &ts_offset,
+					      (const uint8_t *const *)bus.mix, (uint32_t)bus.block_frames))
+			break;
+
+		deque_push_back(&bus.out, resample_data[0], resample_frames * bus.bytes_per_frame);
+	}
+
+	bus_compensate(backlog);
+
+	while (nbytes && bus.out.size) {
+		size_t bytes = nbytes < bus.out.size ? nbytes : bus.out.size;
+
+		if (pa_stream_begin_write(stream, (void **)&buffer, &bytes) < 0 || !bytes)
+			break;
+		if (bytes > bus.out.size)
+			bytes = bus.out.size;
+
+		deque_pop_front(&bus.out, buffer, bytes);
+		pa_stream_write(stream, buffer, bytes, NULL, 0LL, PA_SEEK_RELATIVE);
+		nbytes -= bytes;
+	}
+
+	bus_update_latency(stream, backlog);
+
+	pthread_mutex_unlock(&bus.data_mutex);
+}
+
+/* -------------------------------------------------------------------------- */
+/* bus lifetime, called with the bus mutex held                               */
+
+static void bus_close(void)
 {
-	if (monitor->stream) {
+	if (!bus.device_id)
+		return;
+
+	if (bus.stream) {
 		/* Stop the stream */
 		pulseaudio_lock();
-		pa_stream_disconnect(monitor->stream);
+		pa_stream_disconnect(bus.stream);
 		pulseaudio_unlock();
 
 		/* Remove the callbacks, to ensure we no longer try to do anything
 		 * with this stream object */
-		pulseaudio_write_callback(monitor->stream, NULL, NULL);
+		pulseaudio_write_callback(bus.stream, NULL, NULL);
 
 		/* Unreference the stream and drop it. PA will free it when it can. */
 		pulseaudio_lock();
-		pa_stream_unref(monitor->stream);
+		pa_stream_unref(bus.stream);
 		pulseaudio_unlock();
-		monitor->stream = NULL;
+		bus.stream = NULL;
+
+		blog(LOG_INFO, "Stopped Monitoring in '%s'", bus.device);
 	}
 
-	blog(LOG_INFO, "Stopped Monitoring in '%s'", monitor->device);
-	blog(LOG_INFO, "Got %" PRIuFAST32 " packets with %" PRIuFAST64 " frames", monitor->packets, monitor->frames);
+	pthread_mutex_lock(&bus.data_mutex);
+	audio_resampler_destroy(bus.resampler);
+	bus.resampler = NULL;
+	for (size_t ch = 0; ch < MAX_AUDIO_CHANNELS; ch++) {
+		bfree(bus.mix[ch]);
+		bus.mix[ch] = NULL;
+	}
+	bfree(bus.scratch);
+	bus.scratch = NULL;
+	deque_free(&bus.out);
+	bus.compensation = 0;
+	os_atomic_set_long(&bus.latency_us, 0);
+	pthread_mutex_unlock(&bus.data_mutex);
+
+	pulseaudio_unref();
 
-	monitor->packets = 0;
-	monitor->frames = 0;
+	bfree(bus.device);
+	bfree(bus.device_id);
+	bus.device = NULL;
+	bus.device_id = NULL;
 }
 
-static bool audio_monitor_init(struct audio_monitor *monitor, obs_source_t *source)
+static bool bus_open(const char *id)
 {
-	pthread_mutex_init_value(&monitor->playback_mutex);
-
-	monitor->source = source;
-
-	const char *id = obs->audio.monitoring_device_id;
-	if (!id)
-		return false;
-
-	if (source->info.output_flags & OBS_SOURCE_DO_NOT_SELF_MONITOR) {
-		obs_data_t *s = obs_source_get_settings(source);
-		const char *s_dev_id = obs_data_get_string(s, "device_id");
-		bool match = devices_match(s_dev_id, id);
-		obs_data_release(s);
-
-		if (match) {
-			monitor->ignore = true;
-			blog(LOG_INFO, "Prevented feedback-loop in '%s'", s_dev_id);
-			return true;
-		}
-	}
+	bus.device_id = bstrdup(id);
 
 	pulseaudio_init();
 
 	if (strcmp(id, "default") == 0)
-		get_default_id(&monitor->device);
+		get_default_id(&bus.device);
 	else
-		monitor->device = bstrdup(id);
+		bus.device = bstrdup(id);
 
-	if (!monitor->device)
+	if (!bus.device)
 		return false;
 
-	if (pulseaudio_get_server_info(pulseaudio_server_info, (void *)monitor) < 0) {
+	if (pulseaudio_get_server_info(pulseaudio_server_info, (void *)&bus) < 0) {
 		blog(LOG_ERROR, "Unable to get server info !");
 		return false;
 	}
 
-	if (pulseaudio_get_sink_info(pulseaudio_sink_info, monitor->device, (void *)monitor) < 0) {
+	if (pulseaudio_get_sink_info(pulseaudio_sink_info, bus.device, (void *)&bus) < 0) {
 		blog(LOG_ERROR, "Unable to get sink info !");
 		return false;
 	}
-	if (monitor->format == PA_SAMPLE_INVALID) {
+	if (bus.format == PA_SAMPLE_INVALID) {
 		blog(LOG_ERROR, "An error occurred while getting the source info!");
 		return false;
 	}
 
 	pa_sample_spec spec;
-	spec.format = monitor->format;
-	spec.rate = (uint32_t)monitor->samples_per_sec;
-	spec.channels = monitor->channels;
+	spec.format = bus.format;
+	spec.rate = (uint32_t)bus.samples_per_sec;
+	spec.channels = bus.channels;
 
 	if (!pa_sample_spec_valid(&spec)) {
 		blog(LOG_ERROR, "Sample spec is not valid");
@@ -410,46 +451,182 @@ static bool audio_monitor_init(struct audio_monitor *monitor, obs_source_t *sour
 	struct resample_info from = {.samples_per_sec = info->samples_per_sec,
 				     .speakers = info->speakers,
 				     .format = AUDIO_FORMAT_FLOAT_PLANAR};
-	struct resample_info to = {.samples_per_sec = (uint32_t)monitor->samples_per_sec,
-				   .speakers = pulseaudio_channels_to_obs_speakers(monitor->channels),
-				   .format = pulseaudio_to_obs_audio_format(monitor->format)};
+	struct resample_info to = {.samples_per_sec = (uint32_t)bus.samples_per_sec,
+				   .speakers = pulseaudio_channels_to_obs_speakers(bus.channels),
+				   .format = pulseaudio_to_obs_audio_format(bus.format)};
+
+	bus.speakers = pulseaudio_channels_to_obs_speakers(spec.channels);
+	bus.bytes_per_frame = pa_frame_size(&spec);
+
+	pthread_mutex_lock(&bus.data_mutex);
+
+	bus.resampler = audio_resampler_create(&to, &from);
+
+	bus.obs_rate = info->samples_per_sec;
+	bus.obs_channels = audio_output_get_channels(obs->audio.audio);
+	bus.block_frames = bus.obs_rate * BUS_BLOCK_MS / 1000;
+	bus.target_frames = bus.obs_rate * BUS_TARGET_MS / 1000;
+	bus.max_skew_frames = bus.obs_rate * BUS_MAX_SKEW_MS / 1000;
+	bus.max_input_frames = bus.obs_rate * BUS_MAX_INPUT_MS / 1000;
+
+	for (size_t ch = 0; ch < bus.obs_channels; ch++)
+		bus.mix[ch] = bmalloc(bus.block_frames * sizeof(float));
+	bus.scratch = bmalloc(bus.block_frames * sizeof(float));
+
+	/* inputs kept from a previous device start over */
+	for (size_t i = 0; i < bus.inputs.num; i++) {
+		struct audio_monitor *monitor = bus.inputs.array[i];
+		for (size_t ch = 0; ch < MAX_AUDIO_CHANNELS; ch++)
+			deque_free(&monitor->buf[ch]);
+		monitor->playing = false;
+	}
+
+	pthread_mutex_unlock(&bus.data_mutex);
 
-	monitor->resampler = audio_resampler_create(&to, &from);
-	if (!monitor->resampler) {
+	if (!bus.resampler) {
 		blog(LOG_WARNING, "%s: %s", __FUNCTION__, "Failed to create resampler");
 		return false;
 	}
 
-	monitor->speakers = pulseaudio_channels_to_obs_speakers(spec.channels);
-	monitor->bytes_per_frame = pa_frame_size(&spec);
+	pa_channel_map channel_map = pulseaudio_channel_map(bus.speakers);
 
-	pa_channel_map channel_map = pulseaudio_channel_map(monitor->speakers);
-
-	monitor->stream = pulseaudio_stream_new(obs_source_get_name(monitor->source), &spec, &channel_map);
-	if (!monitor->stream) {
+	bus.stream = pulseaudio_stream_new("OBS Monitoring", &spec, &channel_map);
+	if (!bus.stream) {
 		blog(LOG_ERROR, "Unable to create stream");
 		return false;
 	}
 
-	monitor->attr.fragsize = (uint32_t)-1;
-	monitor->attr.maxlength = (uint32_t)-1;
-	monitor->attr.minreq = (uint32_t)-1;
-	monitor->attr.prebuf = (uint32_t)-1;
-	monitor->attr.tlength = pa_usec_to_bytes(25000, &spec);
+	bus.attr.fragsize = (uint32_t)-1;
+	bus.attr.maxlength = (uint32_t)-1;
+	bus.attr.minreq = (uint32_t)-1;
+	bus.attr.prebuf = (uint32_t)-1;
+	bus.attr.tlength = pa_usec_to_bytes(BUS_STREAM_MS * 1000, &spec);
+
+	pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING | PA_STREAM_AUTO_TIMING_UPDATE |
+				  PA_STREAM_ADJUST_LATENCY;
 
-	pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING | PA_STREAM_AUTO_TIMING_UPDATE | PA_STREAM_START_CORKED;
+	pulseaudio_write_callback(bus.stream, bus_stream_write, NULL);
 
-	int_fast32_t ret = pulseaudio_connect_playback(monitor->stream, monitor->device, &monitor->attr, flags);
+	int_fast32_t ret = pulseaudio_connect_playback(bus.stream, bus.device, &bus.attr, flags);
 	if (ret < 0) {
-		pulseaudio_stop_playback(monitor);
 		blog(LOG_ERROR, "Unable to connect to stream");
 		return false;
 	}
 
-	blog(LOG_INFO, "Started Monitoring in '%s'", monitor->device);
+	blog(LOG_INFO, "Started Monitoring in '%s'", bus.device);
 	return true;
 }
 
+static bool bus_attach(struct audio_monitor *monitor, const char *id)
+{
+	bool success = true;
+
+	pthread_mutex_lock(&bus.mutex);
+
+	/* the monitoring device changed, move every input over to it */
+	if (bus.device_id && strcmp(bus.device_id, id) != 0)
+		bus_close();
+
+	if (!bus.device_id && !bus_open(id)) {
+		bus_close();
+		success = false;
+	}
+
+	if (success) {
+		pthread_mutex_lock(&bus.data_mutex);
+		da_push_back(bus.inputs, &monitor);
+		monitor->attached = true;
+		pthread_mutex_unlock(&bus.data_mutex);
+	}
+
+	pthread_mutex_unlock(&bus.mutex);
+	return success;
+}
+
+static void bus_detach(struct audio_monitor *monitor)
+{
+	if (!monitor->attached)
+		return;
+
+	pthread_mutex_lock(&bus.mutex);
+
+	pthread_mutex_lock(&bus.data_mutex);
+	da_erase_item(bus.inputs, &monitor);
+	for (size_t ch = 0; ch < MAX_AUDIO_CHANNELS; ch++)
+		deque_free(&monitor->buf[ch]);
+	monitor->attached = false;
+	monitor->playing = false;
+	pthread_mutex_unlock(&bus.data_mutex);
+
+	if (!bus.inputs.num) {
+		bus_close();
+		da_free(bus.inputs);
+	}
+
+	pthread_mutex_unlock(&bus.mutex);
+}
+
+/* -------------------------------------------------------------------------- */
+
+static void on_audio_playback(void *param, obs_source_t *source, const struct audio_data *audio_data, bool muted)
+{
+	struct audio_monitor *monitor = param;
+	size_t size = audio_data->frames * sizeof(float);
+
+	if (os_atomic_load_long(&source->activate_refs) == 0)
+		return;
+
+	pthread_mutex_lock(&bus.data_mutex);
+
+	if (!monitor->attached || !bus.resampler)
+		goto unlock;
+
+	for (size_t ch = 0; ch < bus.obs_channels; ch++) {
+		if (muted || !audio_data->data[ch])
+			deque_push_back_zero(&monitor->buf[ch], size);
+		else
+			deque_push_back(&monitor->buf[ch], audio_data->data[ch], size);
+	}
+
+	/* the stream stopped pulling, don't let the backlog grow forever */
+	size_t frames = monitor->buf[0].size / sizeof(float);
+	if (frames > bus.max_input_frames) {
+		size_t drop = (frames - bus.target_frames) * sizeof(float);
+		for (size_t ch = 0; ch < bus.obs_channels; ch++)
+			deque_pop_front(&monitor->buf[ch], NULL, drop);
+	}
+
+	monitor->packets++;
+	monitor->frames += audio_data->frames;
+
+unlock:
+	pthread_mutex_unlock(&bus.data_mutex);
+}
+
+static bool audio_monitor_init(struct audio_monitor *monitor, obs_source_t *source)
+{
+	monitor->source = source;
+
+	const char *id = obs->audio.monitoring_device_id;
+	if (!id)
+		return false;
+
+	if (source->info.output_flags & OBS_SOURCE_DO_NOT_SELF_MONITOR) {
+		obs_data_t *s = obs_source_get_settings(source);
+		const char *s_dev_id = obs_data_get_string(s, "device_id");
+		bool match = devices_match(s_dev_id, id);
+		obs_data_release(s);
+
+		if (match) {
+			monitor->ignore = true;
+			blog(LOG_INFO, "Prevented feedback-loop in '%s'", s_dev_id);
+			return true;
+		}
+	}
+
+	return bus_attach(monitor, id);
+}
+
 static void audio_monitor_init_final(struct audio_monitor *monitor)
 {
 	if (monitor->ignore)
@@ -466,54 +643,44 @@ static inline void audio_monitor_free(struct audio_monitor *monitor)
 	if (monitor->source)
 		obs_source_remove_audio_capture_callback(monitor->source, on_audio_playback, monitor);
 
-	audio_resampler_destroy(monitor->resampler);
-	deque_free(&monitor->new_data);
-
-	if (monitor->stream)
-		pulseaudio_stop_playback(monitor);
-	pulseaudio_unref();
+	if (monitor->attached)
+		blog(LOG_INFO, "'%s': got %" PRIuFAST32 " packets with %" PRIuFAST64 " frames",
+		     obs_source_get_name(monitor->source), monitor->packets, monitor->frames);
 
-	bfree(monitor->device);
+	bus_detach(monitor);
 }
 
 struct audio_monitor *audio_monitor_create(obs_source_t *source)
 {
-	struct audio_monitor monitor = {0};
-	struct audio_monitor *out;
+	struct audio_monitor *monitor = bzalloc(sizeof(struct audio_monitor));
 
-	if (!audio_monitor_init(&monitor, source))
+	if (!audio_monitor_init(monitor, source))
 		goto fail;
 
-	out = bmemdup(&monitor, sizeof(monitor));
-
 	pthread_mutex_lock(&obs->audio.monitoring_mutex);
-	da_push_back(obs->audio.monitors, &out);
+	da_push_back(obs->audio.monitors, &monitor);
 	pthread_mutex_unlock(&obs->audio.monitoring_mutex);
 
-	audio_monitor_init_final(out);
-	return out;
+	audio_monitor_init_final(monitor);
+	return monitor;
 
 fail:
-	audio_monitor_free(&monitor);
+	audio_monitor_free(monitor);
+	bfree(monitor);
 	return NULL;
 }
 
 void audio_monitor_reset(struct audio_monitor *monitor)
 {
-	struct audio_monitor new_monitor = {0};
-	bool success;
-	audio_monitor_free(monitor);
+	obs_source_t *source = monitor->source;
 
-	pthread_mutex_lock(&monitor->playback_mutex);
-	success = audio_monitor_init(&new_monitor, monitor->source);
-	pthread_mutex_unlock(&monitor->playback_mutex);
+	audio_monitor_free(monitor);
+	memset(monitor, 0, sizeof(struct audio_monitor));
 
-	if (success) {
-		*monitor = new_monitor;
+	if (audio_monitor_init(monitor, source))
 		audio_monitor_init_final(monitor);
-	} else {
-		audio_monitor_free(&new_monitor);
-	}
+	else
+		audio_monitor_free(monitor);
 }
 
 void audio_monitor_destroy(struct audio_monitor *monitor)
@@ -528,3 +695,8 @@ void audio_monitor_destroy(struct audio_monitor *monitor)
 		bfree(monitor);
 	}
 }
+
+uint64_t obs_get_audio_monitoring_latency_ns(void)
+{
+	return (uint64_t)os_atomic_load_long(&bus.latency_us) * 1000;
+}
@@ -461,3 +461,8 @@ void audio_monitor_destroy(struct audio_monitor *monitor)
 		bfree(monitor);
 	}
 }
+
+uint64_t obs_get_audio_monitoring_latency_ns(void)
+{
+	return 0;
+}
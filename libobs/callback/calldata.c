@@ -20,6 +20,7 @@
 #include "../util/base.h"
 
 #include "calldata.h"
+#include "decl.h"
 
 /*
  *   Uses a data stack.  Probably more complex than it should be, but reduces
@@ -62,19 +63,23 @@ static inline const char *cd_serialize_string(uint8_t **pos)
 static bool cd_getparam(const calldata_t *data, const char *name, uint8_t **pos)
 {
 	size_t name_size;
+	size_t name_len;
 
 	if (!data->size)
 		return false;
 
 	*pos = data->stack;
+	name_len = strlen(name) + 1;
 
 	name_size = cd_serialize_size(pos);
 	while (name_size != 0) {
 		const char *param_name = (const char *)*pos;
 		size_t param_size;
 
+		/* names are stored with their size, so most mismatches can be
+		 * skipped without looking at the string at all */
 		*pos += name_size;
-		if (strcmp(param_name, name) == 0)
+		if (name_size == name_len && memcmp(param_name, name, name_len) == 0)
 			return true;
 
 		param_size = cd_serialize_size(pos);
@@ -236,3 +241,167 @@ bool calldata_get_string(const calldata_t *data, const char *name, const char **
 	*str = cd_serialize_string(&pos);
 	return true;
 }
+
+/* ------------------------------------------------------------------------- */
+
+/*
+ *   A layout is a pre-serialized stack for a declaration.  Every parameter
+ * with a fixed size is laid out up front, in declaration order, so that its
+ * data always lives at the same offset and can be overwritten in place.
+ * Strings are not part of the layout and are appended after the fixed
+ * parameters when set, which means they never move a fixed parameter.
+ */
+
+#define CD_NO_SLOT ((size_t)-1)
+
+struct calldata_layout {
+	struct decl_info decl;
+	uint8_t *stack;
+	size_t size;
+
+	/* offset of the data size of each parameter, or CD_NO_SLOT */
+	size_t *offsets;
+};
+
+static inline size_t cd_type_size(enum call_param_type type)
+{
+	switch (type) {
+	case CALL_PARAM_TYPE_INT:
+		return sizeof(long long);
+	case CALL_PARAM_TYPE_FLOAT:
+		return sizeof(double);
+	case CALL_PARAM_TYPE_BOOL:
+		return sizeof(bool);
+	case CALL_PARAM_TYPE_PTR:
+		return sizeof(void *);
+	case CALL_PARAM_TYPE_VOID:
+	case CALL_PARAM_TYPE_STRING:
+		break;
+	}
+
+	return 0;
+}
+
+calldata_layout_t *calldata_layout_create(const char *decl_string)
+{
+	struct calldata_layout *layout = bzalloc(sizeof(struct calldata_layout));
+	size_t size = sizeof(size_t);
+	uint8_t *pos;
+
+	if (!parse_decl_string(&layout->decl, decl_string)) {
+		blog(LOG_ERROR, "Calldata layout declaration invalid: %s", decl_string);
+		bfree(layout);
+		return NULL;
+	}
+
+	layout->offsets = bmalloc(sizeof(size_t) * (layout->decl.params.num + 1));
+
+	for (size_t i = 0; i < layout->decl.params.num; i++) {
+		struct decl_param *param = layout->decl.params.array + i;
+		size_t data_size = cd_type_size(param->type);
+
+		if (data_size)
+			size += sizeof(size_t) * 2 + strlen(param->name) + 1 + data_size;
+	}
+
+	layout->stack = bzalloc(size);
+	layout->size = size;
+	pos = layout->stack;
+
+	for (size_t i = 0; i < layout->decl.params.num; i++) {
+		struct decl_param *param = layout->decl.params.array + i;
+		size_t data_size = cd_type_size(param->type);
+
+		if (!data_size) {
+			layout->offsets[i] = CD_NO_SLOT;
+			continue;
+		}
+
+		cd_copy_string(&pos, param->name, 0);
+		layout->offsets[i] = pos - layout->stack;
+
+		memcpy(pos, &data_size, sizeof(size_t));
+		pos += sizeof(size_t) + data_size;
+	}
+
+	return layout;
+}
+
+void calldata_layout_destroy(calldata_layout_t *layout)
+{
+	if (!layout)
+		return;
+
+	decl_info_free(&layout->decl);
+	bfree(layout->offsets);
+	bfree(layout->stack);
+	bfree(layout);
+}
+
+size_t calldata_layout_size(const calldata_layout_t *layout)
+{
+	return layout ? layout->size : 0;
+}
+
+void calldata_init_layout(calldata_t *data, const calldata_layout_t *layout, uint8_t *stack, size_t size)
+{
+	calldata_init_fixed(data, stack, size);
+
+	if (!layout)
+		return;
+
+	/* the terminator doubles as room for appending, so require more */
+	if (layout->size >= size) {
+		blog(LOG_ERROR, "Calldata layout '%s' does not fit a %zu byte stack", layout->decl.name, size);
+		return;
+	}
+
+	memcpy(stack, layout->stack, layout->size);
+	data->size = layout->size;
+}
+
+static inline uint8_t *cd_getslot(const calldata_t *data, const calldata_layout_t *layout, size_t slot,
+				  size_t size)
+{
+	size_t offset;
+	size_t cur_size;
+
+	if (!data || !layout || slot >= layout->decl.params.num)
+		return NULL;
+
+	offset = layout->offsets[slot];
+	if (offset == CD_NO_SLOT || offset + sizeof(size_t) + size > data->size)
+		return NULL;
+
+	/* a setter by name with a different size may have moved things */
+	memcpy(&cur_size, data->stack + offset, sizeof(size_t));
+	if (cur_size != size)
+		return NULL;
+
+	return data->stack + offset + sizeof(size_t);
+}
+
+void calldata_set_slot(calldata_t *data, const calldata_layout_t *layout, size_t slot, const void *in, size_t size)
+{
+	uint8_t *pos = cd_getslot(data, layout, slot, size);
+
+	if (pos)
+		memcpy(pos, in, size);
+	else if (layout && slot < layout->decl.params.num)
+		calldata_set_data(data, layout->decl.params.array[slot].name, in, size);
+}
+
+bool calldata_get_slot(const calldata_t *data, const calldata_layout_t *layout, size_t slot, void *out, size_t size)
+{
+	uint8_t *pos = cd_getslot(data, layout, slot, size);
+
+	if (pos) {
+		memcpy(out, pos, size);
+		return true;
+	}
+
+	if (!layout || slot >= layout->decl.params.num)
+		return false;
+
+	return calldata_get_data(data, layout->decl.params.array[slot].name, out, size);
+}
@@ -190,6 +190,78 @@ static inline void calldata_set_string(calldata_t *data, const char *name, const
 		calldata_set_data(data, name, NULL, 0);
 }
 
+/* ------------------------------------------------------------------------- */
+/*
+ *   Layouts pre-serialize every non-string parameter of a declaration so that
+ * a calldata stack can be set up with a single copy, and parameters can then
+ * be set and read by their index in the declaration without any lookups or
+ * allocations.  Parameters can still be accessed by name as usual.
+ */
+
+struct calldata_layout;
+typedef struct calldata_layout calldata_layout_t;
+
+EXPORT calldata_layout_t *calldata_layout_create(const char *decl_string);
+EXPORT void calldata_layout_destroy(calldata_layout_t *layout);
+EXPORT size_t calldata_layout_size(const calldata_layout_t *layout);
+
+EXPORT void calldata_init_layout(calldata_t *data, const calldata_layout_t *layout, uint8_t *stack, size_t size);
+
+EXPORT void calldata_set_slot(calldata_t *data, const calldata_layout_t *layout, size_t slot, const void *in,
+			      size_t size);
+EXPORT bool calldata_get_slot(const calldata_t *data, const calldata_layout_t *layout, size_t slot, void *out,
+			      size_t size);
+
+static inline void calldata_set_slot_int(calldata_t *data, const calldata_layout_t *layout, size_t slot,
+					 long long val)
+{
+	calldata_set_slot(data, layout, slot, &val, sizeof(val));
+}
+
+static inline void calldata_set_slot_float(calldata_t *data, const calldata_layout_t *layout, size_t slot,
+					   double val)
+{
+	calldata_set_slot(data, layout, slot, &val, sizeof(val));
+}
+
+static inline void calldata_set_slot_bool(calldata_t *data, const calldata_layout_t *layout, size_t slot, bool val)
+{
+	calldata_set_slot(data, layout, slot, &val, sizeof(val));
+}
+
+static inline void calldata_set_slot_ptr(calldata_t *data, const calldata_layout_t *layout, size_t slot, void *ptr)
+{
+	calldata_set_slot(data, layout, slot, &ptr, sizeof(ptr));
+}
+
+static inline long long calldata_slot_int(const calldata_t *data, const calldata_layout_t *layout, size_t slot)
+{
+	long long val = 0;
+	calldata_get_slot(data, layout, slot, &val, sizeof(val));
+	return val;
+}
+
+static inline double calldata_slot_float(const calldata_t *data, const calldata_layout_t *layout, size_t slot)
+{
+	double val = 0.0;
+	calldata_get_slot(data, layout, slot, &val, sizeof(val));
+	return val;
+}
+
+static inline bool calldata_slot_bool(const calldata_t *data, const calldata_layout_t *layout, size_t slot)
+{
+	bool val = false;
+	calldata_get_slot(data, layout, slot, &val, sizeof(val));
+	return val;
+}
+
+static inline void *calldata_slot_ptr(const calldata_t *data, const calldata_layout_t *layout, size_t slot)
+{
+	void *val = NULL;
+	calldata_get_slot(data, layout, slot, &val, sizeof(val));
+	return val;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,6 +15,7 @@
  */
 
 #include "../util/darray.h"
+#include "../util/fnv.h"
 #include "../util/threading.h"
 
 #include "decl.h"
@@ -22,6 +23,7 @@
 
 struct proc_info {
 	struct decl_info func;
+	uint32_t hash;
 	void *data;
 	proc_handler_proc_t callback;
 };
@@ -32,24 +34,68 @@ static inline void proc_info_free(struct proc_info *pi)
 }
 
 struct proc_handler {
-	/* TODO: replace with hash table lookup? */
 	pthread_mutex_t mutex;
 	DARRAY(struct proc_info) procs;
+
+	/* open addressed index into procs, stores index + 1, 0 is empty */
+	size_t *slots;
+	size_t mask;
 };
 
 static struct proc_info *getproc(proc_handler_t *handler, const char *name)
 {
-	for (size_t i = 0; i < handler->procs.num; i++) {
-		struct proc_info *info = handler->procs.array + i;
+	if (!handler->slots)
+		return NULL;
+
+	uint32_t hash = fnv1a_str32(name);
+	size_t i = hash & handler->mask;
+
+	for (size_t slot = handler->slots[i]; slot; slot = handler->slots[i]) {
+		struct proc_info *info = handler->procs.array + slot - 1;
 
-		if (strcmp(info->func.name, name) == 0) {
+		if (info->hash == hash && strcmp(info->func.name, name) == 0)
 			return info;
-		}
+
+		i = (i + 1) & handler->mask;
 	}
 
 	return NULL;
 }
 
+static inline void index_insert(proc_handler_t *handler, size_t idx)
+{
+	size_t i = handler->procs.array[idx].hash & handler->mask;
+
+	while (handler->slots[i])
+		i = (i + 1) & handler->mask;
+
+	handler->slots[i] = idx + 1;
+}
+
+/* must be called with the mutex locked, after the proc has been pushed */
+static void index_add(proc_handler_t *handler)
+{
+	size_t num = handler->procs.num;
+	size_t capacity = handler->slots ? handler->mask + 1 : 0;
+
+	/* keep the load factor at or below one half */
+	if (capacity < num * 2) {
+		if (!capacity)
+			capacity = 16;
+		while (capacity < num * 2)
+			capacity *= 2;
+
+		bfree(handler->slots);
+		handler->slots = bzalloc(sizeof(size_t) * capacity);
+		handler->mask = capacity - 1;
+
+		for (size_t i = 0; i < num; i++)
+			index_insert(handler, i);
+	} else {
+		index_insert(handler, num - 1);
+	}
+}
+
 /* ------------------------------------------------------------------------- */
 
 proc_handler_t *proc_handler_create(void)
@@ -63,6 +109,8 @@ proc_handler_t *proc_handler_create(void)
 	}
 
 	da_init(handler->procs);
+	handler->slots = NULL;
+	handler->mask = 0;
 	return handler;
 }
 
@@ -75,6 +123,7 @@ void proc_handler_destroy(proc_handler_t *handler)
 		proc_info_free(handler->procs.array + i);
 
 	da_free(handler->procs);
+	bfree(handler->slots);
 	pthread_mutex_destroy(&handler->mutex);
 	bfree(handler);
 }
@@ -92,6 +141,7 @@ void proc_handler_add(proc_handler_t *handler, const char *decl_string, proc_han
 		return;
 	}
 
+	pi.hash = fnv1a_str32(pi.func.name);
 	pi.callback = proc;
 	pi.data = data;
 
@@ -103,6 +153,7 @@ void proc_handler_add(proc_handler_t *handler, const char *decl_string, proc_han
 		proc_info_free(&pi);
 	} else {
 		da_push_back(handler->procs, &pi);
+		index_add(handler);
 	}
 
 	pthread_mutex_unlock(&handler->mutex);
@@ -15,39 +15,157 @@
  */
 
 #include "../util/darray.h"
+#include "../util/fnv.h"
 #include "../util/threading.h"
+#include "../util/platform.h"
 
 #include "decl.h"
 #include "signal.h"
 
+/*
+ *   Emitting a signal does not take any locks: the signal table and the
+ * callback list of each signal are immutable snapshots that are replaced
+ * (copy on write) when signals are added or callbacks (dis)connected.
+ * Replaced snapshots are kept until no thread is emitting anymore.
+ */
+
 struct signal_callback {
 	signal_callback_t callback;
 	void *data;
-	bool remove;
+	volatile bool remove;
 	bool keep_ref;
+	bool deferred;
+
+	/* in-flight calls, used to wait for them when disconnecting */
+	volatile long calls;
+	volatile long refs;
+};
+
+struct callback_list {
+	struct callback_list *next_retired;
+	size_t num;
+	struct signal_callback *array[];
 };
 
 struct signal_info {
 	struct decl_info func;
-	DARRAY(struct signal_callback) callbacks;
+	uint32_t hash;
+
+	struct callback_list *volatile callbacks;
+	struct callback_list *retired;
+	volatile long emitting;
+
+	/* serializes writers only */
 	pthread_mutex_t mutex;
-	bool signalling;
+};
 
-	struct signal_info *next;
+struct signal_table {
+	struct signal_table *next_retired;
+	size_t num;
+	size_t mask;
+	struct signal_info *slots[];
 };
 
+struct global_callback_info {
+	global_signal_callback_t callback;
+	void *data;
+	long signaling;
+	bool remove;
+};
+
+struct signal_handler {
+	struct signal_table *volatile table;
+	struct signal_table *retired;
+	volatile long readers;
+	pthread_mutex_t mutex;
+	volatile long refs;
+
+	DARRAY(struct global_callback_info) global_callbacks;
+	pthread_mutex_t global_callbacks_mutex;
+	volatile long num_global_callbacks;
+};
+
+/* callbacks currently being called on this thread, innermost first */
+struct callback_frame {
+	struct signal_callback *cb;
+	struct global_callback_info *global_cb;
+	struct callback_frame *prev;
+};
+
+static THREAD_LOCAL struct callback_frame *current_frame = NULL;
+
+static void queue_deferred(struct signal_callback *cb, calldata_t *params);
+
+/* ------------------------------------------------------------------------- */
+
+static inline void callback_addref(struct signal_callback *cb)
+{
+	os_atomic_inc_long(&cb->refs);
+}
+
+static inline void callback_release(struct signal_callback *cb)
+{
+	if (cb && os_atomic_dec_long(&cb->refs) == 0)
+		bfree(cb);
+}
+
+static struct callback_list *callback_list_create(size_t num)
+{
+	struct callback_list *list = bmalloc(sizeof(struct callback_list) + sizeof(struct signal_callback *) * num);
+	list->next_retired = NULL;
+	list->num = 0;
+	return list;
+}
+
+static void callback_list_destroy(struct callback_list *list)
+{
+	if (!list)
+		return;
+
+	for (size_t i = 0; i < list->num; i++)
+		callback_release(list->array[i]);
+	bfree(list);
+}
+
+static inline struct callback_list *get_callbacks(struct signal_info *si)
+{
+	return os_atomic_load_ptr((void *const volatile *)&si->callbacks);
+}
+
+static void free_retired_callbacks(struct signal_info *si)
+{
+	while (si->retired) {
+		struct callback_list *next = si->retired->next_retired;
+		callback_list_destroy(si->retired);
+		si->retired = next;
+	}
+}
+
+/* must be called with the signal mutex locked */
+static void set_callbacks(struct signal_info *si, struct callback_list *list)
+{
+	struct callback_list *old = os_atomic_exchange_ptr((void *volatile *)&si->callbacks, list);
+
+	old->next_retired = si->retired;
+	si->retired = old;
+
+	/* any emitter starting from now on sees the new list */
+	if (os_atomic_load_long(&si->emitting) == 0)
+		free_retired_callbacks(si);
+}
+
 static inline struct signal_info *signal_info_create(struct decl_info *info)
 {
-	struct signal_info *si = bmalloc(sizeof(struct signal_info));
+	struct signal_info *si = bzalloc(sizeof(struct signal_info));
 	si->func = *info;
-	si->next = NULL;
-	si->signalling = false;
-	da_init(si->callbacks);
+	si->hash = fnv1a_str32(info->name);
+	si->callbacks = callback_list_create(0);
 
-	if (pthread_mutex_init_recursive(&si->mutex) != 0) {
+	if (pthread_mutex_init(&si->mutex, NULL) != 0) {
 		blog(LOG_ERROR, "Could not create signal");
 
 		decl_info_free(&si->func);
+		bfree(si->callbacks);
 		bfree(si);
 		return NULL;
 	}
@@ -58,57 +176,119 @@ static inline struct signal_info *signal_info_create(struct decl_info *info)
 static inline void signal_info_destroy(struct signal_info *si)
 {
 	if (si) {
+		struct callback_list *list = get_callbacks(si);
+
+		/* pending deferred calls may still hold callback references */
+		for (size_t i = 0; i < list->num; i++)
+			os_atomic_set_bool(&list->array[i]->remove, true);
+
+		free_retired_callbacks(si);
+		callback_list_destroy(list);
 		pthread_mutex_destroy(&si->mutex);
 		decl_info_free(&si->func);
-		da_free(si->callbacks);
 		bfree(si);
 	}
 }
 
-static inline size_t signal_get_callback_idx(struct signal_info *si, signal_callback_t callback, void *data)
+static inline size_t signal_get_callback_idx(struct callback_list *list, signal_callback_t callback, void *data)
 {
-	for (size_t i = 0; i < si->callbacks.num; i++) {
-		struct signal_callback *sc = si->callbacks.array + i;
+	for (size_t i = 0; i < list->num; i++) {
+		struct signal_callback *sc = list->array[i];
 
-		if (sc->callback == callback && sc->data == data)
+		if (sc->callback == callback && sc->data == data && !os_atomic_load_bool(&sc->remove))
 			return i;
 	}
 
 	return DARRAY_INVALID;
 }
 
-struct global_callback_info {
-	global_signal_callback_t callback;
-	void *data;
-	long signaling;
-	bool remove;
-};
+/* ------------------------------------------------------------------------- */
 
-struct signal_handler {
-	struct signal_info *first;
-	pthread_mutex_t mutex;
-	volatile long refs;
+static inline struct signal_table *get_table(signal_handler_t *handler)
+{
+	return os_atomic_load_ptr((void *const volatile *)&handler->table);
+}
 
-	DARRAY(struct global_callback_info) global_callbacks;
-	pthread_mutex_t global_callbacks_mutex;
-};
+static struct signal_info *table_find(struct signal_table *table, const char *name)
+{
+	if (!table)
+		return NULL;
+
+	uint32_t hash = fnv1a_str32(name);
+	size_t i = hash & table->mask;
+
+	for (struct signal_info *si = table->slots[i]; si; si = table->slots[i]) {
+		if (si->hash == hash && strcmp(si->func.name, name) == 0)
+			return si;
+
+		i = (i + 1) & table->mask;
+	}
+
+	return NULL;
+}
 
-static struct signal_info *getsignal(signal_handler_t *handler, const char *name, struct signal_info **p_last)
+static inline void table_insert(struct signal_table *table, struct signal_info *si)
 {
-	struct signal_info *signal, *last = NULL;
+	size_t i = si->hash & table->mask;
 
-	signal = handler->first;
-	while (signal != NULL) {
-		if (strcmp(signal->func.name, name) == 0)
-			break;
+	while (table->slots[i])
+		i = (i + 1) & table->mask;
+
+	table->slots[i] = si;
+	table->num++;
+}
+
+/* must be called with the handler mutex locked */
+static void table_add(signal_handler_t *handler, struct signal_info *si)
+{
+	struct signal_table *old = get_table(handler);
+	size_t num = old ? old->num + 1 : 1;
+	size_t capacity = 16;
+
+	/* keep the load factor at or below one half */
+	while (capacity < num * 2)
+		capacity *= 2;
+
+	struct signal_table *table = bzalloc(sizeof(struct signal_table) + sizeof(struct signal_info *) * capacity);
+	table->mask = capacity - 1;
+
+	if (old) {
+		for (size_t i = 0; i <= old->mask; i++) {
+			if (old->slots[i])
+				table_insert(table, old->slots[i]);
+		}
+	}
+	table_insert(table, si);
+
+	os_atomic_exchange_ptr((void *volatile *)&handler->table, table);
+
+	if (old) {
+		old->next_retired = handler->retired;
+		handler->retired = old;
+	}
 
-		last = signal;
-		signal = signal->next;
+	if (os_atomic_load_long(&handler->readers) == 0) {
+		while (handler->retired) {
+			struct signal_table *next = handler->retired->next_retired;
+			bfree(handler->retired);
+			handler->retired = next;
+		}
 	}
+}
+
+static struct signal_info *getsignal(signal_handler_t *handler, const char *name)
+{
+	struct signal_info *sig;
+
+	if (!handler)
+		return NULL;
 
-	if (p_last)
-		*p_last = last;
-	return signal;
+	/* signal infos live as long as the handler, only the table changes */
+	os_atomic_inc_long(&handler->readers);
+	sig = table_find(get_table(handler), name);
+	os_atomic_dec_long(&handler->readers);
+
+	return sig;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -116,7 +296,6 @@ static struct signal_info *getsignal(signal_handler_t *handler, const char *name
 signal_handler_t *signal_handler_create(void)
 {
 	struct signal_handler *handler = bzalloc(sizeof(struct signal_handler));
-	handler->first = NULL;
 	handler->refs = 1;
 
 	if (pthread_mutex_init(&handler->mutex, NULL) != 0) {
@@ -137,11 +316,18 @@ signal_handler_t *signal_handler_create(void)
 
 static void signal_handler_actually_destroy(signal_handler_t *handler)
 {
-	struct signal_info *sig = handler->first;
-	while (sig != NULL) {
-		struct signal_info *next = sig->next;
-		signal_info_destroy(sig);
-		sig = next;
+	struct signal_table *table = get_table(handler);
+
+	if (table) {
+		for (size_t i = 0; i <= table->mask; i++)
+			signal_info_destroy(table->slots[i]);
+		bfree(table);
+	}
+
+	while (handler->retired) {
+		struct signal_table *next = handler->retired->next_retired;
+		bfree(handler->retired);
+		handler->retired = next;
 	}
 
 	da_free(handler->global_callbacks);
@@ -160,7 +346,7 @@ void signal_handler_destroy(signal_handler_t *handler)
 bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 {
 	struct decl_info func = {0};
-	struct signal_info *sig, *last;
+	struct signal_info *sig;
 	bool success = true;
 
 	if (!parse_decl_string(&func, signal_decl)) {
@@ -170,17 +356,17 @@ bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 
 	pthread_mutex_lock(&handler->mutex);
 
-	sig = getsignal(handler, func.name, &last);
+	sig = table_find(get_table(handler), func.name);
 	if (sig) {
 		blog(LOG_WARNING, "Signal declaration '%s' exists", func.name);
 		decl_info_free(&func);
 		success = false;
 	} else {
 		sig = signal_info_create(&func);
-		if (!last)
-			handler->first = sig;
+		if (sig)
+			table_add(handler, sig);
 		else
-			last->next = sig;
+			success = false;
 	}
 
 	pthread_mutex_unlock(&handler->mutex);
@@ -189,19 +375,15 @@ bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 }
 
 static void signal_handler_connect_internal(signal_handler_t *handler, const char *signal, signal_callback_t callback,
-					    void *data, bool keep_ref)
+					    void *data, bool keep_ref, bool deferred)
 {
-	struct signal_info *sig, *last;
-	struct signal_callback cb_data = {callback, data, false, keep_ref};
-	size_t idx;
+	struct signal_info *sig;
+	struct callback_list *list;
 
 	if (!handler)
 		return;
 
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, signal, &last);
-	pthread_mutex_unlock(&handler->mutex);
-
+	sig = getsignal(handler, signal);
 	if (!sig) {
 		blog(LOG_WARNING,
 		     "signal_handler_connect: "
@@ -217,41 +399,95 @@ static void signal_handler_connect_internal(signal_handler_t *handler, const cha
 	if (keep_ref)
 		os_atomic_inc_long(&handler->refs);
 
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (keep_ref || idx == DARRAY_INVALID)
-		da_push_back(sig->callbacks, &cb_data);
+	list = get_callbacks(sig);
+
+	if (keep_ref || signal_get_callback_idx(list, callback, data) == DARRAY_INVALID) {
+		struct signal_callback *cb = bzalloc(sizeof(struct signal_callback));
+		struct callback_list *new_list = callback_list_create(list->num + 1);
+
+		cb->callback = callback;
+		cb->data = data;
+		cb->keep_ref = keep_ref;
+		cb->deferred = deferred;
+		cb->refs = 1;
+
+		for (size_t i = 0; i < list->num; i++) {
+			callback_addref(list->array[i]);
+			new_list->array[i] = list->array[i];
+		}
+		new_list->array[list->num] = cb;
+		new_list->num = list->num + 1;
+
+		set_callbacks(sig, new_list);
+	}
 
 	pthread_mutex_unlock(&sig->mutex);
 }
 
 void signal_handler_connect(signal_handler_t *handler, const char *signal, signal_callback_t callback, void *data)
 {
-	signal_handler_connect_internal(handler, signal, callback, data, false);
+	signal_handler_connect_internal(handler, signal, callback, data, false, false);
 }
 
 void signal_handler_connect_ref(signal_handler_t *handler, const char *signal, signal_callback_t callback, void *data)
 {
-	signal_handler_connect_internal(handler, signal, callback, data, true);
+	signal_handler_connect_internal(handler, signal, callback, data, true, false);
 }
 
-static inline struct signal_info *getsignal_locked(signal_handler_t *handler, const char *name)
+void signal_handler_connect_deferred(signal_handler_t *handler, const char *signal, signal_callback_t callback,
+				     void *data)
 {
-	struct signal_info *sig;
+	signal_handler_connect_internal(handler, signal, callback, data, false, true);
+}
 
-	if (!handler)
-		return NULL;
+/* Removes callbacks flagged for removal from the list, returning the number
+ * of handler references they were holding.  Must be called with the signal
+ * mutex locked. */
+static long purge_callbacks(struct signal_info *sig)
+{
+	struct callback_list *list = get_callbacks(sig);
+	struct callback_list *new_list;
+	long remove_refs = 0;
 
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, name, NULL);
-	pthread_mutex_unlock(&handler->mutex);
+	new_list = callback_list_create(list->num);
 
-	return sig;
+	for (size_t i = 0; i < list->num; i++) {
+		struct signal_callback *cb = list->array[i];
+
+		if (os_atomic_load_bool(&cb->remove)) {
+			if (cb->keep_ref)
+				remove_refs++;
+		} else {
+			callback_addref(cb);
+			new_list->array[new_list->num++] = cb;
+		}
+	}
+
+	if (new_list->num == list->num)
+		callback_list_destroy(new_list);
+	else
+		set_callbacks(sig, new_list);
+
+	return remove_refs;
+}
+
+static inline long calls_on_this_thread(struct signal_callback *cb)
+{
+	long calls = 0;
+
+	for (struct callback_frame *frame = current_frame; frame; frame = frame->prev) {
+		if (frame->cb == cb)
+			calls++;
+	}
+
+	return calls;
 }
 
 void signal_handler_disconnect(signal_handler_t *handler, const char *signal, signal_callback_t callback, void *data)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
-	bool keep_ref = false;
+	struct signal_info *sig = getsignal(handler, signal);
+	struct signal_callback *cb = NULL;
+	long remove_refs = 0;
 	size_t idx;
 
 	if (!sig)
@@ -259,91 +495,130 @@ void signal_handler_disconnect(signal_handler_t *handler, const char *signal, si
 
 	pthread_mutex_lock(&sig->mutex);
 
-	idx = signal_get_callback_idx(sig, callback, data);
+	idx = signal_get_callback_idx(get_callbacks(sig), callback, data);
 	if (idx != DARRAY_INVALID) {
-		if (sig->signalling) {
-			sig->callbacks.array[idx].remove = true;
-		} else {
-			keep_ref = sig->callbacks.array[idx].keep_ref;
-			da_erase(sig->callbacks, idx);
-		}
+		cb = get_callbacks(sig)->array[idx];
+		callback_addref(cb);
+
+		os_atomic_set_bool(&cb->remove, true);
+		remove_refs = purge_callbacks(sig);
 	}
 
 	pthread_mutex_unlock(&sig->mutex);
 
-	if (keep_ref && os_atomic_dec_long(&handler->refs) == 0) {
+	if (!cb)
+		return;
+
+	/* Callers expect the callback to not be running anymore once this
+	 * returns, unless it is being called further up this thread's stack */
+	long own_calls = calls_on_this_thread(cb);
+	while (os_atomic_load_long(&cb->calls) > own_calls)
+		os_sleep_ms(1);
+
+	callback_release(cb);
+
+	if (remove_refs && os_atomic_dec_long(&handler->refs) == 0) {
 		signal_handler_actually_destroy(handler);
 	}
 }
 
-static THREAD_LOCAL struct signal_callback *current_signal_cb = NULL;
-static THREAD_LOCAL struct global_callback_info *current_global_cb = NULL;
-
 void signal_handler_remove_current(void)
 {
-	if (current_signal_cb)
-		current_signal_cb->remove = true;
-	else if (current_global_cb)
-		current_global_cb->remove = true;
+	if (!current_frame)
+		return;
+
+	if (current_frame->cb)
+		os_atomic_set_bool(&current_frame->cb->remove, true);
+	else
+		current_frame->global_cb->remove = true;
 }
 
-void signal_handler_signal(signal_handler_t *handler, const char *signal, calldata_t *params)
+static inline void call_callback(struct signal_callback *cb, calldata_t *params)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
-	long remove_refs = 0;
+	struct callback_frame frame = {cb, NULL, current_frame};
 
-	if (!sig)
-		return;
+	os_atomic_inc_long(&cb->calls);
 
-	pthread_mutex_lock(&sig->mutex);
-	sig->signalling = true;
+	if (!os_atomic_load_bool(&cb->remove)) {
+		current_frame = &frame;
+		cb->callback(cb->data, params);
+		current_frame = frame.prev;
+	}
+
+	os_atomic_dec_long(&cb->calls);
+}
+
+static void signal_global_callbacks(signal_handler_t *handler, const char *signal, calldata_t *params)
+{
+	pthread_mutex_lock(&handler->global_callbacks_mutex);
+
+	for (size_t i = 0; i < handler->global_callbacks.num; i++) {
+		struct global_callback_info *cb = handler->global_callbacks.array + i;
 
-	for (size_t i = 0; i < sig->callbacks.num; i++) {
-		struct signal_callback *cb = sig->callbacks.array + i;
 		if (!cb->remove) {
-			current_signal_cb = cb;
-			cb->callback(cb->data, params);
-			current_signal_cb = NULL;
+			struct callback_frame frame = {NULL, cb, current_frame};
+
+			cb->signaling++;
+			current_frame = &frame;
+			cb->callback(cb->data, signal, params);
+			current_frame = frame.prev;
+			cb->signaling--;
 		}
 	}
 
-	for (size_t i = sig->callbacks.num; i > 0; i--) {
-		struct signal_callback *cb = sig->callbacks.array + i - 1;
-		if (cb->remove) {
-			if (cb->keep_ref)
-				remove_refs++;
+	for (size_t i = handler->global_callbacks.num; i > 0; i--) {
+		struct global_callback_info *cb = handler->global_callbacks.array + (i - 1);
 
-			da_erase(sig->callbacks, i - 1);
-		}
+		if (cb->remove && !cb->signaling)
+			da_erase(handler->global_callbacks, i - 1);
 	}
 
-	sig->signalling = false;
-	pthread_mutex_unlock(&sig->mutex);
+	os_atomic_set_long(&handler->num_global_callbacks, (long)handler->global_callbacks.num);
 
-	pthread_mutex_lock(&handler->global_callbacks_mutex);
+	pthread_mutex_unlock(&handler->global_callbacks_mutex);
+}
 
-	if (handler->global_callbacks.num) {
-		for (size_t i = 0; i < handler->global_callbacks.num; i++) {
-			struct global_callback_info *cb = handler->global_callbacks.array + i;
+void signal_handler_signal(signal_handler_t *handler, const char *signal, calldata_t *params)
+{
+	struct signal_info *sig = getsignal(handler, signal);
+	struct callback_list *list;
+	long remove_refs = 0;
+	bool purge = false;
 
-			if (!cb->remove) {
-				cb->signaling++;
-				current_global_cb = cb;
-				cb->callback(cb->data, signal, params);
-				current_global_cb = NULL;
-				cb->signaling--;
-			}
-		}
+	if (!sig)
+		return;
 
-		for (size_t i = handler->global_callbacks.num; i > 0; i--) {
-			struct global_callback_info *cb = handler->global_callbacks.array + (i - 1);
+	os_atomic_inc_long(&sig->emitting);
+	list = get_callbacks(sig);
 
-			if (cb->remove && !cb->signaling)
-				da_erase(handler->global_callbacks, i - 1);
+	for (size_t i = 0; i < list->num; i++) {
+		struct signal_callback *cb = list->array[i];
+
+		if (os_atomic_load_bool(&cb->remove)) {
+			purge = true;
+			continue;
 		}
+
+		if (cb->deferred)
+			queue_deferred(cb, params);
+		else
+			call_callback(cb, params);
+
+		/* removed from within the callback */
+		if (os_atomic_load_bool(&cb->remove))
+			purge = true;
 	}
 
-	pthread_mutex_unlock(&handler->global_callbacks_mutex);
+	os_atomic_dec_long(&sig->emitting);
+
+	if (purge) {
+		pthread_mutex_lock(&sig->mutex);
+		remove_refs = purge_callbacks(sig);
+		pthread_mutex_unlock(&sig->mutex);
+	}
+
+	if (os_atomic_load_long(&handler->num_global_callbacks))
+		signal_global_callbacks(handler, signal, params);
 
 	if (remove_refs) {
 		os_atomic_set_long(&handler->refs, os_atomic_load_long(&handler->refs) - remove_refs);
@@ -364,6 +639,8 @@ void signal_handler_connect_global(signal_handler_t *handler, global_signal_call
 	if (idx == DARRAY_INVALID)
 		da_push_back(handler->global_callbacks, &cb_data);
 
+	os_atomic_set_long(&handler->num_global_callbacks, (long)handler->global_callbacks.num);
+
 	pthread_mutex_unlock(&handler->global_callbacks_mutex);
 }
 
@@ -387,5 +664,185 @@ void signal_handler_disconnect_global(signal_handler_t *handler, global_signal_c
 			da_erase(handler->global_callbacks, idx);
 	}
 
+	os_atomic_set_long(&handler->num_global_callbacks, (long)handler->global_callbacks.num);
+
 	pthread_mutex_unlock(&handler->global_callbacks_mutex);
 }
+
+/* ------------------------------------------------------------------------- */
+/* Deferred delivery                                                         */
+
+/*
+ *   Deferred calls are pushed to an intrusive multi-producer single-consumer
+ * queue (Vyukov), so emitting threads never wait for the dispatcher.
+ */
+
+struct deferred_call {
+	struct deferred_call *volatile next;
+	struct signal_callback *cb;
+	calldata_t params;
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	pthread_t thread;
+	bool active;
+	volatile bool stop;
+	os_sem_t *sem;
+
+	struct deferred_call stub;
+	struct deferred_call *volatile head;
+	struct deferred_call *tail;
+} dispatcher = {.mutex = PTHREAD_MUTEX_INITIALIZER};
+
+static inline struct deferred_call *next_call(struct deferred_call *call)
+{
+	return os_atomic_load_ptr((void *const volatile *)&call->next);
+}
+
+static void dispatcher_push(struct deferred_call *call)
+{
+	call->next = NULL;
+	struct deferred_call *prev = os_atomic_exchange_ptr((void *volatile *)&dispatcher.head, call);
+	os_atomic_exchange_ptr((void *volatile *)&prev->next, call);
+}
+
+/* returns NULL if the queue is empty or a push is still in progress */
+static struct deferred_call *dispatcher_pop(void)
+{
+	struct deferred_call *tail = dispatcher.tail;
+	struct deferred_call *next = next_call(tail);
+
+	if (tail == &dispatcher.stub) {
+		if (!next)
+			return NULL;
+
+		dispatcher.tail = next;
+		tail = next;
+		next = next_call(next);
+	}
+
+	if (next) {
+		dispatcher.tail = next;
+		return tail;
+	}
+
+	if (tail != os_atomic_load_ptr((void *const volatile *)&dispatcher.head))
+		return NULL;
+
+	dispatcher_push(&dispatcher.stub);
+
+	next = next_call(tail);
+	if (next) {
+		dispatcher.tail = next;
+		return tail;
+	}
+
+	return NULL;
+}
+
+static void deferred_call_free(struct deferred_call *call)
+{
+	callback_release(call->cb);
+	calldata_free(&call->params);
+	bfree(call);
+}
+
+static void *dispatcher_thread(void *unused)
+{
+	os_set_thread_name("libobs: signal dispatcher");
+
+	while (os_sem_wait(dispatcher.sem) == 0) {
+		struct deferred_call *call;
+
+		/* deliver everything queued before the stop */
+		if (os_atomic_load_bool(&dispatcher.stop)) {
+			while ((call = dispatcher_pop()) != NULL) {
+				call_callback(call->cb, &call->params);
+				deferred_call_free(call);
+			}
+			break;
+		}
+
+		/* a post means a call was fully queued, but an earlier push on
+		 * another thread may still be linking itself in */
+		while (!(call = dispatcher_pop()))
+			os_sleep_ms(0);
+
+		call_callback(call->cb, &call->params);
+		deferred_call_free(call);
+	}
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+static bool dispatcher_start(void)
+{
+	bool success = true;
+
+	pthread_mutex_lock(&dispatcher.mutex);
+
+	if (!dispatcher.active) {
+		dispatcher.stub.next = NULL;
+		dispatcher.head = &dispatcher.stub;
+		dispatcher.tail = &dispatcher.stub;
+		dispatcher.stop = false;
+
+		success = os_sem_init(&dispatcher.sem, 0) == 0 &&
+			  pthread_create(&dispatcher.thread, NULL, dispatcher_thread, NULL) == 0;
+		if (success) {
+			dispatcher.active = true;
+		} else {
+			blog(LOG_ERROR, "Couldn't start signal dispatcher thread");
+			os_sem_destroy(dispatcher.sem);
+			dispatcher.sem = NULL;
+		}
+	}
+
+	pthread_mutex_unlock(&dispatcher.mutex);
+	return success;
+}
+
+static void queue_deferred(struct signal_callback *cb, calldata_t *params)
+{
+	if (!os_atomic_load_bool(&dispatcher.active) && !dispatcher_start())
+		return;
+
+	struct deferred_call *call = bzalloc(sizeof(struct deferred_call));
+
+	callback_addref(cb);
+	call->cb = cb;
+
+	if (params && params->size) {
+		call->params.stack = bmemdup(params->stack, params->size);
+		call->params.size = params->size;
+		call->params.capacity = params->size;
+	}
+
+	dispatcher_push(call);
+	os_sem_post(dispatcher.sem);
+}
+
+void signal_handler_shutdown_deferred(void)
+{
+	pthread_mutex_lock(&dispatcher.mutex);
+
+	if (dispatcher.active) {
+		os_atomic_set_bool(&dispatcher.stop, true);
+		os_sem_post(dispatcher.sem);
+		pthread_join(dispatcher.thread, NULL);
+
+		/* only pushes that were still linking in when the dispatcher
+		 * drained the queue are left */
+		struct deferred_call *call;
+		while ((call = dispatcher_pop()) != NULL)
+			deferred_call_free(call);
+
+		os_sem_destroy(dispatcher.sem);
+		dispatcher.sem = NULL;
+		os_atomic_set_bool(&dispatcher.active, false);
+	}
+
+	pthread_mutex_unlock(&dispatcher.mutex);
+}
@@ -58,6 +58,8 @@ EXPORT void signal_handler_connect(signal_handler_t *handler, const char *signal
 				   void *data);
 EXPORT void signal_handler_connect_ref(signal_handler_t *handler, const char *signal, signal_callback_t callback,
 				       void *data);
+EXPORT void signal_handler_connect_deferred(signal_handler_t *handler, const char *signal, signal_callback_t callback,
+					    void *data);
 EXPORT void signal_handler_disconnect(signal_handler_t *handler, const char *signal, signal_callback_t callback,
 				      void *data);
 
@@ -68,6 +70,8 @@ EXPORT void signal_handler_remove_current(void);
 
 EXPORT void signal_handler_signal(signal_handler_t *handler, const char *signal, calldata_t *params);
 
+EXPORT void signal_handler_shutdown_deferred(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,110 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Adaptive audio buffering controller
+ *
+ *   Keeps the worst amount of buffering (in audio ticks) that sources needed
+ * over a sliding window of one second slots.  Buffering grows as soon as a
+ * source is late, but is only given back one tick at a time, once the whole
+ * window has been covered without any source needing it.
+ */
+
+#define AUDIO_BUFFERING_SLOTS 10
+#define AUDIO_BUFFERING_SLOT_NS 1000000000ULL
+#define AUDIO_BUFFERING_STEP_NS 1000000000ULL
+
+struct audio_buffering {
+	uint32_t needed[AUDIO_BUFFERING_SLOTS];
+	size_t slot;
+	size_t slots_filled;
+	uint64_t slot_start;
+	uint64_t last_shrink;
+};
+
+static inline void audio_buffering_reset(struct audio_buffering *ab, uint64_t ts)
+{
+	memset(ab, 0, sizeof(struct audio_buffering));
+	ab->slot_start = ts;
+	ab->last_shrink = ts;
+}
+
+/* buffering had to grow, so everything observed before no longer counts */
+static inline void audio_buffering_grew(struct audio_buffering *ab, uint64_t ts)
+{
+	audio_buffering_reset(ab, ts);
+}
+
+/* records how many ticks of buffering sources needed at ts */
+static inline void audio_buffering_observe(struct audio_buffering *ab, uint64_t ts, uint32_t needed_ticks)
+{
+	if (!ab->slot_start || ts < ab->slot_start) {
+		audio_buffering_reset(ab, ts);
+
+	} else if (ts - ab->slot_start >= AUDIO_BUFFERING_SLOTS * AUDIO_BUFFERING_SLOT_NS) {
+		/* nothing was observed for the whole window, start over */
+		audio_buffering_reset(ab, ts);
+
+	} else {
+		while (ts - ab->slot_start >= AUDIO_BUFFERING_SLOT_NS) {
+			ab->slot = (ab->slot + 1) % AUDIO_BUFFERING_SLOTS;
+			ab->needed[ab->slot] = 0;
+			ab->slot_start += AUDIO_BUFFERING_SLOT_NS;
+
+			if (ab->slots_filled < AUDIO_BUFFERING_SLOTS)
+				ab->slots_filled++;
+		}
+	}
+
+	if (needed_ticks > ab->needed[ab->slot])
+		ab->needed[ab->slot] = needed_ticks;
+}
+
+/* returns true if one tick of buffering can be removed at ts */
+static inline bool audio_buffering_should_shrink(struct audio_buffering *ab, uint64_t ts, uint32_t cur_ticks)
+{
+	uint32_t needed = 0;
+
+	if (!cur_ticks || ab->slots_filled < AUDIO_BUFFERING_SLOTS)
+		return false;
+	if (ts - ab->last_shrink < AUDIO_BUFFERING_STEP_NS)
+		return false;
+
+	for (size_t i = 0; i < AUDIO_BUFFERING_SLOTS; i++) {
+		if (ab->needed[i] > needed)
+			needed = ab->needed[i];
+	}
+
+	if (needed >= cur_ticks)
+		return false;
+
+	ab->last_shrink = ts;
+	return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
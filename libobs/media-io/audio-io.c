@@ -71,6 +71,14 @@ struct audio_output {
 	pthread_t thread;
 	os_event_t *stop_event;
 
+	/* scheduling requested for the thread, applied by the thread itself */
+	volatile long sched_gen;
+	volatile bool sched_realtime;
+	volatile long sched_cpu;
+
+	/* extra blocks the input callback asked for to reduce its latency */
+	volatile long catch_up_blocks;
+
 	bool initialized;
 
 	audio_input_callback_t input_cb;
@@ -157,7 +165,7 @@ static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
 	}
 }
 
-static void input_and_output(struct audio_output *audio, uint64_t audio_time, uint64_t prev_time)
+static void output_block(struct audio_output *audio, uint64_t audio_time, uint64_t prev_time)
 {
 	size_t bytes = AUDIO_OUTPUT_FRAMES * audio->block_size;
 	struct audio_output_data data[MAX_AUDIO_MIXES];
@@ -202,6 +210,32 @@ static void input_and_output(struct audio_output *audio, uint64_t audio_time, ui
 		do_audio_output(audio, i, new_ts, AUDIO_OUTPUT_FRAMES);
 }
 
+static void input_and_output(struct audio_output *audio, uint64_t audio_time, uint64_t prev_time)
+{
+	output_block(audio, audio_time, prev_time);
+
+	/* catch-up blocks are requested with an empty time range, the input
+	 * callback outputs data it has already buffered for them */
+	while (os_atomic_load_long(&audio->catch_up_blocks) > 0) {
+		os_atomic_dec_long(&audio->catch_up_blocks);
+		output_block(audio, audio_time, audio_time);
+	}
+}
+
+static void apply_thread_scheduling(struct audio_output *audio, long *sched_gen)
+{
+	long gen = os_atomic_load_long(&audio->sched_gen);
+	if (gen == *sched_gen)
+		return;
+
+	*sched_gen = gen;
+#ifndef _WIN32
+	/* MMCSS already takes care of the priority on windows */
+	os_set_thread_realtime(os_atomic_load_bool(&audio->sched_realtime));
+#endif
+	os_set_thread_affinity((int)os_atomic_load_long(&audio->sched_cpu));
+}
+
 static void *audio_thread(void *param)
 {
 #ifdef _WIN32
@@ -219,12 +253,18 @@ static void *audio_thread(void *param)
 
 	const char *audio_thread_name =
 		profile_store_name(obs_get_profiler_name_store(), "audio_thread(%s)", audio->info.name);
+	const char *wakeup_name =
+		profile_store_name(obs_get_profiler_name_store(), "audio_thread(%s) wakeup jitter", audio->info.name);
+
+	os_pacer_t *pacer = os_pacer_create(wakeup_name);
+	long sched_gen = 0;
 
 	while (os_event_try(audio->stop_event) == EAGAIN) {
 		samples += AUDIO_OUTPUT_FRAMES;
 		uint64_t audio_time = start_time + audio_frames_to_ns(rate, samples);
 
-		os_sleepto_ns_fast(audio_time);
+		apply_thread_scheduling(audio, &sched_gen);
+		os_pacer_sleepto_ns(pacer, audio_time);
 
 		profile_start(audio_thread_name);
 
@@ -236,6 +276,8 @@ static void *audio_thread(void *param)
 		profile_reenable_thread();
 	}
 
+	os_pacer_destroy(pacer);
+
 #ifdef _WIN32
 	if (handle)
 		AvRevertMmThreadCharacteristics(handle);
@@ -244,6 +286,24 @@ static void *audio_thread(void *param)
 	return NULL;
 }
 
+void audio_output_set_thread_scheduling(audio_t *audio, bool realtime, int cpu)
+{
+	if (!audio)
+		return;
+
+	os_atomic_set_bool(&audio->sched_realtime, realtime);
+	os_atomic_set_long(&audio->sched_cpu, cpu);
+	os_atomic_inc_long(&audio->sched_gen);
+}
+
+void audio_output_catch_up(audio_t *audio, uint32_t blocks)
+{
+	if (!audio)
+		return;
+
+	os_atomic_set_long(&audio->catch_up_blocks, (long)blocks);
+}
+
 /* ------------------------------------------------------------------------- */
 
 static size_t audio_get_input_idx(const audio_t *audio, size_t mix_idx, audio_output_callback_t callback, void *param)
@@ -223,6 +223,15 @@ EXPORT size_t audio_output_get_channels(const audio_t *audio);
 EXPORT uint32_t audio_output_get_sample_rate(const audio_t *audio);
 EXPORT const struct audio_output_info *audio_output_get_info(const audio_t *audio);
 
+/** Requests realtime scheduling for the audio thread and pins it to a CPU,
+ * or unpins it if cpu is negative */
+EXPORT void audio_output_set_thread_scheduling(audio_t *audio, bool realtime, int cpu);
+
+/** Requests extra blocks right after the current one, so the input callback
+ * can output audio it has buffered ahead.  The input callback is called with
+ * start_ts equal to end_ts for each of them. */
+EXPORT void audio_output_catch_up(audio_t *audio, uint32_t blocks);
+
 #ifdef __cplusplus
 }
 #endif
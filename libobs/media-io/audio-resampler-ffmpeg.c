@@ -216,3 +216,17 @@ bool audio_resampler_resample(audio_resampler_t *rs, uint8_t *output[], uint32_t
 	*out_frames = (uint32_t)ret;
 	return true;
 }
+
+bool audio_resampler_set_compensation(audio_resampler_t *rs, int delta, int distance)
+{
+	if (!rs)
+		return false;
+
+	int ret = swr_set_compensation(rs->context, delta, distance);
+	if (ret < 0) {
+		blog(LOG_ERROR, "swr_set_compensation failed: %d", ret);
+		return false;
+	}
+
+	return true;
+}
@@ -39,6 +39,10 @@ EXPORT void audio_resampler_destroy(audio_resampler_t *resampler);
 EXPORT bool audio_resampler_resample(audio_resampler_t *resampler, uint8_t *output[], uint32_t *out_frames,
 				     uint64_t *ts_offset, const uint8_t *const input[], uint32_t in_frames);
 
+/** Stretches (positive delta) or shrinks (negative delta) the output by delta
+ * frames over the next distance output frames, to follow clock drift */
+EXPORT bool audio_resampler_set_compensation(audio_resampler_t *resampler, int delta, int distance);
+
 #ifdef __cplusplus
 }
 #endif
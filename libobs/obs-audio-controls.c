@@ -19,7 +19,20 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "util/sse-intrin.h"
 
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(_M_ARM64EC)
+#define VOLMETER_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+#endif
+
 #include "util/threading.h"
+#include "util/spsc-ring.h"
+#include "util/platform.h"
 #include "util/bmem.h"
 #include "media-io/audio-math.h"
 #include "obs.h"
@@ -62,6 +75,9 @@ struct meter_cb {
 };
 
 struct obs_volmeter {
+	/* held by the owner, and by the audio thread while it signals */
+	volatile long refs;
+
 	pthread_mutex_t mutex;
 	obs_source_t *source;
 	enum obs_fader_type type;
@@ -72,10 +88,21 @@ struct obs_volmeter {
 
 	enum obs_peak_meter_type peak_meter_type;
 	unsigned int update_ms;
+
+	/* audio received from the source, measured by the audio thread */
+	struct spsc_ring pending;
 	float prev_samples[MAX_AUDIO_CHANNELS][4];
 
-	float magnitude[MAX_AUDIO_CHANNELS];
-	float peak[MAX_AUDIO_CHANNELS];
+	/* levels published by the audio thread, read with a sequence lock */
+	volatile long levels_seq;
+	struct obs_volmeter_levels levels;
+};
+
+struct meter_packet {
+	uint32_t frames;
+	uint32_t channels;
+	bool zero_volume;
+	/* followed by planar float data */
 };
 
 static float cubic_def_to_db(const float def)
@@ -330,7 +357,7 @@ static float get_true_peak(__m128 previous_samples, const float *samples, size_t
 	__m128 work = previous_samples;
 	__m128 peak = previous_samples;
 	for (size_t i = 0; (i + 3) < nr_samples; i += 4) {
-		__m128 new_work = _mm_load_ps(&samples[i]);
+		__m128 new_work = _mm_loadu_ps(&samples[i]);
 		__m128 intrp_samples;
 
 		/* Include the actual sample values in the peak. */
@@ -360,6 +387,83 @@ static float get_true_peak(__m128 previous_samples, const float *samples, size_t
 	return r;
 }
 
+#ifdef VOLMETER_AVX2
+static bool cpu_has_avx2(void)
+{
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	/* FMA, OSXSAVE and AVX, and the OS saving the YMM registers */
+	__cpuid(info, 1);
+	if ((info[2] & 0x18001000) != 0x18001000)
+		return false;
+	if ((_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+AVX2_TARGET static inline __m256 load_2ps(const float *lo, const float *hi)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(lo)), _mm_loadu_ps(hi), 1);
+}
+
+AVX2_TARGET static inline __m256 abs_256(__m256 v)
+{
+	return _mm256_andnot_ps(_mm256_set1_ps(-0.f), v);
+}
+
+/* Same as get_true_peak, for two channels at once, one per 128-bit lane.
+ * The matrix product is done as a sum of each sample broadcast over its
+ * column of the interpolation matrix, which avoids the transposes. */
+AVX2_TARGET static void get_true_peak_x2(const float *prev_a, const float *prev_b, const float *a, const float *b,
+					 size_t nr_samples, float peaks[2])
+{
+	const __m256 c0 = _mm256_setr_ps(-0.103943f, -0.189207f, -0.216236f, -0.155915f, -0.103943f, -0.189207f,
+					 -0.216236f, -0.155915f);
+	const __m256 c1 = _mm256_setr_ps(0.233872f, 0.504551f, 0.756827f, 0.935489f, 0.233872f, 0.504551f,
+					 0.756827f, 0.935489f);
+	const __m256 c2 = _mm256_setr_ps(0.935489f, 0.756827f, 0.504551f, 0.233872f, 0.935489f, 0.756827f,
+					 0.504551f, 0.233872f);
+	const __m256 c3 = _mm256_setr_ps(-0.155915f, -0.216236f, -0.189207f, -0.103943f, -0.155915f, -0.216236f,
+					 -0.189207f, -0.103943f);
+
+	__m256 work = load_2ps(prev_a, prev_b);
+	__m256 peak = work;
+	for (size_t i = 0; (i + 3) < nr_samples; i += 4) {
+		__m256 new_work = load_2ps(&a[i], &b[i]);
+		peak = _mm256_max_ps(peak, abs_256(new_work));
+
+		for (int j = 0; j < 4; j++) {
+			/* Shift in the next point, within each lane. */
+			__m256 tmp = _mm256_shuffle_ps(work, new_work, _MM_SHUFFLE(0, 0, 3, 3));
+			work = _mm256_shuffle_ps(work, tmp, _MM_SHUFFLE(2, 1, 2, 1));
+			new_work = _mm256_shuffle_ps(new_work, new_work, _MM_SHUFFLE(3, 3, 2, 1));
+
+			__m256 intrp = _mm256_mul_ps(_mm256_permute_ps(work, 0x00), c0);
+			intrp = _mm256_fmadd_ps(_mm256_permute_ps(work, 0x55), c1, intrp);
+			intrp = _mm256_fmadd_ps(_mm256_permute_ps(work, 0xAA), c2, intrp);
+			intrp = _mm256_fmadd_ps(_mm256_permute_ps(work, 0xFF), c3, intrp);
+			peak = _mm256_max_ps(peak, abs_256(intrp));
+		}
+	}
+
+	float mem[8];
+	_mm256_storeu_ps(mem, peak);
+	peaks[0] = fmaxf(fmaxf(mem[0], mem[1]), fmaxf(mem[2], mem[3]));
+	peaks[1] = fmaxf(fmaxf(mem[4], mem[5]), fmaxf(mem[6], mem[7]));
+}
+#endif
+
 /* points contain the first four samples to calculate the sinc interpolation
  * over. They will have come from a previous iteration.
  */
@@ -367,7 +471,7 @@ static float get_sample_peak(__m128 previous_samples, const float *samples, size
 {
 	__m128 peak = previous_samples;
 	for (size_t i = 0; (i + 3) < nr_samples; i += 4) {
-		__m128 new_work = _mm_load_ps(&samples[i]);
+		__m128 new_work = _mm_loadu_ps(&samples[i]);
 		peak = _mm_max_ps(peak, abs_ps(new_work));
 	}
 
@@ -376,7 +480,26 @@ static float get_sample_peak(__m128 previous_samples, const float *samples, size
 	return r;
 }
 
-static void volmeter_process_peak_last_samples(obs_volmeter_t *volmeter, int channel_nr, float *samples,
+static float get_sum_of_squares(const float *samples, size_t nr_samples)
+{
+	__m128 sum4 = _mm_setzero_ps();
+	size_t i = 0;
+
+	for (; (i + 3) < nr_samples; i += 4) {
+		__m128 v = _mm_loadu_ps(&samples[i]);
+		sum4 = _mm_add_ps(sum4, _mm_mul_ps(v, v));
+	}
+
+	float mem[4];
+	_mm_storeu_ps(mem, sum4);
+	float sum = mem[0] + mem[1] + mem[2] + mem[3];
+
+	for (; i < nr_samples; i++)
+		sum += samples[i] * samples[i];
+	return sum;
+}
+
+static void volmeter_process_peak_last_samples(obs_volmeter_t *volmeter, int channel_nr, const float *samples,
 					       size_t nr_samples)
 {
 	/* Take the last 4 samples that need to be used for the next peak
@@ -412,110 +535,208 @@ static void volmeter_process_peak_last_samples(obs_volmeter_t *volmeter, int cha
 	}
 }
 
-static void volmeter_process_peak(obs_volmeter_t *volmeter, const struct audio_data *data, int nr_channels)
+#ifdef VOLMETER_AVX2
+/* set on the first volmeter creation, under volmeters_mutex */
+static bool use_avx2 = false;
+#endif
+
+static void volmeter_process_peak(obs_volmeter_t *volmeter, enum obs_peak_meter_type type, const float **planes,
+				  int nr_channels, size_t nr_samples, float peak[MAX_AUDIO_CHANNELS])
 {
-	int nr_samples = data->frames;
 	int channel_nr = 0;
-	for (int plane_nr = 0; channel_nr < nr_channels; plane_nr++) {
-		float *samples = (float *)data->data[plane_nr];
-		if (!samples) {
-			continue;
-		}
-		if (((uintptr_t)samples & 0xf) > 0) {
-			printf("Audio plane %i is not aligned %p skipping "
-			       "peak volume measurement.\n",
-			       plane_nr, samples);
-			volmeter->peak[channel_nr] = 1.0;
-			channel_nr++;
-			continue;
+
+#ifdef VOLMETER_AVX2
+	if (type == TRUE_PEAK_METER && use_avx2) {
+		for (; channel_nr + 1 < nr_channels; channel_nr += 2) {
+			float pair[2];
+			get_true_peak_x2(volmeter->prev_samples[channel_nr], volmeter->prev_samples[channel_nr + 1],
+					 planes[channel_nr], planes[channel_nr + 1], nr_samples, pair);
+			peak[channel_nr] = fmaxf(peak[channel_nr], pair[0]);
+			peak[channel_nr + 1] = fmaxf(peak[channel_nr + 1], pair[1]);
 		}
+	}
+#endif
 
+	for (; channel_nr < nr_channels; channel_nr++) {
 		/* volmeter->prev_samples may not be aligned to 16 bytes;
 		 * use unaligned load. */
 		__m128 previous_samples = _mm_loadu_ps(volmeter->prev_samples[channel_nr]);
+		const float *samples = planes[channel_nr];
+		float channel_peak;
 
-		float peak;
-		switch (volmeter->peak_meter_type) {
+		switch (type) {
 		case TRUE_PEAK_METER:
-			peak = get_true_peak(previous_samples, samples, nr_samples);
+			channel_peak = get_true_peak(previous_samples, samples, nr_samples);
 			break;
 
 		case SAMPLE_PEAK_METER:
 		default:
-			peak = get_sample_peak(previous_samples, samples, nr_samples);
+			channel_peak = get_sample_peak(previous_samples, samples, nr_samples);
 			break;
 		}
 
-		volmeter_process_peak_last_samples(volmeter, channel_nr, samples, nr_samples);
+		peak[channel_nr] = fmaxf(peak[channel_nr], channel_peak);
+	}
 
-		volmeter->peak[channel_nr] = peak;
+	for (channel_nr = 0; channel_nr < nr_channels; channel_nr++)
+		volmeter_process_peak_last_samples(volmeter, channel_nr, planes[channel_nr], nr_samples);
+}
 
-		channel_nr++;
-	}
+static void volmeter_publish_levels(obs_volmeter_t *volmeter, const float magnitude[MAX_AUDIO_CHANNELS],
+				    const float peak[MAX_AUDIO_CHANNELS], bool zero_volume)
+{
+	struct obs_volmeter_levels levels;
+	float mul;
+
+	pthread_mutex_lock(&volmeter->mutex);
+	mul = zero_volume ? 0.0f : db_to_mul(volmeter->cur_db);
+	pthread_mutex_unlock(&volmeter->mutex);
+
+	// Adjust magnitude/peak based on the volume level set by the user.
+	// And convert to dB.
+	for (int channel_nr = 0; channel_nr < MAX_AUDIO_CHANNELS; channel_nr++) {
+		levels.magnitude[channel_nr] = mul_to_db(magnitude[channel_nr] * mul);
+		levels.peak[channel_nr] = mul_to_db(peak[channel_nr] * mul);
 
-	/* Clear the peak of the channels that have not been handled. */
-	for (; channel_nr < MAX_AUDIO_CHANNELS; channel_nr++) {
-		volmeter->peak[channel_nr] = 0.0;
+		/* The input-peak is NOT adjusted with volume, so that the user
+		 * can check the input-gain. */
+		levels.input_peak[channel_nr] = mul_to_db(peak[channel_nr]);
 	}
+	levels.timestamp = os_gettime_ns();
+
+	os_atomic_inc_long(&volmeter->levels_seq);
+	volmeter->levels = levels;
+	os_atomic_inc_long(&volmeter->levels_seq);
 }
 
-static void volmeter_process_magnitude(obs_volmeter_t *volmeter, const struct audio_data *data, int nr_channels)
+/* audio thread only, returns true if new levels were published */
+static bool volmeter_process_pending(obs_volmeter_t *volmeter)
 {
-	size_t nr_samples = data->frames;
+	float sum[MAX_AUDIO_CHANNELS] = {0};
+	float peak[MAX_AUDIO_CHANNELS] = {0};
+	size_t total_frames = 0;
+	bool zero_volume = false;
+	enum obs_peak_meter_type type;
+	const uint8_t *ptr;
+	size_t size;
 
-	int channel_nr = 0;
-	for (int plane_nr = 0; channel_nr < nr_channels; plane_nr++) {
-		float *samples = (float *)data->data[plane_nr];
-		if (!samples) {
-			continue;
-		}
+	pthread_mutex_lock(&volmeter->mutex);
+	type = volmeter->peak_meter_type;
+	pthread_mutex_unlock(&volmeter->mutex);
 
-		float sum = 0.0;
-		for (size_t i = 0; i < nr_samples; i++) {
-			float sample = samples[i];
-			sum += sample * sample;
-		}
-		volmeter->magnitude[channel_nr] = sqrtf(sum / nr_samples);
+	while ((ptr = spsc_ring_read_begin(&volmeter->pending, &size)) != NULL) {
+		struct meter_packet packet;
+		const float *planes[MAX_AUDIO_CHANNELS];
 
-		channel_nr++;
+		memcpy(&packet, ptr, sizeof(packet));
+		ptr += sizeof(packet);
+
+		for (uint32_t ch = 0; ch < packet.channels; ch++)
+			planes[ch] = (const float *)ptr + ch * packet.frames;
+
+		volmeter_process_peak(volmeter, type, planes, (int)packet.channels, packet.frames, peak);
+		for (uint32_t ch = 0; ch < packet.channels; ch++)
+			sum[ch] += get_sum_of_squares(planes[ch], packet.frames);
+
+		total_frames += packet.frames;
+		zero_volume = packet.zero_volume;
+
+		spsc_ring_read_end(&volmeter->pending);
 	}
+
+	if (!total_frames)
+		return false;
+
+	float magnitude[MAX_AUDIO_CHANNELS];
+	for (int channel_nr = 0; channel_nr < MAX_AUDIO_CHANNELS; channel_nr++)
+		magnitude[channel_nr] = sqrtf(sum[channel_nr] / total_frames);
+
+	volmeter_publish_levels(volmeter, magnitude, peak, zero_volume);
+	return true;
 }
 
-static void volmeter_process_audio_data(obs_volmeter_t *volmeter, const struct audio_data *data)
+static void volmeter_release(obs_volmeter_t *volmeter)
 {
-	int nr_channels = get_nr_channels_from_audio_data(data);
+	if (os_atomic_dec_long(&volmeter->refs) != 0)
+		return;
+
+	spsc_ring_free(&volmeter->pending);
+	da_free(volmeter->callbacks);
+	pthread_mutex_destroy(&volmeter->callback_mutex);
+	pthread_mutex_destroy(&volmeter->mutex);
 
-	volmeter_process_peak(volmeter, data, nr_channels);
-	volmeter_process_magnitude(volmeter, data, nr_channels);
+	bfree(volmeter);
+}
+
+void obs_process_volmeters(void)
+{
+	struct obs_core_data *data = &obs->data;
+
+	pthread_mutex_lock(&data->volmeters_mutex);
+	for (size_t i = 0; i < data->volmeters.num; i++) {
+		obs_volmeter_t *volmeter = data->volmeters.array[i];
+
+		if (volmeter_process_pending(volmeter)) {
+			os_atomic_inc_long(&volmeter->refs);
+			da_push_back(data->volmeters_updated, &volmeter);
+		}
+	}
+	pthread_mutex_unlock(&data->volmeters_mutex);
+
+	/* callbacks are called without volmeters_mutex, they may create or
+	 * destroy volmeters.  the levels are only written by this thread. */
+	for (size_t i = 0; i < data->volmeters_updated.num; i++) {
+		obs_volmeter_t *volmeter = data->volmeters_updated.array[i];
+		struct obs_volmeter_levels *levels = &volmeter->levels;
+
+		signal_levels_updated(volmeter, levels->magnitude, levels->peak, levels->input_peak);
+		volmeter_release(volmeter);
+	}
+	da_resize(data->volmeters_updated, 0);
 }
 
 static void volmeter_source_data_received(void *vptr, obs_source_t *source, const struct audio_data *data, bool muted)
 {
 	struct obs_volmeter *volmeter = (struct obs_volmeter *)vptr;
-	float mul;
-	float magnitude[MAX_AUDIO_CHANNELS];
-	float peak[MAX_AUDIO_CHANNELS];
-	float input_peak[MAX_AUDIO_CHANNELS];
+	int nr_channels = get_nr_channels_from_audio_data(data);
+	size_t max_frames;
+	uint32_t frames;
 
-	pthread_mutex_lock(&volmeter->mutex);
+	if (!nr_channels || !data->frames)
+		return;
 
-	volmeter_process_audio_data(volmeter, data);
+	/* the levels are only for display, anything too large for the ring
+	 * is measured partially */
+	max_frames = (spsc_ring_max_record_size(&volmeter->pending) - sizeof(struct meter_packet)) /
+		     (nr_channels * sizeof(float));
+	frames = data->frames < max_frames ? data->frames : (uint32_t)max_frames;
 
-	// Adjust magnitude/peak based on the volume level set by the user.
-	// And convert to dB.
-	mul = muted && !obs_source_muted(source) ? 0.0f : db_to_mul(volmeter->cur_db);
-	for (int channel_nr = 0; channel_nr < MAX_AUDIO_CHANNELS; channel_nr++) {
-		magnitude[channel_nr] = mul_to_db(volmeter->magnitude[channel_nr] * mul);
-		peak[channel_nr] = mul_to_db(volmeter->peak[channel_nr] * mul);
+	size_t plane_size = frames * sizeof(float);
+	size_t size = sizeof(struct meter_packet) + plane_size * nr_channels;
+	uint8_t *ptr = spsc_ring_write_begin(&volmeter->pending, size);
+	if (!ptr)
+		return;
 
-		/* The input-peak is NOT adjusted with volume, so that the user
-		 * can check the input-gain. */
-		input_peak[channel_nr] = mul_to_db(volmeter->peak[channel_nr]);
-	}
+	struct meter_packet packet = {
+		.frames = frames,
+		.channels = (uint32_t)nr_channels,
+		.zero_volume = muted && !obs_source_muted(source),
+	};
 
-	pthread_mutex_unlock(&volmeter->mutex);
+	memcpy(ptr, &packet, sizeof(packet));
+	ptr += sizeof(packet);
+
+	int channel_nr = 0;
+	for (int plane_nr = 0; channel_nr < nr_channels; plane_nr++) {
+		if (!data->data[plane_nr])
+			continue;
 
-	signal_levels_updated(volmeter, magnitude, peak, input_peak);
+		memcpy(ptr, data->data[plane_nr], plane_size);
+		ptr += plane_size;
+		channel_nr++;
+	}
+
+	spsc_ring_write_end(&volmeter->pending);
 }
 
 obs_fader_t *obs_fader_create(enum obs_fader_type type)
@@ -734,6 +955,7 @@ obs_volmeter_t *obs_volmeter_create(enum obs_fader_type type)
 	if (!volmeter)
 		return NULL;
 
+	volmeter->refs = 1;
 	pthread_mutex_init_value(&volmeter->mutex);
 	pthread_mutex_init_value(&volmeter->callback_mutex);
 	if (pthread_mutex_init(&volmeter->mutex, NULL) != 0)
@@ -743,6 +965,24 @@ obs_volmeter_t *obs_volmeter_create(enum obs_fader_type type)
 
 	volmeter->type = type;
 
+	size_t channels = MAX_AUDIO_CHANNELS;
+	size_t sample_rate = 48000;
+	if (obs->audio.audio) {
+		channels = audio_output_get_channels(obs->audio.audio);
+		sample_rate = audio_output_get_sample_rate(obs->audio.audio);
+	}
+
+	/* a quarter second, the audio thread measures it every tick */
+	spsc_ring_init(&volmeter->pending, sample_rate / 4 * channels * sizeof(float));
+
+	pthread_mutex_lock(&obs->data.volmeters_mutex);
+#ifdef VOLMETER_AVX2
+	if (!obs->data.volmeters.num)
+		use_avx2 = cpu_has_avx2();
+#endif
+	da_push_back(obs->data.volmeters, &volmeter);
+	pthread_mutex_unlock(&obs->data.volmeters_mutex);
+
 	return volmeter;
 fail:
 	obs_volmeter_destroy(volmeter);
@@ -755,11 +995,18 @@ void obs_volmeter_destroy(obs_volmeter_t *volmeter)
 		return;
 
 	obs_volmeter_detach_source(volmeter);
+
+	pthread_mutex_lock(&obs->data.volmeters_mutex);
+	da_erase_item(obs->data.volmeters, &volmeter);
+	pthread_mutex_unlock(&obs->data.volmeters_mutex);
+
+	/* the audio thread may still hold a reference, but it must not call
+	 * back into the owner once it has been destroyed */
+	pthread_mutex_lock(&volmeter->callback_mutex);
 	da_free(volmeter->callbacks);
-	pthread_mutex_destroy(&volmeter->callback_mutex);
-	pthread_mutex_destroy(&volmeter->mutex);
+	pthread_mutex_unlock(&volmeter->callback_mutex);
 
-	bfree(volmeter);
+	volmeter_release(volmeter);
 }
 
 bool obs_volmeter_attach_source(obs_volmeter_t *volmeter, obs_source_t *source)
@@ -838,6 +1085,27 @@ int obs_volmeter_get_nr_channels(obs_volmeter_t *volmeter)
 	return CLAMP(source_nr_audio_channels, 0, obs_nr_audio_channels);
 }
 
+bool obs_volmeter_get_levels(obs_volmeter_t *volmeter, struct obs_volmeter_levels *levels)
+{
+	if (!obs_ptr_valid(volmeter, "obs_volmeter_get_levels"))
+		return false;
+
+	for (;;) {
+		long seq = os_atomic_load_long(&volmeter->levels_seq);
+		if (seq & 1)
+			continue;
+
+		*levels = volmeter->levels;
+
+		/* compare and swap rather than load, so the copy above cannot
+		 * be moved past the check */
+		if (os_atomic_compare_swap_long(&volmeter->levels_seq, seq, seq))
+			break;
+	}
+
+	return levels->timestamp != 0;
+}
+
 void obs_volmeter_add_callback(obs_volmeter_t *volmeter, obs_volmeter_updated_t callback, void *param)
 {
 	struct meter_cb cb = {callback, param};
@@ -231,6 +231,29 @@ EXPORT void obs_volmeter_set_peak_meter_type(obs_volmeter_t *volmeter, enum obs_
  */
 EXPORT int obs_volmeter_get_nr_channels(obs_volmeter_t *volmeter);
 
+struct obs_volmeter_levels {
+	float magnitude[MAX_AUDIO_CHANNELS];
+	float peak[MAX_AUDIO_CHANNELS];
+	float input_peak[MAX_AUDIO_CHANNELS];
+
+	/** system time the levels were published at, 0 if none yet */
+	uint64_t timestamp;
+};
+
+/**
+ * @brief Get the most recent levels of the volume meter
+ * @param volmeter pointer to the volume meter object
+ * @param levels receives the levels, in dB
+ * @return true if any levels have been published yet
+ *
+ * Levels are measured by the audio thread once per audio tick, for all volume
+ * meters at once.  This never blocks the audio thread and is meant to be
+ * polled at the rate the levels are displayed at.
+ */
+EXPORT bool obs_volmeter_get_levels(obs_volmeter_t *volmeter, struct obs_volmeter_levels *levels);
+
+/* called from the audio thread once per audio tick that the source output
+ * audio in, prefer polling with obs_volmeter_get_levels */
 typedef void (*obs_volmeter_updated_t)(void *param, const float magnitude[MAX_AUDIO_CHANNELS],
 				       const float peak[MAX_AUDIO_CHANNELS],
 				       const float input_peak[MAX_AUDIO_CHANNELS]);
@@ -317,6 +317,13 @@ static inline bool audio_buffering_maxed(struct obs_core_audio *audio)
 	return audio->total_buffering_ticks == audio->max_buffering_ticks;
 }
 
+static inline size_t update_buffering_ms(struct obs_core_audio *audio, size_t sample_rate)
+{
+	size_t total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
+	os_atomic_set_long(&audio->buffering_ms, (long)total_ms);
+	return total_ms;
+}
+
 static void set_fixed_audio_buffering(struct obs_core_audio *audio, size_t sample_rate, struct ts_info *ts)
 {
 	struct ts_info new_ts;
@@ -332,7 +339,7 @@ static void set_fixed_audio_buffering(struct obs_core_audio *audio, size_t sampl
 	ticks = audio->max_buffering_ticks - audio->total_buffering_ticks;
 	audio->total_buffering_ticks += ticks;
 
-	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
+	total_ms = update_buffering_ms(audio, sample_rate);
 
 	blog(LOG_INFO,
 	     "Enabling fixed audio buffering, total "
@@ -387,7 +394,7 @@ static void add_audio_buffering(struct obs_core_audio *audio, size_t sample_rate
 	}
 
 	ms = ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
-	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
+	total_ms = update_buffering_ms(audio, sample_rate);
 
 	blog(LOG_INFO,
 	     "adding %d milliseconds of audio buffering, total "
@@ -421,6 +428,50 @@ static void add_audio_buffering(struct obs_core_audio *audio, size_t sample_rate
 	*ts = new_ts;
 }
 
+/* The next buffered window is output right away instead of on the next tick,
+ * which brings every output one tick closer to real time without dropping or
+ * stretching any audio. */
+static void remove_audio_buffering(struct obs_core_audio *audio, size_t sample_rate)
+{
+	size_t total_ms;
+	size_t ms;
+
+	audio->total_buffering_ticks--;
+
+	ms = AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
+	total_ms = update_buffering_ms(audio, sample_rate);
+
+	blog(LOG_INFO,
+	     "removing %d milliseconds of audio buffering, total "
+	     "audio buffering is now %d milliseconds",
+	     (int)ms, (int)total_ms);
+
+	audio_output_catch_up(audio->audio, 1);
+}
+
+/* Returns how many ticks of buffering the latest source needs, measured from
+ * the end of the audio it has provided so far to the current time. */
+static uint32_t calc_needed_buffering(struct obs_core_data *data, size_t sample_rate, uint64_t now)
+{
+	uint64_t tick_ns = audio_frames_to_ns(sample_rate, AUDIO_OUTPUT_FRAMES);
+	uint64_t lateness = 0;
+
+	struct obs_source *source = data->first_audio_source;
+	while (source) {
+		if (!source->info.audio_render && !source->audio_pending && source->audio_ts) {
+			size_t frames = source->audio_input_buf[0].size / sizeof(float);
+			uint64_t end_ts = source->audio_ts + audio_frames_to_ns(sample_rate, frames);
+
+			if (end_ts < now && now - end_ts > lateness)
+				lateness = now - end_ts;
+		}
+
+		source = (struct obs_source *)source->next_audio_source;
+	}
+
+	return (uint32_t)((lateness + tick_ns - 1) / tick_ns);
+}
+
 static bool audio_buffer_insufficient(struct obs_source *source, size_t sample_rate, uint64_t min_ts)
 {
 	size_t total_floats = AUDIO_OUTPUT_FRAMES;
@@ -558,13 +609,20 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in, uint6
 	size_t sample_rate = audio_output_get_sample_rate(audio->audio);
 	size_t channels = audio_output_get_channels(audio->audio);
 	struct ts_info ts = {start_ts_in, end_ts_in};
+	int prev_buffering_ticks = audio->total_buffering_ticks;
+	uint32_t needed_ticks;
 	size_t audio_size;
 	uint64_t min_ts;
 
+	/* an empty range means we asked to output the next buffered window
+	 * early, so no new window is queued for it */
+	bool catch_up = start_ts_in == end_ts_in;
+
 	da_resize(audio->render_order, 0);
 	da_resize(audio->root_nodes, 0);
 
-	deque_push_back(&audio->buffered_timestamps, &ts, sizeof(ts));
+	if (!catch_up)
+		deque_push_back(&audio->buffered_timestamps, &ts, sizeof(ts));
 	deque_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
 	min_ts = ts.start;
 
@@ -613,6 +671,10 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in, uint6
 
 	source = data->first_audio_source;
 	while (source) {
+		/* take in everything async sources have output since the
+		 * last tick */
+		obs_source_drain_audio(source);
+
 		if (!obs_source_removed(source)) {
 			push_audio_tree(NULL, source, audio);
 		}
@@ -645,9 +707,7 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in, uint6
 				assert(false);
 #endif
 			} else {
-				pthread_mutex_lock(&source->audio_buf_mutex);
 				bool rerender = ignore_audio(source, channels, sample_rate, ts.start);
-				pthread_mutex_unlock(&source->audio_buf_mutex);
 
 				/* if we (potentially) recovered, re-render */
 				if (rerender)
@@ -660,6 +720,7 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in, uint6
 	/* get minimum audio timestamp */
 	pthread_mutex_lock(&data->audio_sources_mutex);
 	const char *buffering_name = calc_min_ts(data, sample_rate, &min_ts);
+	needed_ticks = calc_needed_buffering(data, sample_rate, end_ts_in);
 	pthread_mutex_unlock(&data->audio_sources_mutex);
 
 	/* ------------------------------------------------ */
@@ -681,12 +742,8 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in, uint6
 			if (source->audio_pending)
 				continue;
 
-			pthread_mutex_lock(&source->audio_buf_mutex);
-
 			if (source->audio_output_buf[0][0] && source->audio_ts)
 				mix_audio(mixes, source, channels, sample_rate, &ts);
-
-			pthread_mutex_unlock(&source->audio_buf_mutex);
 		}
 	}
 
@@ -696,15 +753,31 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in, uint6
 
 	source = data->first_audio_source;
 	while (source) {
-		pthread_mutex_lock(&source->audio_buf_mutex);
 		discard_audio(audio, source, channels, sample_rate, &ts);
-		pthread_mutex_unlock(&source->audio_buf_mutex);
 
 		source = (struct obs_source *)source->next_audio_source;
 	}
 
 	pthread_mutex_unlock(&data->audio_sources_mutex);
 
+	/* ------------------------------------------------ */
+	/* give back buffering once sources are on time     */
+	if (!audio->fixed_buffer) {
+		struct audio_buffering *ab = &audio->adaptive_buffering;
+
+		if (audio->total_buffering_ticks != prev_buffering_ticks) {
+			audio_buffering_grew(ab, end_ts_in);
+		} else if (!catch_up && !audio->buffering_wait_ticks) {
+			audio_buffering_observe(ab, end_ts_in, needed_ticks);
+			if (audio_buffering_should_shrink(ab, end_ts_in, (uint32_t)audio->total_buffering_ticks))
+				remove_audio_buffering(audio, sample_rate);
+		}
+	}
+
+	/* ------------------------------------------------ */
+	/* measure levels for all volume meters in one pass */
+	obs_process_volmeters();
+
 	/* ------------------------------------------------ */
 	/* release audio sources */
 	release_audio_sources(audio);
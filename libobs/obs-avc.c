@@ -18,6 +18,7 @@
 #include "obs-avc.h"
 
 #include "obs.h"
+#include "obs-internal.h"
 #include "obs-nal.h"
 #include "util/array-serializer.h"
 #include "util/bitstream.h"
@@ -65,64 +66,66 @@ static int compute_avc_keyframe_priority(const uint8_t *nal_start, bool *is_keyf
 	return priority;
 }
 
-static void serialize_avc_data(struct serializer *s, const uint8_t *data, size_t size, bool *is_keyframe, int *priority)
+static void serialize_avc_data(struct serializer *s, const struct obs_nal_index *index, bool *is_keyframe,
+				int *priority)
 {
-	const uint8_t *const end = data + size;
-	const uint8_t *nal_start = obs_nal_find_startcode(data, end);
-	while (true) {
-		while (nal_start < end && !*(nal_start++))
-			;
-
-		if (nal_start == end)
-			break;
+	for (size_t i = 0; i < index->units.num; i++) {
+		const struct obs_nal_unit *nal = index->units.array + i;
 
-		*priority = compute_avc_keyframe_priority(nal_start, is_keyframe, *priority);
+		*priority = compute_avc_keyframe_priority(nal->data, is_keyframe, *priority);
 
-		const uint8_t *const nal_end = obs_nal_find_startcode(nal_start, end);
-		const size_t nal_size = nal_end - nal_start;
-		s_wb32(s, (uint32_t)nal_size);
-		s_write(s, nal_start, nal_size);
-		nal_start = nal_end;
+		s_wb32(s, (uint32_t)nal->size);
+		s_write(s, nal->data, nal->size);
 	}
 }
 
 void obs_parse_avc_packet(struct encoder_packet *avc_packet, const struct encoder_packet *src)
 {
 	struct array_output_data output;
+	struct obs_nal_index index;
 	struct serializer s;
 	long ref = 1;
 
+	/* already converted for another output */
+	if (obs_encoder_packet_get_converted(avc_packet, src))
+		return;
+
+	obs_nal_index_init(&index);
+	obs_nal_index_build(&index, src->data, src->size);
+
 	array_output_serializer_init(&s, &output);
+	da_reserve(output.bytes, sizeof(ref) + obs_nal_index_length_prefixed_size(&index));
 	*avc_packet = *src;
 
 	serialize(&s, &ref, sizeof(ref));
-	serialize_avc_data(&s, src->data, src->size, &avc_packet->keyframe, &avc_packet->priority);
+	serialize_avc_data(&s, &index, &avc_packet->keyframe, &avc_packet->priority);
+	obs_nal_index_free(&index);
 
 	avc_packet->data = output.bytes.array + sizeof(ref);
 	avc_packet->size = output.bytes.num - sizeof(ref);
 	avc_packet->drop_priority = avc_packet->priority;
+
+	obs_encoder_packet_set_converted(avc_packet, src);
 }
 
 int obs_parse_avc_packet_priority(const struct encoder_packet *packet)
 {
-	int priority = packet->priority;
+	int priority = obs_encoder_packet_get_converted_priority(packet);
+	if (priority != -1)
+		return priority;
 
-	const uint8_t *const data = packet->data;
-	const uint8_t *const end = data + packet->size;
-	const uint8_t *nal_start = obs_nal_find_startcode(data, end);
-	while (true) {
-		while (nal_start < end && !*(nal_start++))
-			;
+	priority = packet->priority;
 
-		if (nal_start == end)
-			break;
+	struct obs_nal_index index;
+	obs_nal_index_init(&index);
+	obs_nal_index_build(&index, packet->data, packet->size);
 
+	for (size_t i = 0; i < index.units.num; i++) {
 		bool unused;
-		priority = compute_avc_keyframe_priority(nal_start, &unused, priority);
-
-		nal_start = obs_nal_find_startcode(nal_start, end);
+		priority = compute_avc_keyframe_priority(index.units.array[i].data, &unused, priority);
 	}
 
+	obs_nal_index_free(&index);
 	return priority;
 }
 
@@ -137,31 +140,25 @@ static inline bool has_start_code(const uint8_t *data)
 static void get_sps_pps(const uint8_t *data, size_t size, const uint8_t **sps, size_t *sps_size, const uint8_t **pps,
 			size_t *pps_size)
 {
-	const uint8_t *nal_start, *nal_end;
-	const uint8_t *end = data + size;
-	int type;
+	struct obs_nal_index index;
 
-	nal_start = obs_nal_find_startcode(data, end);
-	while (true) {
-		while (nal_start < end && !*(nal_start++))
-			;
+	obs_nal_index_init(&index);
+	obs_nal_index_build(&index, data, size);
 
-		if (nal_start == end)
-			break;
-
-		nal_end = obs_nal_find_startcode(nal_start, end);
+	for (size_t i = 0; i < index.units.num; i++) {
+		const struct obs_nal_unit *nal = index.units.array + i;
+		const int type = nal->data[0] & 0x1F;
 
-		type = nal_start[0] & 0x1F;
 		if (type == OBS_NAL_SPS) {
-			*sps = nal_start;
-			*sps_size = nal_end - nal_start;
+			*sps = nal->data;
+			*sps_size = nal->size;
 		} else if (type == OBS_NAL_PPS) {
-			*pps = nal_start;
-			*pps_size = nal_end - nal_start;
+			*pps = nal->data;
+			*pps_size = nal->size;
 		}
-
-		nal_start = nal_end;
 	}
+
+	obs_nal_index_free(&index);
 }
 
 static inline uint8_t get_ue_golomb(struct bitstream_reader *gb)
@@ -276,42 +273,32 @@ void obs_extract_avc_headers(const uint8_t *packet, size_t size, uint8_t **new_p
 	DARRAY(uint8_t) new_packet;
 	DARRAY(uint8_t) header;
 	DARRAY(uint8_t) sei;
-	const uint8_t *nal_start, *nal_end, *nal_codestart;
-	const uint8_t *end = packet + size;
+	struct obs_nal_index index;
 
 	da_init(new_packet);
 	da_init(header);
 	da_init(sei);
 
-	nal_start = obs_nal_find_startcode(packet, end);
-	nal_end = NULL;
-	while (nal_end != end) {
-		nal_codestart = nal_start;
-
-		while (nal_start < end && !*(nal_start++))
-			;
-
-		if (nal_start == end)
-			break;
-
-		const uint8_t type = nal_start[0] & 0x1F;
+	obs_nal_index_init(&index);
+	obs_nal_index_build(&index, packet, size);
 
-		nal_end = obs_nal_find_startcode(nal_start, end);
-		if (!nal_end)
-			nal_end = end;
+	for (size_t i = 0; i < index.units.num; i++) {
+		const struct obs_nal_unit *nal = index.units.array + i;
+		const uint8_t type = nal->data[0] & 0x1F;
+		const size_t nal_size = nal->data + nal->size - nal->startcode;
 
 		if (type == OBS_NAL_SPS || type == OBS_NAL_PPS) {
-			da_push_back_array(header, nal_codestart, nal_end - nal_codestart);
+			da_push_back_array(header, nal->startcode, nal_size);
 		} else if (type == OBS_NAL_SEI) {
-			da_push_back_array(sei, nal_codestart, nal_end - nal_codestart);
+			da_push_back_array(sei, nal->startcode, nal_size);
 
 		} else {
-			da_push_back_array(new_packet, nal_codestart, nal_end - nal_codestart);
+			da_push_back_array(new_packet, nal->startcode, nal_size);
 		}
-
-		nal_start = nal_end;
 	}
 
+	obs_nal_index_free(&index);
+
 	*new_packet_data = new_packet.array;
 	*new_packet_size = new_packet.num;
 	*header_data = header.array;
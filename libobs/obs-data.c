@@ -734,6 +734,278 @@ const char *obs_data_get_last_json(obs_data_t *data)
 	return data ? data->json : NULL;
 }
 
+/* ------------------------------------------------------------------------- */
+/* JSON writer, produces the same output as jansson without building a json_t
+ * tree first */
+
+struct json_writer {
+	struct dstr out;
+	bool pretty;
+	bool with_defaults;
+};
+
+static inline void json_write(struct json_writer *w, const char *str, size_t len)
+{
+	dstr_ncat(&w->out, str, len);
+}
+
+static inline void json_write_str(struct json_writer *w, const char *str)
+{
+	json_write(w, str, strlen(str));
+}
+
+static void json_write_indent(struct json_writer *w, int depth, bool delim)
+{
+	static const char spaces[] = "                ";
+
+	if (!w->pretty) {
+		if (delim)
+			json_write(w, ",", 1);
+		return;
+	}
+
+	json_write(w, delim ? ",\n" : "\n", delim ? 2 : 1);
+
+	for (size_t n = (size_t)depth * 4; n;) {
+		size_t count = n < sizeof(spaces) - 1 ? n : sizeof(spaces) - 1;
+		json_write(w, spaces, count);
+		n -= count;
+	}
+}
+
+/* jansson refuses keys and strings that aren't valid UTF-8 */
+static bool json_utf8_valid(const uint8_t *str)
+{
+	while (*str) {
+		uint8_t c = *str++;
+		size_t extra;
+		uint32_t cp;
+
+		if (c < 0x80)
+			continue;
+		else if (c >= 0xC2 && c <= 0xDF)
+			extra = 1, cp = c & 0x1F;
+		else if (c >= 0xE0 && c <= 0xEF)
+			extra = 2, cp = c & 0x0F;
+		else if (c >= 0xF0 && c <= 0xF4)
+			extra = 3, cp = c & 0x07;
+		else
+			return false;
+
+		for (size_t i = 0; i < extra; i++) {
+			if ((*str & 0xC0) != 0x80)
+				return false;
+			cp = (cp << 6) | (*str++ & 0x3F);
+		}
+
+		if ((extra == 2 && (cp < 0x800 || (cp >= 0xD800 && cp <= 0xDFFF))) ||
+		    (extra == 3 && (cp < 0x10000 || cp > 0x10FFFF)))
+			return false;
+	}
+
+	return true;
+}
+
+static void json_write_escaped(struct json_writer *w, const char *str)
+{
+	const char *start = str;
+
+	json_write(w, "\"", 1);
+
+	for (; *str; str++) {
+		unsigned char c = (unsigned char)*str;
+		const char *esc;
+		char hex[8];
+
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+
+		json_write(w, start, str - start);
+		start = str + 1;
+
+		switch (c) {
+		case '"':
+			esc = "\\\"";
+			break;
+		case '\\':
+			esc = "\\\\";
+			break;
+		case '\b':
+			esc = "\\b";
+			break;
+		case '\f':
+			esc = "\\f";
+			break;
+		case '\n':
+			esc = "\\n";
+			break;
+		case '\r':
+			esc = "\\r";
+			break;
+		case '\t':
+			esc = "\\t";
+			break;
+		default:
+			snprintf(hex, sizeof(hex), "\\u%04X", c);
+			esc = hex;
+		}
+
+		json_write_str(w, esc);
+	}
+
+	json_write(w, start, str - start);
+	json_write(w, "\"", 1);
+}
+
+static void json_write_real(struct json_writer *w, double val)
+{
+	char buf[64];
+	int len = snprintf(buf, sizeof(buf), "%.17g", val);
+	char *pos;
+
+	if (len <= 0 || (size_t)len >= sizeof(buf))
+		return;
+
+	/* locale independent decimal point */
+	pos = strchr(buf, ',');
+	if (pos)
+		*pos = '.';
+
+	if (strspn(buf, "0123456789-") == (size_t)len) {
+		strcat(buf, ".0");
+	} else if ((pos = strchr(buf, 'e')) != NULL) {
+		/* 1e+05 -> 1e5, 1e-05 -> 1e-5 */
+		char *start = pos + 1;
+		char *end = start + 1;
+
+		if (*start == '-')
+			start++;
+		while (*end == '0')
+			end++;
+		if (end != start)
+			memmove(start, end, strlen(end) + 1);
+	}
+
+	json_write_str(w, buf);
+}
+
+static void json_write_obj(struct json_writer *w, obs_data_t *data, int depth);
+
+static void json_write_array(struct json_writer *w, obs_data_array_t *array, int depth)
+{
+	size_t count = obs_data_array_count(array);
+
+	if (!count) {
+		json_write(w, "[]", 2);
+		return;
+	}
+
+	json_write(w, "[", 1);
+
+	for (size_t idx = 0; idx < count; idx++) {
+		obs_data_t *sub_item = obs_data_array_item(array, idx);
+
+		json_write_indent(w, depth + 1, idx > 0);
+		json_write_obj(w, sub_item, depth + 1);
+		obs_data_release(sub_item);
+	}
+
+	json_write_indent(w, depth, false);
+	json_write(w, "]", 1);
+}
+
+static void json_write_key(struct json_writer *w, const char *name, int depth, bool *first)
+{
+	json_write_indent(w, depth + 1, !*first);
+	json_write_escaped(w, name);
+	json_write(w, w->pretty ? ": " : ":", w->pretty ? 2 : 1);
+	*first = false;
+}
+
+static void json_write_obj(struct json_writer *w, obs_data_t *data, int depth)
+{
+	obs_data_item_t *item = NULL;
+	obs_data_item_t *temp = NULL;
+	bool first = true;
+
+	json_write(w, "{", 1);
+
+	HASH_ITER (hh, data->items, item, temp) {
+		enum obs_data_type type = obs_data_item_gettype(item);
+		const char *name = get_item_name(item);
+
+		if (!w->with_defaults && !obs_data_item_has_user_value(item))
+			continue;
+		if (!json_utf8_valid((const uint8_t *)name))
+			continue;
+
+		if (type == OBS_DATA_STRING) {
+			const char *val = obs_data_item_get_string(item);
+			if (!val || !json_utf8_valid((const uint8_t *)val))
+				continue;
+
+			json_write_key(w, name, depth, &first);
+			json_write_escaped(w, val);
+
+		} else if (type == OBS_DATA_NUMBER) {
+			char buf[32];
+
+			if (obs_data_item_numtype(item) == OBS_DATA_NUM_INT) {
+				snprintf(buf, sizeof(buf), "%lld", obs_data_item_get_int(item));
+				json_write_key(w, name, depth, &first);
+				json_write_str(w, buf);
+			} else {
+				double val = obs_data_item_get_double(item);
+				if (!isfinite(val))
+					continue;
+
+				json_write_key(w, name, depth, &first);
+				json_write_real(w, val);
+			}
+
+		} else if (type == OBS_DATA_BOOLEAN) {
+			json_write_key(w, name, depth, &first);
+			json_write_str(w, obs_data_item_get_bool(item) ? "true" : "false");
+
+		} else if (type == OBS_DATA_OBJECT) {
+			obs_data_t *obj = obs_data_item_get_obj(item);
+			if (!obj)
+				continue;
+
+			json_write_key(w, name, depth, &first);
+			json_write_obj(w, obj, depth + 1);
+			obs_data_release(obj);
+
+		} else if (type == OBS_DATA_ARRAY) {
+			obs_data_array_t *array = obs_data_item_get_array(item);
+
+			json_write_key(w, name, depth, &first);
+			json_write_array(w, array, depth + 1);
+			obs_data_array_release(array);
+		}
+	}
+
+	if (!first)
+		json_write_indent(w, depth, false);
+	json_write(w, "}", 1);
+}
+
+static bool obs_data_write_json_file_safe(obs_data_t *data, const char *file, bool pretty, const char *temp_ext,
+					  const char *backup_ext)
+{
+	struct json_writer w = {.pretty = pretty};
+	bool success;
+
+	if (!data)
+		return false;
+
+	json_write_obj(&w, data, 0);
+
+	success = os_quick_write_utf8_file_safe(file, w.out.array, w.out.len, false, temp_ext, backup_ext);
+	dstr_free(&w.out);
+	return success;
+}
+
 bool obs_data_save_json(obs_data_t *data, const char *file)
 {
 	const char *json = obs_data_get_json(data);
@@ -758,13 +1030,7 @@ bool obs_data_save_json_safe(obs_data_t *data, const char *file, const char *tem
 
 bool obs_data_save_json_pretty_safe(obs_data_t *data, const char *file, const char *temp_ext, const char *backup_ext)
 {
-	const char *json = obs_data_get_json_pretty(data);
-
-	if (json && *json) {
-		return os_quick_write_utf8_file_safe(file, json, strlen(json), false, temp_ext, backup_ext);
-	}
-
-	return false;
+	return obs_data_write_json_file_safe(data, file, true, temp_ext, backup_ext);
 }
 
 static void get_defaults_array_cb(obs_data_t *data, void *vp)
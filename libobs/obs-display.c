@@ -57,6 +57,7 @@ bool obs_display_init(struct obs_display *display, const struct gs_init_data *gr
 	}
 
 	display->enabled = true;
+	display->visible = true;
 	return true;
 }
 
@@ -234,12 +235,33 @@ static inline void render_display_end()
 	gs_end_scene();
 }
 
+static inline bool render_display_due(struct obs_display *display)
+{
+	const uint64_t interval = (uint64_t)os_atomic_load_long(&display->min_interval_us) * 1000;
+	const uint64_t now = obs->video.video_time;
+
+	if (!interval)
+		return true;
+
+	/* half a frame of slack so that a display limited to the canvas
+	 * rate (or a multiple of it) is never skipped due to rounding */
+	if (now + obs->video.video_half_frame_interval_ns < display->next_render_ts)
+		return false;
+
+	if (now > display->next_render_ts + interval)
+		display->next_render_ts = now;
+	display->next_render_ts += interval;
+	return true;
+}
+
 void render_display(struct obs_display *display)
 {
 	uint32_t cx, cy;
 	bool update_color_space;
 
-	if (!display || !display->enabled)
+	if (!display || !display->enabled || !os_atomic_load_bool(&display->visible))
+		return;
+	if (!render_display_due(display))
 		return;
 
 	/* -------------------------------------------- */
@@ -289,6 +311,18 @@ bool obs_display_enabled(obs_display_t *display)
 	return display ? display->enabled : false;
 }
 
+void obs_display_set_visible(obs_display_t *display, bool visible)
+{
+	if (display)
+		os_atomic_set_bool(&display->visible, visible);
+}
+
+void obs_display_set_max_fps(obs_display_t *display, double fps)
+{
+	if (display)
+		os_atomic_set_long(&display->min_interval_us, fps > 0.0 ? (long)(1000000.0 / fps) : 0);
+}
+
 void obs_display_set_background_color(obs_display_t *display, uint32_t color)
 {
 	if (display)
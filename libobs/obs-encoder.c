@@ -346,6 +346,20 @@ static void maybe_set_up_gpu_rescale(struct obs_encoder *encoder)
 	pthread_mutex_unlock(&obs->video.mixes_mutex);
 }
 
+/* bytes of packet data copied into packet instances and AVCC/HVCC
+ * conversions, for all encoders */
+static volatile int64_t copied_bytes = 0;
+
+static inline void add_copied_bytes(size_t size)
+{
+	os_atomic_add_int64(&copied_bytes, (int64_t)size);
+}
+
+static inline uint64_t get_copied_bytes(void)
+{
+	return (uint64_t)os_atomic_load_int64(&copied_bytes);
+}
+
 static void add_connection(struct obs_encoder *encoder)
 {
 	if (encoder->info.type == OBS_ENCODER_AUDIO) {
@@ -373,9 +387,25 @@ static void add_connection(struct obs_encoder *encoder)
 			add_ready_encoder_group(encoder);
 	}
 
+	encoder->copied_bytes_start = get_copied_bytes();
+	encoder->copied_time_start = os_gettime_ns();
+
 	set_encoder_active(encoder, true);
 }
 
+static void log_copied_bytes(struct obs_encoder *encoder)
+{
+	uint64_t bytes = get_copied_bytes() - encoder->copied_bytes_start;
+	uint64_t time = os_gettime_ns() - encoder->copied_time_start;
+
+	if (encoder->info.type != OBS_ENCODER_VIDEO || !time)
+		return;
+
+	blog(LOG_INFO, "encoder '%s': %.2f MiB/s of packet data copied while active (all encoders, %.1f MiB total)",
+	     encoder->context.name, (double)bytes / 1048576.0 / ((double)time / 1000000000.0),
+	     (double)bytes / 1048576.0);
+}
+
 void obs_encoder_group_actually_destroy(obs_encoder_group_t *group);
 static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 {
@@ -389,6 +419,8 @@ static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 		}
 	}
 
+	log_copied_bytes(encoder);
+
 	if (encoder->encoder_group) {
 		pthread_mutex_lock(&encoder->encoder_group->mutex);
 		if (--encoder->encoder_group->num_encoders_started == 0)
@@ -1261,11 +1293,79 @@ static inline bool get_sei(const struct obs_encoder *encoder, uint8_t **sei, siz
 	return false;
 }
 
+/* Shared by all references to a packet instance created by the encoder.  It
+ * is allocated in front of the refcount, laid out as [shared][refs][data],
+ * and registered by its data pointer, so that packets from anywhere else are
+ * never mistaken for one and struct encoder_packet keeps its public layout. */
+struct encoder_packet_shared {
+	/* AVCC/HVCC conversion, created by the first output that needs it */
+	struct encoder_packet *volatile converted;
+
+	uint8_t *data;
+	UT_hash_handle hh;
+};
+
+static pthread_mutex_t shared_packets_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct encoder_packet_shared *shared_packets = NULL;
+
+/* the caller must hold a reference to the packet */
+static struct encoder_packet_shared *get_shared(const struct encoder_packet *packet)
+{
+	struct encoder_packet_shared *shared = NULL;
+
+	if (!packet->data)
+		return NULL;
+
+	pthread_mutex_lock(&shared_packets_mutex);
+	HASH_FIND_PTR(shared_packets, &packet->data, shared);
+	pthread_mutex_unlock(&shared_packets_mutex);
+	return shared;
+}
+
+/* called once the last reference is gone */
+static struct encoder_packet_shared *remove_shared(uint8_t *data)
+{
+	struct encoder_packet_shared *shared = NULL;
+
+	pthread_mutex_lock(&shared_packets_mutex);
+	HASH_FIND_PTR(shared_packets, &data, shared);
+	if (shared)
+		HASH_DEL(shared_packets, shared);
+	pthread_mutex_unlock(&shared_packets_mutex);
+	return shared;
+}
+
+/* copies the packet data, with an optional prefix, into a new instance */
+static void create_shared_instance(struct encoder_packet *dst, const struct encoder_packet *src,
+				   const uint8_t *prefix, size_t prefix_size)
+{
+	struct encoder_packet_shared *shared;
+	size_t size = prefix_size + src->size;
+	long *p_refs;
+
+	shared = bzalloc(sizeof(struct encoder_packet_shared) + sizeof(long) + size);
+	p_refs = (long *)(shared + 1);
+	*p_refs = 1;
+
+	*dst = *src;
+	dst->data = (void *)(p_refs + 1);
+	dst->size = size;
+	if (prefix_size)
+		memcpy(dst->data, prefix, prefix_size);
+	memcpy(dst->data + prefix_size, src->data, src->size);
+
+	shared->data = dst->data;
+	pthread_mutex_lock(&shared_packets_mutex);
+	HASH_ADD_PTR(shared_packets, data, shared);
+	pthread_mutex_unlock(&shared_packets_mutex);
+
+	add_copied_bytes(size);
+}
+
 static void send_first_video_packet(struct obs_encoder *encoder, struct encoder_callback *cb,
 				    struct encoder_packet *packet, struct encoder_packet_time *packet_time)
 {
 	struct encoder_packet first_packet;
-	DARRAY(uint8_t) data;
 	uint8_t *sei;
 	size_t size;
 
@@ -1273,25 +1373,19 @@ static void send_first_video_packet(struct obs_encoder *encoder, struct encoder_
 	if (!packet->keyframe)
 		return;
 
-	da_init(data);
-
 	if (!get_sei(encoder, &sei, &size) || !sei || !size) {
 		cb->new_packet(cb->param, packet, packet_time);
 		cb->sent_first_packet = true;
 		return;
 	}
 
-	da_push_back_array(data, sei, size);
-	da_push_back_array(data, packet->data, packet->size);
-
-	first_packet = *packet;
-	first_packet.data = data.array;
-	first_packet.size = data.num;
+	/* a separate instance, so outputs can share it like any other */
+	create_shared_instance(&first_packet, packet, sei, size);
 
 	cb->new_packet(cb->param, &first_packet, packet_time);
 	cb->sent_first_packet = true;
 
-	da_free(data);
+	obs_encoder_packet_release(&first_packet);
 }
 
 static const char *send_packet_name = "send_packet";
@@ -1376,10 +1470,19 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success, bool received
 
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 
-		for (size_t i = encoder->callbacks.num; i > 0; i--) {
-			struct encoder_callback *cb;
-			cb = encoder->callbacks.array + (i - 1);
-			send_packet(encoder, cb, pkt, found_ept ? &ept_local : NULL);
+		if (encoder->callbacks.num) {
+			/* copy the packet once and let every output share it,
+			 * along with anything they derive from it */
+			struct encoder_packet instance;
+			create_shared_instance(&instance, pkt, NULL, 0);
+
+			for (size_t i = encoder->callbacks.num; i > 0; i--) {
+				struct encoder_callback *cb;
+				cb = encoder->callbacks.array + (i - 1);
+				send_packet(encoder, cb, &instance, found_ept ? &ept_local : NULL);
+			}
+
+			obs_encoder_packet_release(&instance);
 		}
 
 		pthread_mutex_unlock(&encoder->callbacks_mutex);
@@ -1784,6 +1887,83 @@ void obs_encoder_packet_create_instance(struct encoder_packet *dst, const struct
 	dst->data = (void *)(p_refs + 1);
 	*p_refs = 1;
 	memcpy(dst->data, src->data, src->size);
+
+	add_copied_bytes(src->size);
+}
+
+void obs_encoder_packet_share(struct encoder_packet *dst, struct encoder_packet *src)
+{
+	if (get_shared(src))
+		obs_encoder_packet_ref(dst, src);
+	else
+		obs_encoder_packet_create_instance(dst, src);
+}
+
+static inline void copy_converted(struct encoder_packet *dst, const struct encoder_packet *src,
+				  struct encoder_packet *converted)
+{
+	long *p_refs = ((long *)converted->data) - 1;
+	os_atomic_inc_long(p_refs);
+
+	/* timestamps and track can differ between outputs, so only the
+	 * data and what was parsed from it comes from the conversion */
+	*dst = *src;
+	dst->data = converted->data;
+	dst->size = converted->size;
+	dst->keyframe = converted->keyframe;
+	dst->priority = converted->priority;
+	dst->drop_priority = converted->drop_priority;
+}
+
+bool obs_encoder_packet_get_converted(struct encoder_packet *dst, const struct encoder_packet *src)
+{
+	struct encoder_packet_shared *shared = get_shared(src);
+	struct encoder_packet *converted;
+
+	if (!shared)
+		return false;
+
+	converted = os_atomic_load_ptr((void *const volatile *)&shared->converted);
+	if (!converted)
+		return false;
+
+	copy_converted(dst, src, converted);
+	return true;
+}
+
+void obs_encoder_packet_set_converted(struct encoder_packet *dst, const struct encoder_packet *src)
+{
+	struct encoder_packet_shared *shared = get_shared(src);
+	struct encoder_packet *converted;
+
+	add_copied_bytes(dst->size);
+
+	if (!shared)
+		return;
+
+	converted = bmalloc(sizeof(struct encoder_packet));
+	obs_encoder_packet_ref(converted, dst);
+
+	if (!os_atomic_compare_swap_ptr((void *volatile *)&shared->converted, NULL, converted)) {
+		/* another output converted it at the same time, use theirs */
+		obs_encoder_packet_release(converted);
+		bfree(converted);
+
+		obs_encoder_packet_release(dst);
+		obs_encoder_packet_get_converted(dst, src);
+	}
+}
+
+int obs_encoder_packet_get_converted_priority(const struct encoder_packet *src)
+{
+	struct encoder_packet_shared *shared = get_shared(src);
+	struct encoder_packet *converted;
+
+	if (!shared)
+		return -1;
+
+	converted = os_atomic_load_ptr((void *const volatile *)&shared->converted);
+	return converted ? converted->priority : -1;
 }
 
 void obs_encoder_packet_ref(struct encoder_packet *dst, struct encoder_packet *src)
@@ -1806,8 +1986,20 @@ void obs_encoder_packet_release(struct encoder_packet *pkt)
 
 	if (pkt->data) {
 		long *p_refs = ((long *)pkt->data) - 1;
-		if (os_atomic_dec_long(p_refs) == 0)
-			bfree(p_refs);
+
+		if (os_atomic_dec_long(p_refs) == 0) {
+			struct encoder_packet_shared *shared = remove_shared(pkt->data);
+
+			if (shared) {
+				if (shared->converted) {
+					obs_encoder_packet_release(shared->converted);
+					bfree(shared->converted);
+				}
+				bfree(shared);
+			} else {
+				bfree(p_refs);
+			}
+		}
 	}
 
 	memset(pkt, 0, sizeof(struct encoder_packet));
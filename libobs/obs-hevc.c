@@ -18,6 +18,7 @@
 #include "obs-hevc.h"
 
 #include "obs.h"
+#include "obs-internal.h"
 #include "obs-nal.h"
 #include "util/array-serializer.h"
 
@@ -89,65 +90,66 @@ static int compute_hevc_keyframe_priority(const uint8_t *nal_start, bool *is_key
 	return priority > new_priority ? priority : new_priority;
 }
 
-static void serialize_hevc_data(struct serializer *s, const uint8_t *data, size_t size, bool *is_keyframe,
+static void serialize_hevc_data(struct serializer *s, const struct obs_nal_index *index, bool *is_keyframe,
 				int *priority)
 {
-	const uint8_t *const end = data + size;
-	const uint8_t *nal_start = obs_nal_find_startcode(data, end);
-	while (true) {
-		while (nal_start < end && !*(nal_start++))
-			;
+	for (size_t i = 0; i < index->units.num; i++) {
+		const struct obs_nal_unit *nal = index->units.array + i;
 
-		if (nal_start == end)
-			break;
-
-		*priority = compute_hevc_keyframe_priority(nal_start, is_keyframe, *priority);
+		*priority = compute_hevc_keyframe_priority(nal->data, is_keyframe, *priority);
 
-		const uint8_t *const nal_end = obs_nal_find_startcode(nal_start, end);
-		const size_t nal_size = nal_end - nal_start;
-		s_wb32(s, (uint32_t)nal_size);
-		s_write(s, nal_start, nal_size);
-		nal_start = nal_end;
+		s_wb32(s, (uint32_t)nal->size);
+		s_write(s, nal->data, nal->size);
 	}
 }
 
 void obs_parse_hevc_packet(struct encoder_packet *hevc_packet, const struct encoder_packet *src)
 {
 	struct array_output_data output;
+	struct obs_nal_index index;
 	struct serializer s;
 	long ref = 1;
 
+	/* already converted for another output */
+	if (obs_encoder_packet_get_converted(hevc_packet, src))
+		return;
+
+	obs_nal_index_init(&index);
+	obs_nal_index_build(&index, src->data, src->size);
+
 	array_output_serializer_init(&s, &output);
+	da_reserve(output.bytes, sizeof(ref) + obs_nal_index_length_prefixed_size(&index));
 	*hevc_packet = *src;
 
 	serialize(&s, &ref, sizeof(ref));
-	serialize_hevc_data(&s, src->data, src->size, &hevc_packet->keyframe, &hevc_packet->priority);
+	serialize_hevc_data(&s, &index, &hevc_packet->keyframe, &hevc_packet->priority);
+	obs_nal_index_free(&index);
 
 	hevc_packet->data = output.bytes.array + sizeof(ref);
 	hevc_packet->size = output.bytes.num - sizeof(ref);
 	hevc_packet->drop_priority = hevc_packet->priority;
+
+	obs_encoder_packet_set_converted(hevc_packet, src);
 }
 
 int obs_parse_hevc_packet_priority(const struct encoder_packet *packet)
 {
-	int priority = packet->priority;
+	int priority = obs_encoder_packet_get_converted_priority(packet);
+	if (priority != -1)
+		return priority;
 
-	const uint8_t *const data = packet->data;
-	const uint8_t *const end = data + packet->size;
-	const uint8_t *nal_start = obs_nal_find_startcode(data, end);
-	while (true) {
-		while (nal_start < end && !*(nal_start++))
-			;
+	priority = packet->priority;
 
-		if (nal_start == end)
-			break;
+	struct obs_nal_index index;
+	obs_nal_index_init(&index);
+	obs_nal_index_build(&index, packet->data, packet->size);
 
+	for (size_t i = 0; i < index.units.num; i++) {
 		bool unused;
-		priority = compute_hevc_keyframe_priority(nal_start, &unused, priority);
-
-		nal_start = obs_nal_find_startcode(nal_start, end);
+		priority = compute_hevc_keyframe_priority(index.units.array[i].data, &unused, priority);
 	}
 
+	obs_nal_index_free(&index);
 	return priority;
 }
 
@@ -157,42 +159,32 @@ void obs_extract_hevc_headers(const uint8_t *packet, size_t size, uint8_t **new_
 	DARRAY(uint8_t) new_packet;
 	DARRAY(uint8_t) header;
 	DARRAY(uint8_t) sei;
-	const uint8_t *nal_start, *nal_end, *nal_codestart;
-	const uint8_t *end = packet + size;
+	struct obs_nal_index index;
 
 	da_init(new_packet);
 	da_init(header);
 	da_init(sei);
 
-	nal_start = obs_nal_find_startcode(packet, end);
-	nal_end = NULL;
-	while (nal_end != end) {
-		nal_codestart = nal_start;
-
-		while (nal_start < end && !*(nal_start++))
-			;
-
-		if (nal_start == end)
-			break;
-
-		const uint8_t type = (nal_start[0] & 0x7F) >> 1;
+	obs_nal_index_init(&index);
+	obs_nal_index_build(&index, packet, size);
 
-		nal_end = obs_nal_find_startcode(nal_start, end);
-		if (!nal_end)
-			nal_end = end;
+	for (size_t i = 0; i < index.units.num; i++) {
+		const struct obs_nal_unit *nal = index.units.array + i;
+		const uint8_t type = (nal->data[0] & 0x7F) >> 1;
+		const size_t nal_size = nal->data + nal->size - nal->startcode;
 
 		if (type == OBS_HEVC_NAL_VPS || type == OBS_HEVC_NAL_SPS || type == OBS_HEVC_NAL_PPS) {
-			da_push_back_array(header, nal_codestart, nal_end - nal_codestart);
+			da_push_back_array(header, nal->startcode, nal_size);
 		} else if (type == OBS_HEVC_NAL_SEI_PREFIX || type == OBS_HEVC_NAL_SEI_SUFFIX) {
-			da_push_back_array(sei, nal_codestart, nal_end - nal_codestart);
+			da_push_back_array(sei, nal->startcode, nal_size);
 
 		} else {
-			da_push_back_array(new_packet, nal_codestart, nal_end - nal_codestart);
+			da_push_back_array(new_packet, nal->startcode, nal_size);
 		}
-
-		nal_start = nal_end;
 	}
 
+	obs_nal_index_free(&index);
+
 	*new_packet_data = new_packet.array;
 	*new_packet_size = new_packet.num;
 	*header_data = header.array;
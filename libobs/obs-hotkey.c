@@ -1105,6 +1105,10 @@ void obs_hotkey_inject_event(obs_key_combination_t hotkey, bool pressed)
 	};
 	enum_bindings(inject_hotkey, &event);
 	unlock();
+
+	/* releases are picked up by the hotkey thread */
+	if (!pressed)
+		os_event_signal(obs->hotkeys.wake_event);
 }
 
 void obs_hotkey_enable_background_press(bool enable)
@@ -1154,17 +1158,87 @@ static inline void query_hotkeys()
 
 #define NBSP "\xC2\xA0"
 
+void obs_hotkeys_platform_key_state_changed(void)
+{
+	struct obs_core_hotkeys *hotkeys = &obs->hotkeys;
+
+	pthread_mutex_lock(&hotkeys->event_mutex);
+	if (!hotkeys->event_ts)
+		hotkeys->event_ts = os_gettime_ns();
+	pthread_mutex_unlock(&hotkeys->event_mutex);
+
+	os_event_signal(hotkeys->wake_event);
+}
+
+void obs_hotkeys_platform_events_lost(void)
+{
+	struct obs_core_hotkeys *hotkeys = &obs->hotkeys;
+
+	os_atomic_set_bool(&hotkeys->event_driven, false);
+	os_event_signal(hotkeys->wake_event);
+}
+
+static inline void update_event_latency(struct obs_core_hotkeys *hotkeys)
+{
+	uint64_t event_ts;
+
+	pthread_mutex_lock(&hotkeys->event_mutex);
+	event_ts = hotkeys->event_ts;
+	hotkeys->event_ts = 0;
+	pthread_mutex_unlock(&hotkeys->event_mutex);
+
+	if (!event_ts)
+		return;
+
+	uint64_t latency = os_gettime_ns() - event_ts;
+	hotkeys->event_count++;
+	hotkeys->event_latency_total += latency;
+	if (latency > hotkeys->event_latency_max)
+		hotkeys->event_latency_max = latency;
+}
+
+static const char *register_hotkey_thread_root(bool event_driven)
+{
+	const char *name;
+
+	if (event_driven) {
+		name = profile_store_name(obs_get_profiler_name_store(), "obs_hotkey_thread(events)");
+		profile_register_root(name, 0);
+	} else {
+		name = profile_store_name(obs_get_profiler_name_store(), "obs_hotkey_thread(%g" NBSP "ms)", 25.);
+		profile_register_root(name, (uint64_t)25000000);
+	}
+
+	return name;
+}
+
 void *obs_hotkey_thread(void *arg)
 {
 	UNUSED_PARAMETER(arg);
 
+	struct obs_core_hotkeys *hotkeys = &obs->hotkeys;
+	const char *hotkey_thread_name;
+	bool event_driven = os_atomic_load_bool(&hotkeys->event_driven);
+
 	os_set_thread_name("libobs: hotkey thread");
 
-	const char *hotkey_thread_name =
-		profile_store_name(obs_get_profiler_name_store(), "obs_hotkey_thread(%g" NBSP "ms)", 25.);
-	profile_register_root(hotkey_thread_name, (uint64_t)25000000);
+	hotkey_thread_name = register_hotkey_thread_root(event_driven);
+
+	for (;;) {
+		/* the platform can lose its event source and fall back to
+		 * polling at any time */
+		if (event_driven && !os_atomic_load_bool(&hotkeys->event_driven)) {
+			event_driven = false;
+			hotkey_thread_name = register_hotkey_thread_root(false);
+		}
+
+		if (event_driven)
+			os_event_wait(hotkeys->wake_event);
+		else
+			os_event_timedwait(hotkeys->wake_event, 25);
 
-	while (os_event_timedwait(obs->hotkeys.stop_event, 25) == ETIMEDOUT) {
+		if (os_event_try(hotkeys->stop_event) != EAGAIN)
+			break;
 		if (!lock())
 			continue;
 
@@ -1174,8 +1248,17 @@ void *obs_hotkey_thread(void *arg)
 
 		unlock();
 
+		update_event_latency(hotkeys);
 		profile_reenable_thread();
 	}
+
+	if (hotkeys->event_count) {
+		double avg = (double)hotkeys->event_latency_total / (double)hotkeys->event_count;
+		blog(LOG_INFO,
+		     "Hotkey key events: %" PRIu64 ", average event to dispatch latency: %.3f ms, "
+		     "max: %.3f ms",
+		     hotkeys->event_count, avg / 1000000.0, (double)hotkeys->event_latency_max / 1000000.0);
+	}
 	return NULL;
 }
 
@@ -21,6 +21,7 @@
 #include "util/darray.h"
 #include "util/deque.h"
 #include "util/dstr.h"
+#include "util/spsc-ring.h"
 #include "util/threading.h"
 #include "util/platform.h"
 #include "util/profiler.h"
@@ -36,6 +37,7 @@
 #include "media-io/audio-resampler.h"
 #include "media-io/video-io.h"
 #include "media-io/audio-io.h"
+#include "media-io/audio-buffering.h"
 
 #include "obs.h"
 
@@ -247,6 +249,14 @@ bool obs_hotkeys_platform_init(struct obs_core_hotkeys *hotkeys);
 void obs_hotkeys_platform_free(struct obs_core_hotkeys *hotkeys);
 bool obs_hotkeys_platform_is_pressed(obs_hotkeys_platform_t *context, obs_key_t key);
 
+/* called by platforms that set hotkeys->event_driven whenever key state
+ * changes, wakes the hotkey thread instead of waiting for the next poll */
+void obs_hotkeys_platform_key_state_changed(void);
+
+/* called by platforms that set hotkeys->event_driven if they stop receiving
+ * key events, the hotkey thread goes back to polling */
+void obs_hotkeys_platform_events_lost(void);
+
 const char *obs_get_hotkey_translation(obs_key_t key, const char *def);
 
 struct obs_context_data;
@@ -299,6 +309,10 @@ struct obs_display {
 	DARRAY(struct draw_callback) draw_callbacks;
 	bool use_clear_workaround;
 
+	volatile bool visible;
+	volatile long min_interval_us;
+	uint64_t next_render_ts;
+
 	struct obs_display *next;
 	struct obs_display **prev_next;
 };
@@ -409,6 +423,8 @@ struct obs_core_video {
 	pthread_t video_thread;
 	uint32_t total_frames;
 	uint32_t lagged_frames;
+	uint32_t display_lagged_frames;
+	bool displays_skipped;
 	bool thread_initialized;
 
 	gs_texture_t *transparent_texture;
@@ -452,6 +468,10 @@ struct obs_core_audio {
 	int max_buffering_ticks;
 	bool fixed_buffer;
 
+	/* gives buffering back once sources have been on time for a while */
+	struct audio_buffering adaptive_buffering;
+	volatile long buffering_ms;
+
 	pthread_mutex_t monitoring_mutex;
 	DARRAY(struct audio_monitor *) monitors;
 	char *monitoring_device_name;
@@ -487,6 +507,9 @@ struct obs_core_data {
 	pthread_mutex_t audio_sources_mutex;
 	pthread_mutex_t draw_callbacks_mutex;
 	pthread_mutex_t canvases_mutex;
+	pthread_mutex_t volmeters_mutex;
+	DARRAY(struct obs_volmeter *) volmeters;
+	DARRAY(struct obs_volmeter *) volmeters_updated; /* audio thread only */
 	DARRAY(struct draw_callback) draw_callbacks;
 	DARRAY(struct rendered_callback) rendered_callbacks;
 	DARRAY(struct tick_callback) tick_callbacks;
@@ -515,6 +538,8 @@ struct obs_core_hotkeys {
 	pthread_t hotkey_thread;
 	bool hotkey_thread_initialized;
 	os_event_t *stop_event;
+	os_event_t *wake_event;
+	volatile bool event_driven;
 	bool thread_disable_press;
 	bool strict_modifiers;
 	bool reroute_hotkeys;
@@ -525,6 +550,12 @@ struct obs_core_hotkeys {
 
 	obs_hotkeys_platform_t *platform_context;
 
+	pthread_mutex_t event_mutex;
+	uint64_t event_ts;
+	uint64_t event_count;
+	uint64_t event_latency_total;
+	uint64_t event_latency_max;
+
 	pthread_once_t name_map_init_token;
 	struct obs_hotkey_name_map_item *name_map;
 
@@ -561,6 +592,19 @@ struct obs_core {
 	signal_handler_t *signals;
 	proc_handler_t *procs;
 
+	/* pre-laid-out calldata for signals emitted at a high rate */
+	calldata_layout_t *source_layout;
+	calldata_layout_t *source_canvas_layout;
+	calldata_layout_t *volume_layout;
+	calldata_layout_t *balance_layout;
+	calldata_layout_t *sync_offset_layout;
+
+	/* scheduling requested for the graphics and audio threads */
+	volatile long thread_sched_gen;
+	bool thread_sched_realtime;
+	int graphics_thread_cpu;
+	int audio_thread_cpu;
+
 	char *locale;
 	char *module_config_path;
 	bool name_store_owned;
@@ -587,6 +631,8 @@ struct obs_graphics_context {
 	uint64_t fps_total_ns;
 	uint32_t fps_total_frames;
 	const char *video_thread_name;
+	os_pacer_t *pacer;
+	long sched_gen;
 };
 
 extern void *obs_graphics_thread(void *param);
@@ -803,6 +849,8 @@ struct media_action {
 	};
 };
 
+#define NUM_RENDER_CACHE_SPACES (GS_CS_709_SCRGB + 1)
+
 struct obs_source {
 	struct obs_context_data context;
 	struct obs_source_info info;
@@ -866,12 +914,16 @@ struct obs_source {
 	uint64_t audio_ts;
 	struct deque audio_input_buf[MAX_AUDIO_CHANNELS];
 	size_t last_audio_input_buf_size;
+	struct spsc_ring audio_ring;
+	volatile long audio_ring_dropped;
+	long audio_ring_dropped_logged;
 	DARRAY(struct audio_action) audio_actions;
 	float *audio_output_buf[MAX_AUDIO_MIXES][MAX_AUDIO_CHANNELS];
 	float *audio_mix_buf[MAX_AUDIO_CHANNELS];
 	struct resample_info sample_info;
 	audio_resampler_t *resampler;
 	pthread_mutex_t audio_actions_mutex;
+	/* serializes writers of the audio ring, never taken by the audio thread */
 	pthread_mutex_t audio_buf_mutex;
 	pthread_mutex_t audio_mutex;
 	pthread_mutex_t audio_cb_mutex;
@@ -987,6 +1039,13 @@ struct obs_source {
 	/* color space */
 	gs_texrender_t *color_space_texrender;
 
+	/* render-once cache for sources drawn several times per frame, one
+	 * texture per target color space, reset every tick */
+	gs_texrender_t *render_cache[NUM_RENDER_CACHE_SPACES];
+	uint32_t render_count;
+	bool render_cache_enabled;
+	bool view_dependent;
+
 	/* audio monitoring */
 	struct audio_monitor *monitor;
 	enum obs_monitoring_type monitoring_type;
@@ -1032,8 +1091,8 @@ static inline void obs_source_dosignal(struct obs_source *source, const char *si
 	struct calldata data;
 	uint8_t stack[128];
 
-	calldata_init_fixed(&data, stack, sizeof(stack));
-	calldata_set_ptr(&data, "source", source);
+	calldata_init_layout(&data, obs->source_layout, stack, sizeof(stack));
+	calldata_set_slot_ptr(&data, obs->source_layout, 0, source);
 	if (signal_obs && !source->context.private)
 		signal_handler_signal(obs->signals, signal_obs, &data);
 	if (signal_source)
@@ -1046,9 +1105,9 @@ static inline void obs_source_dosignal_canvas(struct obs_source *source, struct
 	struct calldata data;
 	uint8_t stack[128];
 
-	calldata_init_fixed(&data, stack, sizeof(stack));
-	calldata_set_ptr(&data, "source", source);
-	calldata_set_ptr(&data, "canvas", canvas);
+	calldata_init_layout(&data, obs->source_canvas_layout, stack, sizeof(stack));
+	calldata_set_slot_ptr(&data, obs->source_canvas_layout, 0, source);
+	calldata_set_slot_ptr(&data, obs->source_canvas_layout, 1, canvas);
 	if (signal_obs && !source->context.private)
 		signal_handler_signal(obs->signals, signal_obs, &data);
 	if (signal_source)
@@ -1123,6 +1182,7 @@ extern void obs_source_video_tick(obs_source_t *source, float seconds);
 extern float obs_source_get_target_volume(obs_source_t *source, obs_source_t *target);
 extern uint64_t obs_source_get_last_async_ts(const obs_source_t *source);
 
+extern void obs_source_drain_audio(obs_source_t *source);
 extern void obs_source_audio_render(obs_source_t *source, uint32_t mixers, size_t channels, size_t sample_rate,
 				    size_t size);
 
@@ -1141,6 +1201,9 @@ extern void deinterlace_process_last_frame(obs_source_t *source, uint64_t sys_ti
 extern void deinterlace_update_async_video(obs_source_t *source);
 extern void deinterlace_render(obs_source_t *s);
 
+/* audio thread only, measures what all volume meters received this tick */
+extern void obs_process_volmeters(void);
+
 /* ------------------------------------------------------------------------- */
 /* outputs  */
 
@@ -1350,6 +1413,13 @@ struct obs_encoder_group {
 	uint64_t start_timestamp;
 };
 
+/* packet instances created by the encoder are shared by all outputs, along
+ * with their AVCC/HVCC conversion */
+extern void obs_encoder_packet_share(struct encoder_packet *dst, struct encoder_packet *src);
+extern bool obs_encoder_packet_get_converted(struct encoder_packet *dst, const struct encoder_packet *src);
+extern void obs_encoder_packet_set_converted(struct encoder_packet *dst, const struct encoder_packet *src);
+extern int obs_encoder_packet_get_converted_priority(const struct encoder_packet *src);
+
 struct obs_encoder {
 	struct obs_context_data context;
 	struct obs_encoder_info info;
@@ -1400,6 +1470,11 @@ struct obs_encoder {
 	// Number of frames successfully encoded
 	uint32_t encoded_frames;
 
+	/* packet bytes copied by libobs when the encoder was started, to log
+	 * the copy rate when it stops */
+	uint64_t copied_bytes_start;
+	uint64_t copied_time_start;
+
 	/* Regions of interest to prioritize during encoding */
 	pthread_mutex_t roi_mutex;
 	DARRAY(struct obs_encoder_roi) roi;
@@ -1507,6 +1582,9 @@ extern void source_profiler_render_end(void);
 /* Reset settings, buffers, and GPU timers when video settings change */
 extern void source_profiler_reset_video(struct obs_video_info *ovi);
 
+/* Stop collecting and free all data, while sources and graphics still exist */
+extern void source_profiler_shutdown(void);
+
 /* Signal that source received an async frame */
 extern void source_profiler_async_frame_received(obs_source_t *source);
 
@@ -16,51 +16,87 @@
 ******************************************************************************/
 
 #include "obs-nal.h"
+#include "util/sse-intrin.h"
 
-/* NOTE: I noticed that FFmpeg does some unusual special handling of certain
- * scenarios that I was unaware of, so instead of just searching for {0, 0, 1}
- * we'll just use the code from FFmpeg - http://www.ffmpeg.org/ */
-static const uint8_t *ff_avc_find_startcode_internal(const uint8_t *p, const uint8_t *end)
+/* Returns the first {0, 0, 1} in [p, end - 3), or end.  This matches the
+ * FFmpeg based scanner this replaced, which never matched a startcode in the
+ * last three bytes. */
+static const uint8_t *find_startcode_internal(const uint8_t *p, const uint8_t *end)
 {
-	const uint8_t *a = p + 4 - ((intptr_t)p & 3);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
 
-	for (end -= 3; p < a && p < end; p++) {
-		if (p[0] == 0 && p[1] == 0 && p[2] == 1)
-			return p;
-	}
+	/* compare 16 candidate positions at once, the last of which reads
+	 * up to p[17] and must be below end - 3 */
+	while (end - p >= 19) {
+		__m128i b0 = _mm_loadu_si128((const __m128i *)p);
+		__m128i b1 = _mm_loadu_si128((const __m128i *)(p + 1));
+		__m128i b2 = _mm_loadu_si128((const __m128i *)(p + 2));
 
-	for (end -= 3; p < end; p += 4) {
-		uint32_t x = *(const uint32_t *)p;
+		__m128i match = _mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero));
+		match = _mm_and_si128(match, _mm_cmpeq_epi8(b2, one));
 
-		if ((x - 0x01010101) & (~x) & 0x80808080) {
-			if (p[1] == 0) {
-				if (p[0] == 0 && p[2] == 1)
-					return p;
-				if (p[2] == 0 && p[3] == 1)
-					return p + 1;
-			}
-
-			if (p[3] == 0) {
-				if (p[2] == 0 && p[4] == 1)
-					return p + 2;
-				if (p[4] == 0 && p[5] == 1)
-					return p + 3;
+		int mask = _mm_movemask_epi8(match);
+		if (mask) {
+			while (!(mask & 1)) {
+				mask >>= 1;
+				p++;
 			}
+			return p;
 		}
+
+		p += 16;
 	}
 
-	for (end += 3; p < end; p++) {
+	for (; end - p > 3; p++) {
 		if (p[0] == 0 && p[1] == 0 && p[2] == 1)
 			return p;
 	}
 
-	return end + 3;
+	return end;
 }
 
 const uint8_t *obs_nal_find_startcode(const uint8_t *p, const uint8_t *end)
 {
-	const uint8_t *out = ff_avc_find_startcode_internal(p, end);
+	const uint8_t *out = find_startcode_internal(p, end);
 	if (p < out && out < end && !out[-1])
 		out--;
 	return out;
 }
+
+void obs_nal_index_init(struct obs_nal_index *index)
+{
+	da_init(index->units);
+}
+
+void obs_nal_index_free(struct obs_nal_index *index)
+{
+	da_free(index->units);
+}
+
+void obs_nal_index_build(struct obs_nal_index *index, const uint8_t *data, size_t size)
+{
+	const uint8_t *const end = data + size;
+	const uint8_t *nal_start = obs_nal_find_startcode(data, end);
+
+	da_resize(index->units, 0);
+
+	while (true) {
+		const uint8_t *startcode = nal_start;
+
+		while (nal_start < end && !*(nal_start++))
+			;
+
+		if (nal_start == end)
+			break;
+
+		const uint8_t *const nal_end = obs_nal_find_startcode(nal_start, end);
+
+		struct obs_nal_unit *unit = da_push_back_new(index->units);
+		unit->startcode = startcode;
+		unit->data = nal_start;
+		unit->size = nal_end - nal_start;
+
+		nal_start = nal_end;
+	}
+}
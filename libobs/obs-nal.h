@@ -18,6 +18,7 @@
 #pragma once
 
 #include "util/c99defs.h"
+#include "util/darray.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -30,8 +31,38 @@ enum {
 	OBS_NAL_PRIORITY_HIGHEST = 3,
 };
 
+struct obs_nal_unit {
+	/* start of the unit including its startcode, for copying it as is */
+	const uint8_t *startcode;
+
+	/* NAL header, following the startcode */
+	const uint8_t *data;
+
+	/* size of the unit from data, excluding the startcode */
+	size_t size;
+};
+
+/* All NAL units of an Annex B packet, found in a single pass.  The units
+ * point into the packet, so it must outlive the index. */
+struct obs_nal_index {
+	DARRAY(struct obs_nal_unit) units;
+};
+
 EXPORT const uint8_t *obs_nal_find_startcode(const uint8_t *p, const uint8_t *end);
 
+EXPORT void obs_nal_index_init(struct obs_nal_index *index);
+EXPORT void obs_nal_index_free(struct obs_nal_index *index);
+EXPORT void obs_nal_index_build(struct obs_nal_index *index, const uint8_t *data, size_t size);
+
+/* size of all units when written with 4 byte length prefixes (AVCC/HVCC) */
+static inline size_t obs_nal_index_length_prefixed_size(const struct obs_nal_index *index)
+{
+	size_t size = 0;
+	for (size_t i = 0; i < index->units.num; i++)
+		size += 4 + index->units.array[i].size;
+	return size;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -246,6 +246,10 @@ static bool obs_nix_wayland_hotkeys_platform_init(struct obs_core_hotkeys *hotke
 	struct wl_registry *registry = wl_display_get_registry(display);
 	wl_registry_add_listener(registry, &registry_listener, hotkeys->platform_context);
 	wl_display_roundtrip(display);
+
+	// Key state is never available outside of focus (see is_pressed), so
+	// there is nothing to poll for. Injected releases still wake the thread.
+	hotkeys->event_driven = true;
 	return true;
 }
 
@@ -31,6 +31,10 @@
 #include <X11/XF86keysym.h>
 #include <X11/Sunkeysym.h>
 
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
 void obs_nix_x11_log_info(void)
 {
 	Display *dpy = obs_get_nix_platform_display();
@@ -96,6 +100,17 @@ struct obs_hotkeys_platform {
 	bool pressed[XINPUT_MOUSE_LEN];
 	bool update[XINPUT_MOUSE_LEN];
 	bool button_pressed[XINPUT_MOUSE_LEN];
+
+	/* raw event listener, keeps key state locally so that the hotkey
+	 * thread neither has to poll nor round trip to the server */
+	xcb_connection_t *event_connection;
+	volatile bool events_lost;
+	uint8_t xinput_opcode;
+	pthread_t event_thread;
+	int event_stop_fds[2];
+	pthread_mutex_t state_mutex;
+	uint8_t keys[32];
+	bool buttons[XINPUT_MOUSE_LEN];
 #endif
 };
 
@@ -821,9 +836,8 @@ static inline xcb_window_t root_window(obs_hotkeys_platform_t *context, xcb_conn
 }
 
 #if defined(XCB_XINPUT_FOUND)
-static inline void registerMouseEvents(struct obs_core_hotkeys *hotkeys)
+static inline void registerMouseEvents(obs_hotkeys_platform_t *context)
 {
-	obs_hotkeys_platform_t *context = hotkeys->platform_context;
 	xcb_connection_t *connection = XGetXCBConnection(context->display);
 	xcb_window_t window = root_window(context, connection);
 
@@ -838,6 +852,180 @@ static inline void registerMouseEvents(struct obs_core_hotkeys *hotkeys)
 	xcb_input_xi_select_events(connection, window, 1, &mask.head);
 	xcb_flush(connection);
 }
+
+/* key state is only tracked locally while the event connection is alive */
+static inline bool use_event_state(obs_hotkeys_platform_t *context)
+{
+	return context->event_connection && !os_atomic_load_bool(&context->events_lost);
+}
+
+/* returns true if the event changed key or button state */
+static bool handle_raw_event(obs_hotkeys_platform_t *context, xcb_generic_event_t *ev)
+{
+	xcb_ge_generic_event_t *ge = (xcb_ge_generic_event_t *)ev;
+	bool changed = true;
+
+	if ((ev->response_type & ~0x80) != XCB_GE_GENERIC || ge->extension != context->xinput_opcode)
+		return false;
+
+	pthread_mutex_lock(&context->state_mutex);
+
+	switch (ge->event_type) {
+	case XCB_INPUT_RAW_KEY_PRESS:
+	case XCB_INPUT_RAW_KEY_RELEASE: {
+		uint32_t code = ((xcb_input_raw_key_press_event_t *)ev)->detail;
+		if (code >= sizeof(context->keys) * 8) {
+			changed = false;
+		} else if (ge->event_type == XCB_INPUT_RAW_KEY_PRESS) {
+			context->keys[code / 8] |= (uint8_t)(1 << (code % 8));
+		} else {
+			context->keys[code / 8] &= (uint8_t)~(1 << (code % 8));
+		}
+		break;
+	}
+	case XCB_INPUT_RAW_BUTTON_PRESS:
+	case XCB_INPUT_RAW_BUTTON_RELEASE: {
+		uint32_t button = ((xcb_input_raw_button_press_event_t *)ev)->detail;
+		if (button >= 1 && button < XINPUT_MOUSE_LEN)
+			context->buttons[button - 1] = ge->event_type == XCB_INPUT_RAW_BUTTON_PRESS;
+		else
+			changed = false;
+		break;
+	}
+	default:
+		changed = false;
+	}
+
+	pthread_mutex_unlock(&context->state_mutex);
+	return changed;
+}
+
+static void *x11_event_thread(void *data)
+{
+	obs_hotkeys_platform_t *context = data;
+	xcb_connection_t *connection = context->event_connection;
+	struct pollfd fds[2] = {
+		{.fd = xcb_get_file_descriptor(connection), .events = POLLIN},
+		{.fd = context->event_stop_fds[0], .events = POLLIN},
+	};
+
+	os_set_thread_name("libobs: x11 hotkey events");
+
+	for (;;) {
+		xcb_generic_event_t *ev;
+		bool changed = false;
+
+		while ((ev = xcb_poll_for_event(connection))) {
+			changed |= handle_raw_event(context, ev);
+			free(ev);
+		}
+
+		if (changed)
+			obs_hotkeys_platform_key_state_changed();
+
+		if (xcb_connection_has_error(connection)) {
+			blog(LOG_WARNING, "X11 hotkey event connection lost, falling back to polling hotkeys");
+			break;
+		}
+
+		if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+			blog(LOG_WARNING, "Failed to wait for X11 hotkey events, falling back to polling hotkeys");
+			break;
+		}
+		if (fds[1].revents)
+			return NULL;
+	}
+
+	registerMouseEvents(context);
+	os_atomic_set_bool(&context->events_lost, true);
+	obs_hotkeys_platform_events_lost();
+	return NULL;
+}
+
+/* Opens a separate connection that receives XInput2 raw key and button
+ * events.  Raw events are delivered to the root window regardless of focus
+ * and grabs from XI 2.1 on, which makes them usable for global hotkeys. */
+static bool start_event_thread(obs_hotkeys_platform_t *context)
+{
+	const xcb_query_extension_reply_t *ext;
+	xcb_input_xi_query_version_reply_t *version;
+	xcb_query_keymap_reply_t *keymap;
+	xcb_connection_t *connection;
+	bool supported;
+
+	connection = xcb_connect(DisplayString(context->display), NULL);
+	if (xcb_connection_has_error(connection))
+		goto fail;
+
+	ext = xcb_get_extension_data(connection, &xcb_input_id);
+	if (!ext || !ext->present)
+		goto fail;
+
+	version = xcb_input_xi_query_version_reply(connection, xcb_input_xi_query_version(connection, 2, 2), NULL);
+	supported = version &&
+		    (version->major_version > 2 || (version->major_version == 2 && version->minor_version >= 1));
+	free(version);
+	if (!supported)
+		goto fail;
+
+	struct {
+		xcb_input_event_mask_t head;
+		xcb_input_xi_event_mask_t mask;
+	} mask;
+	mask.head.deviceid = XCB_INPUT_DEVICE_ALL_MASTER;
+	mask.head.mask_len = sizeof(mask.mask) / sizeof(uint32_t);
+	mask.mask = XCB_INPUT_XI_EVENT_MASK_RAW_KEY_PRESS | XCB_INPUT_XI_EVENT_MASK_RAW_KEY_RELEASE |
+		    XCB_INPUT_XI_EVENT_MASK_RAW_BUTTON_PRESS | XCB_INPUT_XI_EVENT_MASK_RAW_BUTTON_RELEASE;
+
+	xcb_input_xi_select_events(connection, root_window(context, connection), 1, &mask.head);
+
+	/* events are selected first, so anything that changes after the
+	 * initial state was queried is still picked up by the thread */
+	keymap = xcb_query_keymap_reply(connection, xcb_query_keymap(connection), NULL);
+	if (!keymap)
+		goto fail;
+	memcpy(context->keys, keymap->keys, sizeof(context->keys));
+	free(keymap);
+
+	if (pipe(context->event_stop_fds) != 0)
+		goto fail;
+	if (pthread_mutex_init(&context->state_mutex, NULL) != 0)
+		goto fail_pipe;
+
+	context->event_connection = connection;
+	context->xinput_opcode = ext->major_opcode;
+
+	if (pthread_create(&context->event_thread, NULL, x11_event_thread, context) != 0) {
+		context->event_connection = NULL;
+		pthread_mutex_destroy(&context->state_mutex);
+		goto fail_pipe;
+	}
+
+	return true;
+
+fail_pipe:
+	close(context->event_stop_fds[0]);
+	close(context->event_stop_fds[1]);
+fail:
+	xcb_disconnect(connection);
+	return false;
+}
+
+static void stop_event_thread(obs_hotkeys_platform_t *context)
+{
+	if (!context->event_connection)
+		return;
+
+	if (write(context->event_stop_fds[1], "", 1) != 1)
+		blog(LOG_WARNING, "Failed to signal X11 hotkey event thread");
+	pthread_join(context->event_thread, NULL);
+
+	close(context->event_stop_fds[0]);
+	close(context->event_stop_fds[1]);
+	pthread_mutex_destroy(&context->state_mutex);
+	xcb_disconnect(context->event_connection);
+	context->event_connection = NULL;
+}
 #endif
 
 static bool obs_nix_x11_hotkeys_platform_init(struct obs_core_hotkeys *hotkeys)
@@ -850,11 +1038,17 @@ static bool obs_nix_x11_hotkeys_platform_init(struct obs_core_hotkeys *hotkeys)
 	hotkeys->platform_context = bzalloc(sizeof(obs_hotkeys_platform_t));
 	hotkeys->platform_context->display = display;
 
-#if defined(XCB_XINPUT_FOUND)
-	registerMouseEvents(hotkeys);
-#endif
 	fill_base_keysyms(hotkeys);
 	fill_keycodes(hotkeys);
+
+#if defined(XCB_XINPUT_FOUND)
+	if (start_event_thread(hotkeys->platform_context)) {
+		hotkeys->event_driven = true;
+	} else {
+		blog(LOG_INFO, "XInput 2.1 raw events unavailable, polling hotkeys");
+		registerMouseEvents(hotkeys->platform_context);
+	}
+#endif
 	return true;
 }
 
@@ -864,6 +1058,10 @@ static void obs_nix_x11_hotkeys_platform_free(struct obs_core_hotkeys *hotkeys)
 	if (!context)
 		return;
 
+#if defined(XCB_XINPUT_FOUND)
+	stop_event_thread(context);
+#endif
+
 	for (size_t i = 0; i < OBS_KEY_LAST_VALUE; i++)
 		da_free(context->keycodes[i].list);
 
@@ -882,35 +1080,41 @@ static bool mouse_button_pressed(xcb_connection_t *connection, obs_hotkeys_platf
 	memset(context->pressed, 0, XINPUT_MOUSE_LEN);
 	memset(context->update, 0, XINPUT_MOUSE_LEN);
 
-	xcb_generic_event_t *ev;
-	while ((ev = xcb_poll_for_event(connection))) {
-		if ((ev->response_type & ~80) == XCB_GE_GENERIC) {
-			switch (((xcb_ge_event_t *)ev)->event_type) {
-			case XCB_INPUT_RAW_BUTTON_PRESS: {
-				xcb_input_raw_button_press_event_t *mot;
-				mot = (xcb_input_raw_button_press_event_t *)ev;
-				if (mot->detail < XINPUT_MOUSE_LEN) {
-					context->pressed[mot->detail - 1] = true;
-					context->update[mot->detail - 1] = true;
-				} else {
-					blog(LOG_WARNING, "Unsupported button");
+	if (use_event_state(context)) {
+		pthread_mutex_lock(&context->state_mutex);
+		memcpy(context->pressed, context->buttons, XINPUT_MOUSE_LEN);
+		pthread_mutex_unlock(&context->state_mutex);
+	} else {
+		xcb_generic_event_t *ev;
+		while ((ev = xcb_poll_for_event(connection))) {
+			if ((ev->response_type & ~80) == XCB_GE_GENERIC) {
+				switch (((xcb_ge_event_t *)ev)->event_type) {
+				case XCB_INPUT_RAW_BUTTON_PRESS: {
+					xcb_input_raw_button_press_event_t *mot;
+					mot = (xcb_input_raw_button_press_event_t *)ev;
+					if (mot->detail < XINPUT_MOUSE_LEN) {
+						context->pressed[mot->detail - 1] = true;
+						context->update[mot->detail - 1] = true;
+					} else {
+						blog(LOG_WARNING, "Unsupported button");
+					}
+					break;
+				}
+				case XCB_INPUT_RAW_BUTTON_RELEASE: {
+					xcb_input_raw_button_release_event_t *mot;
+					mot = (xcb_input_raw_button_release_event_t *)ev;
+					if (mot->detail < XINPUT_MOUSE_LEN)
+						context->update[mot->detail - 1] = true;
+					else
+						blog(LOG_WARNING, "Unsupported button");
+					break;
+				}
+				default:
+					break;
 				}
-				break;
-			}
-			case XCB_INPUT_RAW_BUTTON_RELEASE: {
-				xcb_input_raw_button_release_event_t *mot;
-				mot = (xcb_input_raw_button_release_event_t *)ev;
-				if (mot->detail < XINPUT_MOUSE_LEN)
-					context->update[mot->detail - 1] = true;
-				else
-					blog(LOG_WARNING, "Unsupported button");
-				break;
-			}
-			default:
-				break;
 			}
+			free(ev);
 		}
-		free(ev);
 	}
 
 	// Mouse 2 for OBS is Right Click and Mouse 3 is Wheel Click.
@@ -1043,34 +1247,46 @@ static bool mouse_button_pressed(xcb_connection_t *connection, obs_hotkeys_platf
 	return ret;
 }
 
-static inline bool keycode_pressed(xcb_query_keymap_reply_t *reply, xcb_keycode_t code)
+static inline bool keycode_pressed(const uint8_t *keys, xcb_keycode_t code)
 {
-	return (reply->keys[code / 8] & (1 << (code % 8))) != 0;
+	return (keys[code / 8] & (1 << (code % 8))) != 0;
 }
 
-static bool key_pressed(xcb_connection_t *connection, obs_hotkeys_platform_t *context, obs_key_t key)
+static bool keymap_key_pressed(obs_hotkeys_platform_t *context, const uint8_t *keys, obs_key_t key)
 {
 	struct keycode_list *codes = &context->keycodes[key];
+
+	if (key == OBS_KEY_META)
+		return keycode_pressed(keys, context->super_l_code) || keycode_pressed(keys, context->super_r_code);
+
+	for (size_t i = 0; i < codes->list.num; i++) {
+		if (keycode_pressed(keys, codes->list.array[i]))
+			return true;
+	}
+
+	return false;
+}
+
+static bool key_pressed(xcb_connection_t *connection, obs_hotkeys_platform_t *context, obs_key_t key)
+{
 	xcb_generic_error_t *error = NULL;
 	xcb_query_keymap_reply_t *reply;
 	bool pressed = false;
 
+#if defined(XCB_XINPUT_FOUND)
+	if (use_event_state(context)) {
+		pthread_mutex_lock(&context->state_mutex);
+		pressed = keymap_key_pressed(context, context->keys, key);
+		pthread_mutex_unlock(&context->state_mutex);
+		return pressed;
+	}
+#endif
+
 	reply = xcb_query_keymap_reply(connection, xcb_query_keymap(connection), &error);
-	if (error) {
+	if (error)
 		blog(LOG_WARNING, "xcb_query_keymap failed");
-
-	} else if (key == OBS_KEY_META) {
-		pressed = keycode_pressed(reply, context->super_l_code) ||
-			  keycode_pressed(reply, context->super_r_code);
-
-	} else {
-		for (size_t i = 0; i < codes->list.num; i++) {
-			if (keycode_pressed(reply, codes->list.array[i])) {
-				pressed = true;
-				break;
-			}
-		}
-	}
+	else
+		pressed = keymap_key_pressed(context, reply->keys, key);
 
 	free(reply);
 	free(error);
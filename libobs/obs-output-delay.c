@@ -53,7 +53,7 @@ static inline void push_packet(struct obs_output *output, struct encoder_packet
 	dd.packet_time_valid = packet_time != NULL;
 	if (packet_time != NULL)
 		dd.packet_time = *packet_time;
-	obs_encoder_packet_create_instance(&dd.packet, packet);
+	obs_encoder_packet_share(&dd.packet, packet);
 
 	pthread_mutex_lock(&output->delay_mutex);
 	deque_push_back(&output->delay_data, &dd, sizeof(dd));
@@ -2257,7 +2257,7 @@ static void interleave_packets(void *data, struct encoder_packet *packet, struct
 	if (output->active_delay_ns)
 		out = *packet;
 	else
-		obs_encoder_packet_create_instance(&out, packet);
+		obs_encoder_packet_share(&out, packet);
 
 	if (packet_time) {
 		output_packet_time = da_push_back_new(output->encoder_packet_times[packet->track_idx]);
@@ -987,20 +987,32 @@ cleanup:
 	GS_DEBUG_MARKER_END();
 }
 
+static inline bool source_view_dependent(const obs_source_t *source)
+{
+	return (source->info.output_flags & OBS_SOURCE_VIEW_DEPENDENT) != 0 || source->view_dependent;
+}
+
 static void scene_video_tick(void *data, float seconds)
 {
 	struct obs_scene *scene = data;
 	struct obs_scene_item *item;
+	bool view_dependent = false;
 
 	video_lock(scene);
 	item = scene->first_item;
 	while (item) {
 		if (item->item_render)
 			gs_texrender_reset(item->item_render);
+		if (source_view_dependent(item->source))
+			view_dependent = true;
 		item = item->next;
 	}
 	video_unlock(scene);
 
+	/* checked by render_video_cached, and by parent scenes through
+	 * source_view_dependent so that it propagates up nested scenes */
+	scene->source->view_dependent = view_dependent;
+
 	UNUSED_PARAMETER(seconds);
 }
 
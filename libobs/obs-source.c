@@ -209,6 +209,20 @@ static inline bool requires_canvas(const struct obs_source *source)
 	return source->info.output_flags & OBS_SOURCE_REQUIRES_CANVAS;
 }
 
+static void init_audio_ring(obs_source_t *source)
+{
+	size_t channels = MAX_AUDIO_CHANNELS;
+	size_t sample_rate = 48000;
+
+	if (obs->audio.audio) {
+		channels = audio_output_get_channels(obs->audio.audio);
+		sample_rate = audio_output_get_sample_rate(obs->audio.audio);
+	}
+
+	/* half a second of audio, the audio thread drains it every tick */
+	spsc_ring_init(&source->audio_ring, sample_rate / 2 * channels * sizeof(float));
+}
+
 extern char *find_libobs_data_file(const char *file);
 
 /* internal initialization */
@@ -246,6 +260,8 @@ static bool obs_source_init(struct obs_source *source)
 
 	if (is_audio_source(source) || is_composite_source(source))
 		allocate_audio_output_buffer(source);
+	if (is_audio_source(source) && !source->info.audio_render)
+		init_audio_ring(source);
 	if (source->info.audio_mix)
 		allocate_audio_mix_buffer(source);
 
@@ -801,12 +817,15 @@ static void obs_source_destroy_defer(struct obs_source *source)
 		gs_texrender_destroy(source->filter_texrender);
 	if (source->color_space_texrender)
 		gs_texrender_destroy(source->color_space_texrender);
+	for (size_t c = 0; c < NUM_RENDER_CACHE_SPACES; c++)
+		gs_texrender_destroy(source->render_cache[c]);
 	gs_leave_context();
 
 	for (i = 0; i < MAX_AV_PLANES; i++)
 		bfree(source->audio_data.data[i]);
 	for (i = 0; i < MAX_AUDIO_CHANNELS; i++)
 		deque_free(&source->audio_input_buf[i]);
+	spsc_ring_free(&source->audio_ring);
 	audio_resampler_destroy(source->resampler);
 	bfree(source->audio_output_buf[0][0]);
 	bfree(source->audio_mix_buf[0]);
@@ -1377,6 +1396,15 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 	if (source->filter_texrender)
 		gs_texrender_reset(source->filter_texrender);
 
+	/* only cache renders of sources that were drawn more than once last
+	 * frame, a single draw is cheaper without the extra texture pass */
+	source->render_cache_enabled = source->render_count > 1;
+	source->render_count = 0;
+	for (size_t i = 0; i < NUM_RENDER_CACHE_SPACES; i++) {
+		if (source->render_cache[i])
+			gs_texrender_reset(source->render_cache[i]);
+	}
+
 	/* call show/hide if the reference changed */
 	now_showing = !!source->show_refs;
 	if (now_showing != source->showing) {
@@ -1457,7 +1485,88 @@ static inline void reset_audio_timing(obs_source_t *source, uint64_t timestamp,
 	source->timing_adjust = os_time - timestamp;
 }
 
+/*
+ *   Async audio is handed from the thread(s) outputting it to the audio
+ * thread through a single producer, single consumer ring per source, so that
+ * the audio thread never has to wait on a capture thread.  Writers are
+ * serialized with audio_buf_mutex.  Everything that depends on the state of
+ * the input buffers (placement, resets) is applied by the audio thread when
+ * it drains the ring at the start of each tick.
+ */
+
+#define AUDIO_PACKET_RESET (1 << 0)
+#define AUDIO_PACKET_PUSH_BACK (1 << 1)
+
+struct audio_packet {
+	uint64_t timestamp;
+	uint64_t reset_ts;
+	uint32_t frames;
+	uint16_t channels;
+	uint16_t flags;
+	/* followed by planar float data */
+};
+
+/* must be called with audio_buf_mutex locked */
+static void queue_audio_packet(obs_source_t *source, const struct audio_data *in, uint16_t flags, uint64_t reset_ts)
+{
+	size_t sample_rate = audio_output_get_sample_rate(obs->audio.audio);
+	size_t channels = audio_output_get_channels(obs->audio.audio);
+	uint32_t frames = in ? in->frames : 0;
+	uint32_t offset = 0;
+
+	if (!source->audio_ring.data)
+		return;
+
+	size_t max_frames = (spsc_ring_max_record_size(&source->audio_ring) - sizeof(struct audio_packet)) /
+			    (channels * sizeof(float));
+
+	/* packets too large for the ring are split, the rest continue
+	 * directly after the first part */
+	do {
+		uint32_t chunk = frames - offset;
+		if (chunk > max_frames)
+			chunk = (uint32_t)max_frames;
+
+		size_t plane_size = chunk * sizeof(float);
+		size_t size = sizeof(struct audio_packet) + plane_size * channels;
+		uint8_t *ptr = spsc_ring_write_begin(&source->audio_ring, size);
+		if (!ptr) {
+			os_atomic_inc_long(&source->audio_ring_dropped);
+			return;
+		}
+
+		struct audio_packet packet = {
+			.timestamp = in ? in->timestamp + conv_frames_to_time(sample_rate, offset) : 0,
+			.reset_ts = reset_ts,
+			.frames = chunk,
+			.channels = (uint16_t)channels,
+			.flags = flags,
+		};
+
+		memcpy(ptr, &packet, sizeof(packet));
+		ptr += sizeof(packet);
+
+		for (size_t ch = 0; ch < channels && chunk; ch++) {
+			memcpy(ptr, in->data[ch] + offset * sizeof(float), plane_size);
+			ptr += plane_size;
+		}
+
+		spsc_ring_write_end(&source->audio_ring);
+
+		offset += chunk;
+		flags = AUDIO_PACKET_PUSH_BACK;
+	} while (offset < frames);
+}
+
+/* must be called with audio_buf_mutex locked */
 static void reset_audio_data(obs_source_t *source, uint64_t os_time)
+{
+	source->next_audio_sys_ts_min = os_time;
+	queue_audio_packet(source, NULL, AUDIO_PACKET_RESET, os_time);
+}
+
+/* audio thread only */
+static void reset_audio_input_buf(obs_source_t *source, uint64_t os_time)
 {
 	for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++) {
 		if (source->audio_input_buf[i].size)
@@ -1466,7 +1575,6 @@ static void reset_audio_data(obs_source_t *source, uint64_t os_time)
 
 	source->last_audio_input_buf_size = 0;
 	source->audio_ts = os_time;
-	source->next_audio_sys_ts_min = os_time;
 }
 
 static void handle_ts_jump(obs_source_t *source, uint64_t expected, uint64_t ts, uint64_t diff, uint64_t os_time)
@@ -1505,15 +1613,14 @@ static inline size_t get_buf_placement(audio_t *audio, uint64_t offset)
 	return (size_t)util_mul_div64(offset, sample_rate, 1000000000ULL);
 }
 
-static void source_output_audio_place(obs_source_t *source, const struct audio_data *in)
+static void source_output_audio_place(obs_source_t *source, const struct audio_data *in, size_t channels)
 {
 	audio_t *audio = obs->audio.audio;
 	size_t buf_placement;
-	size_t channels = audio_output_get_channels(audio);
 	size_t size = in->frames * sizeof(float);
 
 	if (!source->audio_ts || in->timestamp < source->audio_ts)
-		reset_audio_data(source, in->timestamp);
+		reset_audio_input_buf(source, in->timestamp);
 
 	buf_placement = get_buf_placement(audio, in->timestamp - source->audio_ts) * sizeof(float);
 
@@ -1536,10 +1643,8 @@ static void source_output_audio_place(obs_source_t *source, const struct audio_d
 	source->last_audio_input_buf_size = 0;
 }
 
-static inline void source_output_audio_push_back(obs_source_t *source, const struct audio_data *in)
+static inline void source_output_audio_push_back(obs_source_t *source, const struct audio_data *in, size_t channels)
 {
-	audio_t *audio = obs->audio.audio;
-	size_t channels = audio_output_get_channels(audio);
 	size_t size = in->frames * sizeof(float);
 
 	/* do not allow the circular buffers to become too big */
@@ -1554,6 +1659,42 @@ static inline void source_output_audio_push_back(obs_source_t *source, const str
 	source->last_audio_input_buf_size = 0;
 }
 
+void obs_source_drain_audio(obs_source_t *source)
+{
+	const uint8_t *ptr;
+	size_t size;
+
+	while ((ptr = spsc_ring_read_begin(&source->audio_ring, &size)) != NULL) {
+		struct audio_packet packet;
+		memcpy(&packet, ptr, sizeof(packet));
+		ptr += sizeof(packet);
+
+		if (packet.flags & AUDIO_PACKET_RESET)
+			reset_audio_input_buf(source, packet.reset_ts);
+
+		if (packet.frames) {
+			struct audio_data in = {.frames = packet.frames, .timestamp = packet.timestamp};
+
+			for (size_t ch = 0; ch < packet.channels; ch++)
+				in.data[ch] = (uint8_t *)ptr + ch * packet.frames * sizeof(float);
+
+			if ((packet.flags & AUDIO_PACKET_PUSH_BACK) && source->audio_ts)
+				source_output_audio_push_back(source, &in, packet.channels);
+			else
+				source_output_audio_place(source, &in, packet.channels);
+		}
+
+		spsc_ring_read_end(&source->audio_ring);
+	}
+
+	long dropped = os_atomic_load_long(&source->audio_ring_dropped);
+	if (dropped != source->audio_ring_dropped_logged) {
+		blog(LOG_WARNING, "Source '%s' dropped %ld audio packet(s), the audio thread could not keep up",
+		     source->context.name, dropped - source->audio_ring_dropped_logged);
+		source->audio_ring_dropped_logged = dropped;
+	}
+}
+
 static inline bool source_muted(obs_source_t *source, uint64_t os_time)
 {
 	if (source->push_to_mute_enabled && source->user_push_to_mute_pressed)
@@ -1647,12 +1788,8 @@ static void source_output_audio_data(obs_source_t *source, const struct audio_da
 		source->last_sync_offset = sync_offset;
 	}
 
-	if (source->monitoring_type != OBS_MONITORING_TYPE_MONITOR_ONLY) {
-		if (push_back && source->audio_ts)
-			source_output_audio_push_back(source, &in);
-		else
-			source_output_audio_place(source, &in);
-	}
+	if (source->monitoring_type != OBS_MONITORING_TYPE_MONITOR_ONLY)
+		queue_audio_packet(source, &in, push_back ? AUDIO_PACKET_PUSH_BACK : 0, 0);
 
 	pthread_mutex_unlock(&source->audio_buf_mutex);
 
@@ -2945,6 +3082,84 @@ static inline void render_video(obs_source_t *source)
 	GS_DEBUG_MARKER_END();
 }
 
+static inline void render_filter_tex(gs_texture_t *tex, gs_effect_t *effect, uint32_t width, uint32_t height,
+				     const char *tech_name);
+
+static inline bool render_cache_allowed(obs_source_t *source)
+{
+	/* groups draw straight into their parent scene, and nested scenes
+	 * are already rendered to a cleared texture by their scene item, so
+	 * only regular scenes have an output that can be reused as is */
+	return source->info.type == OBS_SOURCE_TYPE_SCENE && !obs_source_is_group(source) &&
+	       !source->rendering_filter && !source->view_dependent;
+}
+
+static void destroy_render_cache(obs_source_t *source)
+{
+	for (size_t i = 0; i < NUM_RENDER_CACHE_SPACES; i++) {
+		gs_texrender_destroy(source->render_cache[i]);
+		source->render_cache[i] = NULL;
+	}
+}
+
+/* Scenes are often drawn several times per frame (program, preview,
+ * multiview, projectors).  The first draw of a frame renders the scene to a
+ * texture for the current color space, and the following draws of the same
+ * frame reuse it.  Returns false if the source must be rendered directly. */
+static bool render_video_cached(obs_source_t *source)
+{
+	if (!render_cache_allowed(source))
+		return false;
+
+	source->render_count++;
+
+	if (!source->render_cache_enabled) {
+		destroy_render_cache(source);
+		return false;
+	}
+
+	const enum gs_color_space space = gs_get_color_space();
+	const uint32_t cx = obs_source_get_width(source);
+	const uint32_t cy = obs_source_get_height(source);
+	gs_texrender_t **texrender = &source->render_cache[space];
+
+	if (!cx || !cy)
+		return false;
+
+	if (!*texrender)
+		*texrender = gs_texrender_create(gs_get_format_from_space(space), GS_ZS_NONE);
+
+	if (gs_texrender_begin_with_color_space(*texrender, cx, cy, space)) {
+		struct vec4 clear_color;
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+		gs_blend_state_push();
+		gs_reset_blend_state();
+		render_video(source);
+		gs_blend_state_pop();
+
+		gs_texrender_end(*texrender);
+	}
+
+	/* the size can change between draws within a frame */
+	gs_texture_t *tex = gs_texrender_get_texture(*texrender);
+	if (!tex || gs_texture_get_width(tex) != cx || gs_texture_get_height(tex) != cy)
+		return false;
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+	const bool previous = gs_set_linear_srgb(true);
+
+	render_filter_tex(tex, obs->video.default_effect, cx, cy, "Draw");
+
+	gs_set_linear_srgb(previous);
+	gs_blend_state_pop();
+	return true;
+}
+
 void obs_source_video_render(obs_source_t *source)
 {
 	if (!obs_source_valid(source, "obs_source_video_render"))
@@ -2952,7 +3167,8 @@ void obs_source_video_render(obs_source_t *source)
 
 	source = obs_source_get_ref(source);
 	if (source) {
-		render_video(source);
+		if (!render_video_cached(source))
+			render_video(source);
 		obs_source_release(source);
 	}
 }
@@ -4520,15 +4736,15 @@ void obs_source_set_volume(obs_source_t *source, float volume)
 		struct calldata data;
 		uint8_t stack[128];
 
-		calldata_init_fixed(&data, stack, sizeof(stack));
-		calldata_set_ptr(&data, "source", source);
-		calldata_set_float(&data, "volume", volume);
+		calldata_init_layout(&data, obs->volume_layout, stack, sizeof(stack));
+		calldata_set_slot_ptr(&data, obs->volume_layout, 0, source);
+		calldata_set_slot_float(&data, obs->volume_layout, 1, volume);
 
 		signal_handler_signal(source->context.signals, "volume", &data);
 		if (!source->context.private)
 			signal_handler_signal(obs->signals, "source_volume", &data);
 
-		volume = (float)calldata_float(&data, "volume");
+		volume = (float)calldata_slot_float(&data, obs->volume_layout, 1);
 
 		pthread_mutex_lock(&source->audio_actions_mutex);
 		da_push_back(source->audio_actions, &action);
@@ -4549,13 +4765,13 @@ void obs_source_set_sync_offset(obs_source_t *source, int64_t offset)
 		struct calldata data;
 		uint8_t stack[128];
 
-		calldata_init_fixed(&data, stack, sizeof(stack));
-		calldata_set_ptr(&data, "source", source);
-		calldata_set_int(&data, "offset", offset);
+		calldata_init_layout(&data, obs->sync_offset_layout, stack, sizeof(stack));
+		calldata_set_slot_ptr(&data, obs->sync_offset_layout, 0, source);
+		calldata_set_slot_int(&data, obs->sync_offset_layout, 1, offset);
 
 		signal_handler_signal(source->context.signals, "audio_sync", &data);
 
-		source->sync_offset = calldata_int(&data, "offset");
+		source->sync_offset = calldata_slot_int(&data, obs->sync_offset_layout, 1);
 	}
 }
 
@@ -5407,19 +5623,14 @@ static inline void process_audio_source_tick(obs_source_t *source, uint32_t mixe
 {
 	bool audio_submix = !!(source->info.output_flags & OBS_SOURCE_SUBMIX);
 
-	pthread_mutex_lock(&source->audio_buf_mutex);
-
 	if (source->audio_input_buf[0].size < size) {
 		source->audio_pending = true;
-		pthread_mutex_unlock(&source->audio_buf_mutex);
 		return;
 	}
 
 	for (size_t ch = 0; ch < channels; ch++)
 		deque_peek_front(&source->audio_input_buf[ch], source->audio_output_buf[0][ch], size);
 
-	pthread_mutex_unlock(&source->audio_buf_mutex);
-
 	for (size_t mix = 1; mix < MAX_AUDIO_MIXES; mix++) {
 		uint32_t mix_and_val = (1 << mix);
 
@@ -5663,13 +5874,13 @@ void obs_source_set_balance_value(obs_source_t *source, float balance)
 		struct calldata data;
 		uint8_t stack[128];
 
-		calldata_init_fixed(&data, stack, sizeof(stack));
-		calldata_set_ptr(&data, "source", source);
-		calldata_set_float(&data, "balance", balance);
+		calldata_init_layout(&data, obs->balance_layout, stack, sizeof(stack));
+		calldata_set_slot_ptr(&data, obs->balance_layout, 0, source);
+		calldata_set_slot_float(&data, obs->balance_layout, 1, balance);
 
 		signal_handler_signal(source->context.signals, "audio_balance", &data);
 
-		source->balance = (float)calldata_float(&data, "balance");
+		source->balance = (float)calldata_slot_float(&data, obs->balance_layout, 1);
 	}
 }
 
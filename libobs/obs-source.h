@@ -208,6 +208,12 @@ enum obs_media_state {
  */
 #define OBS_SOURCE_REQUIRES_CANVAS (1 << 17)
 
+/**
+ * Source output depends on the view it is rendered in, so scenes containing
+ * it must be rendered again for each view instead of reusing a cached frame
+ */
+#define OBS_SOURCE_VIEW_DEPENDENT (1 << 18)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent, obs_source_t *child, void *param);
@@ -804,14 +804,15 @@ void add_ready_encoder_group(obs_encoder_t *encoder)
 	pthread_mutex_unlock(&obs->video.encoder_group_mutex);
 }
 
-static inline void video_sleep(struct obs_core_video *video, uint64_t *p_time, uint64_t interval_ns)
+static inline void video_sleep(struct obs_core_video *video, os_pacer_t *pacer, uint64_t *p_time,
+			       uint64_t interval_ns)
 {
 	struct obs_vframe_info vframe_info;
 	uint64_t cur_time = *p_time;
 	uint64_t t = cur_time + interval_ns;
 	int count;
 
-	if (os_sleepto_ns(t)) {
+	if (os_pacer_sleepto_ns(pacer, t)) {
 		*p_time = t;
 		count = 1;
 	} else {
@@ -1096,11 +1097,23 @@ static inline bool stop_requested(void)
 	return success;
 }
 
+static void apply_thread_scheduling(struct obs_graphics_context *context)
+{
+	long gen = os_atomic_load_long(&obs->thread_sched_gen);
+	if (gen == context->sched_gen)
+		return;
+
+	context->sched_gen = gen;
+	os_set_thread_realtime(obs->thread_sched_realtime);
+	os_set_thread_affinity(obs->graphics_thread_cpu);
+}
+
 bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 {
 	uint64_t frame_start = os_gettime_ns();
 	uint64_t frame_time_ns;
 
+	apply_thread_scheduling(context);
 	update_active_states();
 
 	profile_start(context->video_thread_name);
@@ -1127,9 +1140,23 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 	output_frames();
 	profile_end(output_frame_name);
 
-	profile_start(render_displays_name);
-	render_displays();
-	profile_end(render_displays_name);
+	/* if the output frame alone already took the whole interval, don't
+	 * make it worse by presenting displays, but never skip twice in a row
+	 * so that previews keep updating */
+	uint64_t displays_start = os_gettime_ns();
+	uint64_t display_time_ns = 0;
+
+	if (displays_start - frame_start >= context->interval && !obs->video.displays_skipped) {
+		obs->video.displays_skipped = true;
+	} else {
+		obs->video.displays_skipped = false;
+
+		profile_start(render_displays_name);
+		render_displays();
+		profile_end(render_displays_name);
+
+		display_time_ns = os_gettime_ns() - displays_start;
+	}
 	source_profiler_render_end();
 
 	execute_graphics_tasks();
@@ -1141,7 +1168,13 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 
 	profile_reenable_thread();
 
-	video_sleep(&obs->video, &obs->video.video_time, context->interval);
+	uint32_t lagged = obs->video.lagged_frames;
+	video_sleep(&obs->video, context->pacer, &obs->video.video_time, context->interval);
+	lagged = obs->video.lagged_frames - lagged;
+
+	/* frames that would have been on time without rendering displays */
+	if (lagged && frame_time_ns - display_time_ns < context->interval)
+		obs->video.display_lagged_frames += lagged;
 
 	context->frame_time_total_ns += frame_time_ns;
 	context->fps_total_ns += (obs->video.video_time - context->last_time);
@@ -1179,6 +1212,9 @@ void *obs_graphics_thread(void *param)
 							   "obs_graphics_thread(%g" NBSP "ms)", interval / 1000000.);
 	profile_register_root(video_thread_name, interval);
 
+	const char *wakeup_name =
+		profile_store_name(obs_get_profiler_name_store(), "obs_graphics_thread wakeup jitter");
+
 	srand((unsigned int)time(NULL));
 
 	struct obs_graphics_context context;
@@ -1188,6 +1224,8 @@ void *obs_graphics_thread(void *param)
 	context.fps_total_frames = 0;
 	context.last_time = 0;
 	context.video_thread_name = video_thread_name;
+	context.pacer = os_pacer_create(wakeup_name);
+	context.sched_gen = 0;
 
 #ifdef __APPLE__
 	while (obs_graphics_thread_loop_autorelease(&context))
@@ -1196,6 +1234,8 @@ void *obs_graphics_thread(void *param)
 #endif
 		;
 
+	os_pacer_destroy(context.pacer);
+
 #ifdef _WIN32
 	uninit_winrt_state(&winrt);
 #endif
@@ -921,9 +921,12 @@ static bool obs_init_audio(struct audio_output_info *ai)
 	signal_handler_connect(obs->signals, "deduplication_changed", apply_monitoring_deduplication, NULL);
 
 	errorcode = audio_output_open(&audio->audio, ai);
-	if (errorcode == AUDIO_OUTPUT_SUCCESS)
+	if (errorcode == AUDIO_OUTPUT_SUCCESS) {
+		if (os_atomic_load_long(&obs->thread_sched_gen))
+			audio_output_set_thread_scheduling(audio->audio, obs->thread_sched_realtime,
+							   obs->audio_thread_cpu);
 		return true;
-	else if (errorcode == AUDIO_OUTPUT_INVALIDPARAM)
+	} else if (errorcode == AUDIO_OUTPUT_INVALIDPARAM)
 		blog(LOG_ERROR, "Invalid audio parameters specified");
 	else
 		blog(LOG_ERROR, "Could not open audio output");
@@ -986,6 +989,8 @@ static bool obs_init_data(void)
 		goto fail;
 	if (pthread_mutex_init_recursive(&obs->data.canvases_mutex) != 0)
 		goto fail;
+	if (pthread_mutex_init_recursive(&obs->data.volmeters_mutex) != 0)
+		goto fail;
 
 	data->sources = NULL;
 	data->public_sources = NULL;
@@ -1064,6 +1069,9 @@ static void obs_free_data(void)
 	pthread_mutex_destroy(&data->services_mutex);
 	pthread_mutex_destroy(&data->draw_callbacks_mutex);
 	pthread_mutex_destroy(&data->canvases_mutex);
+	pthread_mutex_destroy(&data->volmeters_mutex);
+	da_free(data->volmeters);
+	da_free(data->volmeters_updated);
 	da_free(data->draw_callbacks);
 	da_free(data->rendered_callbacks);
 	da_free(data->tick_callbacks);
@@ -1126,6 +1134,14 @@ static inline bool obs_init_handlers(void)
 	if (!obs->procs)
 		return false;
 
+	/* activate/show/media/transition signals are emitted every time
+	 * scenes or transitions change, and for every nested source */
+	obs->source_layout = calldata_layout_create("void source(ptr source)");
+	obs->source_canvas_layout = calldata_layout_create("void source_canvas(ptr source, ptr canvas)");
+	obs->volume_layout = calldata_layout_create("void volume(ptr source, in out float volume)");
+	obs->balance_layout = calldata_layout_create("void audio_balance(ptr source, in out float balance)");
+	obs->sync_offset_layout = calldata_layout_create("void audio_sync(ptr source, in out int offset)");
+
 	return signal_handler_add_array(obs->signals, obs_signals);
 }
 
@@ -1148,6 +1164,11 @@ static inline bool obs_init_hotkeys(void)
 	hotkeys->sceneitem_show = bstrdup("Show '%1'");
 	hotkeys->sceneitem_hide = bstrdup("Hide '%1'");
 
+	if (pthread_mutex_init(&hotkeys->event_mutex, NULL) != 0)
+		return false;
+	if (os_event_init(&hotkeys->wake_event, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
+
 	if (!obs_hotkeys_platform_init(hotkeys))
 		return false;
 
@@ -1175,6 +1196,7 @@ static inline void stop_hotkeys(void)
 
 	if (hotkeys->hotkey_thread_initialized) {
 		os_event_signal(hotkeys->stop_event);
+		os_event_signal(hotkeys->wake_event);
 		pthread_join(hotkeys->hotkey_thread, &thread_ret);
 		hotkeys->hotkey_thread_initialized = false;
 	}
@@ -1198,6 +1220,8 @@ static inline void obs_free_hotkeys(void)
 
 	obs_hotkeys_platform_free(hotkeys);
 	pthread_mutex_destroy(&hotkeys->mutex);
+	pthread_mutex_destroy(&hotkeys->event_mutex);
+	os_event_destroy(hotkeys->wake_event);
 }
 
 extern const struct obs_source_info scene_info;
@@ -1412,6 +1436,11 @@ void obs_shutdown(void)
 	stop_video();
 	stop_audio();
 	stop_hotkeys();
+	source_profiler_shutdown();
+
+	/* deferred calls may point into modules, deliver them while the
+	 * modules are still loaded */
+	signal_handler_shutdown_deferred();
 
 	module = obs->first_module;
 	while (module) {
@@ -1435,8 +1464,15 @@ void obs_shutdown(void)
 	os_task_queue_destroy(obs->destruction_task_thread);
 	obs_free_hotkeys();
 	obs_free_graphics();
+	/* and anything queued while the data was being freed */
+	signal_handler_shutdown_deferred();
 	proc_handler_destroy(obs->procs);
 	signal_handler_destroy(obs->signals);
+	calldata_layout_destroy(obs->source_layout);
+	calldata_layout_destroy(obs->source_canvas_layout);
+	calldata_layout_destroy(obs->volume_layout);
+	calldata_layout_destroy(obs->balance_layout);
+	calldata_layout_destroy(obs->sync_offset_layout);
 	obs->procs = NULL;
 	obs->signals = NULL;
 
@@ -1712,6 +1748,11 @@ bool obs_get_audio_info2(struct obs_audio_info2 *oai2)
 	}
 }
 
+uint32_t obs_get_audio_buffering_ms(void)
+{
+	return (uint32_t)os_atomic_load_long(&obs->audio.buffering_ms);
+}
+
 bool obs_enum_source_types(size_t idx, const char **id)
 {
 	if (idx >= obs->source_types.num)
@@ -3080,6 +3121,25 @@ uint32_t obs_get_lagged_frames(void)
 	return obs->video.lagged_frames;
 }
 
+uint32_t obs_get_display_lagged_frames(void)
+{
+	return obs->video.display_lagged_frames;
+}
+
+void obs_set_thread_scheduling(bool realtime, int graphics_cpu, int audio_cpu)
+{
+	if (!obs)
+		return;
+
+	obs->thread_sched_realtime = realtime;
+	obs->graphics_thread_cpu = graphics_cpu;
+	obs->audio_thread_cpu = audio_cpu;
+	os_atomic_inc_long(&obs->thread_sched_gen);
+
+	if (obs->audio.audio)
+		audio_output_set_thread_scheduling(obs->audio.audio, realtime, audio_cpu);
+}
+
 struct obs_core_video_mix *get_mix_for_video(video_t *v)
 {
 	struct obs_core_video_mix *result = NULL;
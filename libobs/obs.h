@@ -466,6 +466,9 @@ EXPORT bool obs_get_audio_info(struct obs_audio_info *oai);
  */
 EXPORT bool obs_get_audio_info2(struct obs_audio_info2 *oai2);
 
+/** Gets the amount of audio buffering currently in use, in milliseconds */
+EXPORT uint32_t obs_get_audio_buffering_ms(void);
+
 /**
  * Opens a plugin module directly from a specific path.
  *
@@ -885,6 +888,9 @@ EXPORT void obs_enum_audio_monitoring_devices(obs_enum_audio_device_cb cb, void
 EXPORT bool obs_set_audio_monitoring_device(const char *name, const char *id);
 EXPORT void obs_get_audio_monitoring_device(const char **name, const char **id);
 
+/** Gets the latency of audio monitoring in nanoseconds, or 0 if unknown */
+EXPORT uint64_t obs_get_audio_monitoring_latency_ns(void);
+
 EXPORT void obs_add_tick_callback(void (*tick)(void *param, float seconds), void *param);
 EXPORT void obs_remove_tick_callback(void (*tick)(void *param, float seconds), void *param);
 
@@ -912,6 +918,13 @@ EXPORT uint64_t obs_get_frame_interval_ns(void);
 
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
+EXPORT uint32_t obs_get_display_lagged_frames(void);
+
+/**
+ * Requests realtime scheduling for the graphics and audio threads, and pins
+ * them to the given CPUs (-1 to not pin them).
+ */
+EXPORT void obs_set_thread_scheduling(bool realtime, int graphics_cpu, int audio_cpu);
 
 OBS_DEPRECATED EXPORT bool obs_nv12_tex_active(void);
 OBS_DEPRECATED EXPORT bool obs_p010_tex_active(void);
@@ -1021,6 +1034,18 @@ EXPORT void obs_display_remove_draw_callback(obs_display_t *display,
 EXPORT void obs_display_set_enabled(obs_display_t *display, bool enable);
 EXPORT bool obs_display_enabled(obs_display_t *display);
 
+/**
+ * Tells the display whether its window can currently be seen (e.g. not
+ * minimized or hidden).  Displays that cannot be seen are not rendered.
+ */
+EXPORT void obs_display_set_visible(obs_display_t *display, bool visible);
+
+/**
+ * Limits how often the display is rendered and presented, for example to the
+ * refresh rate of the monitor it is on.  0 renders the display every frame.
+ */
+EXPORT void obs_display_set_max_fps(obs_display_t *display, double fps);
+
 EXPORT void obs_display_set_background_color(obs_display_t *display, uint32_t color);
 
 EXPORT void obs_display_size(obs_display_t *display, uint32_t *width, uint32_t *height);
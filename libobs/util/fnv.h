@@ -0,0 +1,40 @@
+#pragma once
+
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * FNV-1a hashes of null-terminated strings
+ *
+ *   Fast and good enough for hash tables and file names, not suitable for
+ * anything that needs to resist collisions on purpose.
+ */
+
+static inline uint32_t fnv1a_str32(const char *str)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*str) {
+		hash ^= (uint8_t)*(str++);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static inline uint64_t fnv1a_str64(const char *str)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	while (*str) {
+		hash ^= (uint8_t)*(str++);
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+#ifdef __cplusplus
+}
+#endif
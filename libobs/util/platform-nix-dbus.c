@@ -164,3 +164,28 @@ void dbus_inhibit_sleep(struct dbus_sleep_info *info, const char *reason, bool a
 	else
 		info->cookie = 0;
 }
+
+bool dbus_make_thread_realtime(uint64_t thread_id, uint32_t priority)
+{
+	g_autoptr(GDBusConnection) c = NULL;
+	g_autoptr(GVariant) reply = NULL;
+	g_autoptr(GError) error = NULL;
+
+	c = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+	if (!c) {
+		blog(LOG_WARNING, "Could not create dbus connection: %s", error->message);
+		return false;
+	}
+
+	reply = g_dbus_connection_call_sync(c, "org.freedesktop.RealtimeKit1", "/org/freedesktop/RealtimeKit1",
+					    "org.freedesktop.RealtimeKit1", "MakeThreadRealtime",
+					    g_variant_new("(tu)", thread_id, priority), NULL, G_DBUS_CALL_FLAGS_NONE,
+					    -1, NULL, &error);
+
+	if (error != NULL) {
+		blog(LOG_WARNING, "Failed to make thread realtime through RTKit: %s", error->message);
+		return false;
+	}
+
+	return true;
+}
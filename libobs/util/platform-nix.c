@@ -14,6 +14,10 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <errno.h>
 #include <sys/types.h>
@@ -31,6 +35,12 @@
 
 #include "obsconfig.h"
 
+#include <pthread.h>
+#include <sched.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
 #if !defined(__APPLE__)
 #include <sys/times.h>
 #include <sys/wait.h>
@@ -177,6 +187,16 @@ bool os_sleepto_ns(uint64_t time_target)
 	if (time_target < current)
 		return false;
 
+#if defined(__linux__) || defined(__FreeBSD__)
+	/* sleep on the same clock os_gettime_ns uses, with an absolute target
+	 * so that interruptions don't add up */
+	struct timespec abs_req;
+	abs_req.tv_sec = time_target / 1000000000;
+	abs_req.tv_nsec = time_target % 1000000000;
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &abs_req, NULL) == EINTR)
+		;
+#else
 	time_target -= current;
 
 	struct timespec req, remain;
@@ -189,6 +209,7 @@ bool os_sleepto_ns(uint64_t time_target)
 		req = remain;
 		memset(&remain, 0, sizeof(remain));
 	}
+#endif
 
 	return true;
 }
@@ -215,6 +236,110 @@ void os_sleep_ms(uint32_t duration)
 	usleep(duration * 1000);
 }
 
+#if defined(__linux__) && defined(GIO_FOUND)
+extern bool dbus_make_thread_realtime(uint64_t thread_id, uint32_t priority);
+#endif
+
+#define RT_THREAD_PRIORITY 10
+
+#if defined(__linux__) && defined(GIO_FOUND)
+/* soft limit in us of CPU time a realtime thread may use without blocking */
+#define RT_TIME_SOFT_LIMIT 200000
+
+/* a realtime thread that keeps the CPU busy past the soft RLIMIT_RTTIME
+ * gets SIGXCPU, which would otherwise terminate the process.  Demote it
+ * instead; hitting the hard limit is always fatal, so that is left alone. */
+static void rt_time_exceeded(int sig)
+{
+	struct sched_param param = {0};
+	int err = errno;
+
+	if (sched_getscheduler(0) != SCHED_OTHER)
+		sched_setscheduler(0, SCHED_OTHER, &param);
+
+	errno = err;
+	UNUSED_PARAMETER(sig);
+}
+
+static void install_rt_time_handler(void)
+{
+	struct sigaction sa;
+
+	/* don't replace a handler the application installed */
+	if (sigaction(SIGXCPU, NULL, &sa) != 0 || sa.sa_handler != SIG_DFL)
+		return;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = rt_time_exceeded;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGXCPU, &sa, NULL);
+}
+
+static pthread_once_t rt_time_handler_once = PTHREAD_ONCE_INIT;
+#endif
+
+bool os_set_thread_realtime(bool realtime)
+{
+	struct sched_param param = {0};
+	int policy = SCHED_OTHER;
+
+	if (realtime) {
+		policy = SCHED_FIFO;
+		param.sched_priority = RT_THREAD_PRIORITY;
+	}
+
+	int err = pthread_setschedparam(pthread_self(), policy, &param);
+	if (err == 0)
+		return true;
+
+#if defined(__linux__) && defined(GIO_FOUND)
+	if (realtime && err == EPERM) {
+		/* RTKit refuses threads of processes without an RT time
+		 * limit.  Only the soft limit is set, below the hard one, so
+		 * that exceeding it demotes the thread instead of killing
+		 * the process. */
+		struct rlimit rl;
+		pthread_once(&rt_time_handler_once, install_rt_time_handler);
+		if (getrlimit(RLIMIT_RTTIME, &rl) == 0 && rl.rlim_cur == RLIM_INFINITY) {
+			rl.rlim_cur = RT_TIME_SOFT_LIMIT;
+			if (rl.rlim_max != RLIM_INFINITY && rl.rlim_cur >= rl.rlim_max)
+				rl.rlim_cur = rl.rlim_max / 2;
+			setrlimit(RLIMIT_RTTIME, &rl);
+		}
+
+		if (dbus_make_thread_realtime((uint64_t)syscall(SYS_gettid), RT_THREAD_PRIORITY))
+			return true;
+	}
+#endif
+
+	blog(LOG_DEBUG, "Could not change thread scheduling policy: %s", strerror(err));
+	return false;
+}
+
+bool os_set_thread_affinity(int cpu)
+{
+#if defined(__linux__)
+	long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	if (cpu < 0) {
+		for (long i = 0; i < num_cpus && i < CPU_SETSIZE; i++)
+			CPU_SET(i, &set);
+	} else if (cpu < num_cpus && cpu < CPU_SETSIZE) {
+		CPU_SET(cpu, &set);
+	} else {
+		return false;
+	}
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	UNUSED_PARAMETER(cpu);
+	return false;
+#endif
+}
+
 #if !defined(__APPLE__)
 
 uint64_t os_gettime_ns(void)
@@ -386,6 +386,33 @@ void os_sleep_ms(uint32_t duration)
 	Sleep(duration);
 }
 
+bool os_set_thread_realtime(bool realtime)
+{
+	int priority = realtime ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_NORMAL;
+	return !!SetThreadPriority(GetCurrentThread(), priority);
+}
+
+bool os_set_thread_affinity(int cpu)
+{
+	DWORD_PTR process_mask, system_mask;
+	DWORD_PTR mask;
+
+	if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+		return false;
+
+	if (cpu < 0) {
+		mask = process_mask;
+	} else if (cpu < (int)(sizeof(DWORD_PTR) * 8)) {
+		mask = (DWORD_PTR)1 << cpu;
+		if (!(mask & process_mask))
+			return false;
+	} else {
+		return false;
+	}
+
+	return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
 uint64_t os_gettime_ns(void)
 {
 	LARGE_INTEGER current_time;
@@ -28,6 +28,19 @@
 #include "dstr.h"
 #include "obs.h"
 #include "threading.h"
+#include "profiler.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#define cpu_pause() _mm_pause()
+#elif defined(_M_ARM64) || defined(_M_ARM)
+#include <intrin.h>
+#define cpu_pause() __yield()
+#elif defined(__aarch64__) || defined(__arm__)
+#define cpu_pause() __asm__ __volatile__("yield")
+#else
+#define cpu_pause()
+#endif
 
 FILE *os_wfopen(const wchar_t *path, const char *mode)
 {
@@ -844,3 +857,82 @@ struct timespec *os_nstime_to_timespec(uint64_t timestamp, struct timespec *stor
 
 	return storage;
 }
+
+/* ------------------------------------------------------------------------- */
+
+/* never spin for longer than this, regardless of how bad the timer is */
+#define PACER_MAX_SPIN_NS 1000000LL
+#define PACER_INITIAL_SPIN_NS 200000LL
+
+struct os_pacer {
+	const char *name;
+	uint64_t spin_ns;
+
+	/* smoothed timer oversleep and its mean deviation, in ns */
+	int64_t oversleep_avg;
+	int64_t oversleep_dev;
+};
+
+os_pacer_t *os_pacer_create(const char *name)
+{
+	struct os_pacer *pacer = bzalloc(sizeof(struct os_pacer));
+	pacer->name = name;
+	pacer->spin_ns = PACER_INITIAL_SPIN_NS;
+	pacer->oversleep_avg = PACER_INITIAL_SPIN_NS / 2;
+	pacer->oversleep_dev = PACER_INITIAL_SPIN_NS / 8;
+	return pacer;
+}
+
+void os_pacer_destroy(os_pacer_t *pacer)
+{
+	bfree(pacer);
+}
+
+static void pacer_update(struct os_pacer *pacer, int64_t oversleep)
+{
+	int64_t err = oversleep - pacer->oversleep_avg;
+	int64_t spin;
+
+	pacer->oversleep_avg += err / 8;
+	pacer->oversleep_dev += ((err < 0 ? -err : err) - pacer->oversleep_dev) / 4;
+
+	spin = pacer->oversleep_avg + pacer->oversleep_dev * 4;
+	if (spin < 0)
+		spin = 0;
+	else if (spin > PACER_MAX_SPIN_NS)
+		spin = PACER_MAX_SPIN_NS;
+
+	pacer->spin_ns = (uint64_t)spin;
+}
+
+bool os_pacer_sleepto_ns(os_pacer_t *pacer, uint64_t time_target)
+{
+	uint64_t current = os_gettime_ns();
+	if (time_target < current)
+		return false;
+
+	if (time_target - current > pacer->spin_ns) {
+		uint64_t wake_target = time_target - pacer->spin_ns;
+
+		os_sleepto_ns(wake_target);
+		current = os_gettime_ns();
+		pacer_update(pacer, (int64_t)(current - wake_target));
+	}
+
+	/* the pause hint lets a sibling hyperthread run and keeps the spin
+	 * from flooding the pipeline with speculative loads */
+	while (current < time_target) {
+		cpu_pause();
+		current = os_gettime_ns();
+	}
+
+	if (pacer->name)
+		profile_record(pacer->name, current - time_target);
+
+	return true;
+}
+
+uint64_t os_pacer_get_spin_ns(const os_pacer_t *pacer)
+{
+	return pacer ? pacer->spin_ns : 0;
+}
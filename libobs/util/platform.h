@@ -98,6 +98,30 @@ EXPORT bool os_sleepto_ns(uint64_t time_target);
 EXPORT bool os_sleepto_ns_fast(uint64_t time_target);
 EXPORT void os_sleep_ms(uint32_t duration);
 
+/**
+ * Paces a thread to target times.  Sleeps until shortly before the target
+ * and spins for the rest, where the spin window is calibrated against how
+ * late the system timer has woken the thread up recently.  If name is not
+ * NULL, the wakeup jitter is recorded to the profiler under that name, which
+ * must be a stored profiler name.
+ * os_pacer_sleepto_ns returns false if already at or past target time.
+ */
+typedef struct os_pacer os_pacer_t;
+
+EXPORT os_pacer_t *os_pacer_create(const char *name);
+EXPORT void os_pacer_destroy(os_pacer_t *pacer);
+EXPORT bool os_pacer_sleepto_ns(os_pacer_t *pacer, uint64_t time_target);
+EXPORT uint64_t os_pacer_get_spin_ns(const os_pacer_t *pacer);
+
+/**
+ * Raises the calling thread to (or lowers it from) realtime scheduling.  On
+ * Linux this falls back to RTKit if the process may not do so itself.
+ */
+EXPORT bool os_set_thread_realtime(bool realtime);
+
+/** Pins the calling thread to a CPU, or unpins it if cpu is negative. */
+EXPORT bool os_set_thread_affinity(int cpu);
+
 EXPORT uint64_t os_gettime_ns(void);
 
 EXPORT int os_get_config_path(char *dst, size_t size, const char *name);
@@ -10,6 +10,15 @@
 
 #include <zlib.h>
 
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
 //#define TRACK_OVERHEAD
 
 struct profiler_snapshot {
@@ -255,6 +264,12 @@ static DARRAY(profile_root_entry) root_entries;
 static THREAD_LOCAL profile_call *thread_context = NULL;
 static THREAD_LOCAL bool thread_enabled = true;
 
+/* number of live metric listeners, calls are only recorded for them while
+ * this is non-zero */
+static volatile long live_listeners = 0;
+static void live_record(const char *name, uint64_t duration);
+static void live_free(void);
+
 void profiler_start(void)
 {
 	pthread_mutex_lock(&root_mutex);
@@ -423,12 +438,47 @@ void profile_end(const char *name)
 	call->overhead_end = os_gettime_ns();
 #endif
 
+	if (os_atomic_load_long(&live_listeners))
+		live_record(call->name, end - call->start_time);
+
 	if (call->parent)
 		return;
 
 	merge_context(call);
 }
 
+void profile_record(const char *name, uint64_t duration_ns)
+{
+	uint64_t end = os_gettime_ns();
+	if (!thread_enabled)
+		return;
+
+	profile_call new_call = {
+		.name = name,
+#ifdef TRACK_OVERHEAD
+		.overhead_start = end,
+#endif
+		.start_time = end - duration_ns,
+		.end_time = end,
+#ifdef TRACK_OVERHEAD
+		.overhead_end = end,
+#endif
+		.parent = thread_context,
+	};
+
+	if (os_atomic_load_long(&live_listeners))
+		live_record(name, duration_ns);
+
+	if (new_call.parent) {
+		da_push_back(new_call.parent->children, &new_call);
+		return;
+	}
+
+	profile_call *call = bmalloc(sizeof(profile_call));
+	memcpy(call, &new_call, sizeof(profile_call));
+	merge_context(call);
+}
+
 static int profiler_time_entry_compare(const void *first, const void *second)
 {
 	int64_t diff = ((profiler_time_entry *)second)->time_delta - ((profiler_time_entry *)first)->time_delta;
@@ -792,6 +842,8 @@ void profiler_free(void)
 	da_free(old_root_entries);
 
 	pthread_mutex_destroy(&root_mutex);
+
+	live_free();
 }
 
 /* ------------------------------------------------------------------------- */
@@ -1115,3 +1167,624 @@ uint64_t profiler_snapshot_entry_overall_between_calls_count(profiler_snapshot_e
 {
 	return entry ? entry->overall_between_calls_count : 0;
 }
+
+/* ------------------------------------------------------------------------- */
+/* Live metrics */
+
+#define LIVE_BUFFER_EVENTS 4096
+#define LIVE_NAME_LEN 64
+#define LIVE_DRAIN_INTERVAL_MS 100
+#define LIVE_SUB_BUCKET_BITS 3
+#define LIVE_SUB_BUCKETS (1 << LIVE_SUB_BUCKET_BITS)
+#define LIVE_MAX_EXPONENT 40
+#define LIVE_BUCKETS (LIVE_SUB_BUCKETS * (LIVE_MAX_EXPONENT - LIVE_SUB_BUCKET_BITS + 2))
+
+/* the name is copied, the name store it came from can be freed before the
+ * event is drained */
+struct live_event {
+	char name[LIVE_NAME_LEN];
+	uint64_t duration;
+};
+
+/* written only by its thread, read only by the aggregator */
+struct live_buffer {
+	struct live_event events[LIVE_BUFFER_EVENTS];
+	volatile long write_pos;
+	volatile long read_pos;
+	volatile bool exited;
+	struct live_buffer *next;
+};
+
+/* log-linear histogram, one per second of the window */
+struct live_scope {
+	char *name;
+	uint64_t count[PROFILER_LIVE_WINDOW_SECONDS];
+	uint64_t max[PROFILER_LIVE_WINDOW_SECONDS];
+	uint32_t buckets[PROFILER_LIVE_WINDOW_SECONDS][LIVE_BUCKETS];
+};
+
+struct profiler_live_metrics {
+	DARRAY(profiler_live_metric_t) metrics;
+};
+
+struct live_collector {
+	profiler_live_collect_func func;
+	void *param;
+};
+
+static pthread_mutex_t live_buffers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct live_buffer *live_buffers = NULL;
+static volatile long live_generation = 1;
+static volatile long live_dropped = 0;
+
+/* cleared while the buffers are freed, recorders are counted so that
+ * freeing can wait for the ones that are still writing */
+static volatile bool live_recording = true;
+static volatile long live_writers = 0;
+static THREAD_LOCAL struct live_buffer *thread_live_buffer = NULL;
+static THREAD_LOCAL long thread_live_generation = 0;
+static pthread_once_t live_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t live_buffer_key;
+
+/* aggregator thread only */
+static DARRAY(struct live_scope *) live_scopes;
+static size_t live_slot = 0;
+
+static pthread_mutex_t live_metrics_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct profiler_live_metrics live_published;
+
+static pthread_mutex_t live_collectors_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct live_collector) live_collectors;
+
+static pthread_mutex_t live_state_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool live_thread_active = false;
+static pthread_t live_thread;
+static os_event_t *live_stop_event = NULL;
+
+#ifndef _WIN32
+static int live_server_fd = -1;
+static char *live_server_path = NULL;
+static DARRAY(int) live_clients;
+#endif
+
+static void live_buffer_thread_exit(void *ptr)
+{
+	pthread_mutex_lock(&live_buffers_mutex);
+
+	/* the buffer is gone already if the profiler was freed in between */
+	for (struct live_buffer *buffer = live_buffers; buffer; buffer = buffer->next) {
+		if (buffer == ptr) {
+			os_atomic_set_bool(&buffer->exited, true);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&live_buffers_mutex);
+}
+
+static void live_key_init(void)
+{
+	pthread_key_create(&live_buffer_key, live_buffer_thread_exit);
+}
+
+static struct live_buffer *live_buffer_create(void)
+{
+	struct live_buffer *buffer = bzalloc(sizeof(struct live_buffer));
+
+	pthread_once(&live_key_once, live_key_init);
+	pthread_setspecific(live_buffer_key, buffer);
+
+	pthread_mutex_lock(&live_buffers_mutex);
+	buffer->next = live_buffers;
+	live_buffers = buffer;
+	pthread_mutex_unlock(&live_buffers_mutex);
+
+	return buffer;
+}
+
+static void live_record_event(const char *name, uint64_t duration)
+{
+	long generation = os_atomic_load_long(&live_generation);
+	struct live_buffer *buffer = thread_live_buffer;
+
+	if (!buffer || thread_live_generation != generation) {
+		buffer = thread_live_buffer = live_buffer_create();
+		thread_live_generation = generation;
+	}
+
+	unsigned long write = (unsigned long)buffer->write_pos;
+	unsigned long read = (unsigned long)os_atomic_load_long(&buffer->read_pos);
+
+	if (write - read >= LIVE_BUFFER_EVENTS) {
+		os_atomic_inc_long(&live_dropped);
+		return;
+	}
+
+	struct live_event *event = &buffer->events[write & (LIVE_BUFFER_EVENTS - 1)];
+	strncpy(event->name, name, LIVE_NAME_LEN - 1);
+	event->name[LIVE_NAME_LEN - 1] = 0;
+	event->duration = duration;
+	os_atomic_store_long(&buffer->write_pos, (long)(write + 1));
+}
+
+static void live_record(const char *name, uint64_t duration)
+{
+	os_atomic_inc_long(&live_writers);
+	if (os_atomic_load_bool(&live_recording))
+		live_record_event(name, duration);
+	os_atomic_dec_long(&live_writers);
+}
+
+static inline size_t live_bucket(uint64_t ns)
+{
+	if (ns < LIVE_SUB_BUCKETS)
+		return (size_t)ns;
+
+	int exponent = 0;
+	for (uint64_t val = ns; val > 1; val >>= 1)
+		exponent++;
+
+	if (exponent > LIVE_MAX_EXPONENT)
+		return LIVE_BUCKETS - 1;
+
+	size_t mantissa = (size_t)(ns >> (exponent - LIVE_SUB_BUCKET_BITS)) & (LIVE_SUB_BUCKETS - 1);
+	return LIVE_SUB_BUCKETS * (exponent - LIVE_SUB_BUCKET_BITS + 1) + mantissa;
+}
+
+/* middle of the range of values stored in a bucket */
+static inline uint64_t live_bucket_value(size_t bucket)
+{
+	if (bucket < LIVE_SUB_BUCKETS)
+		return bucket;
+
+	size_t shift = bucket / LIVE_SUB_BUCKETS - 1;
+	uint64_t lower = (uint64_t)(LIVE_SUB_BUCKETS + bucket % LIVE_SUB_BUCKETS) << shift;
+	return lower + ((1ULL << shift) >> 1);
+}
+
+static struct live_scope *live_get_scope(const char *name)
+{
+	for (size_t i = 0; i < live_scopes.num; i++) {
+		if (strcmp(live_scopes.array[i]->name, name) == 0)
+			return live_scopes.array[i];
+	}
+
+	struct live_scope *scope = bzalloc(sizeof(struct live_scope));
+	scope->name = bstrdup(name);
+	da_push_back(live_scopes, &scope);
+	return scope;
+}
+
+static void live_drain(void)
+{
+	struct live_buffer **prev;
+	struct live_buffer *buffer;
+
+	pthread_mutex_lock(&live_buffers_mutex);
+
+	prev = &live_buffers;
+	while ((buffer = *prev) != NULL) {
+		bool exited = os_atomic_load_bool(&buffer->exited);
+		unsigned long read = (unsigned long)buffer->read_pos;
+		unsigned long write = (unsigned long)os_atomic_load_long(&buffer->write_pos);
+
+		for (; read != write; read++) {
+			struct live_event *event = &buffer->events[read & (LIVE_BUFFER_EVENTS - 1)];
+			struct live_scope *scope = live_get_scope(event->name);
+
+			scope->count[live_slot]++;
+			scope->buckets[live_slot][live_bucket(event->duration)]++;
+			if (event->duration > scope->max[live_slot])
+				scope->max[live_slot] = event->duration;
+		}
+
+		os_atomic_store_long(&buffer->read_pos, (long)read);
+
+		if (exited) {
+			*prev = buffer->next;
+			bfree(buffer);
+		} else {
+			prev = &buffer->next;
+		}
+	}
+
+	pthread_mutex_unlock(&live_buffers_mutex);
+}
+
+static uint64_t live_percentile(const uint32_t *buckets, uint64_t count, uint64_t permille)
+{
+	uint64_t target = (count * permille + 999) / 1000;
+	uint64_t seen = 0;
+
+	for (size_t i = 0; i < LIVE_BUCKETS; i++) {
+		seen += buckets[i];
+		if (seen >= target)
+			return live_bucket_value(i);
+	}
+
+	return live_bucket_value(LIVE_BUCKETS - 1);
+}
+
+void profiler_live_metrics_add(profiler_live_metrics_t *metrics, const char *name, uint64_t count, uint64_t p50_ns,
+			       uint64_t p99_ns, uint64_t max_ns)
+{
+	profiler_live_metric_t *metric;
+
+	if (!metrics || !name)
+		return;
+
+	metric = da_push_back_new(metrics->metrics);
+	metric->name = bstrdup(name);
+	metric->count = count;
+	metric->p50_ns = p50_ns;
+	metric->p99_ns = p99_ns;
+	metric->max_ns = max_ns;
+}
+
+static void live_metrics_free(struct profiler_live_metrics *metrics)
+{
+	for (size_t i = 0; i < metrics->metrics.num; i++)
+		bfree((char *)metrics->metrics.array[i].name);
+	da_free(metrics->metrics);
+}
+
+static void live_build_metrics(struct profiler_live_metrics *metrics)
+{
+	uint32_t buckets[LIVE_BUCKETS];
+
+	for (size_t i = 0; i < live_scopes.num; i++) {
+		struct live_scope *scope = live_scopes.array[i];
+		uint64_t count = 0;
+		uint64_t max = 0;
+
+		memset(buckets, 0, sizeof(buckets));
+
+		for (size_t slot = 0; slot < PROFILER_LIVE_WINDOW_SECONDS; slot++) {
+			if (!scope->count[slot])
+				continue;
+
+			count += scope->count[slot];
+			if (scope->max[slot] > max)
+				max = scope->max[slot];
+			for (size_t b = 0; b < LIVE_BUCKETS; b++)
+				buckets[b] += scope->buckets[slot][b];
+		}
+
+		if (count)
+			profiler_live_metrics_add(metrics, scope->name, count, live_percentile(buckets, count, 500),
+						  live_percentile(buckets, count, 990), max);
+	}
+
+	pthread_mutex_lock(&live_collectors_mutex);
+	for (size_t i = 0; i < live_collectors.num; i++) {
+		struct live_collector *collector = &live_collectors.array[i];
+		collector->func(collector->param, metrics);
+	}
+	pthread_mutex_unlock(&live_collectors_mutex);
+}
+
+#ifndef _WIN32
+static void live_server_close_client(size_t idx)
+{
+	close(live_clients.array[idx]);
+	da_erase(live_clients, idx);
+
+	if (!live_clients.num)
+		os_atomic_dec_long(&live_listeners);
+}
+
+static void live_server_accept(void)
+{
+	int fd;
+
+	if (live_server_fd == -1)
+		return;
+
+	while ((fd = accept(live_server_fd, NULL, NULL)) != -1) {
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+		int one = 1;
+		setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+		if (!live_clients.num)
+			os_atomic_inc_long(&live_listeners);
+		da_push_back(live_clients, &fd);
+	}
+}
+
+static void live_server_send(const struct profiler_live_metrics *metrics)
+{
+	struct dstr text = {0};
+
+	if (!live_clients.num)
+		return;
+
+	for (size_t i = 0; i < metrics->metrics.num; i++) {
+		const profiler_live_metric_t *metric = &metrics->metrics.array[i];
+		size_t name_start = text.len;
+
+		dstr_cat(&text, metric->name);
+		for (size_t j = name_start; j < text.len; j++) {
+			if (text.array[j] == '\t' || text.array[j] == '\n')
+				text.array[j] = ' ';
+		}
+
+		dstr_catf(&text, "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\n", metric->count,
+			  metric->p50_ns, metric->p99_ns, metric->max_ns);
+	}
+	dstr_cat(&text, "\n");
+
+#ifdef MSG_NOSIGNAL
+	const int flags = MSG_NOSIGNAL;
+#else
+	const int flags = 0;
+#endif
+
+	/* clients that can not keep up are dropped rather than waited for */
+	for (size_t i = live_clients.num; i > 0; i--) {
+		ssize_t sent = send(live_clients.array[i - 1], text.array, text.len, flags);
+		if (sent != (ssize_t)text.len)
+			live_server_close_client(i - 1);
+	}
+
+	dstr_free(&text);
+}
+
+static void live_server_free(void)
+{
+	while (live_clients.num)
+		live_server_close_client(live_clients.num - 1);
+	da_free(live_clients);
+
+	if (live_server_fd != -1) {
+		close(live_server_fd);
+		live_server_fd = -1;
+	}
+
+	if (live_server_path) {
+		unlink(live_server_path);
+		bfree(live_server_path);
+		live_server_path = NULL;
+	}
+}
+#endif
+
+static void live_publish(void)
+{
+	struct profiler_live_metrics metrics = {0};
+	struct profiler_live_metrics old;
+
+	live_build_metrics(&metrics);
+
+#ifndef _WIN32
+	pthread_mutex_lock(&live_state_mutex);
+	live_server_send(&metrics);
+	pthread_mutex_unlock(&live_state_mutex);
+#endif
+
+	pthread_mutex_lock(&live_metrics_mutex);
+	old = live_published;
+	live_published = metrics;
+	pthread_mutex_unlock(&live_metrics_mutex);
+
+	live_metrics_free(&old);
+
+	long dropped = os_atomic_set_long(&live_dropped, 0);
+	if (dropped)
+		blog(LOG_DEBUG, "profiler: %ld live events dropped", dropped);
+
+	/* start the next second of the window */
+	live_slot = (live_slot + 1) % PROFILER_LIVE_WINDOW_SECONDS;
+	for (size_t i = 0; i < live_scopes.num; i++) {
+		struct live_scope *scope = live_scopes.array[i];
+		scope->count[live_slot] = 0;
+		scope->max[live_slot] = 0;
+		memset(scope->buckets[live_slot], 0, sizeof(scope->buckets[live_slot]));
+	}
+}
+
+static void *live_thread_proc(void *unused)
+{
+	uint64_t next_publish = os_gettime_ns() + 1000000000ULL;
+
+	os_set_thread_name("profiler: live metrics");
+
+	while (os_event_timedwait(live_stop_event, LIVE_DRAIN_INTERVAL_MS) == ETIMEDOUT) {
+		live_drain();
+
+#ifndef _WIN32
+		pthread_mutex_lock(&live_state_mutex);
+		live_server_accept();
+		pthread_mutex_unlock(&live_state_mutex);
+#endif
+
+		if (os_gettime_ns() >= next_publish) {
+			live_publish();
+			next_publish += 1000000000ULL;
+		}
+	}
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+/* must be called with live_state_mutex locked */
+static bool live_thread_start(void)
+{
+	if (live_thread_active)
+		return true;
+
+	if (os_event_init(&live_stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		return false;
+	if (pthread_create(&live_thread, NULL, live_thread_proc, NULL) != 0) {
+		os_event_destroy(live_stop_event);
+		live_stop_event = NULL;
+		return false;
+	}
+
+	live_thread_active = true;
+	return true;
+}
+
+static void live_free(void)
+{
+	pthread_mutex_lock(&live_state_mutex);
+	bool active = live_thread_active;
+	live_thread_active = false;
+	pthread_mutex_unlock(&live_state_mutex);
+
+	if (active) {
+		os_event_signal(live_stop_event);
+		pthread_join(live_thread, NULL);
+		os_event_destroy(live_stop_event);
+		live_stop_event = NULL;
+	}
+
+#ifndef _WIN32
+	live_server_free();
+#endif
+	os_atomic_set_long(&live_listeners, 0);
+
+	/* threads keep a pointer to their buffer, so stop and wait out any
+	 * recorder before freeing them */
+	os_atomic_set_bool(&live_recording, false);
+	while (os_atomic_load_long(&live_writers))
+		os_sleep_ms(1);
+
+	pthread_mutex_lock(&live_buffers_mutex);
+	while (live_buffers) {
+		struct live_buffer *next = live_buffers->next;
+		bfree(live_buffers);
+		live_buffers = next;
+	}
+	os_atomic_inc_long(&live_generation);
+	pthread_mutex_unlock(&live_buffers_mutex);
+
+	os_atomic_set_long(&live_dropped, 0);
+	os_atomic_set_bool(&live_recording, true);
+
+	for (size_t i = 0; i < live_scopes.num; i++) {
+		bfree(live_scopes.array[i]->name);
+		bfree(live_scopes.array[i]);
+	}
+	da_free(live_scopes);
+
+	pthread_mutex_lock(&live_metrics_mutex);
+	live_metrics_free(&live_published);
+	pthread_mutex_unlock(&live_metrics_mutex);
+
+	pthread_mutex_lock(&live_collectors_mutex);
+	da_free(live_collectors);
+	pthread_mutex_unlock(&live_collectors_mutex);
+}
+
+void profiler_live_start(void)
+{
+	pthread_mutex_lock(&live_state_mutex);
+	if (live_thread_start())
+		os_atomic_inc_long(&live_listeners);
+	pthread_mutex_unlock(&live_state_mutex);
+}
+
+void profiler_live_stop(void)
+{
+	long listeners = os_atomic_load_long(&live_listeners);
+
+	while (listeners > 0 && !os_atomic_compare_exchange_long(&live_listeners, &listeners, listeners - 1))
+		;
+}
+
+void profiler_live_enum(profiler_live_enum_func func, void *param)
+{
+	if (!func)
+		return;
+
+	pthread_mutex_lock(&live_metrics_mutex);
+	for (size_t i = 0; i < live_published.metrics.num; i++) {
+		if (!func(param, &live_published.metrics.array[i]))
+			break;
+	}
+	pthread_mutex_unlock(&live_metrics_mutex);
+}
+
+void profiler_live_add_collector(profiler_live_collect_func func, void *param)
+{
+	struct live_collector collector = {func, param};
+
+	if (!func)
+		return;
+
+	pthread_mutex_lock(&live_collectors_mutex);
+	da_push_back(live_collectors, &collector);
+	pthread_mutex_unlock(&live_collectors_mutex);
+}
+
+void profiler_live_remove_collector(profiler_live_collect_func func, void *param)
+{
+	struct live_collector collector = {func, param};
+
+	pthread_mutex_lock(&live_collectors_mutex);
+	da_erase_item(live_collectors, &collector);
+	pthread_mutex_unlock(&live_collectors_mutex);
+}
+
+bool profiler_live_serve(const char *socket_path)
+{
+#ifdef _WIN32
+	blog(LOG_WARNING, "profiler: live metrics socket is not supported on this platform");
+	UNUSED_PARAMETER(socket_path);
+	return false;
+#else
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	bool success = false;
+	int fd;
+
+	if (!socket_path || strlen(socket_path) >= sizeof(addr.sun_path))
+		return false;
+
+	pthread_mutex_lock(&live_state_mutex);
+
+	if (live_server_fd != -1) {
+		blog(LOG_WARNING, "profiler: live metrics are already served at '%s'", live_server_path);
+		goto unlock;
+	}
+
+	strcpy(addr.sun_path, socket_path);
+
+	/* only replace a stale socket, never some other file */
+	struct stat st;
+	if (lstat(socket_path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			blog(LOG_WARNING, "profiler: '%s' exists and is not a socket", socket_path);
+			goto unlock;
+		}
+		unlink(socket_path);
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1)
+		goto unlock;
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 4) != 0) {
+		blog(LOG_WARNING, "profiler: failed to listen on '%s': %s", socket_path, strerror(errno));
+		close(fd);
+		goto unlock;
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	if (!live_thread_start()) {
+		close(fd);
+		unlink(socket_path);
+		goto unlock;
+	}
+
+	live_server_fd = fd;
+	live_server_path = bstrdup(socket_path);
+	success = true;
+
+unlock:
+	pthread_mutex_unlock(&live_state_mutex);
+	return success;
+#endif
+}
@@ -19,6 +19,10 @@ EXPORT void profile_register_root(const char *name, uint64_t expected_time_betwe
 EXPORT void profile_start(const char *name);
 EXPORT void profile_end(const char *name);
 
+/* records a duration measured elsewhere, as a child of the current call or
+ * as a root entry if there is none */
+EXPORT void profile_record(const char *name, uint64_t duration_ns);
+
 EXPORT void profile_reenable_thread(void);
 
 /* ------------------------------------------------------------------------- */
@@ -92,6 +96,46 @@ EXPORT uint64_t profiler_snapshot_entry_min_time_between_calls(profiler_snapshot
 EXPORT uint64_t profiler_snapshot_entry_max_time_between_calls(profiler_snapshot_entry_t *entry);
 EXPORT uint64_t profiler_snapshot_entry_overall_between_calls_count(profiler_snapshot_entry_t *entry);
 
+/* ------------------------------------------------------------------------- */
+/* Live metrics
+ *
+ *   While anything is listening, completed calls are also pushed into
+ * per-thread lock-free buffers and aggregated in the background into rolling
+ * histograms per name, covering the last PROFILER_LIVE_WINDOW_SECONDS.
+ * Metrics are republished once per second. */
+
+#define PROFILER_LIVE_WINDOW_SECONDS 10
+
+struct profiler_live_metric {
+	const char *name;
+	uint64_t count;
+	uint64_t p50_ns;
+	uint64_t p99_ns;
+	uint64_t max_ns;
+};
+
+typedef struct profiler_live_metric profiler_live_metric_t;
+typedef struct profiler_live_metrics profiler_live_metrics_t;
+
+typedef bool (*profiler_live_enum_func)(void *param, const profiler_live_metric_t *metric);
+typedef void (*profiler_live_collect_func)(void *param, profiler_live_metrics_t *metrics);
+
+EXPORT void profiler_live_start(void);
+EXPORT void profiler_live_stop(void);
+
+EXPORT void profiler_live_enum(profiler_live_enum_func func, void *param);
+
+/* collectors are called from the aggregator thread once per second to add
+ * metrics that are not measured with profile_start/profile_end */
+EXPORT void profiler_live_add_collector(profiler_live_collect_func func, void *param);
+EXPORT void profiler_live_remove_collector(profiler_live_collect_func func, void *param);
+EXPORT void profiler_live_metrics_add(profiler_live_metrics_t *metrics, const char *name, uint64_t count,
+				      uint64_t p50_ns, uint64_t p99_ns, uint64_t max_ns);
+
+/* streams metrics as text to clients of a local unix socket, the profiler
+ * only counts as listening while a client is connected */
+EXPORT bool profiler_live_serve(const char *socket_path);
+
 #ifdef __cplusplus
 }
 #endif
@@ -18,8 +18,10 @@
 #include "source-profiler.h"
 
 #include "darray.h"
+#include "dstr.h"
 #include "obs-internal.h"
 #include "platform.h"
+#include "profiler.h"
 #include "threading.h"
 #include "uthash.h"
 
@@ -220,9 +222,26 @@ static void profiler_shutdown(void)
 	reset_gpu_timers();
 }
 
+static void collect_live_metrics(void *param, profiler_live_metrics_t *metrics);
+
 void source_profiler_enable(bool enable)
 {
 	enable_next = enable;
+
+	profiler_live_remove_collector(collect_live_metrics, NULL);
+	if (enable)
+		profiler_live_add_collector(collect_live_metrics, NULL);
+}
+
+void source_profiler_shutdown(void)
+{
+	/* the live metrics thread runs until the profiler is freed, which is
+	 * after libobs has been shut down */
+	profiler_live_remove_collector(collect_live_metrics, NULL);
+
+	enable_next = gpu_enable_next = false;
+	enabled = gpu_enabled = false;
+	profiler_shutdown();
 }
 
 void source_profiler_gpu_enable(bool enable)
@@ -628,3 +647,68 @@ profiler_result_t *source_profiler_get_result(obs_source_t *source)
 	}
 	return ret;
 }
+
+/* ------------------------------------------------------------------------- */
+/* Live metrics, over the samples currently held for each source */
+
+struct live_collect_data {
+	profiler_live_metrics_t *metrics;
+	DARRAY(uint64_t) sorted;
+	struct dstr name;
+};
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t val_a = *(const uint64_t *)a;
+	uint64_t val_b = *(const uint64_t *)b;
+	return val_a < val_b ? -1 : (val_a > val_b ? 1 : 0);
+}
+
+static void add_live_metric(struct live_collect_data *data, obs_source_t *source, const char *what,
+			    const struct ucirclebuf *buf)
+{
+	if (!buf->num)
+		return;
+
+	da_resize(data->sorted, buf->num);
+	memcpy(data->sorted.array, buf->array, buf->num * sizeof(uint64_t));
+	qsort(data->sorted.array, buf->num, sizeof(uint64_t), compare_u64);
+
+	size_t num = buf->num;
+	dstr_printf(&data->name, "source '%s' %s", obs_source_get_name(source), what);
+	profiler_live_metrics_add(data->metrics, data->name.array, num, data->sorted.array[num / 2],
+				  data->sorted.array[(num * 99) / 100], data->sorted.array[num - 1]);
+}
+
+static bool collect_source(void *param, obs_source_t *source)
+{
+	struct live_collect_data *data = param;
+	struct profiler_entry *ent = NULL;
+
+	pthread_rwlock_rdlock(&hm_rwlock);
+
+	HASH_FIND_PTR(hm_entries, &source, ent);
+	if (ent) {
+		add_live_metric(data, source, "tick", &ent->tick);
+		add_live_metric(data, source, "render", &ent->render_cpu);
+		if (gpu_enabled)
+			add_live_metric(data, source, "render_gpu", &ent->render_gpu);
+	}
+
+	pthread_rwlock_unlock(&hm_rwlock);
+	return true;
+}
+
+static void collect_live_metrics(void *param, profiler_live_metrics_t *metrics)
+{
+	struct live_collect_data data = {.metrics = metrics};
+
+	if (!obs || !enabled)
+		return;
+
+	obs_enum_all_sources(collect_source, &data);
+
+	da_free(data.sorted);
+	dstr_free(&data.name);
+	UNUSED_PARAMETER(param);
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "c99defs.h"
+#include <string.h>
+
+#include "bmem.h"
+#include "threading.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Single producer, single consumer ring of variable sized records
+ *
+ *   One thread may write records while one other thread reads them, without
+ * any locking.  Records are always stored contiguously, so they can be
+ * written and read in place.  If a record does not fit before the end of the
+ * buffer, the rest of the buffer is skipped.
+ *
+ *   The read and write positions count bytes and are allowed to wrap.
+ */
+
+#define SPSC_RING_ALIGN sizeof(uint64_t)
+#define SPSC_RING_WRAP ((uint64_t)-1)
+
+struct spsc_ring {
+	uint8_t *data;
+	size_t capacity;
+
+	volatile long write_pos;
+	volatile long read_pos;
+
+	/* owned by the producer and consumer respectively */
+	unsigned long write_next;
+	unsigned long read_next;
+};
+
+static inline size_t spsc_ring_align(size_t size)
+{
+	return (size + SPSC_RING_ALIGN - 1) & ~(SPSC_RING_ALIGN - 1);
+}
+
+static inline void spsc_ring_init(struct spsc_ring *ring, size_t capacity)
+{
+	size_t size = 1024;
+	while (size < capacity)
+		size *= 2;
+
+	memset(ring, 0, sizeof(struct spsc_ring));
+	ring->data = (uint8_t *)bmalloc(size);
+	ring->capacity = size;
+}
+
+static inline void spsc_ring_free(struct spsc_ring *ring)
+{
+	bfree(ring->data);
+	memset(ring, 0, sizeof(struct spsc_ring));
+}
+
+/* largest record that is guaranteed to fit into an empty ring */
+static inline size_t spsc_ring_max_record_size(const struct spsc_ring *ring)
+{
+	return ring->capacity / 2 - sizeof(uint64_t);
+}
+
+/* returns NULL if the ring is full */
+static inline void *spsc_ring_write_begin(struct spsc_ring *ring, size_t size)
+{
+	unsigned long write = (unsigned long)ring->write_pos;
+	unsigned long read = (unsigned long)os_atomic_load_long(&ring->read_pos);
+	size_t mask = ring->capacity - 1;
+	size_t offset = write & mask;
+	size_t total = sizeof(uint64_t) + spsc_ring_align(size);
+	size_t skip = 0;
+
+	if (!ring->data)
+		return NULL;
+	if (offset + total > ring->capacity)
+		skip = ring->capacity - offset;
+	if ((size_t)(write - read) + skip + total > ring->capacity)
+		return NULL;
+
+	if (skip) {
+		uint64_t marker = SPSC_RING_WRAP;
+		memcpy(ring->data + offset, &marker, sizeof(marker));
+		offset = 0;
+	}
+
+	uint64_t record_size = size;
+	memcpy(ring->data + offset, &record_size, sizeof(record_size));
+
+	ring->write_next = write + (unsigned long)(skip + total);
+	return ring->data + offset + sizeof(uint64_t);
+}
+
+static inline void spsc_ring_write_end(struct spsc_ring *ring)
+{
+	os_atomic_store_long(&ring->write_pos, (long)ring->write_next);
+}
+
+/* returns NULL if the ring is empty */
+static inline const void *spsc_ring_read_begin(struct spsc_ring *ring, size_t *size)
+{
+	unsigned long read = (unsigned long)ring->read_pos;
+	unsigned long write = (unsigned long)os_atomic_load_long(&ring->write_pos);
+	size_t mask = ring->capacity - 1;
+
+	while (read != write) {
+		size_t offset = read & mask;
+		uint64_t record_size;
+
+		memcpy(&record_size, ring->data + offset, sizeof(record_size));
+
+		if (record_size == SPSC_RING_WRAP) {
+			read += (unsigned long)(ring->capacity - offset);
+			continue;
+		}
+
+		*size = (size_t)record_size;
+		ring->read_next = read + (unsigned long)(sizeof(uint64_t) + spsc_ring_align(*size));
+		return ring->data + offset + sizeof(uint64_t);
+	}
+
+	return NULL;
+}
+
+static inline void spsc_ring_read_end(struct spsc_ring *ring)
+{
+	os_atomic_store_long(&ring->read_pos, (long)ring->read_next);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -88,6 +88,17 @@ static inline bool os_atomic_compare_exchange_long(volatile long *val, long *old
 	return previous == old_val;
 }
 
+static inline int64_t os_atomic_add_int64(volatile int64_t *val, int64_t add)
+{
+	return _InterlockedExchangeAdd64((volatile __int64 *)val, add) + add;
+}
+
+static inline int64_t os_atomic_load_int64(const volatile int64_t *ptr)
+{
+	/* plain 64-bit loads aren't atomic on 32-bit x86 */
+	return _InterlockedCompareExchange64((volatile __int64 *)ptr, 0, 0);
+}
+
 static inline void os_atomic_store_bool(volatile bool *ptr, bool val)
 {
 #if defined(_M_ARM64)
@@ -140,3 +151,18 @@ static inline bool os_atomic_load_bool(const volatile bool *ptr)
 
 	return b;
 }
+
+static inline void *os_atomic_load_ptr(void *const volatile *ptr)
+{
+	return _InterlockedCompareExchangePointer((void *volatile *)ptr, NULL, NULL);
+}
+
+static inline void *os_atomic_exchange_ptr(void *volatile *ptr, void *val)
+{
+	return _InterlockedExchangePointer(ptr, val);
+}
+
+static inline bool os_atomic_compare_swap_ptr(void *volatile *ptr, void *old_val, void *new_val)
+{
+	return _InterlockedCompareExchangePointer(ptr, new_val, old_val) == old_val;
+}
@@ -44,6 +44,7 @@ static void jack_destroy(void *vptr)
 	if (data->device)
 		bfree(data->device);
 	pthread_mutex_destroy(&data->jack_mutex);
+	pthread_mutex_destroy(&data->ring_mutex);
 	bfree(data);
 }
 
@@ -97,6 +98,18 @@ static void jack_update(void *vptr, obs_data_t *settings)
 	}
 }
 
+/**
+ * Returns the xruns reported by the JACK server, and the frames dropped
+ * because the feed thread fell behind
+ */
+static void jack_get_xruns(void *vptr, calldata_t *cd)
+{
+	struct jack_data *data = (struct jack_data *)vptr;
+
+	calldata_set_int(cd, "xruns", os_atomic_load_long(&data->xruns));
+	calldata_set_int(cd, "dropped_frames", os_atomic_load_long(&data->dropped_frames));
+}
+
 /**
  * Create the plugin object
  */
@@ -105,9 +118,13 @@ static void *jack_create(obs_data_t *settings, obs_source_t *source)
 	struct jack_data *data = bzalloc(sizeof(struct jack_data));
 
 	pthread_mutex_init(&data->jack_mutex, NULL);
+	pthread_mutex_init(&data->ring_mutex, NULL);
 	data->source = source;
 	data->channels = -1;
 
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	proc_handler_add(ph, "void get_xruns(out int xruns, out int dropped_frames)", jack_get_xruns, data);
+
 	jack_update(data, settings);
 
 	if (data->jack_client == NULL) {
@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 
 #include <util/platform.h>
+#include <util/util_uint64.h>
 
 #define blog(level, msg, ...) blog(level, "jack-input: " msg, ##__VA_ARGS__)
 
@@ -58,44 +59,166 @@ static enum speaker_layout jack_channels_to_obs_speakers(uint_fast32_t channels)
 	return SPEAKERS_UNKNOWN;
 }
 
+/* header of each record in the ring, followed by the planar samples */
+struct jack_packet {
+	uint64_t timestamp;
+	uint32_t frames;
+	uint32_t channels;
+};
+
+/* enough for the feed thread to fall this far behind before dropping */
+#define RING_MIN_PERIODS 8
+#define RING_MIN_MS 200
+
+static inline size_t jack_packet_size(uint_fast8_t channels, jack_nframes_t nframes)
+{
+	return sizeof(struct jack_packet) + (size_t)channels * nframes * sizeof(jack_default_audio_sample_t);
+}
+
+static void jack_ring_init(struct jack_data *data, jack_nframes_t nframes)
+{
+	size_t periods = RING_MIN_PERIODS;
+	size_t min_frames = (size_t)data->samples_per_sec * RING_MIN_MS / 1000;
+
+	if (nframes && periods * nframes < min_frames)
+		periods = (min_frames + nframes - 1) / nframes;
+
+	spsc_ring_init(&data->ring, spsc_ring_align(jack_packet_size(data->channels, nframes)) * periods);
+}
+
 int jack_process_callback(jack_nframes_t nframes, void *arg)
 {
 	struct jack_data *data = (struct jack_data *)arg;
 	jack_nframes_t current_frames;
 	jack_time_t current_usecs, next_usecs;
 	float period_usecs;
+	struct jack_packet packet;
+	uint8_t *ptr;
 
 	uint64_t now = os_gettime_ns();
 
 	if (data == 0)
 		return 0;
 
-	struct obs_source_audio out;
-	out.speakers = jack_channels_to_obs_speakers(data->channels);
-	out.samples_per_sec = jack_get_sample_rate(data->jack_client);
-	/* format is always 32 bit float for jack */
-	out.format = AUDIO_FORMAT_FLOAT_PLANAR;
+	packet.frames = nframes;
+	packet.channels = data->channels;
+	packet.timestamp = now - util_mul_div64(nframes, 1000000000ULL, data->samples_per_sec);
+
+	/* the port buffers hold the period that ended when this cycle started,
+	 * so go back from the start of the cycle rather than from now */
+	if (!jack_get_cycle_times(data->jack_client, &current_frames, &current_usecs, &next_usecs, &period_usecs)) {
+		jack_time_t jack_now = jack_get_time();
+		if (jack_now > current_usecs)
+			packet.timestamp -= (jack_now - current_usecs) * 1000;
+	}
+
+	ptr = spsc_ring_write_begin(&data->ring, jack_packet_size(data->channels, nframes));
+	if (!ptr) {
+		/* only ever written from here */
+		os_atomic_set_long(&data->dropped_frames, os_atomic_load_long(&data->dropped_frames) + (long)nframes);
+		return 0;
+	}
+
+	memcpy(ptr, &packet, sizeof(packet));
+	ptr += sizeof(packet);
 
 	for (unsigned int i = 0; i < data->channels; ++i) {
-		jack_default_audio_sample_t *jack_buffer =
-			(jack_default_audio_sample_t *)jack_port_get_buffer(data->jack_ports[i], nframes);
-		out.data[i] = (uint8_t *)jack_buffer;
+		const size_t size = nframes * sizeof(jack_default_audio_sample_t);
+		memcpy(ptr, jack_port_get_buffer(data->jack_ports[i], nframes), size);
+		ptr += size;
 	}
 
-	out.frames = nframes;
-	if (!jack_get_cycle_times(data->jack_client, &current_frames, &current_usecs, &next_usecs, &period_usecs)) {
-		out.timestamp = now - (int64_t)(period_usecs * 1000);
-	} else {
-		out.timestamp = now - util_mul_div64(nframes, 1000000000ULL, data->samples_per_sec);
-		blog(LOG_WARNING, "jack_get_cycle_times error: guessing timestamp");
+	spsc_ring_write_end(&data->ring);
+	os_sem_post(data->feed_sem);
+	return 0;
+}
+
+static void jack_feed_packets(struct jack_data *data)
+{
+	const uint8_t *ptr;
+	size_t size;
+
+	while ((ptr = spsc_ring_read_begin(&data->ring, &size)) != NULL) {
+		struct jack_packet packet;
+		memcpy(&packet, ptr, sizeof(packet));
+
+		const jack_default_audio_sample_t *samples;
+		samples = (const jack_default_audio_sample_t *)(ptr + sizeof(packet));
+
+		struct obs_source_audio out = {0};
+		out.speakers = jack_channels_to_obs_speakers(packet.channels);
+		out.samples_per_sec = data->samples_per_sec;
+		/* format is always 32 bit float for jack */
+		out.format = AUDIO_FORMAT_FLOAT_PLANAR;
+		out.frames = packet.frames;
+		out.timestamp = packet.timestamp;
+
+		for (unsigned int i = 0; i < packet.channels && i < MAX_AV_PLANES; ++i)
+			out.data[i] = (const uint8_t *)(samples + (size_t)i * packet.frames);
+
+		obs_source_output_audio(data->source, &out);
+		spsc_ring_read_end(&data->ring);
+	}
+}
+
+static void *jack_feed_thread(void *arg)
+{
+	struct jack_data *data = (struct jack_data *)arg;
+
+	os_set_thread_name("jack-input: feed");
+
+	while (os_sem_wait(data->feed_sem) == 0) {
+		if (os_atomic_load_bool(&data->feed_stop))
+			break;
+
+		pthread_mutex_lock(&data->ring_mutex);
+		jack_feed_packets(data);
+		pthread_mutex_unlock(&data->ring_mutex);
 	}
 
-	/* FIXME: this function is not realtime-safe, we should do something
-	 * about this */
-	obs_source_output_audio(data->source, &out);
+	return NULL;
+}
+
+/* not called from the realtime thread, and never while process runs */
+static int jack_buffer_size_callback(jack_nframes_t nframes, void *arg)
+{
+	struct jack_data *data = (struct jack_data *)arg;
+
+	if (jack_packet_size(data->channels, nframes) <= spsc_ring_max_record_size(&data->ring))
+		return 0;
+
+	pthread_mutex_lock(&data->ring_mutex);
+	jack_feed_packets(data);
+	spsc_ring_free(&data->ring);
+	jack_ring_init(data, nframes);
+	pthread_mutex_unlock(&data->ring_mutex);
+
+	blog(LOG_INFO, "JACK buffer size changed to %u frames", nframes);
 	return 0;
 }
 
+static int jack_xrun_callback(void *arg)
+{
+	struct jack_data *data = (struct jack_data *)arg;
+
+	os_atomic_inc_long(&data->xruns);
+	return 0;
+}
+
+static void jack_stop_feed_thread(struct jack_data *data)
+{
+	if (data->feed_thread_active) {
+		os_atomic_set_bool(&data->feed_stop, true);
+		os_sem_post(data->feed_sem);
+		pthread_join(data->feed_thread, NULL);
+		data->feed_thread_active = false;
+	}
+
+	os_sem_destroy(data->feed_sem);
+	data->feed_sem = NULL;
+	spsc_ring_free(&data->ring);
+}
+
 int_fast32_t jack_init(struct jack_data *data)
 {
 	pthread_mutex_lock(&data->jack_mutex);
@@ -114,6 +237,10 @@ int_fast32_t jack_init(struct jack_data *data)
 		goto error;
 	}
 
+	data->samples_per_sec = jack_get_sample_rate(data->jack_client);
+	os_atomic_set_long(&data->xruns, 0);
+	os_atomic_set_long(&data->dropped_frames, 0);
+
 	data->jack_ports = (jack_port_t **)bzalloc(sizeof(jack_port_t *) * data->channels);
 	for (unsigned int i = 0; i < data->channels; ++i) {
 		char port_name[10] = {'\0'};
@@ -130,11 +257,33 @@ int_fast32_t jack_init(struct jack_data *data)
 		}
 	}
 
+	jack_ring_init(data, jack_get_buffer_size(data->jack_client));
+	os_atomic_set_bool(&data->feed_stop, false);
+	if (os_sem_init(&data->feed_sem, 0) != 0) {
+		blog(LOG_ERROR, "os_sem_init Error");
+		goto error;
+	}
+	if (pthread_create(&data->feed_thread, NULL, jack_feed_thread, data) != 0) {
+		blog(LOG_ERROR, "Could not create feed thread");
+		goto error;
+	}
+	data->feed_thread_active = true;
+
 	if (jack_set_process_callback(data->jack_client, jack_process_callback, data) != 0) {
 		blog(LOG_ERROR, "jack_set_process_callback Error");
 		goto error;
 	}
 
+	if (jack_set_buffer_size_callback(data->jack_client, jack_buffer_size_callback, data) != 0) {
+		blog(LOG_ERROR, "jack_set_buffer_size_callback Error");
+		goto error;
+	}
+
+	if (jack_set_xrun_callback(data->jack_client, jack_xrun_callback, data) != 0) {
+		blog(LOG_ERROR, "jack_set_xrun_callback Error");
+		goto error;
+	}
+
 	if (jack_activate(data->jack_client) != 0) {
 		blog(LOG_ERROR, "jack_activate Error:"
 				"Could not activate JACK client!");
@@ -161,6 +310,13 @@ void deactivate_jack(struct jack_data *data)
 			data->jack_ports = NULL;
 		}
 		data->jack_client = NULL;
+
+		jack_stop_feed_thread(data);
+
+		long xruns = os_atomic_load_long(&data->xruns);
+		long dropped_frames = os_atomic_load_long(&data->dropped_frames);
+		if (xruns || dropped_frames)
+			blog(LOG_INFO, "%s: %ld xruns, %ld frames dropped", data->device, xruns, dropped_frames);
 	}
 	pthread_mutex_unlock(&data->jack_mutex);
 }
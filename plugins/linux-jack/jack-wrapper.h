@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <jack/jack.h>
 #include <obs.h>
+#include <util/spsc-ring.h>
 #include <util/threading.h>
 
 struct jack_data {
@@ -38,6 +39,20 @@ struct jack_data {
 	jack_port_t **jack_ports;
 
 	pthread_mutex_t jack_mutex;
+
+	/* the process callback only copies the port buffers into the ring,
+	 * the feed thread hands them to libobs outside of the realtime
+	 * thread */
+	struct spsc_ring ring;
+	pthread_mutex_t ring_mutex;
+	os_sem_t *feed_sem;
+	pthread_t feed_thread;
+	bool feed_thread_active;
+	volatile bool feed_stop;
+
+	/* statistics */
+	volatile long xruns;
+	volatile long dropped_frames;
 };
 
 /**
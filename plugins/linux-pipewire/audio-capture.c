@@ -0,0 +1,453 @@
+/* audio-capture.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "audio-capture.h"
+#include "pipewire.h"
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/util_uint64.h>
+
+#include <spa/param/audio/format-utils.h>
+#include <spa/utils/dict.h>
+
+#ifndef PW_KEY_STREAM_CAPTURE_SINK
+#define PW_KEY_STREAM_CAPTURE_SINK "stream.capture.sink"
+#endif
+
+#define DEFAULT_QUANTUM 256
+
+static const uint32_t quantums[] = {64, 128, 256, 512, 1024};
+
+#define N_QUANTUMS (sizeof(quantums) / sizeof(quantums[0]))
+
+struct audio_capture {
+	obs_source_t *source;
+	bool output;
+
+	obs_pipewire *obs_pw;
+	struct pw_stream *stream;
+	struct spa_hook stream_listener;
+
+	/* user settings */
+	char *device;
+	uint32_t quantum;
+
+	/* negotiated format, only changed while the stream is disconnected */
+	enum speaker_layout speakers;
+	uint32_t sample_rate;
+};
+
+/* ------------------------------------------------- */
+
+static void set_channel_positions(uint32_t *position, enum speaker_layout speakers)
+{
+	position[0] = SPA_AUDIO_CHANNEL_FL;
+	position[1] = SPA_AUDIO_CHANNEL_FR;
+	position[2] = SPA_AUDIO_CHANNEL_FC;
+	position[3] = SPA_AUDIO_CHANNEL_LFE;
+	position[4] = SPA_AUDIO_CHANNEL_RL;
+	position[5] = SPA_AUDIO_CHANNEL_RR;
+	position[6] = SPA_AUDIO_CHANNEL_SL;
+	position[7] = SPA_AUDIO_CHANNEL_SR;
+
+	switch (speakers) {
+	case SPEAKERS_MONO:
+		position[0] = SPA_AUDIO_CHANNEL_MONO;
+		break;
+	case SPEAKERS_2POINT1:
+		position[2] = SPA_AUDIO_CHANNEL_LFE;
+		break;
+	case SPEAKERS_4POINT0:
+		position[3] = SPA_AUDIO_CHANNEL_RC;
+		break;
+	case SPEAKERS_4POINT1:
+		position[4] = SPA_AUDIO_CHANNEL_RC;
+		break;
+	default:
+		break;
+	}
+}
+
+/* Asks for the OBS output format as is, planar float at the OBS sample rate
+ * with the OBS channel layout, so the adapter of our node does any conversion
+ * and the samples can be passed on without touching them. */
+static const struct spa_pod *build_format(struct audio_capture *capture, struct spa_pod_builder *builder)
+{
+	struct spa_audio_info_raw info = SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_F32P,
+								  .rate = capture->sample_rate,
+								  .channels = get_audio_channels(capture->speakers));
+
+	set_channel_positions(info.position, capture->speakers);
+	return spa_format_audio_raw_build(builder, SPA_PARAM_EnumFormat, &info);
+}
+
+/* Timestamps come from the graph clock of the cycle the samples were captured
+ * in, which uses the same monotonic clock as os_gettime_ns. */
+static uint64_t get_capture_timestamp(struct audio_capture *capture, uint32_t frames)
+{
+	uint64_t duration = util_mul_div64(frames, SPA_NSEC_PER_SEC, capture->sample_rate);
+	struct pw_time time = {0};
+	uint64_t ts;
+
+#if PW_CHECK_VERSION(0, 3, 50)
+	pw_stream_get_time_n(capture->stream, &time, sizeof(time));
+#else
+	pw_stream_get_time(capture->stream, &time);
+#endif
+
+	if (time.now > 0 && time.rate.denom > 0) {
+		ts = (uint64_t)time.now;
+		if (time.delay > 0)
+			ts -= util_mul_div64((uint64_t)time.delay * time.rate.num, SPA_NSEC_PER_SEC, time.rate.denom);
+	} else {
+		ts = os_gettime_ns();
+	}
+
+	return ts > duration ? ts - duration : 0;
+}
+
+static void on_process_cb(void *user_data)
+{
+	struct audio_capture *capture = user_data;
+	struct obs_source_audio out = {0};
+	struct spa_buffer *buffer;
+	struct pw_buffer *b;
+	uint32_t channels = get_audio_channels(capture->speakers);
+
+	b = pw_stream_dequeue_buffer(capture->stream);
+	if (!b)
+		return;
+
+	buffer = b->buffer;
+	if (buffer->n_datas < channels || channels > MAX_AV_PLANES || !buffer->datas[0].chunk->size)
+		goto done;
+
+	for (uint32_t i = 0; i < channels; i++) {
+		struct spa_data *data = &buffer->datas[i];
+		if (!data->data)
+			goto done;
+
+		out.data[i] = SPA_PTROFF(data->data, data->chunk->offset, uint8_t);
+	}
+
+	out.frames = buffer->datas[0].chunk->size / sizeof(float);
+	out.speakers = capture->speakers;
+	out.format = AUDIO_FORMAT_FLOAT_PLANAR;
+	out.samples_per_sec = capture->sample_rate;
+	out.timestamp = get_capture_timestamp(capture, out.frames);
+
+	obs_source_output_audio(capture->source, &out);
+
+done:
+	pw_stream_queue_buffer(capture->stream, b);
+}
+
+static void on_state_changed_cb(void *user_data, enum pw_stream_state old, enum pw_stream_state state,
+				const char *error)
+{
+	UNUSED_PARAMETER(old);
+
+	struct audio_capture *capture = user_data;
+
+	blog(LOG_INFO, "[pipewire] Audio stream %p state: \"%s\" (error: %s)", capture->stream,
+	     pw_stream_state_as_string(state), error ? error : "none");
+}
+
+static const struct pw_stream_events stream_events = {
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = on_state_changed_cb,
+	.process = on_process_cb,
+};
+
+static void audio_capture_start(struct audio_capture *capture)
+{
+	struct pw_thread_loop *thread_loop;
+	struct pw_properties *props;
+	const struct spa_pod *params[1];
+	struct obs_audio_info oai;
+	uint8_t buffer[1024];
+	struct spa_pod_builder pod_builder = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+
+	if (!capture->obs_pw)
+		return;
+
+	obs_get_audio_info(&oai);
+	capture->speakers = oai.speakers;
+	capture->sample_rate = oai.samples_per_sec;
+
+	props = pw_properties_new(PW_KEY_MEDIA_TYPE, "Audio", PW_KEY_MEDIA_CATEGORY, "Capture", PW_KEY_MEDIA_ROLE,
+				  "Production", NULL);
+
+	/* the graph runs at the smallest quantum any node asks for */
+	pw_properties_setf(props, PW_KEY_NODE_LATENCY, "%u/%u", capture->quantum, capture->sample_rate);
+
+	if (capture->output)
+		pw_properties_set(props, PW_KEY_STREAM_CAPTURE_SINK, "true");
+
+	if (strcmp(capture->device, "default") != 0) {
+#ifdef PW_KEY_TARGET_OBJECT
+		pw_properties_set(props, PW_KEY_TARGET_OBJECT, capture->device);
+#else
+		pw_properties_set(props, PW_KEY_NODE_TARGET, capture->device);
+#endif
+	}
+
+	thread_loop = obs_pipewire_get_thread_loop(capture->obs_pw);
+	pw_thread_loop_lock(thread_loop);
+
+	capture->stream = pw_stream_new(obs_pipewire_get_core(capture->obs_pw), obs_source_get_name(capture->source),
+					props);
+	pw_stream_add_listener(capture->stream, &capture->stream_listener, &stream_events, capture);
+
+	params[0] = build_format(capture, &pod_builder);
+
+	/* obs_source_output_audio takes source locks, so the process callback
+	 * stays on the thread loop rather than the realtime data thread */
+	pw_stream_connect(capture->stream, PW_DIRECTION_INPUT, PW_ID_ANY,
+			  PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS, params, 1);
+
+	pw_thread_loop_unlock(thread_loop);
+
+	blog(LOG_INFO, "[pipewire] Capturing audio from '%s' with a quantum of %u frames at %u Hz", capture->device,
+	     capture->quantum, capture->sample_rate);
+}
+
+static void audio_capture_stop(struct audio_capture *capture)
+{
+	struct pw_thread_loop *thread_loop;
+
+	if (!capture->stream)
+		return;
+
+	thread_loop = obs_pipewire_get_thread_loop(capture->obs_pw);
+	pw_thread_loop_lock(thread_loop);
+	pw_stream_disconnect(capture->stream);
+	pw_stream_destroy(capture->stream);
+	capture->stream = NULL;
+	pw_thread_loop_unlock(thread_loop);
+}
+
+/* ------------------------------------------------- */
+
+struct node_list {
+	obs_property_t *devices;
+	const char *media_class;
+};
+
+static void on_registry_global_cb(void *user_data, uint32_t id, uint32_t permissions, const char *type,
+				  uint32_t version, const struct spa_dict *props)
+{
+	UNUSED_PARAMETER(id);
+	UNUSED_PARAMETER(permissions);
+	UNUSED_PARAMETER(version);
+
+	struct node_list *list = user_data;
+	const char *media_class;
+	const char *name;
+	const char *description;
+
+	if (!props || strcmp(type, PW_TYPE_INTERFACE_Node) != 0)
+		return;
+
+	media_class = spa_dict_lookup(props, PW_KEY_MEDIA_CLASS);
+	if (!media_class || strcmp(media_class, list->media_class) != 0)
+		return;
+
+	name = spa_dict_lookup(props, PW_KEY_NODE_NAME);
+	if (!name)
+		return;
+
+	description = spa_dict_lookup(props, PW_KEY_NODE_DESCRIPTION);
+	obs_property_list_add_string(list->devices, description ? description : name, name);
+}
+
+static const struct pw_registry_events registry_events = {
+	PW_VERSION_REGISTRY_EVENTS,
+	.global = on_registry_global_cb,
+};
+
+static void list_nodes(obs_property_t *devices, bool output)
+{
+	struct node_list list = {
+		.devices = devices,
+		.media_class = output ? "Audio/Sink" : "Audio/Source",
+	};
+	obs_pipewire *obs_pw;
+
+	obs_pw = obs_pipewire_connect(&registry_events, &list);
+	if (!obs_pw)
+		return;
+
+	obs_pipewire_roundtrip(obs_pw);
+	obs_pipewire_destroy(obs_pw);
+}
+
+/* obs_source_info methods */
+
+static const char *audio_capture_input_get_name(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return obs_module_text("PipeWireAudioInput");
+}
+
+static const char *audio_capture_output_get_name(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return obs_module_text("PipeWireAudioOutput");
+}
+
+static void audio_capture_update(void *data, obs_data_t *settings)
+{
+	struct audio_capture *capture = data;
+	const char *device = obs_data_get_string(settings, "device_id");
+	uint32_t quantum = (uint32_t)obs_data_get_int(settings, "quantum");
+
+	if (capture->device && strcmp(capture->device, device) == 0 && capture->quantum == quantum)
+		return;
+
+	/* Signal to deduplication logic in case the device is also used for monitoring. */
+	if (capture->output)
+		obs_source_audio_output_capture_device_changed(capture->source, device);
+
+	bfree(capture->device);
+	capture->device = bstrdup(device);
+	capture->quantum = quantum ? quantum : DEFAULT_QUANTUM;
+
+	audio_capture_stop(capture);
+	audio_capture_start(capture);
+}
+
+static void *audio_capture_create(obs_data_t *settings, obs_source_t *source, bool output)
+{
+	struct audio_capture *capture = bzalloc(sizeof(struct audio_capture));
+
+	capture->source = source;
+	capture->output = output;
+
+	capture->obs_pw = obs_pipewire_connect(NULL, NULL);
+	if (!capture->obs_pw)
+		blog(LOG_WARNING, "[pipewire] Failed to connect to the PipeWire daemon");
+
+	audio_capture_update(capture, settings);
+
+	return capture;
+}
+
+static void *audio_capture_input_create(obs_data_t *settings, obs_source_t *source)
+{
+	return audio_capture_create(settings, source, false);
+}
+
+static void *audio_capture_output_create(obs_data_t *settings, obs_source_t *source)
+{
+	return audio_capture_create(settings, source, true);
+}
+
+static void audio_capture_destroy(void *data)
+{
+	struct audio_capture *capture = data;
+
+	if (!capture)
+		return;
+
+	audio_capture_stop(capture);
+
+	/* If the device is also used for monitoring, a cleanup is needed. */
+	if (capture->output)
+		obs_source_audio_output_capture_device_changed(capture->source, NULL);
+
+	obs_pipewire_destroy(capture->obs_pw);
+	bfree(capture->device);
+	bfree(capture);
+}
+
+static void audio_capture_get_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_string(settings, "device_id", "default");
+	obs_data_set_default_int(settings, "quantum", DEFAULT_QUANTUM);
+}
+
+static obs_properties_t *audio_capture_get_properties(bool output)
+{
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *devices;
+	obs_property_t *quantum;
+	struct obs_audio_info oai;
+
+	devices = obs_properties_add_list(props, "device_id", obs_module_text("Device"), OBS_COMBO_TYPE_LIST,
+					  OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(devices, obs_module_text("Default"), "default");
+	list_nodes(devices, output);
+
+	quantum = obs_properties_add_list(props, "quantum", obs_module_text("Quantum"), OBS_COMBO_TYPE_LIST,
+					  OBS_COMBO_FORMAT_INT);
+	obs_property_set_long_description(quantum, obs_module_text("Quantum.Description"));
+
+	obs_get_audio_info(&oai);
+	for (size_t i = 0; i < N_QUANTUMS; i++) {
+		char name[64];
+		snprintf(name, sizeof(name), "%u (%.1f ms)", quantums[i], quantums[i] * 1000.0 / oai.samples_per_sec);
+		obs_property_list_add_int(quantum, name, quantums[i]);
+	}
+
+	return props;
+}
+
+static obs_properties_t *audio_capture_input_get_properties(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return audio_capture_get_properties(false);
+}
+
+static obs_properties_t *audio_capture_output_get_properties(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return audio_capture_get_properties(true);
+}
+
+void audio_capture_load(void)
+{
+	const struct obs_source_info audio_capture_input_info = {
+		.id = "pipewire_audio_input_capture",
+		.type = OBS_SOURCE_TYPE_INPUT,
+		.output_flags = OBS_SOURCE_AUDIO | OBS_SOURCE_DO_NOT_DUPLICATE,
+		.get_name = audio_capture_input_get_name,
+		.create = audio_capture_input_create,
+		.destroy = audio_capture_destroy,
+		.update = audio_capture_update,
+		.get_defaults = audio_capture_get_defaults,
+		.get_properties = audio_capture_input_get_properties,
+		.icon_type = OBS_ICON_TYPE_AUDIO_INPUT,
+	};
+	obs_register_source(&audio_capture_input_info);
+
+	const struct obs_source_info audio_capture_output_info = {
+		.id = "pipewire_audio_output_capture",
+		.type = OBS_SOURCE_TYPE_INPUT,
+		.output_flags = OBS_SOURCE_AUDIO | OBS_SOURCE_DO_NOT_DUPLICATE | OBS_SOURCE_DO_NOT_SELF_MONITOR,
+		.get_name = audio_capture_output_get_name,
+		.create = audio_capture_output_create,
+		.destroy = audio_capture_destroy,
+		.update = audio_capture_update,
+		.get_defaults = audio_capture_get_defaults,
+		.get_properties = audio_capture_output_get_properties,
+		.icon_type = OBS_ICON_TYPE_AUDIO_OUTPUT,
+	};
+	obs_register_source(&audio_capture_output_info);
+}
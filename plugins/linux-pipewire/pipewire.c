@@ -23,6 +23,10 @@
 #include "formats.h"
 
 #include <util/darray.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <util/spsc-ring.h>
+#include <util/threading.h>
 
 #include <gio/gio.h>
 #include <gio/gunixfdlist.h>
@@ -65,6 +69,11 @@ struct spa_meta_videotransform {
 #define CURSOR_META_SIZE(width, height) \
 	(sizeof(struct spa_meta_cursor) + sizeof(struct spa_meta_bitmap) + width * height * 4)
 
+/* room for far more buffer pointers than a stream negotiates */
+#define IMPORTED_RING_SIZE 1024
+
+static const char *import_buffer_name = "obs_pipewire_import_buffer";
+
 struct obs_pw_version {
 	int major;
 	int minor;
@@ -147,6 +156,21 @@ struct _obs_pipewire_stream {
 		bool release_point_will_signal;
 		bool set;
 	} sync;
+
+	/* The pipewire thread only publishes the latest buffer here, it is
+	 * imported on the graphics thread and handed back through the
+	 * imported ring, so the pipewire thread never takes the graphics
+	 * lock. */
+	void *volatile pending;
+	void *volatile importing;
+	struct spsc_ring imported;
+	struct spa_source *release;
+
+	struct {
+		volatile bool failed;
+		uint32_t spa_format;
+		uint64_t modifier;
+	} bad_modifier;
 };
 
 /* auxiliary methods */
@@ -708,34 +732,16 @@ done:
 	pw_stream_queue_buffer(obs_pw_stream->stream, b);
 }
 
-static void process_video_sync(obs_pipewire_stream *obs_pw_stream)
+/* graphics thread */
+static void import_buffer(obs_pipewire_stream *obs_pw_stream, struct pw_buffer *b)
 {
-	obs_pipewire *obs_pw = obs_pw_stream->obs_pw;
 	struct spa_meta_cursor *cursor;
-	struct spa_meta_header *header;
 	struct spa_meta_region *region;
 	struct spa_meta_videotransform *video_transform;
 	struct obs_pw_video_format obs_pw_video_format;
-	struct spa_buffer *buffer;
-	struct pw_buffer *b;
+	struct spa_buffer *buffer = b->buffer;
 	bool has_buffer = true;
 
-	b = find_latest_buffer(obs_pw_stream->stream);
-	if (!b) {
-		blog(LOG_DEBUG, "[pipewire] Out of buffers!");
-		return;
-	}
-
-	buffer = b->buffer;
-	header = spa_buffer_find_meta_data(buffer, SPA_META_Header, sizeof(*header));
-	if (header && (header->flags & SPA_META_HEADER_FLAG_CORRUPTED) > 0) {
-		blog(LOG_ERROR, "[pipewire] buffer is corrupt");
-		return_unused_pw_buffer(obs_pw_stream->stream, b);
-		return;
-	}
-
-	obs_enter_graphics();
-
 	// Workaround for kwin behaviour pre 5.27.5
 	// Workaround for mutter behaviour pre GNOME 43
 	// Only check this if !SPA_META_Header, once supported platforms update.
@@ -824,9 +830,10 @@ static void process_video_sync(obs_pipewire_stream *obs_pw_stream)
 								       use_modifiers ? modifiers : NULL);
 
 		if (obs_pw_stream->texture == NULL) {
-			remove_modifier_from_format(obs_pw_stream, obs_pw_stream->format.info.raw.format,
-						    obs_pw_stream->format.info.raw.modifier);
-			pw_loop_signal_event(pw_thread_loop_get_loop(obs_pw->thread_loop), obs_pw_stream->reneg);
+			/* the modifier is dropped on the pipewire thread */
+			obs_pw_stream->bad_modifier.spa_format = obs_pw_stream->format.info.raw.format;
+			obs_pw_stream->bad_modifier.modifier = obs_pw_stream->format.info.raw.modifier;
+			os_atomic_set_bool(&obs_pw_stream->bad_modifier.failed, true);
 			goto read_metadata;
 		}
 	} else {
@@ -920,10 +927,109 @@ read_metadata:
 		obs_pw_stream->cursor.x = cursor->position.x;
 		obs_pw_stream->cursor.y = cursor->position.y;
 	}
+}
 
-	pw_stream_queue_buffer(obs_pw_stream->stream, b);
+#define IMPORT_BUSY ((void *)1)
 
-	obs_leave_graphics();
+/* pipewire thread: queues the buffers the graphics thread is done with, except
+ * for one that is being removed */
+static void queue_imported_buffers(obs_pipewire_stream *obs_pw_stream, struct pw_buffer *removed)
+{
+	const void *ptr;
+	size_t size;
+
+	while ((ptr = spsc_ring_read_begin(&obs_pw_stream->imported, &size)) != NULL) {
+		struct pw_buffer *b;
+		memcpy(&b, ptr, sizeof(b));
+		spsc_ring_read_end(&obs_pw_stream->imported);
+
+		if (b != removed)
+			pw_stream_queue_buffer(obs_pw_stream->stream, b);
+	}
+}
+
+static void on_buffers_released(void *data, uint64_t expirations)
+{
+	UNUSED_PARAMETER(expirations);
+	obs_pipewire_stream *obs_pw_stream = data;
+	obs_pipewire *obs_pw = obs_pw_stream->obs_pw;
+
+	queue_imported_buffers(obs_pw_stream, NULL);
+
+	if (os_atomic_exchange_bool(&obs_pw_stream->bad_modifier.failed, false)) {
+		remove_modifier_from_format(obs_pw_stream, obs_pw_stream->bad_modifier.spa_format,
+					    obs_pw_stream->bad_modifier.modifier);
+		pw_loop_signal_event(pw_thread_loop_get_loop(obs_pw->thread_loop), obs_pw_stream->reneg);
+	}
+}
+
+/* pipewire thread: takes back the published buffer, and waits for the graphics
+ * thread to finish importing, before buffers or the format change */
+static void reclaim_buffers(obs_pipewire_stream *obs_pw_stream, struct pw_buffer *removed)
+{
+	struct pw_buffer *b = os_atomic_exchange_ptr(&obs_pw_stream->pending, NULL);
+	if (b && b != removed)
+		return_unused_pw_buffer(obs_pw_stream->stream, b);
+
+	while (os_atomic_load_ptr(&obs_pw_stream->importing) != NULL)
+		os_sleep_ms(1);
+
+	queue_imported_buffers(obs_pw_stream, removed);
+}
+
+static void process_video_sync(obs_pipewire_stream *obs_pw_stream)
+{
+	struct spa_meta_header *header;
+	struct pw_buffer *b;
+
+	b = find_latest_buffer(obs_pw_stream->stream);
+	if (!b) {
+		blog(LOG_DEBUG, "[pipewire] Out of buffers!");
+		return;
+	}
+
+	header = spa_buffer_find_meta_data(b->buffer, SPA_META_Header, sizeof(*header));
+	if (header && (header->flags & SPA_META_HEADER_FLAG_CORRUPTED) > 0) {
+		blog(LOG_ERROR, "[pipewire] buffer is corrupt");
+		return_unused_pw_buffer(obs_pw_stream->stream, b);
+		return;
+	}
+
+	/* a buffer the graphics thread did not get to is stale by now, give it
+	 * back to the compositor right away */
+	b = os_atomic_exchange_ptr(&obs_pw_stream->pending, b);
+	if (b)
+		return_unused_pw_buffer(obs_pw_stream->stream, b);
+
+	queue_imported_buffers(obs_pw_stream, NULL);
+}
+
+/* graphics thread */
+static void import_pending_buffer(obs_pipewire_stream *obs_pw_stream)
+{
+	obs_pipewire *obs_pw = obs_pw_stream->obs_pw;
+	struct pw_buffer *b;
+
+	os_atomic_exchange_ptr(&obs_pw_stream->importing, IMPORT_BUSY);
+	b = os_atomic_exchange_ptr(&obs_pw_stream->pending, NULL);
+
+	if (b) {
+		os_atomic_exchange_ptr(&obs_pw_stream->importing, b);
+
+		profile_start(import_buffer_name);
+		import_buffer(obs_pw_stream, b);
+		profile_end(import_buffer_name);
+
+		void *ptr = spsc_ring_write_begin(&obs_pw_stream->imported, sizeof(b));
+		if (ptr) {
+			memcpy(ptr, &b, sizeof(b));
+			spsc_ring_write_end(&obs_pw_stream->imported);
+		}
+
+		pw_loop_signal_event(pw_thread_loop_get_loop(obs_pw->thread_loop), obs_pw_stream->release);
+	}
+
+	os_atomic_exchange_ptr(&obs_pw_stream->importing, NULL);
 }
 
 static void on_process_cb(void *user_data)
@@ -960,6 +1066,8 @@ static void on_param_changed_cb(void *user_data, uint32_t id, const struct spa_p
 	if (!param || id != SPA_PARAM_Format)
 		return;
 
+	reclaim_buffers(obs_pw_stream, NULL);
+
 	result = spa_format_parse(param, &obs_pw_stream->format.media_type, &obs_pw_stream->format.media_subtype);
 	if (result < 0)
 		return;
@@ -1073,10 +1181,18 @@ static void on_state_changed_cb(void *user_data, enum pw_stream_state old, enum
 	     pw_stream_state_as_string(state), error ? error : "none");
 }
 
+static void on_remove_buffer_cb(void *user_data, struct pw_buffer *buffer)
+{
+	obs_pipewire_stream *obs_pw_stream = user_data;
+
+	reclaim_buffers(obs_pw_stream, buffer);
+}
+
 static const struct pw_stream_events stream_events = {
 	PW_VERSION_STREAM_EVENTS,
 	.state_changed = on_state_changed_cb,
 	.param_changed = on_param_changed_cb,
+	.remove_buffer = on_remove_buffer_cb,
 	.process = on_process_cb,
 };
 
@@ -1132,7 +1248,11 @@ obs_pipewire *obs_pipewire_connect_fd(int pipewire_fd, const struct pw_registry_
 	pw_thread_loop_lock(obs_pw->thread_loop);
 
 	/* Core */
-	obs_pw->core = pw_context_connect_fd(obs_pw->context, fcntl(obs_pw->pipewire_fd, F_DUPFD_CLOEXEC, 5), NULL, 0);
+	if (obs_pw->pipewire_fd >= 0)
+		obs_pw->core =
+			pw_context_connect_fd(obs_pw->context, fcntl(obs_pw->pipewire_fd, F_DUPFD_CLOEXEC, 5), NULL, 0);
+	else
+		obs_pw->core = pw_context_connect(obs_pw->context, NULL, 0);
 	if (!obs_pw->core) {
 		blog(LOG_WARNING, "Error creating PipeWire core: %m");
 		pw_thread_loop_unlock(obs_pw->thread_loop);
@@ -1160,11 +1280,26 @@ obs_pipewire *obs_pipewire_connect_fd(int pipewire_fd, const struct pw_registry_
 	return obs_pw;
 }
 
+obs_pipewire *obs_pipewire_connect(const struct pw_registry_events *registry_events, void *user_data)
+{
+	return obs_pipewire_connect_fd(-1, registry_events, user_data);
+}
+
 struct pw_registry *obs_pipewire_get_registry(obs_pipewire *obs_pw)
 {
 	return obs_pw->registry;
 }
 
+struct pw_core *obs_pipewire_get_core(obs_pipewire *obs_pw)
+{
+	return obs_pw->core;
+}
+
+struct pw_thread_loop *obs_pipewire_get_thread_loop(obs_pipewire *obs_pw)
+{
+	return obs_pw->thread_loop;
+}
+
 void obs_pipewire_roundtrip(obs_pipewire *obs_pw)
 {
 	pw_thread_loop_lock(obs_pw->thread_loop);
@@ -1224,6 +1359,10 @@ obs_pipewire_stream *obs_pipewire_connect_stream(obs_pipewire *obs_pw, obs_sourc
 		pw_loop_add_event(pw_thread_loop_get_loop(obs_pw->thread_loop), renegotiate_format, obs_pw_stream);
 	blog(LOG_DEBUG, "[pipewire] registered event %p", obs_pw_stream->reneg);
 
+	spsc_ring_init(&obs_pw_stream->imported, IMPORTED_RING_SIZE);
+	obs_pw_stream->release =
+		pw_loop_add_event(pw_thread_loop_get_loop(obs_pw->thread_loop), on_buffers_released, obs_pw_stream);
+
 	/* Stream */
 	obs_pw_stream->stream = pw_stream_new(obs_pw->core, connect_info->stream_name, connect_info->stream_properties);
 	pw_stream_add_listener(obs_pw_stream->stream, &obs_pw_stream->stream_listener, &stream_events, obs_pw_stream);
@@ -1328,6 +1467,8 @@ void obs_pipewire_stream_video_render(obs_pipewire_stream *obs_pw_stream, gs_eff
 
 	gs_eparam_t *image;
 
+	import_pending_buffer(obs_pw_stream);
+
 	if (!obs_pw_stream->texture)
 		return;
 
@@ -1416,11 +1557,18 @@ void obs_pipewire_stream_destroy(obs_pipewire_stream *obs_pw_stream)
 	obs_leave_graphics();
 
 	pw_thread_loop_lock(obs_pw_stream->obs_pw->thread_loop);
-	if (obs_pw_stream->stream)
+	if (obs_pw_stream->stream) {
+		reclaim_buffers(obs_pw_stream, NULL);
 		pw_stream_disconnect(obs_pw_stream->stream);
+	}
 	g_clear_pointer(&obs_pw_stream->stream, pw_stream_destroy);
+	if (obs_pw_stream->release)
+		pw_loop_destroy_source(pw_thread_loop_get_loop(obs_pw_stream->obs_pw->thread_loop),
+				       obs_pw_stream->release);
 	pw_thread_loop_unlock(obs_pw_stream->obs_pw->thread_loop);
 
+	spsc_ring_free(&obs_pw_stream->imported);
+
 	g_clear_fd(&obs_pw_stream->sync.acquire_syncobj_fd, NULL);
 	g_clear_fd(&obs_pw_stream->sync.release_syncobj_fd, NULL);
 
@@ -16,6 +16,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <obs-module.h>
+#include <util/bmem.h>
+#include <util/platform.h>
 #include <linux/videodev2.h>
 #include <libavutil/error.h>
 
@@ -130,3 +132,154 @@ int v4l2_decode_frame(struct obs_source_frame *out, uint8_t *data, size_t length
 
 	return 0;
 }
+
+static void *v4l2_decode_worker_thread(void *vptr)
+{
+	struct v4l2_decode_worker *worker = vptr;
+	struct v4l2_decode_pool *pool = worker->pool;
+	struct obs_source_frame out;
+
+	os_set_thread_name("v4l2: decode");
+
+	while (os_sem_wait(worker->sem) == 0) {
+		if (os_atomic_load_bool(&pool->stop))
+			break;
+
+		out = pool->frame;
+		out.timestamp = worker->timestamp;
+
+		bool success = v4l2_decode_frame(&out, worker->data, worker->size, &worker->decoder) == 0 &&
+			       out.data[0] != NULL;
+
+		/* hand frames to obs in the order they were captured */
+		pthread_mutex_lock(&pool->mutex);
+		while (pool->output_seq != worker->seq && !os_atomic_load_bool(&pool->stop))
+			pthread_cond_wait(&pool->cond, &pool->mutex);
+
+		if (success && !os_atomic_load_bool(&pool->stop))
+			obs_source_output_video(pool->source, &out);
+
+		pool->output_seq++;
+		pthread_cond_broadcast(&pool->cond);
+		pthread_mutex_unlock(&pool->mutex);
+
+		long latency = (long)(os_gettime_ns() - worker->submit_ns);
+		long avg = os_atomic_load_long(&pool->latency_ns);
+		os_atomic_set_long(&pool->latency_ns, avg ? avg + (latency - avg) / 16 : latency);
+		if (latency > os_atomic_load_long(&pool->max_latency_ns))
+			os_atomic_set_long(&pool->max_latency_ns, latency);
+
+		if (!success)
+			blog(LOG_ERROR, "failed to unpack jpeg");
+
+		os_atomic_set_bool(&worker->busy, false);
+	}
+
+	return NULL;
+}
+
+int v4l2_init_decode_pool(struct v4l2_decode_pool *pool, obs_source_t *source, const struct obs_source_frame *frame,
+			  int pixfmt, size_t num_workers)
+{
+	memset(pool, 0, sizeof(*pool));
+
+	if (!num_workers) {
+		int cores = os_get_logical_cores();
+		num_workers = cores > 8 ? 4 : (cores > 2 ? (size_t)cores / 2 : 1);
+	}
+
+	pool->source = source;
+	pool->frame = *frame;
+	pool->workers = bzalloc(sizeof(struct v4l2_decode_worker) * num_workers);
+	pool->num_workers = num_workers;
+
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0)
+		return -1;
+	if (pthread_cond_init(&pool->cond, NULL) != 0)
+		return -1;
+
+	for (size_t i = 0; i < num_workers; i++) {
+		struct v4l2_decode_worker *worker = &pool->workers[i];
+		worker->pool = pool;
+
+		if (v4l2_init_decoder(&worker->decoder, pixfmt) < 0)
+			return -1;
+		if (os_sem_init(&worker->sem, 0) != 0)
+			return -1;
+		if (pthread_create(&worker->thread, NULL, v4l2_decode_worker_thread, worker) != 0)
+			return -1;
+	}
+
+	blog(LOG_INFO, "started %zu decoder threads", num_workers);
+
+	return 0;
+}
+
+void v4l2_destroy_decode_pool(struct v4l2_decode_pool *pool)
+{
+	if (!pool->workers)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	os_atomic_set_bool(&pool->stop, true);
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (size_t i = 0; i < pool->num_workers; i++) {
+		struct v4l2_decode_worker *worker = &pool->workers[i];
+
+		if (worker->thread) {
+			os_sem_post(worker->sem);
+			pthread_join(worker->thread, NULL);
+		}
+
+		os_sem_destroy(worker->sem);
+		v4l2_destroy_decoder(&worker->decoder);
+		bfree(worker->data);
+	}
+
+	blog(LOG_INFO, "decode latency: %.2f ms average, %.2f ms max",
+	     (double)os_atomic_load_long(&pool->latency_ns) / 1000000.0,
+	     (double)os_atomic_load_long(&pool->max_latency_ns) / 1000000.0);
+
+	long dropped = os_atomic_load_long(&pool->dropped);
+	if (dropped)
+		blog(LOG_INFO, "%ld frames dropped because all decoder threads were busy", dropped);
+
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->mutex);
+	bfree(pool->workers);
+	pool->workers = NULL;
+}
+
+bool v4l2_decode_pool_submit(struct v4l2_decode_pool *pool, const uint8_t *data, size_t length, uint64_t timestamp)
+{
+	struct v4l2_decode_worker *worker = NULL;
+
+	for (size_t i = 0; i < pool->num_workers; i++) {
+		if (!os_atomic_load_bool(&pool->workers[i].busy)) {
+			worker = &pool->workers[i];
+			break;
+		}
+	}
+
+	if (!worker) {
+		os_atomic_inc_long(&pool->dropped);
+		return false;
+	}
+
+	if (worker->capacity < length) {
+		worker->data = brealloc(worker->data, length);
+		worker->capacity = length;
+	}
+
+	memcpy(worker->data, data, length);
+	worker->size = length;
+	worker->timestamp = timestamp;
+	worker->submit_ns = os_gettime_ns();
+	worker->seq = pool->submit_seq++;
+
+	os_atomic_set_bool(&worker->busy, true);
+	os_sem_post(worker->sem);
+	return true;
+}
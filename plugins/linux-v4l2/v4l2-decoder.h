@@ -25,6 +25,8 @@ extern "C" {
 #include <libavformat/avformat.h>
 #include <libavutil/pixfmt.h>
 
+#include <util/threading.h>
+
 /**
  * Data structure for decoder
  */
@@ -35,6 +37,51 @@ struct v4l2_decoder {
 	AVFrame *frame;
 };
 
+struct v4l2_decode_pool;
+
+/**
+ * Data structure for a decode worker of the pool
+ */
+struct v4l2_decode_worker {
+	struct v4l2_decode_pool *pool;
+	struct v4l2_decoder decoder;
+	pthread_t thread;
+	os_sem_t *sem;
+	volatile bool busy;
+
+	/* copy of the compressed frame, owned by the worker while busy */
+	uint8_t *data;
+	size_t size;
+	size_t capacity;
+	uint64_t timestamp;
+	uint64_t submit_ns;
+	uint64_t seq;
+};
+
+/**
+ * Data structure for a pool of decoders working on consecutive frames
+ *
+ * Frames are decoded in parallel and handed to obs in capture order.
+ * Only intra-only codecs (mjpeg) can be decoded this way.
+ */
+struct v4l2_decode_pool {
+	obs_source_t *source;
+	struct obs_source_frame frame;
+	struct v4l2_decode_worker *workers;
+	size_t num_workers;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	uint64_t submit_seq;
+	uint64_t output_seq;
+	volatile bool stop;
+
+	/* time from dequeuing a buffer to handing the frame to obs */
+	volatile long latency_ns;
+	volatile long max_latency_ns;
+	volatile long dropped;
+};
+
 /**
  * Initialize the decoder.
  * The decoder must be destroyed on failure.
@@ -63,6 +110,39 @@ void v4l2_destroy_decoder(struct v4l2_decoder *decoder);
  */
 int v4l2_decode_frame(struct obs_source_frame *out, uint8_t *data, size_t length, struct v4l2_decoder *decoder);
 
+/**
+ * Start a pool of decoder threads.
+ * The pool must be destroyed on failure.
+ *
+ * @param pool the pool structure
+ * @param source the source the decoded frames are output to
+ * @param frame prepared frame data, see v4l2_prep_obs_frame
+ * @param pixfmt which codec is used
+ * @param num_workers number of decoder threads, 0 for automatic
+ * @return non-zero on failure
+ */
+int v4l2_init_decode_pool(struct v4l2_decode_pool *pool, obs_source_t *source, const struct obs_source_frame *frame,
+			  int pixfmt, size_t num_workers);
+
+/**
+ * Stop the decoder threads and free any data associated with the pool.
+ *
+ * @param pool the pool structure
+ */
+void v4l2_destroy_decode_pool(struct v4l2_decode_pool *pool);
+
+/**
+ * Copy a compressed frame and queue it for decoding.
+ * After this returns the capture buffer can be given back to the device.
+ *
+ * @param pool the pool structure
+ * @param data the codec data
+ * @param length length of the data
+ * @param timestamp timestamp of the frame
+ * @return false if all decoders were busy and the frame was dropped
+ */
+bool v4l2_decode_pool_submit(struct v4l2_decode_pool *pool, const uint8_t *data, size_t length, uint64_t timestamp);
+
 #ifdef __cplusplus
 }
 #endif
@@ -76,12 +76,14 @@ struct v4l2_data {
 	int64_t resolution;
 	int64_t framerate;
 	int color_range;
+	int decode_threads;
 
 	/* internal data */
 	obs_source_t *source;
 	pthread_t thread;
 	os_event_t *event;
 	struct v4l2_decoder decoder;
+	struct v4l2_decode_pool decode_pool;
 
 	bool framerate_unchanged;
 	bool resolution_unchanged;
@@ -258,9 +260,14 @@ static void *v4l2_thread(void *vptr)
 
 		start = (uint8_t *)data->buffers.info[buf.index].start;
 
-		if (data->pixfmt == V4L2_PIX_FMT_MJPEG || data->pixfmt == V4L2_PIX_FMT_H264) {
+		if (data->pixfmt == V4L2_PIX_FMT_MJPEG) {
+			/* the pool copies the frame, so the buffer is requeued
+			 * right away instead of after decoding */
+			v4l2_decode_pool_submit(&data->decode_pool, start, buf.bytesused, out.timestamp);
+			goto continue_queue_buffer;
+		} else if (data->pixfmt == V4L2_PIX_FMT_H264) {
 			if (v4l2_decode_frame(&out, start, buf.bytesused, &data->decoder) < 0) {
-				blog(LOG_ERROR, "failed to unpack jpeg or h264");
+				blog(LOG_ERROR, "failed to unpack h264");
 				break;
 			}
 		} else {
@@ -303,6 +310,7 @@ static void v4l2_defaults(obs_data_t *settings)
 	obs_data_set_default_bool(settings, "buffering", true);
 	obs_data_set_default_bool(settings, "auto_reset", false);
 	obs_data_set_default_int(settings, "timeout_frames", 5);
+	obs_data_set_default_int(settings, "decode_threads", 0);
 }
 
 /**
@@ -813,6 +821,10 @@ static obs_properties_t *v4l2_properties(void *vptr)
 
 	obs_properties_add_int(props, "timeout_frames", obs_module_text("FramesUntilTimeout"), 2, 120, 1);
 
+	obs_property_t *decode_threads = obs_properties_add_int(props, "decode_threads",
+								obs_module_text("DecodeThreads"), 0, 8, 1);
+	obs_property_set_long_description(decode_threads, obs_module_text("DecodeThreads.Description"));
+
 	// a group to contain the camera control
 	obs_properties_t *ctrl_props = obs_properties_create();
 	obs_properties_add_group(props, "controls", obs_module_text("CameraCtrls"), OBS_GROUP_NORMAL, ctrl_props);
@@ -838,7 +850,9 @@ static void v4l2_terminate(struct v4l2_data *data)
 		data->thread = 0;
 	}
 
-	if (data->pixfmt == V4L2_PIX_FMT_MJPEG || data->pixfmt == V4L2_PIX_FMT_H264) {
+	if (data->pixfmt == V4L2_PIX_FMT_MJPEG) {
+		v4l2_destroy_decode_pool(&data->decode_pool);
+	} else if (data->pixfmt == V4L2_PIX_FMT_H264) {
 		v4l2_destroy_decoder(&data->decoder);
 	}
 	v4l2_destroy_mmap(&data->buffers);
@@ -958,7 +972,17 @@ static void v4l2_init(struct v4l2_data *data)
 		goto fail;
 	}
 
-	if (data->pixfmt == V4L2_PIX_FMT_MJPEG || data->pixfmt == V4L2_PIX_FMT_H264) {
+	if (data->pixfmt == V4L2_PIX_FMT_MJPEG) {
+		struct obs_source_frame frame;
+		size_t plane_offsets[MAX_AV_PLANES];
+
+		v4l2_prep_obs_frame(data, &frame, plane_offsets);
+		if (v4l2_init_decode_pool(&data->decode_pool, data->source, &frame, data->pixfmt,
+					  data->decode_threads) < 0) {
+			blog(LOG_ERROR, "Failed to initialize decoder");
+			goto fail;
+		}
+	} else if (data->pixfmt == V4L2_PIX_FMT_H264) {
 		if (v4l2_init_decoder(&data->decoder, data->pixfmt) < 0) {
 			blog(LOG_ERROR, "Failed to initialize decoder");
 			goto fail;
@@ -1020,6 +1044,7 @@ static bool v4l2_settings_changed(struct v4l2_data *data, obs_data_t *settings)
 		}
 
 		res |= data->color_range != obs_data_get_int(settings, "color_range");
+		res |= data->decode_threads != obs_data_get_int(settings, "decode_threads");
 	} else {
 		res = true;
 	}
@@ -1057,6 +1082,7 @@ static void v4l2_update(void *vptr, obs_data_t *settings)
 	data->color_range = obs_data_get_int(settings, "color_range");
 	data->auto_reset = obs_data_get_bool(settings, "auto_reset");
 	data->timeout_frames = obs_data_get_int(settings, "timeout_frames");
+	data->decode_threads = obs_data_get_int(settings, "decode_threads");
 
 	v4l2_update_source_flags(data, settings);
 
@@ -1064,6 +1090,18 @@ static void v4l2_update(void *vptr, obs_data_t *settings)
 		v4l2_init(data);
 }
 
+/**
+ * Report the time from dequeuing a buffer until the decoded frame is handed
+ * to obs, only available for mjpeg.
+ */
+static void v4l2_get_decode_latency(void *vptr, calldata_t *cd)
+{
+	V4L2_DATA(vptr);
+
+	calldata_set_int(cd, "latency_ns", os_atomic_load_long(&data->decode_pool.latency_ns));
+	calldata_set_int(cd, "max_latency_ns", os_atomic_load_long(&data->decode_pool.max_latency_ns));
+}
+
 static void *v4l2_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct v4l2_data *data = bzalloc(sizeof(struct v4l2_data));
@@ -1080,6 +1118,10 @@ static void *v4l2_create(obs_data_t *settings, obs_source_t *source)
 	blog(LOG_WARNING, "Plugin built without dv-timing support!");
 #endif
 
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	proc_handler_add(ph, "void get_decode_latency(out int latency_ns, out int max_latency_ns)",
+			 v4l2_get_decode_latency, data);
+
 	v4l2_update(data, settings);
 
 #if HAVE_UDEV
@@ -290,6 +290,7 @@ static void media_stopped(void *opaque)
 static void ffmpeg_source_open(struct ffmpeg_source *s)
 {
 	if (s->input && *s->input) {
+		char *index_dir = obs_module_config_path("media-index");
 		struct mp_media_info info = {
 			.opaque = s,
 			.v_cb = get_frame,
@@ -299,6 +300,7 @@ static void ffmpeg_source_open(struct ffmpeg_source *s)
 			.stop_cb = media_stopped,
 			.path = s->input,
 			.format = s->input_format,
+			.index_dir = index_dir,
 			.buffering = s->buffering_mb * 1024 * 1024,
 			.speed = s->speed_percent,
 			.force_range = s->range,
@@ -312,6 +314,7 @@ static void ffmpeg_source_open(struct ffmpeg_source *s)
 		};
 
 		s->media = media_playback_create(&info);
+		bfree(index_dir);
 	}
 }
 
@@ -544,6 +547,13 @@ static void get_nb_frames(void *data, calldata_t *cd)
 	calldata_set_int(cd, "num_frames", frames);
 }
 
+static void get_cache_size(void *data, calldata_t *cd)
+{
+	struct ffmpeg_source *s = data;
+	size_t size = media_playback_get_cache_size(s->media);
+	calldata_set_int(cd, "cache_size", (long long)size);
+}
+
 static bool ffmpeg_source_play_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed)
 {
 	UNUSED_PARAMETER(id);
@@ -627,6 +637,7 @@ static void *ffmpeg_source_create(obs_data_t *settings, obs_source_t *source)
 	proc_handler_add(ph, "void preload_first_frame()", preload_first_frame_proc, s);
 	proc_handler_add(ph, "void get_duration(out int duration)", get_duration, s);
 	proc_handler_add(ph, "void get_nb_frames(out int num_frames)", get_nb_frames, s);
+	proc_handler_add(ph, "void get_cache_size(out int cache_size)", get_cache_size, s);
 
 	ffmpeg_source_update(s, settings);
 	return s;
@@ -3,14 +3,46 @@
 #include <util/util_uint64.h>
 
 #define S_DELAY_MS "delay_ms"
+#define S_STORAGE "storage"
+
 #define T_DELAY_MS obs_module_text("DelayMs")
+#define T_STORAGE obs_module_text("GPUDelay.Storage")
+#define T_STORAGE_DESC obs_module_text("GPUDelay.Storage.Description")
+#define T_STORAGE_RGBA obs_module_text("GPUDelay.Storage.RGBA")
+#define T_STORAGE_PACKED obs_module_text("GPUDelay.Storage.Packed")
+#define T_STORAGE_SYSTEM obs_module_text("GPUDelay.Storage.System")
+
+enum storage_mode {
+	STORAGE_RGBA,
+	STORAGE_PACKED,
+	STORAGE_SYSTEM,
+};
+
+/* frames an async readback is given before it is mapped */
+#define NUM_STAGES 3
+
+/* packed frame (luma + alpha, half size chroma) read back to system memory */
+struct cpu_frame {
+	bool ready;
+	uint8_t *ya;
+	uint8_t *uv;
+};
 
 struct frame {
 	gs_texrender_t *render;
+	gs_texrender_t *render_ya;
+	gs_texrender_t *render_uv;
+	struct cpu_frame *cpu;
 	enum gs_color_space space;
 	uint64_t ts;
 };
 
+struct stage {
+	gs_stagesurf_t *ya;
+	gs_stagesurf_t *uv;
+	struct cpu_frame *dst;
+};
+
 struct gpu_delay_filter_data {
 	obs_source_t *context;
 	struct deque frames;
@@ -20,6 +52,22 @@ struct gpu_delay_filter_data {
 	uint32_t cy;
 	bool target_valid;
 	bool processed_frame;
+
+	enum storage_mode storage;
+	gs_effect_t *effect;
+	gs_eparam_t *param_image;
+	gs_eparam_t *param_image_uv;
+	gs_eparam_t *param_multiplier;
+
+	gs_texrender_t *scratch;
+	gs_texrender_t *pack_ya;
+	gs_texrender_t *pack_uv;
+	gs_texture_t *upload_ya;
+	gs_texture_t *upload_uv;
+	bool upload_valid;
+
+	struct stage stages[NUM_STAGES];
+	size_t cur_stage;
 };
 
 static const char *gpu_delay_filter_get_name(void *unused)
@@ -28,15 +76,88 @@ static const char *gpu_delay_filter_get_name(void *unused)
 	return obs_module_text("GPUDelayFilter");
 }
 
+static inline uint32_t uv_width(struct gpu_delay_filter_data *f)
+{
+	return (f->cx + 1) / 2;
+}
+
+static inline uint32_t uv_height(struct gpu_delay_filter_data *f)
+{
+	return (f->cy + 1) / 2;
+}
+
+static struct cpu_frame *cpu_frame_create(struct gpu_delay_filter_data *f)
+{
+	size_t ya_size = (size_t)f->cx * f->cy * 2;
+	size_t uv_size = (size_t)uv_width(f) * uv_height(f) * 2;
+	struct cpu_frame *cpu = bmalloc(sizeof(*cpu) + ya_size + uv_size);
+
+	cpu->ready = false;
+	cpu->ya = (uint8_t *)(cpu + 1);
+	cpu->uv = cpu->ya + ya_size;
+	return cpu;
+}
+
+static void free_cpu_frame(struct gpu_delay_filter_data *f, struct frame *frame)
+{
+	if (!frame->cpu)
+		return;
+
+	/* drop any readback still targeting this frame */
+	for (size_t i = 0; i < NUM_STAGES; i++) {
+		if (f->stages[i].dst == frame->cpu)
+			f->stages[i].dst = NULL;
+	}
+
+	bfree(frame->cpu);
+	frame->cpu = NULL;
+}
+
+static void free_packed(struct gpu_delay_filter_data *f, struct frame *frame)
+{
+	gs_texrender_destroy(frame->render_ya);
+	gs_texrender_destroy(frame->render_uv);
+	frame->render_ya = NULL;
+	frame->render_uv = NULL;
+	free_cpu_frame(f, frame);
+}
+
+static void free_frame(struct gpu_delay_filter_data *f, struct frame *frame)
+{
+	gs_texrender_destroy(frame->render);
+	free_packed(f, frame);
+}
+
 static void free_textures(struct gpu_delay_filter_data *f)
 {
 	obs_enter_graphics();
 	while (f->frames.size) {
 		struct frame frame;
 		deque_pop_front(&f->frames, &frame, sizeof(frame));
-		gs_texrender_destroy(frame.render);
+		free_frame(f, &frame);
 	}
 	deque_free(&f->frames);
+
+	gs_texrender_destroy(f->scratch);
+	gs_texrender_destroy(f->pack_ya);
+	gs_texrender_destroy(f->pack_uv);
+	gs_texture_destroy(f->upload_ya);
+	gs_texture_destroy(f->upload_uv);
+	f->scratch = NULL;
+	f->pack_ya = NULL;
+	f->pack_uv = NULL;
+	f->upload_ya = NULL;
+	f->upload_uv = NULL;
+	f->upload_valid = false;
+
+	for (size_t i = 0; i < NUM_STAGES; i++) {
+		gs_stagesurface_destroy(f->stages[i].ya);
+		gs_stagesurface_destroy(f->stages[i].uv);
+		f->stages[i].ya = NULL;
+		f->stages[i].uv = NULL;
+		f->stages[i].dst = NULL;
+	}
+	f->cur_stage = 0;
 	obs_leave_graphics();
 }
 
@@ -55,27 +176,17 @@ static void update_interval(struct gpu_delay_filter_data *f, uint64_t new_interv
 	f->interval_ns = new_interval_ns;
 	size_t num = (size_t)(f->delay_ns / new_interval_ns);
 
+	/* new frames are zeroed and get their storage on first render */
 	if (num > num_frames(&f->frames)) {
-		size_t prev_num = num_frames(&f->frames);
-
-		obs_enter_graphics();
-
 		deque_upsize(&f->frames, num * sizeof(struct frame));
 
-		for (size_t i = prev_num; i < num; i++) {
-			struct frame *frame = deque_data(&f->frames, i * sizeof(*frame));
-			frame->render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
-		}
-
-		obs_leave_graphics();
-
 	} else if (num < num_frames(&f->frames)) {
 		obs_enter_graphics();
 
 		while (num_frames(&f->frames) > num) {
 			struct frame frame;
 			deque_pop_front(&f->frames, &frame, sizeof(frame));
-			gs_texrender_destroy(frame.render);
+			free_frame(f, &frame);
 		}
 
 		obs_leave_graphics();
@@ -134,6 +245,9 @@ static void gpu_delay_filter_update(void *data, obs_data_t *s)
 	struct gpu_delay_filter_data *f = data;
 
 	f->delay_ns = (uint64_t)obs_data_get_int(s, S_DELAY_MS) * 1000000ULL;
+	f->storage = (enum storage_mode)obs_data_get_int(s, S_STORAGE);
+	if (!f->effect)
+		f->storage = STORAGE_RGBA;
 
 	/* full reset */
 	f->cx = 0;
@@ -149,6 +263,12 @@ static obs_properties_t *gpu_delay_filter_properties(void *data)
 	obs_property_t *p = obs_properties_add_int(props, S_DELAY_MS, T_DELAY_MS, 0, 500, 1);
 	obs_property_int_set_suffix(p, " ms");
 
+	p = obs_properties_add_list(props, S_STORAGE, T_STORAGE, OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(p, T_STORAGE_RGBA, STORAGE_RGBA);
+	obs_property_list_add_int(p, T_STORAGE_PACKED, STORAGE_PACKED);
+	obs_property_list_add_int(p, T_STORAGE_SYSTEM, STORAGE_SYSTEM);
+	obs_property_set_long_description(p, T_STORAGE_DESC);
+
 	UNUSED_PARAMETER(data);
 	return props;
 }
@@ -156,8 +276,22 @@ static obs_properties_t *gpu_delay_filter_properties(void *data)
 static void *gpu_delay_filter_create(obs_data_t *settings, obs_source_t *context)
 {
 	struct gpu_delay_filter_data *f = bzalloc(sizeof(*f));
+	char *effect_path = obs_module_file("gpu_delay.effect");
+
 	f->context = context;
 
+	obs_enter_graphics();
+	f->effect = gs_effect_create_from_file(effect_path, NULL);
+	obs_leave_graphics();
+
+	bfree(effect_path);
+
+	if (f->effect) {
+		f->param_image = gs_effect_get_param_by_name(f->effect, "image");
+		f->param_image_uv = gs_effect_get_param_by_name(f->effect, "image_uv");
+		f->param_multiplier = gs_effect_get_param_by_name(f->effect, "multiplier");
+	}
+
 	obs_source_update(context, settings);
 	return f;
 }
@@ -167,6 +301,11 @@ static void gpu_delay_filter_destroy(void *data)
 	struct gpu_delay_filter_data *f = data;
 
 	free_textures(f);
+
+	obs_enter_graphics();
+	gs_effect_destroy(f->effect);
+	obs_leave_graphics();
+
 	bfree(f);
 }
 
@@ -230,11 +369,42 @@ static const char *get_tech_name_and_multiplier(enum gs_color_space current_spac
 	return tech_name;
 }
 
+static void draw_packed(struct gpu_delay_filter_data *f, gs_texture_t *ya, gs_texture_t *uv)
+{
+	float multiplier = 1.f;
+	if (gs_get_color_space() == GS_CS_709_SCRGB)
+		multiplier = obs_get_video_sdr_white_level() / 80.0f;
+
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(true);
+
+	gs_effect_set_texture(f->param_image, ya);
+	gs_effect_set_texture(f->param_image_uv, uv);
+	gs_effect_set_float(f->param_multiplier, multiplier);
+
+	while (gs_effect_loop(f->effect, "Unpack"))
+		gs_draw_sprite(NULL, 0, f->cx, f->cy);
+
+	gs_enable_framebuffer_srgb(previous);
+}
+
 static void draw_frame(struct gpu_delay_filter_data *f)
 {
 	struct frame frame;
 	deque_peek_front(&f->frames, &frame, sizeof(frame));
 
+	if (frame.render_ya) {
+		draw_packed(f, gs_texrender_get_texture(frame.render_ya), gs_texrender_get_texture(frame.render_uv));
+		return;
+	}
+	if (frame.cpu) {
+		if (f->upload_valid)
+			draw_packed(f, f->upload_ya, f->upload_uv);
+		return;
+	}
+	if (!frame.render)
+		return;
+
 	const enum gs_color_space current_space = gs_get_color_space();
 	float multiplier;
 	const char *technique = get_tech_name_and_multiplier(current_space, frame.space, &multiplier);
@@ -255,6 +425,223 @@ static void draw_frame(struct gpu_delay_filter_data *f)
 	}
 }
 
+static bool render_target(struct gpu_delay_filter_data *f, gs_texrender_t *render, enum gs_color_space space)
+{
+	obs_source_t *target = obs_filter_get_target(f->context);
+	obs_source_t *parent = obs_filter_get_parent(f->context);
+	bool success = false;
+
+	gs_texrender_reset(render);
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	if (gs_texrender_begin_with_color_space(render, f->cx, f->cy, space)) {
+		uint32_t parent_flags = obs_source_get_output_flags(target);
+		bool custom_draw = (parent_flags & OBS_SOURCE_CUSTOM_DRAW) != 0;
+		bool async = (parent_flags & OBS_SOURCE_ASYNC) != 0;
+		struct vec4 clear_color;
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)f->cx, 0.0f, (float)f->cy, -100.0f, 100.0f);
+
+		if (target == parent && !custom_draw && !async)
+			obs_source_default_render(target);
+		else
+			obs_source_video_render(target);
+
+		gs_texrender_end(render);
+		success = true;
+	}
+
+	gs_blend_state_pop();
+	return success;
+}
+
+static void pack_plane(struct gpu_delay_filter_data *f, gs_texrender_t *dst, const char *technique, uint32_t cx,
+		       uint32_t cy)
+{
+	gs_texrender_reset(dst);
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	if (gs_texrender_begin(dst, cx, cy)) {
+		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+		gs_effect_set_texture(f->param_image, gs_texrender_get_texture(f->scratch));
+
+		while (gs_effect_loop(f->effect, technique))
+			gs_draw_sprite(NULL, 0, cx, cy);
+
+		gs_texrender_end(dst);
+	}
+
+	gs_blend_state_pop();
+}
+
+static void pack_frame(struct gpu_delay_filter_data *f, gs_texrender_t *ya, gs_texrender_t *uv)
+{
+	pack_plane(f, ya, "PackYA", f->cx, f->cy);
+	pack_plane(f, uv, "PackUV", uv_width(f), uv_height(f));
+}
+
+static void copy_plane(uint8_t *dst, uint32_t dst_linesize, const uint8_t *src, uint32_t src_linesize,
+		       uint32_t height)
+{
+	if (dst_linesize == src_linesize) {
+		memcpy(dst, src, (size_t)dst_linesize * height);
+		return;
+	}
+
+	for (uint32_t y = 0; y < height; y++)
+		memcpy(dst + (size_t)y * dst_linesize, src + (size_t)y * src_linesize, dst_linesize);
+}
+
+/* the readback was queued NUM_STAGES frames ago, so mapping won't stall */
+static void read_stage(struct gpu_delay_filter_data *f, struct stage *stage)
+{
+	struct cpu_frame *dst = stage->dst;
+	uint8_t *data;
+	uint32_t linesize;
+
+	if (!dst)
+		return;
+
+	stage->dst = NULL;
+
+	if (!gs_stagesurface_map(stage->ya, &data, &linesize))
+		return;
+	copy_plane(dst->ya, f->cx * 2, data, linesize, f->cy);
+	gs_stagesurface_unmap(stage->ya);
+
+	if (!gs_stagesurface_map(stage->uv, &data, &linesize))
+		return;
+	copy_plane(dst->uv, uv_width(f) * 2, data, linesize, uv_height(f));
+	gs_stagesurface_unmap(stage->uv);
+
+	dst->ready = true;
+}
+
+static void store_rgba(struct gpu_delay_filter_data *f, struct frame *frame, enum gs_color_space space)
+{
+	free_packed(f, frame);
+
+	const enum gs_color_format format = gs_get_format_from_space(space);
+	if (!frame->render || gs_texrender_get_format(frame->render) != format) {
+		gs_texrender_destroy(frame->render);
+		frame->render = gs_texrender_create(format, GS_ZS_NONE);
+	}
+
+	if (render_target(f, frame->render, space))
+		frame->space = space;
+}
+
+static void store_packed_gpu(struct gpu_delay_filter_data *f, struct frame *frame)
+{
+	free_cpu_frame(f, frame);
+
+	if (!frame->render_ya) {
+		frame->render_ya = gs_texrender_create(GS_R8G8, GS_ZS_NONE);
+		frame->render_uv = gs_texrender_create(GS_R8G8, GS_ZS_NONE);
+	}
+
+	pack_frame(f, frame->render_ya, frame->render_uv);
+}
+
+static void store_packed_cpu(struct gpu_delay_filter_data *f, struct frame *frame)
+{
+	gs_texrender_destroy(frame->render_ya);
+	gs_texrender_destroy(frame->render_uv);
+	frame->render_ya = NULL;
+	frame->render_uv = NULL;
+
+	if (!frame->cpu)
+		frame->cpu = cpu_frame_create(f);
+	frame->cpu->ready = false;
+
+	if (!f->pack_ya) {
+		f->pack_ya = gs_texrender_create(GS_R8G8, GS_ZS_NONE);
+		f->pack_uv = gs_texrender_create(GS_R8G8, GS_ZS_NONE);
+	}
+
+	pack_frame(f, f->pack_ya, f->pack_uv);
+
+	struct stage *stage = &f->stages[f->cur_stage];
+	read_stage(f, stage);
+
+	if (!stage->ya) {
+		stage->ya = gs_stagesurface_create(f->cx, f->cy, GS_R8G8);
+		stage->uv = gs_stagesurface_create(uv_width(f), uv_height(f), GS_R8G8);
+	}
+
+	gs_stage_texture(stage->ya, gs_texrender_get_texture(f->pack_ya));
+	gs_stage_texture(stage->uv, gs_texrender_get_texture(f->pack_uv));
+	stage->dst = frame->cpu;
+
+	f->cur_stage = (f->cur_stage + 1) % NUM_STAGES;
+}
+
+static void store_packed(struct gpu_delay_filter_data *f, struct frame *frame)
+{
+	gs_texrender_destroy(frame->render);
+	frame->render = NULL;
+
+	if (!f->scratch)
+		f->scratch = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+
+	if (!render_target(f, f->scratch, GS_CS_SRGB))
+		return;
+
+	frame->space = GS_CS_SRGB;
+
+	/* readbacks need a few frames in flight before they are displayed */
+	if (f->storage == STORAGE_SYSTEM && num_frames(&f->frames) >= NUM_STAGES)
+		store_packed_cpu(f, frame);
+	else
+		store_packed_gpu(f, frame);
+}
+
+/* the frame is due before its readback was collected by a later frame, so
+ * map its stage now rather than show nothing */
+static void flush_stage(struct gpu_delay_filter_data *f, struct cpu_frame *cpu)
+{
+	for (size_t i = 0; i < NUM_STAGES; i++) {
+		if (f->stages[i].dst == cpu) {
+			read_stage(f, &f->stages[i]);
+			return;
+		}
+	}
+}
+
+static void upload_front_frame(struct gpu_delay_filter_data *f)
+{
+	struct frame frame;
+	deque_peek_front(&f->frames, &frame, sizeof(frame));
+
+	if (!frame.cpu) {
+		f->upload_valid = false;
+		return;
+	}
+
+	if (!frame.cpu->ready)
+		flush_stage(f, frame.cpu);
+
+	/* if the readback failed, keep showing the last uploaded frame */
+	if (!frame.cpu->ready)
+		return;
+
+	f->upload_valid = true;
+
+	if (!f->upload_ya) {
+		f->upload_ya = gs_texture_create(f->cx, f->cy, GS_R8G8, 1, NULL, GS_DYNAMIC);
+		f->upload_uv = gs_texture_create(uv_width(f), uv_height(f), GS_R8G8, 1, NULL, GS_DYNAMIC);
+	}
+
+	gs_texture_set_image(f->upload_ya, frame.cpu->ya, f->cx * 2, false);
+	gs_texture_set_image(f->upload_uv, frame.cpu->uv, uv_width(f) * 2, false);
+}
+
 static void gpu_delay_filter_render(void *data, gs_effect_t *effect)
 {
 	struct gpu_delay_filter_data *f = data;
@@ -281,40 +668,15 @@ static void gpu_delay_filter_render(void *data, gs_effect_t *effect)
 	};
 	const enum gs_color_space space =
 		obs_source_get_color_space(target, OBS_COUNTOF(preferred_spaces), preferred_spaces);
-	const enum gs_color_format format = gs_get_format_from_space(space);
-	if (gs_texrender_get_format(frame.render) != format) {
-		gs_texrender_destroy(frame.render);
-		frame.render = gs_texrender_create(format, GS_ZS_NONE);
-	}
-
-	gs_texrender_reset(frame.render);
-
-	gs_blend_state_push();
-	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
-
-	if (gs_texrender_begin_with_color_space(frame.render, f->cx, f->cy, space)) {
-		uint32_t parent_flags = obs_source_get_output_flags(target);
-		bool custom_draw = (parent_flags & OBS_SOURCE_CUSTOM_DRAW) != 0;
-		bool async = (parent_flags & OBS_SOURCE_ASYNC) != 0;
-		struct vec4 clear_color;
-
-		vec4_zero(&clear_color);
-		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
-		gs_ortho(0.0f, (float)f->cx, 0.0f, (float)f->cy, -100.0f, 100.0f);
-
-		if (target == parent && !custom_draw && !async)
-			obs_source_default_render(target);
-		else
-			obs_source_video_render(target);
-
-		gs_texrender_end(frame.render);
 
-		frame.space = space;
-	}
-
-	gs_blend_state_pop();
+	/* packing only applies to SDR, HDR frames keep their full format */
+	if (f->storage != STORAGE_RGBA && space == GS_CS_SRGB)
+		store_packed(f, &frame);
+	else
+		store_rgba(f, &frame, space);
 
 	deque_push_back(&f->frames, &frame, sizeof(frame));
+	upload_front_frame(f);
 	draw_frame(f);
 	f->processed_frame = true;
 
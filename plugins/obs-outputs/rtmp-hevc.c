@@ -745,25 +745,20 @@ size_t obs_parse_hevc_header(uint8_t **header, const uint8_t *data, size_t size)
 	struct serializer sn;
 	array_output_serializer_init(&sn, &nals);
 
-	const uint8_t *nal_start, *nal_end;
-	start = data;
-	end = data + size;
+	struct obs_nal_index index;
+	obs_nal_index_init(&index);
+	obs_nal_index_build(&index, data, size);
 
 	size = 0; // reset size
-	nal_start = obs_nal_find_startcode(start, end);
-	for (;;) {
-		while (nal_start < end && !*(nal_start++))
-			;
-		if (nal_start == end)
-			break;
-		nal_end = obs_nal_find_startcode(nal_start, end);
-
-		assert(nal_end - nal_start <= INT_MAX);
-		s_wb32(&sn, (uint32_t)(nal_end - nal_start));
-		s_write(&sn, nal_start, nal_end - nal_start);
-		size += 4 + nal_end - nal_start;
-		nal_start = nal_end;
+	for (size_t i = 0; i < index.units.num; i++) {
+		const struct obs_nal_unit *nal = index.units.array + i;
+
+		assert(nal->size <= INT_MAX);
+		s_wb32(&sn, (uint32_t)nal->size);
+		s_write(&sn, nal->data, nal->size);
+		size += 4 + nal->size;
 	}
+	obs_nal_index_free(&index);
 	if (size == 0)
 		goto done;
 
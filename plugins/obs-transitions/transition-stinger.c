@@ -1,10 +1,15 @@
 #include <obs-module.h>
 #include <util/dstr.h>
+#include <util/darray.h>
 #include "util/platform.h"
 
 #define TIMING_TIME 0
 #define TIMING_FRAME 1
 
+/* upper bound for frames kept on the GPU by "preload_gpu" before we give up
+ * and fall back to decoding the stinger in real time */
+#define GPU_CACHE_MAX_MIB 2048ULL
+
 enum matte_layout {
 	MATTE_LAYOUT_HORIZONTAL,
 	MATTE_LAYOUT_VERTICAL,
@@ -14,6 +19,12 @@ enum matte_layout {
 
 enum fade_style { FADE_STYLE_FADE_OUT_FADE_IN, FADE_STYLE_CROSS_FADE };
 
+struct cached_frame {
+	int64_t ts_ms;
+	gs_texrender_t *texrender;
+	enum gs_color_space space;
+};
+
 struct stinger_info {
 	obs_source_t *source;
 
@@ -49,6 +60,18 @@ struct stinger_info {
 	gs_texrender_t *matte_tex;
 	gs_texrender_t *stinger_tex;
 
+	bool preload_gpu;
+	bool gpu_cache_ready;
+	bool gpu_cache_failed;
+	bool gpu_cache_warm_pending;
+	bool gpu_cache_warming;
+	bool gpu_cache_warm_started;
+	uint32_t gpu_cache_cx;
+	uint32_t gpu_cache_cy;
+	int64_t gpu_cache_end_ms;
+	uint64_t gpu_cache_size;
+	DARRAY(struct cached_frame) gpu_cache;
+
 	float (*mix_a)(void *data, float t);
 	float (*mix_b)(void *data, float t);
 };
@@ -63,6 +86,23 @@ static float mix_a_fade_in_out(void *data, float t);
 static float mix_b_fade_in_out(void *data, float t);
 static float mix_a_cross_fade(void *data, float t);
 static float mix_b_cross_fade(void *data, float t);
+static void stinger_render_media(struct stinger_info *s);
+
+static void gpu_cache_free(struct stinger_info *s)
+{
+	DARRAY(struct cached_frame) frames;
+
+	/* take the frames away from the render path before destroying them */
+	obs_enter_graphics();
+	s->gpu_cache_ready = false;
+	s->gpu_cache_size = 0;
+	da_move(frames, s->gpu_cache);
+
+	for (size_t i = 0; i < frames.num; i++)
+		gs_texrender_destroy(frames.array[i].texrender);
+	da_free(frames);
+	obs_leave_graphics();
+}
 
 static void stinger_update(void *data, obs_data_t *settings)
 {
@@ -79,6 +119,10 @@ static void stinger_update(void *data, obs_data_t *settings)
 	obs_data_set_bool(media_settings, "is_stinger", true);
 	obs_data_set_bool(media_settings, "is_track_matte", s->track_matte_enabled);
 
+	gpu_cache_free(s);
+	s->gpu_cache_failed = false;
+	s->preload_gpu = obs_data_get_bool(settings, "preload_gpu");
+
 	if (s->media_source && s->transitioning)
 		obs_source_remove_active_child(s->source, s->media_source);
 
@@ -93,6 +137,10 @@ static void stinger_update(void *data, obs_data_t *settings)
 	if (s->media_source && s->transitioning)
 		obs_source_add_active_child(s->source, s->media_source);
 
+	/* fill the cache in the background now instead of on first use */
+	s->gpu_cache_warming = false;
+	s->gpu_cache_warm_pending = s->preload_gpu && !!s->media_source;
+
 	int64_t point = obs_data_get_int(settings, "transition_point");
 
 	s->transition_point_is_frame = obs_data_get_int(settings, "tp_type") == TIMING_FRAME;
@@ -209,6 +257,8 @@ static void stinger_destroy(void *data)
 	obs_source_release(s->media_source);
 	obs_source_release(s->matte_source);
 
+	gpu_cache_free(s);
+
 	obs_enter_graphics();
 
 	gs_texrender_destroy(s->matte_tex);
@@ -259,7 +309,10 @@ static void stinger_matte_render(void *data, gs_texture_t *a, gs_texture_t *b, f
 			gs_clear(GS_CLEAR_COLOR, &background, 0.0f, 0);
 			gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
 
-			obs_source_video_render(matte_source);
+			if (matte_source == s->media_source)
+				stinger_render_media(s);
+			else
+				obs_source_video_render(matte_source);
 
 			gs_texrender_end(s->matte_tex);
 		}
@@ -308,7 +361,7 @@ static void stinger_texrender(struct stinger_info *s, uint32_t source_cx, uint32
 
 		gs_blend_state_push();
 		gs_enable_blending(false);
-		obs_source_video_render(s->media_source);
+		stinger_render_media(s);
 		gs_blend_state_pop();
 
 		gs_texrender_end(s->stinger_tex);
@@ -362,6 +415,194 @@ static const char *get_tech_name_and_multiplier(enum gs_color_space current_spac
 	return tech_name;
 }
 
+static void gpu_cache_capture(struct stinger_info *s, uint32_t media_cx, uint32_t media_cy)
+{
+	int64_t ts = obs_source_media_get_time(s->media_source);
+
+	if (s->gpu_cache.num) {
+		int64_t last_ts = s->gpu_cache.array[s->gpu_cache.num - 1].ts_ms;
+		if (ts == last_ts)
+			return;
+
+		/* restarted before reaching the end, start over */
+		if (ts < last_ts)
+			gpu_cache_free(s);
+	}
+
+	const enum gs_color_space space = obs_source_get_color_space(s->media_source, 0, NULL);
+	enum gs_color_format format = gs_get_format_from_space(space);
+	uint64_t size = (uint64_t)media_cx * media_cy * gs_get_format_bpp(format) / 8;
+
+	if (s->gpu_cache_size + size > GPU_CACHE_MAX_MIB * 1024 * 1024) {
+		blog(LOG_WARNING,
+		     "[stinger: '%s'] Stinger does not fit in the GPU "
+		     "preload limit (%llu MiB), using real-time decoding",
+		     obs_source_get_name(s->source), GPU_CACHE_MAX_MIB);
+		gpu_cache_free(s);
+		s->gpu_cache_failed = true;
+		return;
+	}
+
+	gs_texrender_t *texrender = gs_texrender_create(format, GS_ZS_NONE);
+	if (!gs_texrender_begin_with_color_space(texrender, media_cx, media_cy, space)) {
+		gs_texrender_destroy(texrender);
+		return;
+	}
+
+	struct vec4 clear_color;
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_ortho(0.0f, (float)media_cx, 0.0f, (float)media_cy, -100.0f, 100.0f);
+
+	gs_blend_state_push();
+	gs_enable_blending(false);
+	obs_source_video_render(s->media_source);
+	gs_blend_state_pop();
+
+	gs_texrender_end(texrender);
+
+	struct cached_frame *frame = da_push_back_new(s->gpu_cache);
+	frame->ts_ms = ts;
+	frame->texrender = texrender;
+	frame->space = space;
+
+	s->gpu_cache_size += size;
+	s->gpu_cache_cx = media_cx;
+	s->gpu_cache_cy = media_cy;
+}
+
+static void gpu_cache_finish(struct stinger_info *s)
+{
+	if (s->gpu_cache_ready || s->gpu_cache_failed || !s->gpu_cache.num)
+		return;
+
+	/* only keep captures that played all the way through */
+	if (obs_source_media_get_state(s->media_source) != OBS_MEDIA_STATE_ENDED) {
+		gpu_cache_free(s);
+		return;
+	}
+
+	s->gpu_cache_end_ms = obs_source_media_get_duration(s->media_source);
+	s->gpu_cache_ready = true;
+
+	blog(LOG_INFO, "[stinger: '%s'] Preloaded %zu frames (%ux%u) to the GPU, using %.1f MiB of video memory",
+	     obs_source_get_name(s->source), s->gpu_cache.num, s->gpu_cache_cx, s->gpu_cache_cy,
+	     (double)s->gpu_cache_size / (1024.0 * 1024.0));
+}
+
+static void gpu_cache_warm_stop(struct stinger_info *s)
+{
+	if (!s->gpu_cache_warming)
+		return;
+
+	s->gpu_cache_warming = false;
+	obs_source_set_muted(s->media_source, false);
+	obs_source_set_monitoring_type(s->media_source, s->monitoring_type);
+
+	proc_handler_t *ph = obs_source_get_proc_handler(s->media_source);
+	calldata_t cd = {0};
+	proc_handler_call(ph, "preload_first_frame", &cd);
+}
+
+/* plays the stinger once, muted and off screen, while capturing its frames.
+ * runs from video_tick, which is outside of the graphics context. */
+static void gpu_cache_warm_tick(struct stinger_info *s)
+{
+	if (s->gpu_cache_warm_pending) {
+		s->gpu_cache_warm_pending = false;
+		if (s->gpu_cache_ready || s->gpu_cache_failed)
+			return;
+
+		obs_source_set_muted(s->media_source, true);
+		obs_source_set_monitoring_type(s->media_source, OBS_MONITORING_TYPE_NONE);
+		obs_source_media_restart(s->media_source);
+		s->gpu_cache_warming = true;
+		s->gpu_cache_warm_started = false;
+		return;
+	}
+
+	if (!s->gpu_cache_warming)
+		return;
+
+	/* the restart is queued, wait for the media to start */
+	enum obs_media_state state = obs_source_media_get_state(s->media_source);
+	if (state == OBS_MEDIA_STATE_PLAYING) {
+		uint32_t media_cx = obs_source_get_width(s->media_source);
+		uint32_t media_cy = obs_source_get_height(s->media_source);
+
+		s->gpu_cache_warm_started = true;
+		if (media_cx && media_cy) {
+			obs_enter_graphics();
+			gpu_cache_capture(s, media_cx, media_cy);
+			obs_leave_graphics();
+		}
+		if (!s->gpu_cache_failed)
+			return;
+	} else if (!s->gpu_cache_warm_started) {
+		return;
+	}
+
+	gpu_cache_finish(s);
+	gpu_cache_warm_stop(s);
+}
+
+static struct cached_frame *gpu_cache_get_frame(struct stinger_info *s)
+{
+	float t = obs_transition_get_time(s->source);
+	int64_t ts = (int64_t)((long double)t * (long double)(s->duration_ns / 1000000));
+
+	if (ts > s->gpu_cache_end_ms)
+		return NULL;
+
+	/* last frame that starts at or before ts */
+	size_t lo = 0;
+	size_t hi = s->gpu_cache.num;
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (s->gpu_cache.array[mid].ts_ms <= ts)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return &s->gpu_cache.array[lo];
+}
+
+static void stinger_render_media(struct stinger_info *s)
+{
+	if (!s->gpu_cache_ready) {
+		obs_source_video_render(s->media_source);
+		return;
+	}
+
+	struct cached_frame *frame = gpu_cache_get_frame(s);
+	if (!frame)
+		return;
+
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(true);
+
+	float multiplier;
+	const char *technique = get_tech_name_and_multiplier(gs_get_color_space(), frame->space, &multiplier);
+
+	gs_effect_t *e = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_eparam_t *p_image = gs_effect_get_param_by_name(e, "image");
+	gs_eparam_t *p_multiplier = gs_effect_get_param_by_name(e, "multiplier");
+
+	gs_effect_set_texture_srgb(p_image, gs_texrender_get_texture(frame->texrender));
+	gs_effect_set_float(p_multiplier, multiplier);
+	while (gs_effect_loop(e, technique))
+		gs_draw_sprite(NULL, 0, s->gpu_cache_cx, s->gpu_cache_cy);
+
+	gs_enable_framebuffer_srgb(previous);
+}
+
+static inline bool gpu_cache_capturing(struct stinger_info *s)
+{
+	return s->preload_gpu && s->transitioning && !s->gpu_cache_ready && !s->gpu_cache_failed &&
+	       obs_source_media_get_state(s->media_source) == OBS_MEDIA_STATE_PLAYING;
+}
+
 static void stinger_video_render(void *data, gs_effect_t *effect)
 {
 	struct stinger_info *s = data;
@@ -369,6 +610,13 @@ static void stinger_video_render(void *data, gs_effect_t *effect)
 	uint32_t media_cx = obs_source_get_width(s->media_source);
 	uint32_t media_cy = obs_source_get_height(s->media_source);
 
+	if (s->gpu_cache_ready) {
+		media_cx = s->gpu_cache_cx;
+		media_cy = s->gpu_cache_cy;
+	} else if (media_cx && media_cy && gpu_cache_capturing(s)) {
+		gpu_cache_capture(s, media_cx, media_cy);
+	}
+
 	if (s->track_matte_enabled) {
 		bool ready = obs_source_active(s->media_source) && !!media_cx && !!media_cy;
 		if (ready) {
@@ -427,7 +675,7 @@ static void stinger_video_render(void *data, gs_effect_t *effect)
 		const bool previous = gs_set_linear_srgb(true);
 		gs_matrix_push();
 		gs_matrix_scale3f(source_cxf / (float)media_cx, source_cyf / (float)media_cy, 1.0f);
-		obs_source_video_render(s->media_source);
+		stinger_render_media(s);
 		gs_matrix_pop();
 		gs_set_linear_srgb(previous);
 	}
@@ -444,6 +692,9 @@ static void stinger_video_tick(void *data, float seconds)
 		gs_texrender_reset(s->matte_tex);
 	}
 
+	if (s->preload_gpu && !s->transitioning)
+		gpu_cache_warm_tick(s);
+
 	UNUSED_PARAMETER(seconds);
 }
 
@@ -525,6 +776,15 @@ static void stinger_transition_start(void *data)
 {
 	struct stinger_info *s = data;
 
+	/* a transition cuts the background fill short, the cache is filled
+	 * from the transition's own playback instead */
+	if (s->gpu_cache_warming || s->gpu_cache_warm_pending) {
+		obs_enter_graphics();
+		s->gpu_cache_warm_pending = false;
+		gpu_cache_warm_stop(s);
+		obs_leave_graphics();
+	}
+
 	if (s->media_source) {
 		calldata_t cd = {0};
 
@@ -584,6 +844,9 @@ static void stinger_transition_stop(void *data)
 {
 	struct stinger_info *s = data;
 
+	if (s->preload_gpu)
+		gpu_cache_finish(s);
+
 	if (s->media_source)
 		obs_source_remove_active_child(s->source, s->media_source);
 
@@ -690,6 +953,8 @@ static obs_properties_t *stinger_properties(void *data)
 	obs_properties_add_bool(ppts, "hw_decode", obs_module_text("HardwareDecode"));
 	p = obs_properties_add_bool(ppts, "preload", obs_module_text("PreloadVideoToRam"));
 	obs_property_set_long_description(p, obs_module_text("PreloadVideoToRam.Description"));
+	p = obs_properties_add_bool(ppts, "preload_gpu", obs_module_text("PreloadVideoToGpu"));
+	obs_property_set_long_description(p, obs_module_text("PreloadVideoToGpu.Description"));
 
 	obs_properties_add_int(ppts, "transition_point", obs_module_text("TransitionPoint"), 0, 120000, 1);
 
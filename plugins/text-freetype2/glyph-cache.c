@@ -0,0 +1,417 @@
+/******************************************************************************
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include "glyph-cache.h"
+
+struct atlas_page {
+	uint8_t *texbuf;
+	gs_texture_t *tex;
+	bool dirty;
+
+	/* shelf packing */
+	uint32_t x, y, row_h;
+
+	/* pages drawn from recently, or holding glyphs the current call of
+	 * glyph_cache_add_glyphs needs, are not evicted */
+	volatile long last_used;
+	uint64_t pinned_pass;
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	bool initialized;
+
+	struct ft2_font *fonts;
+
+	struct atlas_page pages[GLYPH_ATLAS_MAX_PAGES];
+	uint32_t num_pages;
+	uint64_t pass;
+
+	volatile long generation;
+} cache;
+
+static inline long get_time_ms(void)
+{
+	return (long)(os_gettime_ns() / 1000000);
+}
+
+void glyph_cache_init(void)
+{
+	if (cache.initialized)
+		return;
+
+	pthread_mutex_init_recursive(&cache.mutex);
+	cache.initialized = true;
+}
+
+void glyph_cache_free(void)
+{
+	if (!cache.initialized)
+		return;
+
+	obs_enter_graphics();
+	for (uint32_t i = 0; i < cache.num_pages; i++)
+		gs_texture_destroy(cache.pages[i].tex);
+	obs_leave_graphics();
+
+	for (uint32_t i = 0; i < cache.num_pages; i++)
+		bfree(cache.pages[i].texbuf);
+
+	pthread_mutex_destroy(&cache.mutex);
+	memset(&cache, 0, sizeof(cache));
+}
+
+void glyph_cache_lock(void)
+{
+	pthread_mutex_lock(&cache.mutex);
+}
+
+void glyph_cache_unlock(void)
+{
+	pthread_mutex_unlock(&cache.mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void free_glyphs(struct ft2_font *font)
+{
+	for (uint32_t i = 0; i < num_cache_slots; i++) {
+		bfree(font->glyphs[i]);
+		font->glyphs[i] = NULL;
+	}
+}
+
+struct ft2_font *glyph_cache_get_font(const char *path, FT_Long index, uint16_t size, bool antialiasing, bool sdf)
+{
+	struct ft2_font *font;
+
+	/* SDF glyphs are always smooth */
+	if (sdf)
+		antialiasing = true;
+
+	glyph_cache_lock();
+
+	for (font = cache.fonts; font; font = font->next) {
+		if (font->index == index && font->size == size && font->antialiasing == antialiasing &&
+		    font->sdf == sdf && strcmp(font->path, path) == 0) {
+			font->refs++;
+			goto unlock;
+		}
+	}
+
+	font = bzalloc(sizeof(struct ft2_font));
+	if (FT_New_Face(ft2_lib, path, index, &font->face) != 0) {
+		bfree(font);
+		font = NULL;
+		goto unlock;
+	}
+
+	FT_Set_Pixel_Sizes(font->face, 0, size);
+	FT_Select_Charmap(font->face, FT_ENCODING_UNICODE);
+
+	font->path = bstrdup(path);
+	font->index = index;
+	font->size = size;
+	font->antialiasing = antialiasing;
+	font->sdf = sdf;
+	font->refs = 1;
+
+	font->next = cache.fonts;
+	cache.fonts = font;
+
+unlock:
+	glyph_cache_unlock();
+	return font;
+}
+
+void glyph_cache_release_font(struct ft2_font *font)
+{
+	if (!font)
+		return;
+
+	glyph_cache_lock();
+
+	if (--font->refs == 0) {
+		struct ft2_font **prev = &cache.fonts;
+		while (*prev != font)
+			prev = &(*prev)->next;
+		*prev = font->next;
+
+		free_glyphs(font);
+		FT_Done_Face(font->face);
+		bfree(font->path);
+		bfree(font);
+	}
+
+	glyph_cache_unlock();
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool page_alloc(struct atlas_page *page, uint32_t w, uint32_t h, uint32_t *x, uint32_t *y)
+{
+	uint32_t px = page->x;
+	uint32_t py = page->y;
+	uint32_t row_h = page->row_h;
+
+	if (px + w >= GLYPH_ATLAS_SIZE) {
+		px = 0;
+		py += row_h + 1;
+		row_h = 0;
+	}
+
+	if (px + w >= GLYPH_ATLAS_SIZE || py + h >= GLYPH_ATLAS_SIZE)
+		return false;
+
+	*x = px;
+	*y = py;
+
+	page->x = px + w + 1;
+	page->y = py;
+	page->row_h = h > row_h ? h : row_h;
+	return true;
+}
+
+static void evict_page(uint32_t idx)
+{
+	struct atlas_page *page = &cache.pages[idx];
+
+	for (struct ft2_font *font = cache.fonts; font; font = font->next) {
+		for (uint32_t i = 0; i < num_cache_slots; i++) {
+			if (font->glyphs[i] && font->glyphs[i]->page == idx) {
+				bfree(font->glyphs[i]);
+				font->glyphs[i] = NULL;
+			}
+		}
+	}
+
+	memset(page->texbuf, 0, GLYPH_ATLAS_SIZE * GLYPH_ATLAS_SIZE);
+	page->x = 0;
+	page->y = 0;
+	page->row_h = 0;
+	page->dirty = true;
+
+	os_atomic_inc_long(&cache.generation);
+	blog(LOG_DEBUG, "[text-freetype2] Evicted glyph atlas page %u", idx);
+}
+
+static bool atlas_alloc(uint32_t w, uint32_t h, uint32_t *page_idx, uint32_t *x, uint32_t *y)
+{
+	for (uint32_t i = 0; i < cache.num_pages; i++) {
+		if (page_alloc(&cache.pages[i], w, h, x, y)) {
+			*page_idx = i;
+			goto success;
+		}
+	}
+
+	if (cache.num_pages < GLYPH_ATLAS_MAX_PAGES) {
+		*page_idx = cache.num_pages++;
+		cache.pages[*page_idx].texbuf = bzalloc(GLYPH_ATLAS_SIZE * GLYPH_ATLAS_SIZE);
+
+		blog(LOG_INFO, "[text-freetype2] Glyph atlas grew to %u pages (%u KiB of texture data)",
+		     cache.num_pages, cache.num_pages * (GLYPH_ATLAS_SIZE * GLYPH_ATLAS_SIZE / 1024));
+
+	} else {
+		uint32_t lru = GLYPH_ATLAS_MAX_PAGES;
+		long oldest = 0;
+
+		for (uint32_t i = 0; i < cache.num_pages; i++) {
+			struct atlas_page *page = &cache.pages[i];
+			long last_used = os_atomic_load_long(&page->last_used);
+
+			if (page->pinned_pass == cache.pass)
+				continue;
+			if (lru == GLYPH_ATLAS_MAX_PAGES || last_used < oldest) {
+				lru = i;
+				oldest = last_used;
+			}
+		}
+
+		if (lru == GLYPH_ATLAS_MAX_PAGES)
+			return false;
+
+		evict_page(lru);
+		*page_idx = lru;
+	}
+
+	if (!page_alloc(&cache.pages[*page_idx], w, h, x, y))
+		return false;
+
+success:
+	cache.pages[*page_idx].pinned_pass = cache.pass;
+	cache.pages[*page_idx].dirty = true;
+	return true;
+}
+
+static uint8_t get_pixel_value(const unsigned char *buf_row, FT_Render_Mode render_mode, const uint32_t x)
+{
+	if (render_mode != FT_RENDER_MODE_MONO) {
+		return buf_row[x];
+	}
+
+	const uint32_t byte_index = x / 8;
+	const uint8_t bit_index = x % 8;
+	const bool pixel_set = (buf_row[byte_index] >> (7 - bit_index)) & 1;
+	return pixel_set ? 255 : 0;
+}
+
+static void rasterize(struct atlas_page *page, FT_GlyphSlot slot, const FT_Render_Mode render_mode, const uint32_t dx,
+		      const uint32_t dy)
+{
+	/**
+	 * The pitch's absolute value is the number of bytes taken by one bitmap
+	 * row, including padding.
+	 *
+	 * Source: https://www.freetype.org/freetype2/docs/reference/ft2-basic_types.html
+	 */
+	const int pitch = abs(slot->bitmap.pitch);
+
+	for (uint32_t y = 0; y < slot->bitmap.rows; y++) {
+		const uint32_t row_start = y * pitch;
+		const uint32_t row = (dy + y) * GLYPH_ATLAS_SIZE;
+
+		for (uint32_t x = 0; x < slot->bitmap.width; x++) {
+			const uint32_t row_pixel_position = dx + x;
+			const uint8_t pixel_value = get_pixel_value(&slot->bitmap.buffer[row_start], render_mode, x);
+			page->texbuf[row_pixel_position + row] = pixel_value;
+		}
+	}
+}
+
+static struct glyph_info *init_glyph(FT_GlyphSlot slot, const uint32_t page, const uint32_t dx, const uint32_t dy,
+				     const uint32_t g_w, const uint32_t g_h)
+{
+	struct glyph_info *glyph = bzalloc(sizeof(struct glyph_info));
+	glyph->page = page;
+	glyph->u = (float)dx / (float)GLYPH_ATLAS_SIZE;
+	glyph->u2 = (float)(dx + g_w) / (float)GLYPH_ATLAS_SIZE;
+	glyph->v = (float)dy / (float)GLYPH_ATLAS_SIZE;
+	glyph->v2 = (float)(dy + g_h) / (float)GLYPH_ATLAS_SIZE;
+	glyph->w = g_w;
+	glyph->h = g_h;
+	glyph->yoff = slot->bitmap_top;
+	glyph->xoff = slot->bitmap_left;
+	glyph->xadv = slot->advance.x >> 6;
+
+	return glyph;
+}
+
+static FT_Render_Mode get_font_render_mode(struct ft2_font *font)
+{
+#if HAVE_FT_SDF
+	if (font->sdf)
+		return FT_RENDER_MODE_SDF;
+#endif
+	return font->antialiasing ? FT_RENDER_MODE_NORMAL : FT_RENDER_MODE_MONO;
+}
+
+static void upload_pages(void)
+{
+	obs_enter_graphics();
+
+	for (uint32_t i = 0; i < cache.num_pages; i++) {
+		struct atlas_page *page = &cache.pages[i];
+		if (!page->dirty)
+			continue;
+
+		if (page->tex)
+			gs_texture_set_image(page->tex, page->texbuf, GLYPH_ATLAS_SIZE, false);
+		else
+			page->tex = gs_texture_create(GLYPH_ATLAS_SIZE, GLYPH_ATLAS_SIZE, GS_A8, 1,
+						      (const uint8_t **)&page->texbuf, GS_DYNAMIC);
+		page->dirty = false;
+	}
+
+	obs_leave_graphics();
+}
+
+uint32_t glyph_cache_add_glyphs(struct ft2_font *font, const wchar_t *text)
+{
+	if (!font || !text)
+		return 0;
+
+	const FT_Render_Mode render_mode = get_font_render_mode(font);
+	const FT_Int32 load_mode = render_mode == FT_RENDER_MODE_MONO ? FT_LOAD_TARGET_MONO : FT_LOAD_DEFAULT;
+	FT_GlyphSlot slot = font->face->glyph;
+	const size_t len = wcslen(text);
+	uint32_t cached_glyphs = 0;
+
+	glyph_cache_lock();
+
+	/* keep the pages of glyphs this text already has from being evicted
+	 * to make room for the missing ones */
+	cache.pass++;
+	for (size_t i = 0; i < len; i++) {
+		const FT_UInt glyph_index = FT_Get_Char_Index(font->face, text[i]);
+		if (font->glyphs[glyph_index])
+			cache.pages[font->glyphs[glyph_index]->page].pinned_pass = cache.pass;
+	}
+
+	for (size_t i = 0; i < len; i++) {
+		const FT_UInt glyph_index = FT_Get_Char_Index(font->face, text[i]);
+		uint32_t page, dx, dy;
+
+		if (font->glyphs[glyph_index] != NULL) {
+			continue;
+		}
+
+		FT_Load_Glyph(font->face, glyph_index, load_mode);
+		FT_Render_Glyph(slot, render_mode);
+
+		const uint32_t g_w = slot->bitmap.width;
+		const uint32_t g_h = slot->bitmap.rows;
+
+		if (font->max_h < g_h) {
+			font->max_h = g_h;
+		}
+
+		if (!atlas_alloc(g_w, g_h, &page, &dx, &dy)) {
+			blog(LOG_WARNING, "Out of space trying to render glyphs");
+			break;
+		}
+
+		font->glyphs[glyph_index] = init_glyph(slot, page, dx, dy, g_w, g_h);
+		rasterize(&cache.pages[page], slot, render_mode, dx, dy);
+
+		cached_glyphs++;
+	}
+
+	if (cached_glyphs > 0)
+		upload_pages();
+
+	glyph_cache_unlock();
+	return cached_glyphs;
+}
+
+long glyph_cache_get_generation(void)
+{
+	return os_atomic_load_long(&cache.generation);
+}
+
+gs_texture_t *glyph_cache_get_page_texture(uint32_t page)
+{
+	return page < GLYPH_ATLAS_MAX_PAGES ? cache.pages[page].tex : NULL;
+}
+
+void glyph_cache_touch_page(uint32_t page)
+{
+	if (page < GLYPH_ATLAS_MAX_PAGES)
+		os_atomic_set_long(&cache.pages[page].last_used, get_time_ms());
+}
@@ -0,0 +1,76 @@
+/******************************************************************************
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "text-freetype2.h"
+
+/*
+ * Process wide glyph cache
+ *
+ *   Fonts are shared by every source using the same face, size and render
+ * mode, and their glyphs are packed into atlas pages shared by all fonts.
+ * When every page is full, the least recently drawn page is evicted, and the
+ * cache generation changes so sources can cache their glyphs again.
+ *
+ *   All functions except glyph_cache_get_page_texture and
+ * glyph_cache_touch_page must be called outside of the graphics context,
+ * sources hold glyph_cache_lock while they use a font face.
+ */
+
+#define GLYPH_ATLAS_SIZE 1024
+#define GLYPH_ATLAS_MAX_PAGES 16
+
+/* SDF glyphs are rendered once at this size and scaled when drawn */
+#define SDF_RASTER_SIZE 64
+#define SDF_SPREAD 8
+
+#if FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
+#define HAVE_FT_SDF 1
+#else
+#define HAVE_FT_SDF 0
+#endif
+
+struct ft2_font {
+	char *path;
+	FT_Long index;
+	uint16_t size;
+	bool antialiasing;
+	bool sdf;
+
+	FT_Face face;
+	uint32_t max_h;
+	long refs;
+
+	struct glyph_info *glyphs[num_cache_slots];
+	struct ft2_font *next;
+};
+
+void glyph_cache_init(void);
+void glyph_cache_free(void);
+
+void glyph_cache_lock(void);
+void glyph_cache_unlock(void);
+
+struct ft2_font *glyph_cache_get_font(const char *path, FT_Long index, uint16_t size, bool antialiasing, bool sdf);
+void glyph_cache_release_font(struct ft2_font *font);
+
+/* caches the glyphs of text, returns the number of glyphs added */
+uint32_t glyph_cache_add_glyphs(struct ft2_font *font, const wchar_t *text);
+long glyph_cache_get_generation(void);
+
+/* graphics thread */
+gs_texture_t *glyph_cache_get_page_texture(uint32_t page);
+void glyph_cache_touch_page(uint32_t page);
@@ -54,10 +54,11 @@ gs_vertbuffer_t *create_uv_vbuffer(uint32_t num_verts, bool add_color)
 	return tmp;
 }
 
-void draw_uv_vbuffer(gs_vertbuffer_t *vbuf, gs_texture_t *tex, gs_effect_t *effect, uint32_t num_verts, bool use_color)
+void draw_uv_vbuffer(gs_vertbuffer_t *vbuf, gs_texture_t *tex, gs_effect_t *effect, const char *technique,
+		     uint32_t start_vert, uint32_t num_verts, bool use_color)
 {
 	gs_texture_t *texture = tex;
-	gs_technique_t *tech = gs_effect_get_technique(effect, "Draw");
+	gs_technique_t *tech = gs_effect_get_technique(effect, technique);
 	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
 	size_t passes;
 
@@ -83,7 +84,7 @@ void draw_uv_vbuffer(gs_vertbuffer_t *vbuf, gs_texture_t *tex, gs_effect_t *effe
 
 			gs_effect_set_bool(gs_effect_get_param_by_name(effect, "use_color"), use_color);
 
-			gs_draw(GS_TRIS, 0, num_verts);
+			gs_draw(GS_TRIS, start_vert, num_verts);
 
 			gs_technique_end_pass(tech);
 		}
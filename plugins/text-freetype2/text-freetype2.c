@@ -19,8 +19,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <util/platform.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_MODULE_H
 #include <sys/stat.h>
 #include "text-freetype2.h"
+#include "glyph-cache.h"
 #include "obs-convenience.h"
 #include "find-font.h"
 
@@ -33,8 +35,6 @@ MODULE_EXPORT const char *obs_module_description(void)
 	return "FreeType2 text source";
 }
 
-uint32_t texbuf_w = 2048, texbuf_h = 2048;
-
 static const char *ft2_source_get_name(void *unused);
 static void *ft2_source_create(obs_data_t *settings, obs_source_t *source);
 static void ft2_source_destroy(void *data);
@@ -104,6 +104,13 @@ static void init_plugin(void)
 		return;
 	}
 
+#if HAVE_FT_SDF
+	/* the default spread of 2 pixels is too little to scale glyphs up */
+	FT_Int spread = SDF_SPREAD;
+	FT_Property_Set(ft2_lib, "sdf", "spread", &spread);
+	FT_Property_Set(ft2_lib, "bsdf", "spread", &spread);
+#endif
+
 	if (!load_cached_os_font_list())
 		load_os_font_list();
 
@@ -118,6 +125,8 @@ bool obs_module_load()
 		bfree(config_dir);
 	}
 
+	glyph_cache_init();
+
 	obs_register_source(&freetype2_source_info_v1);
 	obs_register_source(&freetype2_source_info_v2);
 
@@ -126,6 +135,8 @@ bool obs_module_load()
 
 void obs_module_unload(void)
 {
+	glyph_cache_free();
+
 	if (plugin_initialized) {
 		free_os_font_list();
 		FT_Done_FreeType(ft2_lib);
@@ -196,6 +207,11 @@ static obs_properties_t *ft2_source_properties(void *unused)
 
 	obs_properties_add_bool(props, "antialiasing", obs_module_text("Antialiasing"));
 
+#if HAVE_FT_SDF
+	obs_property_t *sdf = obs_properties_add_bool(props, "sdf", obs_module_text("SDF"));
+	obs_property_set_long_description(sdf, obs_module_text("SDF.Description"));
+#endif
+
 	obs_properties_add_bool(props, "log_mode", obs_module_text("ChatLogMode"));
 
 	obs_properties_add_int(props, "log_lines", obs_module_text("ChatLogLines"), 1, 1000, 1);
@@ -219,17 +235,9 @@ static void ft2_source_destroy(void *data)
 {
 	struct ft2_source *srcdata = data;
 
-	if (srcdata->font_face != NULL) {
-		FT_Done_Face(srcdata->font_face);
-		srcdata->font_face = NULL;
-	}
-
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
+	glyph_cache_release_font(srcdata->font);
+	srcdata->font = NULL;
+	srcdata->font_face = NULL;
 
 	if (srcdata->font_name != NULL)
 		bfree(srcdata->font_name);
@@ -237,17 +245,11 @@ static void ft2_source_destroy(void *data)
 		bfree(srcdata->font_style);
 	if (srcdata->text != NULL)
 		bfree(srcdata->text);
-	if (srcdata->texbuf != NULL)
-		bfree(srcdata->texbuf);
 	if (srcdata->text_file != NULL)
 		bfree(srcdata->text_file);
 
 	obs_enter_graphics();
 
-	if (srcdata->tex != NULL) {
-		gs_texture_destroy(srcdata->tex);
-		srcdata->tex = NULL;
-	}
 	if (srcdata->vbuf != NULL) {
 		gs_vertexbuffer_destroy(srcdata->vbuf);
 		srcdata->vbuf = NULL;
@@ -259,6 +261,8 @@ static void ft2_source_destroy(void *data)
 
 	obs_leave_graphics();
 
+	da_free(srcdata->runs);
+	free_text_layout(&srcdata->layout);
 	bfree(srcdata);
 }
 
@@ -268,7 +272,7 @@ static void ft2_source_render(void *data, gs_effect_t *effect)
 	if (srcdata == NULL)
 		return;
 
-	if (srcdata->tex == NULL || srcdata->vbuf == NULL)
+	if (!srcdata->runs.num || srcdata->vbuf == NULL)
 		return;
 	if (srcdata->text == NULL || *srcdata->text == 0)
 		return;
@@ -279,7 +283,7 @@ static void ft2_source_render(void *data, gs_effect_t *effect)
 	if (srcdata->drop_shadow)
 		draw_drop_shadow(srcdata);
 
-	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex, srcdata->draw_effect, (uint32_t)wcslen(srcdata->text) * 6, true);
+	draw_glyphs(srcdata, true);
 
 	UNUSED_PARAMETER(effect);
 }
@@ -289,6 +293,15 @@ static void ft2_video_tick(void *data, float seconds)
 	struct ft2_source *srcdata = data;
 	if (srcdata == NULL)
 		return;
+
+	/* another source evicted some of our glyphs from the shared atlas */
+	if (srcdata->font && srcdata->vbuf && srcdata->glyph_generation != glyph_cache_get_generation()) {
+		glyph_cache_lock();
+		cache_glyphs(srcdata, srcdata->text);
+		set_up_vertex_buffer(srcdata);
+		glyph_cache_unlock();
+	}
+
 	if (!srcdata->from_file || !srcdata->text_file)
 		return;
 
@@ -297,12 +310,20 @@ static void ft2_video_tick(void *data, float seconds)
 		srcdata->last_checked = os_gettime_ns();
 
 		if (srcdata->update_file) {
-			if (srcdata->log_mode)
-				read_from_end(srcdata, srcdata->text_file);
-			else
-				load_text_from_file(srcdata, srcdata->text_file);
-			cache_glyphs(srcdata, srcdata->text);
-			set_up_vertex_buffer(srcdata);
+			bool changed = true;
+
+			if (!append_text_from_file(srcdata, srcdata->text_file, &changed)) {
+				if (srcdata->log_mode)
+					read_from_end(srcdata, srcdata->text_file);
+				else
+					load_text_from_file(srcdata, srcdata->text_file);
+			}
+			if (changed) {
+				glyph_cache_lock();
+				cache_glyphs(srcdata, srcdata->text);
+				set_up_vertex_buffer(srcdata);
+				glyph_cache_unlock();
+			}
 			srcdata->update_file = false;
 		}
 
@@ -323,12 +344,17 @@ static bool init_font(struct ft2_source *srcdata)
 	if (!path)
 		return false;
 
-	if (srcdata->font_face != NULL) {
-		FT_Done_Face(srcdata->font_face);
-		srcdata->font_face = NULL;
-	}
+	/* SDF glyphs are rendered once and scaled to the font size */
+	const uint16_t raster_size = srcdata->sdf ? SDF_RASTER_SIZE : srcdata->font_size;
+	struct ft2_font *font = glyph_cache_get_font(path, index, raster_size, srcdata->antialiasing, srcdata->sdf);
+
+	glyph_cache_release_font(srcdata->font);
+	srcdata->font = font;
+	srcdata->layout.font = NULL;
+	srcdata->font_face = font ? font->face : NULL;
+	srcdata->scale = srcdata->sdf ? (float)srcdata->font_size / (float)SDF_RASTER_SIZE : 1.0f;
 
-	return FT_New_Face(ft2_lib, path, index, &srcdata->font_face) == 0;
+	return font != NULL;
 }
 
 static void ft2_source_update(void *data, obs_data_t *settings)
@@ -348,6 +374,8 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	if (!font_obj)
 		return;
 
+	glyph_cache_lock();
+
 	srcdata->outline_width = 0;
 
 	srcdata->drop_shadow = obs_data_get_bool(settings, "drop_shadow");
@@ -402,8 +430,6 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	if (ft2_lib == NULL)
 		goto error;
 
-	const size_t texbuf_size = (size_t)texbuf_w * (size_t)texbuf_h;
-
 	if (srcdata->draw_effect == NULL) {
 		char *effect_file = NULL;
 		char *error_string = NULL;
@@ -424,14 +450,14 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	if (srcdata->font_size != font_size || srcdata->from_file != from_file)
 		vbuf_needs_update = true;
 
+	/* these select a different shared font, like a font change does */
 	const bool new_aa_setting = obs_data_get_bool(settings, "antialiasing");
-	const bool aa_changed = srcdata->antialiasing != new_aa_setting;
-	if (aa_changed) {
+	const bool new_sdf_setting = HAVE_FT_SDF && obs_data_get_bool(settings, "sdf");
+	const bool render_mode_changed = srcdata->antialiasing != new_aa_setting || srcdata->sdf != new_sdf_setting;
+	if (render_mode_changed) {
 		srcdata->antialiasing = new_aa_setting;
-		if (srcdata->texbuf != NULL) {
-			memset(srcdata->texbuf, 0, texbuf_size);
-		}
-		cache_standard_glyphs(srcdata);
+		srcdata->sdf = new_sdf_setting;
+		vbuf_needs_update = true;
 	}
 
 	srcdata->file_load_failed = false;
@@ -439,7 +465,7 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 
 	if (srcdata->font_name != NULL) {
 		if (strcmp(font_name, srcdata->font_name) == 0 && strcmp(font_style, srcdata->font_style) == 0 &&
-		    font_flags == srcdata->font_flags && font_size == srcdata->font_size)
+		    font_flags == srcdata->font_flags && font_size == srcdata->font_size && !render_mode_changed)
 			goto skip_font_load;
 
 		bfree(srcdata->font_name);
@@ -458,19 +484,10 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	if (!init_font(srcdata) || srcdata->font_face == NULL) {
 		blog(LOG_WARNING, "FT2-text: Failed to load font %s", srcdata->font_name);
 		goto error;
-	} else {
-		FT_Set_Pixel_Sizes(srcdata->font_face, 0, srcdata->font_size);
-		FT_Select_Charmap(srcdata->font_face, FT_ENCODING_UNICODE);
-	}
-
-	if (srcdata->texbuf != NULL) {
-		bfree(srcdata->texbuf);
-		srcdata->texbuf = NULL;
 	}
-	srcdata->texbuf = bzalloc(texbuf_size);
 
-	if (srcdata->font_face)
-		cache_standard_glyphs(srcdata);
+	srcdata->max_h = 0;
+	cache_standard_glyphs(srcdata);
 
 skip_font_load:
 	if (from_file) {
@@ -519,6 +536,7 @@ skip_font_load:
 	}
 
 error:
+	glyph_cache_unlock();
 	obs_data_release(font_obj);
 }
 
@@ -595,6 +613,7 @@ static void ft2_source_defaults(obs_data_t *settings, int ver)
 	obs_data_release(font_obj);
 
 	obs_data_set_default_bool(settings, "antialiasing", true);
+	obs_data_set_default_bool(settings, "sdf", false);
 	obs_data_set_default_bool(settings, "word_wrap", false);
 	obs_data_set_default_bool(settings, "outline", false);
 	obs_data_set_default_bool(settings, "drop_shadow", false);
@@ -18,15 +18,54 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <obs-module.h>
+#include <util/darray.h>
 #include <ft2build.h>
+#include FT_FREETYPE_H
 
 #define num_cache_slots 65535
-#define src_glyph srcdata->cacheglyphs[glyph_index]
+#define src_glyph srcdata->font->glyphs[glyph_index]
 
 struct glyph_info {
 	float u, v, u2, v2;
 	int32_t w, h, xoff, yoff;
 	FT_Pos xadv;
+	uint32_t page;
+};
+
+/* consecutive glyphs of the vertex buffer that are on the same atlas page */
+struct glyph_run {
+	uint32_t page;
+	uint32_t start;
+	uint32_t count;
+};
+
+/* a line of laid out text, up to its line break */
+struct text_line {
+	size_t start;
+	size_t len;
+	uint32_t first_glyph;
+	uint32_t num_glyphs;
+
+	/* in raster pixels, bottom is relative to top */
+	uint32_t top;
+	uint32_t rows;
+	uint32_t width;
+	int32_t bottom;
+};
+
+/* what the vertex buffer was last filled with, so that a text change only
+ * lays out the lines that changed */
+struct text_layout {
+	struct ft2_font *font;
+	long generation;
+	uint32_t max_h, custom_width;
+	uint32_t color[2];
+	float scale, offset;
+
+	wchar_t *text;
+	DARRAY(struct text_line) lines;
+	DARRAY(uint32_t) pages;
+	uint32_t capacity;
 };
 
 struct ft2_source {
@@ -38,27 +77,34 @@ struct ft2_source {
 	bool file_load_failed;
 	bool from_file;
 	bool antialiasing;
+	bool sdf;
 	char *text_file;
 	wchar_t *text;
 	time_t m_timestamp;
+	/* how much of text_file has been read, and the bytes before that,
+	 * so that appended text can be read without reading the file again */
+	int64_t file_size;
+	char file_tail[64];
+	size_t file_tail_size;
 	bool update_file;
 	uint64_t last_checked;
 
 	uint32_t cx, cy, max_h, custom_width;
 	uint32_t outline_width;
-	uint32_t texbuf_x, texbuf_y;
 	uint32_t color[2];
 
 	int32_t cur_scroll, scroll_speed;
 
-	gs_texture_t *tex;
-
-	struct glyph_info *cacheglyphs[num_cache_slots];
-
+	/* glyph metrics are in raster pixels, scale maps them to output pixels
+	 * and is only different from 1 for SDF glyphs */
+	struct ft2_font *font;
 	FT_Face font_face;
+	float scale;
+	long glyph_generation;
 
-	uint8_t *texbuf;
 	gs_vertbuffer_t *vbuf;
+	DARRAY(struct glyph_run) runs;
+	struct text_layout layout;
 
 	gs_effect_t *draw_effect;
 	bool outline_text, drop_shadow;
@@ -70,17 +116,18 @@ struct ft2_source {
 
 extern FT_Library ft2_lib;
 
+void draw_glyphs(struct ft2_source *srcdata, bool use_color);
 void draw_outlines(struct ft2_source *srcdata);
 void draw_drop_shadow(struct ft2_source *srcdata);
 
-uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata);
-
 time_t get_modified_timestamp(char *filename);
 void load_text_from_file(struct ft2_source *srcdata, const char *filename);
 void read_from_end(struct ft2_source *srcdata, const char *filename);
+bool append_text_from_file(struct ft2_source *srcdata, const char *filename, bool *changed);
 
 void cache_standard_glyphs(struct ft2_source *srcdata);
 void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs);
 
 void set_up_vertex_buffer(struct ft2_source *srcdata);
 void fill_vertex_buffer(struct ft2_source *srcdata);
+void free_text_layout(struct text_layout *layout);
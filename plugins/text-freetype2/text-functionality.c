@@ -17,16 +17,31 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <obs-module.h>
 #include <util/platform.h>
+#include <util/profiler.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include <sys/stat.h>
 #include "text-freetype2.h"
+#include "glyph-cache.h"
 #include "obs-convenience.h"
 
 float offsets[16] = {-2.0f, 0.0f, 0.0f, -2.0f, 2.0f,  0.0f, 2.0f,  0.0f,
 		     0.0f,  2.0f, 0.0f, 2.0f,  -2.0f, 0.0f, -2.0f, 0.0f};
 
-extern uint32_t texbuf_w, texbuf_h;
+void draw_glyphs(struct ft2_source *srcdata, bool use_color)
+{
+	const char *technique = srcdata->sdf ? "DrawSDF" : "Draw";
+
+	for (size_t i = 0; i < srcdata->runs.num; i++) {
+		const struct glyph_run *run = &srcdata->runs.array[i];
+
+		if (use_color)
+			glyph_cache_touch_page(run->page);
+
+		draw_uv_vbuffer(srcdata->vbuf, glyph_cache_get_page_texture(run->page), srcdata->draw_effect,
+				technique, run->start, run->count, use_color);
+	}
+}
 
 void draw_outlines(struct ft2_source *srcdata)
 {
@@ -36,8 +51,7 @@ void draw_outlines(struct ft2_source *srcdata)
 	gs_matrix_push();
 	for (int32_t i = 0; i < 8; i++) {
 		gs_matrix_translate3f(offsets[i * 2], offsets[(i * 2) + 1], 0.0f);
-		draw_uv_vbuffer(srcdata->vbuf, srcdata->tex, srcdata->draw_effect, (uint32_t)wcslen(srcdata->text) * 6,
-				false);
+		draw_glyphs(srcdata, false);
 	}
 	gs_matrix_identity();
 	gs_matrix_pop();
@@ -50,67 +64,43 @@ void draw_drop_shadow(struct ft2_source *srcdata)
 
 	gs_matrix_push();
 	gs_matrix_translate3f(4.0f, 4.0f, 0.0f);
-	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex, srcdata->draw_effect, (uint32_t)wcslen(srcdata->text) * 6, false);
+	draw_glyphs(srcdata, false);
 	gs_matrix_identity();
 	gs_matrix_pop();
 }
 
-void set_up_vertex_buffer(struct ft2_source *srcdata)
+static const char *set_up_vertex_buffer_name = "set_up_vertex_buffer";
+
+static void wrap_words(struct ft2_source *srcdata)
 {
 	FT_UInt glyph_index = 0;
 	uint32_t x = 0, space_pos = 0, word_width = 0;
-	size_t len;
-
-	if (!srcdata->text)
-		return;
-
-	if (srcdata->custom_width >= 100)
-		srcdata->cx = srcdata->custom_width;
-	else
-		srcdata->cx = get_ft2_text_width(srcdata->text, srcdata);
-	srcdata->cy = srcdata->max_h;
-
-	obs_enter_graphics();
-	if (srcdata->vbuf != NULL) {
-		gs_vertbuffer_t *tmpvbuf = srcdata->vbuf;
-		srcdata->vbuf = NULL;
-		gs_vertexbuffer_destroy(tmpvbuf);
-	}
-
-	if (*srcdata->text == 0) {
-		obs_leave_graphics();
-		return;
-	}
-
-	srcdata->vbuf = create_uv_vbuffer((uint32_t)wcslen(srcdata->text) * 6, true);
-
-	if (srcdata->custom_width <= 100)
-		goto skip_word_wrap;
-	if (!srcdata->word_wrap)
-		goto skip_word_wrap;
-
-	len = wcslen(srcdata->text);
+	size_t len = wcslen(srcdata->text);
 
 	for (uint32_t i = 0; i <= len; i++) {
-		if (i == wcslen(srcdata->text))
+		if (i == len)
 			goto eos_check;
 
 		if (srcdata->text[i] != L' ' && srcdata->text[i] != L'\n')
 			goto next_char;
 
 	eos_check:;
-		if (x + word_width > srcdata->custom_width) {
+		if ((float)(x + word_width) * srcdata->scale > (float)srcdata->custom_width) {
 			if (space_pos != 0)
 				srcdata->text[space_pos] = L'\n';
 			x = 0;
 		}
-		if (i == wcslen(srcdata->text))
+		if (i == len)
 			goto eos_skip;
 
 		x += word_width;
 		word_width = 0;
-		if (srcdata->text[i] == L'\n')
+		/* lines wrap on their own, so that a line only changes when
+		 * its text does */
+		if (srcdata->text[i] == L'\n') {
 			x = 0;
+			space_pos = 0;
+		}
 		if (srcdata->text[i] == L' ')
 			space_pos = i;
 	next_char:;
@@ -119,229 +109,324 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 			word_width += src_glyph->xadv;
 	eos_skip:;
 	}
+}
 
-skip_word_wrap:;
-	fill_vertex_buffer(srcdata);
-	gs_vertexbuffer_flush(srcdata->vbuf);
-	obs_leave_graphics();
+void free_text_layout(struct text_layout *layout)
+{
+	bfree(layout->text);
+	da_free(layout->lines);
+	da_free(layout->pages);
+	memset(layout, 0, sizeof(*layout));
 }
 
-void fill_vertex_buffer(struct ft2_source *srcdata)
+void set_up_vertex_buffer(struct ft2_source *srcdata)
 {
-	struct gs_vb_data *vdata = gs_vertexbuffer_get_data(srcdata->vbuf);
-	if (vdata == NULL || !srcdata->text)
-		return;
+	struct text_layout *layout = &srcdata->layout;
 
-	struct vec2 *tvarray = (struct vec2 *)vdata->tvarray[0].array;
-	uint32_t *col = (uint32_t *)vdata->colors;
+	if (!srcdata->text)
+		return;
 
-	FT_UInt glyph_index = 0;
+	srcdata->glyph_generation = glyph_cache_get_generation();
 
-	uint32_t dx = 0, dy = srcdata->max_h, max_y = dy;
-	uint32_t cur_glyph = 0;
-	uint32_t offset = 0;
-	size_t len = wcslen(srcdata->text);
+	if (srcdata->custom_width > 100 && srcdata->word_wrap)
+		wrap_words(srcdata);
 
-	if (srcdata->outline_text) {
-		offset = 2;
-		dx = offset;
-	}
+	const size_t len = wcslen(srcdata->text);
 
-	for (size_t i = 0; i < len; i++) {
-	add_linebreak:;
-		if (srcdata->text[i] != L'\n')
-			goto draw_glyph;
-		dx = offset;
-		i++;
-		dy += srcdata->max_h + 4;
-		if (i == wcslen(srcdata->text))
-			goto skip_glyph;
-		if (srcdata->text[i] == L'\n')
-			goto add_linebreak;
-	draw_glyph:;
-		// Skip filthy dual byte Windows line breaks
-		if (srcdata->text[i] == L'\r')
-			goto skip_glyph;
+	srcdata->cx = srcdata->custom_width >= 100 ? srcdata->custom_width : 0;
+	srcdata->cy = (uint32_t)((float)srcdata->max_h * srcdata->scale);
 
-		glyph_index = FT_Get_Char_Index(srcdata->font_face, srcdata->text[i]);
-		if (src_glyph == NULL)
-			goto skip_glyph;
+	profile_start(set_up_vertex_buffer_name);
+	obs_enter_graphics();
+	da_resize(srcdata->runs, 0);
 
-		if (srcdata->custom_width < 100)
-			goto skip_custom_width;
+	if (len == 0) {
+		da_resize(layout->lines, 0);
+		goto finish;
+	}
 
-		if (dx + src_glyph->xadv > srcdata->custom_width) {
-			dx = offset;
-			dy += srcdata->max_h + 4;
+	/* the buffer is reused while the text fits, it holds at most one
+	 * glyph per character */
+	if (!srcdata->vbuf || len > layout->capacity) {
+		uint32_t capacity = layout->capacity;
+		while (capacity < len)
+			capacity = capacity ? capacity * 2 : 64;
+
+		if (srcdata->vbuf != NULL) {
+			gs_vertbuffer_t *tmpvbuf = srcdata->vbuf;
+			srcdata->vbuf = NULL;
+			gs_vertexbuffer_destroy(tmpvbuf);
 		}
 
-	skip_custom_width:;
+		srcdata->vbuf = create_uv_vbuffer(capacity * 6, true);
+		layout->capacity = srcdata->vbuf ? capacity : 0;
+		da_resize(layout->lines, 0);
+		da_resize(layout->pages, 0);
+	}
 
-		set_v3_rect(vdata->points + (cur_glyph * 6), (float)dx + (float)src_glyph->xoff,
-			    (float)dy - (float)src_glyph->yoff, (float)src_glyph->w, (float)src_glyph->h);
-		set_v2_uv(tvarray + (cur_glyph * 6), src_glyph->u, src_glyph->v, src_glyph->u2, src_glyph->v2);
-		set_rect_colors2(col + (cur_glyph * 6), srcdata->color[0], srcdata->color[1]);
-		dx += src_glyph->xadv;
-		if (dy - (float)src_glyph->yoff + src_glyph->h > max_y)
-			max_y = dy - src_glyph->yoff + src_glyph->h;
-		cur_glyph++;
-	skip_glyph:;
+	if (srcdata->vbuf) {
+		fill_vertex_buffer(srcdata);
+		gs_vertexbuffer_flush(srcdata->vbuf);
 	}
 
-	srcdata->cy = max_y;
+finish:
+	obs_leave_graphics();
+	profile_end(set_up_vertex_buffer_name);
 }
 
-void cache_standard_glyphs(struct ft2_source *srcdata)
+static bool layout_is_current(const struct ft2_source *srcdata, float offset)
 {
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
-
-	srcdata->texbuf_x = 0;
-	srcdata->texbuf_y = 0;
+	const struct text_layout *layout = &srcdata->layout;
 
-	cache_glyphs(srcdata, L"abcdefghijklmnopqrstuvwxyz"
-			      L"ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890"
-			      L"!@#$%^&*()-_=+,<.>/?\\|[]{}`~ \'\"\0");
+	return layout->text && layout->font == srcdata->font && layout->generation == srcdata->glyph_generation &&
+	       layout->max_h == srcdata->max_h && layout->custom_width == srcdata->custom_width &&
+	       layout->color[0] == srcdata->color[0] && layout->color[1] == srcdata->color[1] &&
+	       layout->scale == srcdata->scale && layout->offset == offset;
 }
 
-FT_Render_Mode get_render_mode(struct ft2_source *srcdata)
+static inline size_t line_length(const wchar_t *text)
 {
-	return srcdata->antialiasing ? FT_RENDER_MODE_NORMAL : FT_RENDER_MODE_MONO;
+	const wchar_t *end = wcschr(text, L'\n');
+	return end ? (size_t)(end - text) : wcslen(text);
 }
 
-void load_glyph(struct ft2_source *srcdata, const FT_UInt glyph_index, const FT_Render_Mode render_mode)
+static inline bool line_equals(const struct text_layout *layout, size_t idx, const wchar_t *text, size_t len)
 {
-	const FT_Int32 load_mode = render_mode == FT_RENDER_MODE_MONO ? FT_LOAD_TARGET_MONO : FT_LOAD_DEFAULT;
-	FT_Load_Glyph(srcdata->font_face, glyph_index, load_mode);
+	const struct text_line *line = &layout->lines.array[idx];
+	return line->len == len && wmemcmp(layout->text + line->start, text, len) == 0;
 }
 
-struct glyph_info *init_glyph(FT_GlyphSlot slot, const uint32_t dx, const uint32_t dy, const uint32_t g_w,
-			      const uint32_t g_h)
+/* Finds the lines of the last layout that the new text starts with. Lines
+ * only depend on their own text, so they can be kept as they are and only
+ * need to move up when lines before them were removed, like in chat log
+ * mode. */
+static size_t find_kept_lines(const struct text_layout *layout, const wchar_t *text, size_t *first)
 {
-	struct glyph_info *glyph = bzalloc(sizeof(struct glyph_info));
-	glyph->u = (float)dx / (float)texbuf_w;
-	glyph->u2 = (float)(dx + g_w) / (float)texbuf_w;
-	glyph->v = (float)dy / (float)texbuf_h;
-	glyph->v2 = (float)(dy + g_h) / (float)texbuf_h;
-	glyph->w = g_w;
-	glyph->h = g_h;
-	glyph->yoff = slot->bitmap_top;
-	glyph->xoff = slot->bitmap_left;
-	glyph->xadv = slot->advance.x >> 6;
-
-	return glyph;
+	size_t len = line_length(text);
+	size_t kept = 0;
+
+	for (*first = 0; *first < layout->lines.num; (*first)++) {
+		if (line_equals(layout, *first, text, len))
+			break;
+	}
+
+	for (size_t i = *first; i < layout->lines.num; i++) {
+		if (!line_equals(layout, i, text, len))
+			break;
+
+		kept++;
+		if (!text[len])
+			break;
+
+		text += len + 1;
+		len = line_length(text);
+	}
+
+	return kept;
 }
 
-uint8_t get_pixel_value(const unsigned char *buf_row, FT_Render_Mode render_mode, const uint32_t x)
+static void move_glyphs_up(struct gs_vb_data *vdata, uint32_t first, uint32_t count, float y)
 {
-	if (render_mode == FT_RENDER_MODE_NORMAL) {
-		return buf_row[x];
-	}
+	struct vec2 *tvarray = (struct vec2 *)vdata->tvarray[0].array;
+	const size_t first_vert = (size_t)first * 6;
+	const size_t num_verts = (size_t)count * 6;
 
-	const uint32_t byte_index = x / 8;
-	const uint8_t bit_index = x % 8;
-	const bool pixel_set = (buf_row[byte_index] >> (7 - bit_index)) & 1;
-	return pixel_set ? 255 : 0;
+	memmove(vdata->points, vdata->points + first_vert, num_verts * sizeof(struct vec3));
+	memmove(tvarray, tvarray + first_vert, num_verts * sizeof(struct vec2));
+	memmove(vdata->colors, vdata->colors + first_vert, num_verts * sizeof(uint32_t));
+
+	for (size_t i = 0; i < num_verts; i++)
+		vdata->points[i].y -= y;
 }
 
-void rasterize(struct ft2_source *srcdata, FT_GlyphSlot slot, const FT_Render_Mode render_mode, const uint32_t dx,
-	       const uint32_t dy)
+static void keep_lines(struct ft2_source *srcdata, struct gs_vb_data *vdata, size_t first, size_t kept)
 {
-	/**
-	 * The pitch's absolute value is the number of bytes taken by one bitmap
-	 * row, including padding.
-	 *
-	 * Source: https://www.freetype.org/freetype2/docs/reference/ft2-basic_types.html
-	 */
-	const int pitch = abs(slot->bitmap.pitch);
-
-	for (uint32_t y = 0; y < slot->bitmap.rows; y++) {
-		const uint32_t row_start = y * pitch;
-		const uint32_t row = (dy + y) * texbuf_w;
-
-		for (uint32_t x = 0; x < slot->bitmap.width; x++) {
-			const uint32_t row_pixel_position = dx + x;
-			const uint8_t pixel_value = get_pixel_value(&slot->bitmap.buffer[row_start], render_mode, x);
-			srcdata->texbuf[row_pixel_position + row] = pixel_value;
-		}
+	struct text_layout *layout = &srcdata->layout;
+	const struct text_line base = layout->lines.array[first];
+	const struct text_line *last = &layout->lines.array[first + kept - 1];
+	const uint32_t num_glyphs = last->first_glyph + last->num_glyphs - base.first_glyph;
+	const uint32_t shift = base.top - srcdata->max_h;
+
+	if (first) {
+		move_glyphs_up(vdata, base.first_glyph, num_glyphs, (float)shift * srcdata->scale);
+		memmove(layout->pages.array, layout->pages.array + base.first_glyph, num_glyphs * sizeof(uint32_t));
+		da_erase_range(layout->lines, 0, first);
+	}
+
+	da_resize(layout->lines, kept);
+	da_resize(layout->pages, num_glyphs);
+
+	for (size_t i = 0; i < kept; i++) {
+		struct text_line *line = &layout->lines.array[i];
+		line->start -= base.start;
+		line->first_glyph -= base.first_glyph;
+		line->top -= shift;
 	}
 }
 
-void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs)
+void fill_vertex_buffer(struct ft2_source *srcdata)
 {
-	if (!srcdata->font_face || !cache_glyphs)
+	struct text_layout *layout = &srcdata->layout;
+	struct gs_vb_data *vdata = gs_vertexbuffer_get_data(srcdata->vbuf);
+	if (vdata == NULL || !srcdata->text)
 		return;
 
-	FT_GlyphSlot slot = srcdata->font_face->glyph;
+	struct vec2 *tvarray = (struct vec2 *)vdata->tvarray[0].array;
+	uint32_t *col = (uint32_t *)vdata->colors;
+	const wchar_t *text = srcdata->text;
 
-	uint32_t dx = srcdata->texbuf_x;
-	uint32_t dy = srcdata->texbuf_y;
+	FT_UInt glyph_index = 0;
 
-	int32_t cached_glyphs = 0;
-	const size_t len = wcslen(cache_glyphs);
+	/* layout is in glyph pixels, vertices are scaled to output pixels */
+	const float scale = srcdata->scale;
+	const float offset = srcdata->outline_text ? 2.0f : 0.0f;
+	const uint32_t row_h = srcdata->max_h + 4;
+	uint32_t dx = 0, dy = srcdata->max_h;
+	uint32_t cur_glyph = 0;
+	size_t i = 0;
+
+	size_t first = 0, kept = 0;
+	if (layout_is_current(srcdata, offset))
+		kept = find_kept_lines(layout, text, &first);
+
+	if (kept) {
+		keep_lines(srcdata, vdata, first, kept);
+
+		const struct text_line *last = &layout->lines.array[kept - 1];
+		cur_glyph = last->first_glyph + last->num_glyphs;
+		dy = last->top + last->rows * row_h;
+		i = last->start + last->len + 1;
+	} else {
+		da_resize(layout->lines, 0);
+		da_resize(layout->pages, 0);
+	}
+
+	layout->font = srcdata->font;
+	layout->generation = srcdata->glyph_generation;
+	layout->max_h = srcdata->max_h;
+	layout->custom_width = srcdata->custom_width;
+	layout->color[0] = srcdata->color[0];
+	layout->color[1] = srcdata->color[1];
+	layout->scale = scale;
+	layout->offset = offset;
 
-	const FT_Render_Mode render_mode = get_render_mode(srcdata);
+	/* the last kept line is the end of the text */
+	const size_t len = wcslen(text);
+	if (i > len)
+		goto finish;
+
+	struct text_line *line = NULL;
+
+	for (;; i++) {
+		if (!line) {
+			line = da_push_back_new(layout->lines);
+			line->start = i;
+			line->first_glyph = cur_glyph;
+			line->top = dy;
+			line->rows = 1;
+			dx = 0;
+		}
 
-	for (size_t i = 0; i < len; i++) {
-		const FT_UInt glyph_index = FT_Get_Char_Index(srcdata->font_face, cache_glyphs[i]);
+		if (text[i] == 0 || text[i] == L'\n') {
+			line->len = i - line->start;
+			line->num_glyphs = cur_glyph - line->first_glyph;
+			dy = line->top + line->rows * row_h;
+			line = NULL;
 
-		if (src_glyph != NULL) {
+			if (text[i] == 0)
+				break;
 			continue;
 		}
 
-		load_glyph(srcdata, glyph_index, render_mode);
-		FT_Render_Glyph(slot, render_mode);
-
-		const uint32_t g_w = slot->bitmap.width;
-		const uint32_t g_h = slot->bitmap.rows;
+		// Skip filthy dual byte Windows line breaks
+		if (text[i] == L'\r')
+			continue;
 
-		if (srcdata->max_h < g_h) {
-			srcdata->max_h = g_h;
-		}
+		glyph_index = FT_Get_Char_Index(srcdata->font_face, text[i]);
+		if (src_glyph == NULL)
+			continue;
 
-		if (dx + g_w >= texbuf_w) {
+		if (srcdata->custom_width >= 100 &&
+		    offset + (float)(dx + src_glyph->xadv) * scale > (float)srcdata->custom_width) {
 			dx = 0;
-			dy += srcdata->max_h + 1;
+			line->rows++;
 		}
 
-		if (dy + g_h >= texbuf_h) {
-			blog(LOG_WARNING, "Out of space trying to render glyphs");
-			break;
-		}
+		const uint32_t row_y = line->top + (line->rows - 1) * row_h;
 
-		src_glyph = init_glyph(slot, dx, dy, g_w, g_h);
-		rasterize(srcdata, slot, render_mode, dx, dy);
+		set_v3_rect(vdata->points + (cur_glyph * 6), offset + ((float)dx + (float)src_glyph->xoff) * scale,
+			    ((float)row_y - (float)src_glyph->yoff) * scale, (float)src_glyph->w * scale,
+			    (float)src_glyph->h * scale);
+		set_v2_uv(tvarray + (cur_glyph * 6), src_glyph->u, src_glyph->v, src_glyph->u2, src_glyph->v2);
+		set_rect_colors2(col + (cur_glyph * 6), srcdata->color[0], srcdata->color[1]);
+		da_push_back(layout->pages, &src_glyph->page);
 
-		dx += (g_w + 1);
-		if (dx >= texbuf_w) {
-			dx = 0;
-			dy += srcdata->max_h;
-		}
+		dx += src_glyph->xadv;
+		if (dx > line->width)
+			line->width = dx;
 
-		cached_glyphs++;
+		const int32_t bottom = (int32_t)(row_y - line->top) - src_glyph->yoff + src_glyph->h;
+		if (cur_glyph == line->first_glyph || bottom > line->bottom)
+			line->bottom = bottom;
+		cur_glyph++;
 	}
 
-	srcdata->texbuf_x = dx;
-	srcdata->texbuf_y = dy;
+finish:
+	bfree(layout->text);
+	layout->text = bwstrdup(text);
 
-	if (cached_glyphs > 0) {
+	uint32_t max_x = 0, max_y = srcdata->max_h;
+	struct glyph_run *run = NULL;
 
-		obs_enter_graphics();
+	for (size_t l = 0; l < layout->lines.num; l++) {
+		const struct text_line *cur = &layout->lines.array[l];
+		if (cur->width > max_x)
+			max_x = cur->width;
+		if (cur->num_glyphs && (int64_t)cur->top + cur->bottom > (int64_t)max_y)
+			max_y = (uint32_t)((int64_t)cur->top + cur->bottom);
+	}
 
-		if (srcdata->tex != NULL) {
-			gs_texture_t *tmp_texture = srcdata->tex;
-			srcdata->tex = NULL;
-			gs_texture_destroy(tmp_texture);
+	for (uint32_t g = 0; g < layout->pages.num; g++) {
+		if (!run || run->page != layout->pages.array[g]) {
+			run = da_push_back_new(srcdata->runs);
+			run->page = layout->pages.array[g];
+			run->start = g * 6;
 		}
+		run->count += 6;
+	}
 
-		srcdata->tex = gs_texture_create(texbuf_w, texbuf_h, GS_A8, 1, (const uint8_t **)&srcdata->texbuf, 0);
+	if (srcdata->custom_width < 100)
+		srcdata->cx = (uint32_t)((float)max_x * scale);
+	srcdata->cy = (uint32_t)((float)max_y * scale);
+}
 
-		obs_leave_graphics();
-	}
+void cache_standard_glyphs(struct ft2_source *srcdata)
+{
+	cache_glyphs(srcdata, L"abcdefghijklmnopqrstuvwxyz"
+			      L"ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890"
+			      L"!@#$%^&*()-_=+,<.>/?\\|[]{}`~ \'\"\0");
+}
+
+FT_Render_Mode get_render_mode(struct ft2_source *srcdata)
+{
+	return srcdata->antialiasing ? FT_RENDER_MODE_NORMAL : FT_RENDER_MODE_MONO;
+}
+
+void load_glyph(struct ft2_source *srcdata, const FT_UInt glyph_index, const FT_Render_Mode render_mode)
+{
+	const FT_Int32 load_mode = render_mode == FT_RENDER_MODE_MONO ? FT_LOAD_TARGET_MONO : FT_LOAD_DEFAULT;
+	FT_Load_Glyph(srcdata->font_face, glyph_index, load_mode);
+}
+
+void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs)
+{
+	if (!srcdata->font || !cache_glyphs)
+		return;
+
+	glyph_cache_add_glyphs(srcdata->font, cache_glyphs);
+
+	if (srcdata->max_h < srcdata->font->max_h)
+		srcdata->max_h = srcdata->font->max_h;
 }
 
 time_t get_modified_timestamp(char *filename)
@@ -356,6 +441,27 @@ time_t get_modified_timestamp(char *filename)
 	return stats.st_mtime;
 }
 
+/* remembers where reading the file stopped, along with the bytes before it */
+static void remember_file_end(struct ft2_source *srcdata, int64_t size, const char *data, size_t data_size)
+{
+	const size_t max_tail = sizeof(srcdata->file_tail);
+
+	if (data_size >= max_tail) {
+		memcpy(srcdata->file_tail, data + data_size - max_tail, max_tail);
+		srcdata->file_tail_size = max_tail;
+	} else {
+		size_t keep = srcdata->file_tail_size;
+		if (keep > max_tail - data_size)
+			keep = max_tail - data_size;
+
+		memmove(srcdata->file_tail, srcdata->file_tail + srcdata->file_tail_size - keep, keep);
+		memcpy(srcdata->file_tail + keep, data, data_size);
+		srcdata->file_tail_size = keep + data_size;
+	}
+
+	srcdata->file_size = size;
+}
+
 static void remove_cr(wchar_t *source)
 {
 	int j = 0;
@@ -375,6 +481,9 @@ void load_text_from_file(struct ft2_source *srcdata, const char *filename)
 	uint16_t header = 0;
 	size_t bytes_read;
 
+	srcdata->file_size = -1;
+	srcdata->file_tail_size = 0;
+
 	tmp_file = os_fopen(filename, "rb");
 	if (tmp_file == NULL) {
 		if (!srcdata->file_load_failed) {
@@ -409,6 +518,9 @@ void load_text_from_file(struct ft2_source *srcdata, const char *filename)
 	bytes_read = fread(tmp_read, filesize, 1, tmp_file);
 	fclose(tmp_file);
 
+	if (bytes_read == 1)
+		remember_file_end(srcdata, filesize, tmp_read, filesize);
+
 	if (srcdata->text != NULL) {
 		bfree(srcdata->text);
 		srcdata->text = NULL;
@@ -431,6 +543,9 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 
 	bool utf16 = false;
 
+	srcdata->file_size = -1;
+	srcdata->file_tail_size = 0;
+
 	tmp_file = fopen(filename, "rb");
 	if (tmp_file == NULL) {
 		if (!srcdata->file_load_failed) {
@@ -491,6 +606,9 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 	bytes_read = fread(tmp_read, filesize - cur_pos, 1, tmp_file);
 	fclose(tmp_file);
 
+	if (bytes_read == 1)
+		remember_file_end(srcdata, filesize, tmp_read, filesize - cur_pos);
+
 	if (srcdata->text != NULL) {
 		bfree(srcdata->text);
 		srcdata->text = NULL;
@@ -502,32 +620,102 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 	bfree(tmp_read);
 }
 
-uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata)
+/* size of data without a UTF-8 sequence that is still being written */
+static size_t complete_utf8_size(const char *data, size_t size)
 {
-	if (!text) {
-		return 0;
+	for (size_t i = 1; i <= 4 && i <= size; i++) {
+		const uint8_t c = (uint8_t)data[size - i];
+		if ((c & 0xC0) == 0x80)
+			continue;
+
+		const size_t seq = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+		return seq > i ? size - i : size;
 	}
 
-	FT_GlyphSlot slot = srcdata->font_face->glyph;
-	uint32_t w = 0, max_w = 0;
+	return size;
+}
+
+static void trim_log_lines(wchar_t *text, uint32_t log_lines)
+{
 	const size_t len = wcslen(text);
-	for (size_t i = 0; i < len; i++) {
-		const FT_UInt glyph_index = FT_Get_Char_Index(srcdata->font_face, text[i]);
-
-		if (text[i] == L'\n')
-			w = 0;
-		else {
-			if (src_glyph) {
-				// Use the cached values.
-				w += src_glyph->xadv;
-			} else {
-				load_glyph(srcdata, glyph_index, get_render_mode(srcdata));
-				w += slot->advance.x >> 6;
-			}
-			if (w > max_w)
-				max_w = w;
+	uint32_t line_breaks = 0;
+
+	for (size_t i = len; i > 0; i--) {
+		if (text[i - 1] == L'\n' && ++line_breaks > log_lines) {
+			memmove(text, text + i, (len - i + 1) * sizeof(wchar_t));
+			return;
 		}
 	}
+}
+
+/* Reads what was appended to the file since it was last read. Returns false
+ * if the file has to be read again, like when it was rewritten, is in UTF-16
+ * or is shown as a word wrapped log. */
+bool append_text_from_file(struct ft2_source *srcdata, const char *filename, bool *changed)
+{
+	const int64_t read_size = srcdata->file_size;
+	const size_t tail_size = srcdata->file_tail_size;
+	char tail[sizeof(srcdata->file_tail)];
+	char *tmp_read = NULL;
+	wchar_t *appended = NULL;
+	bool success = false;
+
+	if (read_size < 0 || !srcdata->text)
+		return false;
+
+	/* word wrap turns spaces in the text into line breaks, which can't be
+	 * told apart from the lines of the log anymore */
+	if (srcdata->log_mode && srcdata->word_wrap && srcdata->custom_width > 100)
+		return false;
+
+	FILE *tmp_file = os_fopen(filename, "rb");
+	if (tmp_file == NULL)
+		return false;
+
+	os_fseeki64(tmp_file, 0, SEEK_END);
+	const int64_t filesize = os_ftelli64(tmp_file);
+
+	/* the file was rewritten if it shrank or the end that was read changed */
+	if (filesize < read_size)
+		goto finish;
+	if (os_fseeki64(tmp_file, read_size - (int64_t)tail_size, SEEK_SET) != 0)
+		goto finish;
+	if (fread(tail, 1, tail_size, tmp_file) != tail_size || memcmp(tail, srcdata->file_tail, tail_size) != 0)
+		goto finish;
+
+	const size_t new_size = (size_t)(filesize - read_size);
+
+	if (new_size) {
+		tmp_read = bmalloc(new_size);
+		if (fread(tmp_read, 1, new_size, tmp_file) != new_size)
+			goto finish;
+	}
+
+	const size_t size = complete_utf8_size(tmp_read, new_size);
+	success = true;
+	*changed = false;
+	if (!size)
+		goto finish;
+
+	remember_file_end(srcdata, read_size + (int64_t)size, tmp_read, size);
+
+	if (os_utf8_to_wcs_ptr(tmp_read, size, &appended) && appended) {
+		remove_cr(appended);
+
+		const size_t len = wcslen(srcdata->text);
+		const size_t appended_len = wcslen(appended);
+
+		srcdata->text = brealloc(srcdata->text, (len + appended_len + 1) * sizeof(wchar_t));
+		wmemcpy(srcdata->text + len, appended, appended_len + 1);
+
+		if (srcdata->log_mode)
+			trim_log_lines(srcdata->text, srcdata->log_lines);
+		*changed = true;
+	}
 
-	return max_w;
+finish:
+	bfree(appended);
+	bfree(tmp_read);
+	fclose(tmp_file);
+	return success;
 }
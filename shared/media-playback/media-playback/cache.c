@@ -32,6 +32,123 @@ static bool mp_cache_reset(mp_cache_t *c);
 
 static int64_t base_sys_ts = 0;
 
+/* caches of all media sources share a budget of a quarter of the system's
+ * memory.  when a cache needs more, the least recently used caches are
+ * evicted and go back to decoding on demand. */
+#define CACHE_BUDGET_DIVISOR 4
+#define EVICT_TIMEOUT_NS 2000000000ULL
+#define LAST_USED_INTERVAL_NS 1000000000ULL
+
+static pthread_mutex_t budget_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(mp_cache_t *) budget_caches;
+static uint64_t budget_size = 0;
+static uint64_t budget_used = 0;
+
+static mp_cache_t *find_eviction_candidate(mp_cache_t *c, bool *pending)
+{
+	mp_cache_t *victim = NULL;
+
+	*pending = false;
+
+	for (size_t i = 0; i < budget_caches.num; i++) {
+		mp_cache_t *other = budget_caches.array[i];
+		if (other == c)
+			continue;
+
+		if (os_atomic_load_bool(&other->evict)) {
+			*pending = true;
+		} else if (other->evictable && (!victim || other->last_used < victim->last_used)) {
+			victim = other;
+		}
+	}
+
+	return victim;
+}
+
+static bool budget_reserve(mp_cache_t *c, size_t size)
+{
+	uint64_t timeout = os_gettime_ns() + EVICT_TIMEOUT_NS;
+
+	pthread_mutex_lock(&budget_mutex);
+
+	if (!budget_size)
+		budget_size = os_get_sys_total_size() / CACHE_BUDGET_DIVISOR;
+	if (da_find(budget_caches, &c, 0) == DARRAY_INVALID)
+		da_push_back(budget_caches, &c);
+
+	while (budget_used + size > budget_size) {
+		bool pending;
+		mp_cache_t *victim = find_eviction_candidate(c, &pending);
+
+		/* only evict one cache at a time, the next victim is chosen once
+		 * the pending one has released its budget */
+		if (!pending && victim) {
+			os_atomic_set_bool(&victim->evict, true);
+			os_sem_post(victim->sem);
+			pending = true;
+		}
+
+		if (!pending || os_gettime_ns() > timeout) {
+			pthread_mutex_unlock(&budget_mutex);
+			return false;
+		}
+
+		/* evicted caches free their frames and leave budget_caches from
+		 * their own thread */
+		pthread_mutex_unlock(&budget_mutex);
+		os_sleep_ms(10);
+		pthread_mutex_lock(&budget_mutex);
+	}
+
+	budget_used += size;
+	c->cache_size += size;
+
+	pthread_mutex_unlock(&budget_mutex);
+	return true;
+}
+
+static void budget_release(mp_cache_t *c)
+{
+	pthread_mutex_lock(&budget_mutex);
+
+	budget_used -= c->cache_size;
+	c->cache_size = 0;
+	c->evictable = false;
+
+	da_erase_item(budget_caches, &c);
+	if (!budget_caches.num)
+		da_free(budget_caches);
+
+	pthread_mutex_unlock(&budget_mutex);
+}
+
+static void budget_set_evictable(mp_cache_t *c)
+{
+	pthread_mutex_lock(&budget_mutex);
+	c->evictable = true;
+	c->last_used = os_gettime_ns();
+
+	blog(LOG_INFO, "MP: Cached '%s' in %.1f MB (%.1f MB decoded), %.1f of %.1f MB of the cache budget in use",
+	     c->path, (double)c->cache_size / 1048576.0, (double)c->raw_size / 1048576.0,
+	     (double)budget_used / 1048576.0, (double)budget_size / 1048576.0);
+
+	pthread_mutex_unlock(&budget_mutex);
+}
+
+static void budget_touch(mp_cache_t *c)
+{
+	uint64_t ts = os_gettime_ns();
+
+	/* only written by the cache thread, so it can be read without the
+	 * lock here */
+	if (ts - c->last_used < LAST_USED_INTERVAL_NS)
+		return;
+
+	pthread_mutex_lock(&budget_mutex);
+	c->last_used = ts;
+	pthread_mutex_unlock(&budget_mutex);
+}
+
 #define v_eof(c) (c->cur_v_idx == c->video_frames.num)
 #define a_eof(c) (c->cur_a_idx == c->audio_segments.num)
 
@@ -119,7 +236,7 @@ bool mp_cache_decode(mp_cache_t *c)
 
 	mp_media_reset(m);
 
-	while (!mp_media_eof(m)) {
+	while (!mp_media_eof(m) && !c->over_budget) {
 		if (m->has_video)
 			mp_media_next_video(m, false);
 		if (m->has_audio)
@@ -154,7 +271,7 @@ static void seek_to(mp_cache_t *c, int64_t pos)
 		struct obs_source_frame *v;
 
 		for (size_t i = 0; i < c->video_frames.num; i++) {
-			v = &c->video_frames.array[i];
+			v = &c->video_frames.array[i].frame;
 			new_v_idx = i;
 			if ((int64_t)v->timestamp >= pos) {
 				break;
@@ -165,7 +282,7 @@ static void seek_to(mp_cache_t *c, int64_t pos)
 		if (next_idx == c->video_frames.num) {
 			c->next_v_ts = (int64_t)v->timestamp + c->final_v_duration;
 		} else {
-			struct obs_source_frame *next = &c->video_frames.array[next_idx];
+			struct obs_source_frame *next = &c->video_frames.array[next_idx].frame;
 			c->next_v_ts = (int64_t)next->timestamp;
 		}
 	}
@@ -209,7 +326,7 @@ static inline void calc_next_v_ts(mp_cache_t *c, struct obs_source_frame *frame)
 {
 	int64_t offset;
 	if (c->next_v_idx < c->video_frames.num) {
-		struct obs_source_frame *next = &c->video_frames.array[c->next_v_idx];
+		struct obs_source_frame *next = &c->video_frames.array[c->next_v_idx].frame;
 		offset = (int64_t)(next->timestamp - frame->timestamp);
 	} else {
 		offset = c->final_v_duration;
@@ -231,6 +348,207 @@ static inline void calc_next_a_ts(mp_cache_t *c, struct obs_source_audio *audio)
 	c->next_a_ts += offset;
 }
 
+enum packed_row {
+	ROW_RAW,
+	ROW_REPEAT,
+	ROW_RLE,
+};
+
+static inline uint32_t get_plane_height(enum video_format format, size_t plane, uint32_t height)
+{
+	switch (format) {
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_NV12:
+	case VIDEO_FORMAT_I010:
+	case VIDEO_FORMAT_P010:
+	case VIDEO_FORMAT_I40A:
+		return (plane == 1 || plane == 2) ? (height + 1) / 2 : height;
+	default:
+		return height;
+	}
+}
+
+static void ensure_frame(struct obs_source_frame *frame, enum video_format format, uint32_t width, uint32_t height)
+{
+	if (frame->data[0] && frame->format == format && frame->width == width && frame->height == height)
+		return;
+
+	obs_source_frame_free(frame);
+	obs_source_frame_init(frame, format, width, height);
+}
+
+/* PackBits: a header byte n < 128 is followed by n + 1 literal bytes, a
+ * header byte n > 128 repeats the byte after it 257 - n times */
+static size_t rle_encode(uint8_t *out, const uint8_t *in, size_t size)
+{
+	uint8_t *start = out;
+	size_t i = 0;
+
+	while (i < size) {
+		size_t run = 1;
+		while (i + run < size && run < 128 && in[i + run] == in[i])
+			run++;
+
+		if (run >= 3) {
+			*(out++) = (uint8_t)(257 - run);
+			*(out++) = in[i];
+			i += run;
+			continue;
+		}
+
+		/* literals up to the next run of at least 3 */
+		size_t lit = 0;
+		while (i + lit < size && lit < 128) {
+			const uint8_t *p = in + i + lit;
+			if (i + lit + 2 < size && p[0] == p[1] && p[0] == p[2])
+				break;
+			lit++;
+		}
+
+		*(out++) = (uint8_t)(lit - 1);
+		memcpy(out, in + i, lit);
+		out += lit;
+		i += lit;
+	}
+
+	return (size_t)(out - start);
+}
+
+static bool rle_decode(uint8_t *out, size_t size, const uint8_t **in, const uint8_t *end)
+{
+	const uint8_t *p = *in;
+	size_t i = 0;
+
+	while (i < size) {
+		if (p >= end)
+			return false;
+
+		uint8_t header = *(p++);
+		if (header < 128) {
+			size_t n = (size_t)header + 1;
+			if (n > size - i || n > (size_t)(end - p))
+				return false;
+			memcpy(out + i, p, n);
+			p += n;
+			i += n;
+		} else {
+			size_t n = 257 - (size_t)header;
+			if (n > size - i || p >= end)
+				return false;
+			memset(out + i, *(p++), n);
+			i += n;
+		}
+	}
+
+	*in = p;
+	return true;
+}
+
+/* rows are stored as is, as a repeat of the row above, or run length
+ * encoded when that is smaller, which keeps unpacking close to a memcpy.
+ * the packed frame is left in pack_buf. */
+static bool pack_frame(mp_cache_t *c, struct mp_cached_frame *cf, const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *layout = &c->unpacked;
+	size_t bound = 0;
+
+	ensure_frame(layout, frame->format, frame->width, frame->height);
+	if (!layout->data[0])
+		return false;
+
+	cf->frame = *frame;
+	memset(cf->frame.data, 0, sizeof(cf->frame.data));
+
+	for (size_t p = 0; p < MAX_AV_PLANES && layout->data[p]; p++) {
+		uint32_t rows = get_plane_height(frame->format, p, frame->height);
+		uint32_t row = frame->linesize[p] < layout->linesize[p] ? frame->linesize[p] : layout->linesize[p];
+
+		cf->frame.linesize[p] = row;
+		bound += (size_t)rows * (row + row / 128 + 2);
+	}
+
+	da_resize(c->pack_buf, bound);
+	uint8_t *out = c->pack_buf.array;
+
+	for (size_t p = 0; p < MAX_AV_PLANES && layout->data[p]; p++) {
+		uint32_t rows = get_plane_height(frame->format, p, frame->height);
+		uint32_t row = cf->frame.linesize[p];
+		const uint8_t *prev = NULL;
+
+		for (uint32_t y = 0; y < rows; y++) {
+			const uint8_t *in = frame->data[p] + (size_t)y * frame->linesize[p];
+
+			if (prev && memcmp(in, prev, row) == 0) {
+				*(out++) = ROW_REPEAT;
+			} else {
+				uint8_t *type = out++;
+				size_t size = rle_encode(out, in, row);
+
+				if (size < row) {
+					*type = ROW_RLE;
+					out += size;
+				} else {
+					*type = ROW_RAW;
+					memcpy(out, in, row);
+					out += row;
+				}
+			}
+
+			prev = in;
+		}
+	}
+
+	cf->size = (size_t)(out - c->pack_buf.array);
+	return true;
+}
+
+static bool unpack_frame(mp_cache_t *c, const struct mp_cached_frame *cf, struct obs_source_frame *out_frame)
+{
+	struct obs_source_frame *dst = &c->unpacked;
+	const uint8_t *in = cf->packed;
+	const uint8_t *end = in + cf->size;
+
+	ensure_frame(dst, cf->frame.format, cf->frame.width, cf->frame.height);
+	if (!dst->data[0])
+		return false;
+
+	for (size_t p = 0; p < MAX_AV_PLANES && dst->data[p]; p++) {
+		uint32_t rows = get_plane_height(cf->frame.format, p, cf->frame.height);
+		uint32_t row = cf->frame.linesize[p];
+
+		for (uint32_t y = 0; y < rows; y++) {
+			uint8_t *out = dst->data[p] + (size_t)y * dst->linesize[p];
+
+			if (in >= end)
+				return false;
+
+			switch (*(in++)) {
+			case ROW_REPEAT:
+				if (!y)
+					return false;
+				memcpy(out, out - dst->linesize[p], row);
+				break;
+			case ROW_RLE:
+				if (!rle_decode(out, row, &in, end))
+					return false;
+				break;
+			default:
+				if ((size_t)(end - in) < row)
+					return false;
+				memcpy(out, in, row);
+				in += row;
+			}
+		}
+	}
+
+	*out_frame = cf->frame;
+	for (size_t p = 0; p < MAX_AV_PLANES; p++) {
+		out_frame->data[p] = dst->data[p];
+		out_frame->linesize[p] = dst->linesize[p];
+	}
+	return true;
+}
+
 static void mp_cache_next_video(mp_cache_t *c, bool preload)
 {
 	/* eof check */
@@ -240,8 +558,12 @@ static void mp_cache_next_video(mp_cache_t *c, bool preload)
 		return;
 	}
 
-	struct obs_source_frame *frame = &c->video_frames.array[c->next_v_idx];
-	struct obs_source_frame dup = *frame;
+	struct mp_cached_frame *cf = &c->video_frames.array[c->next_v_idx];
+	struct obs_source_frame *frame = &cf->frame;
+	struct obs_source_frame dup;
+
+	if (!unpack_frame(c, cf, &dup))
+		return;
 
 	dup.timestamp = c->base_ts + dup.timestamp - c->start_ts + c->play_sys_ts - base_sys_ts;
 
@@ -314,7 +636,7 @@ static bool mp_cache_reset(mp_cache_t *c)
 	if (c->has_video) {
 		size_t next_idx = c->video_frames.num > 1 ? 1 : 0;
 		c->cur_v_idx = c->next_v_idx = 0;
-		c->next_v_ts = c->video_frames.array[next_idx].timestamp;
+		c->next_v_ts = c->video_frames.array[next_idx].frame.timestamp;
 	}
 	if (c->has_audio) {
 		size_t next_idx = c->audio_segments.num > 1 ? 1 : 0;
@@ -365,6 +687,54 @@ static void mp_cache_calc_next_ns(mp_cache_t *c)
 	c->next_pts_ns = min_next_ns;
 }
 
+static void free_frames(mp_cache_t *c)
+{
+	for (size_t i = 0; i < c->video_frames.num; i++)
+		bfree(c->video_frames.array[i].packed);
+	for (size_t i = 0; i < c->audio_segments.num; i++) {
+		struct obs_source_audio *a = &c->audio_segments.array[i];
+		bfree((void *)a->data[0]);
+	}
+	da_free(c->video_frames);
+	da_free(c->audio_segments);
+
+	obs_source_frame_free(&c->unpacked);
+	obs_source_frame_free(&c->converted);
+	da_free(c->pack_buf);
+}
+
+/* hands playback over to m, continuing where the cache left off */
+static bool mp_cache_go_on_demand(mp_cache_t *c)
+{
+	int64_t pos = c->has_video || c->has_audio ? mp_cache_get_current_time(c) : 0;
+	bool success;
+
+	free_frames(c);
+	budget_release(c);
+
+	pthread_mutex_lock(&c->mutex);
+
+	success = mp_media_init(&c->m, &c->info);
+	if (success) {
+		c->on_demand = true;
+
+		if (c->active) {
+			mp_media_play(&c->m, c->looping, false);
+			if (pos > 0)
+				mp_media_seek(&c->m, pos);
+			if (c->pause)
+				mp_media_play_pause(&c->m, true);
+		}
+	} else {
+		blog(LOG_WARNING, "MP: Failed to reopen '%s' after its cache was released", c->path);
+		c->has_video = false;
+		c->has_audio = false;
+	}
+
+	pthread_mutex_unlock(&c->mutex);
+	return success;
+}
+
 static inline bool mp_cache_thread(mp_cache_t *c)
 {
 	os_set_thread_name("mp_cache_thread");
@@ -373,6 +743,13 @@ static inline bool mp_cache_thread(mp_cache_t *c)
 		return false;
 	}
 
+	if (c->over_budget) {
+		blog(LOG_INFO, "MP: Not enough cache budget left for '%s', decoding it on demand", c->path);
+		return mp_cache_go_on_demand(c);
+	}
+
+	budget_set_evictable(c);
+
 	for (;;) {
 		bool reset, kill, is_active, seek, pause, reset_time, preload_frame;
 		int64_t seek_pos;
@@ -413,6 +790,10 @@ static inline bool mp_cache_thread(mp_cache_t *c)
 		if (kill) {
 			break;
 		}
+		if (os_atomic_load_bool(&c->evict)) {
+			blog(LOG_INFO, "MP: Cache budget exceeded, '%s' now decodes on demand", c->path);
+			return mp_cache_go_on_demand(c);
+		}
 		if (reset) {
 			mp_cache_reset(c);
 			continue;
@@ -432,11 +813,16 @@ static inline bool mp_cache_thread(mp_cache_t *c)
 		if (pause)
 			continue;
 
-		if (preload_frame)
-			c->v_preload_cb(c->opaque, &c->video_frames.array[0]);
+		if (preload_frame && c->video_frames.num) {
+			struct obs_source_frame frame;
+			if (unpack_frame(c, &c->video_frames.array[0], &frame))
+				c->v_preload_cb(c->opaque, &frame);
+		}
 
 		/* frames are ready */
 		if (is_active && !timeout) {
+			budget_touch(c);
+
 			if (c->has_video)
 				mp_cache_next_video(c, false);
 			if (c->has_audio)
@@ -465,19 +851,145 @@ static void *mp_cache_thread_start(void *opaque)
 	return NULL;
 }
 
+static inline bool nv12_compatible(enum video_format format)
+{
+	switch (format) {
+	case VIDEO_FORMAT_I444:
+	case VIDEO_FORMAT_I422:
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_UYVY:
+	case VIDEO_FORMAT_YVYU:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* sum of the two chroma samples covering luma pixels x and x + 1 of row y */
+static inline void get_chroma_pair(const struct obs_source_frame *f, uint32_t x, uint32_t y, uint32_t *u,
+				   uint32_t *v)
+{
+	uint32_t x1 = x + 1 < f->width ? x + 1 : x;
+	const uint8_t *row;
+
+	switch (f->format) {
+	case VIDEO_FORMAT_I444:
+		row = f->data[1] + (size_t)y * f->linesize[1];
+		*u = row[x] + row[x1];
+		row = f->data[2] + (size_t)y * f->linesize[2];
+		*v = row[x] + row[x1];
+		return;
+	case VIDEO_FORMAT_I422:
+		*u = f->data[1][(size_t)y * f->linesize[1] + x / 2] * 2;
+		*v = f->data[2][(size_t)y * f->linesize[2] + x / 2] * 2;
+		return;
+	default:
+		break;
+	}
+
+	row = f->data[0] + (size_t)y * f->linesize[0] + (x / 2) * 4;
+
+	switch (f->format) {
+	case VIDEO_FORMAT_YUY2:
+		*u = row[1] * 2;
+		*v = row[3] * 2;
+		break;
+	case VIDEO_FORMAT_UYVY:
+		*u = row[0] * 2;
+		*v = row[2] * 2;
+		break;
+	default:
+		*u = row[3] * 2;
+		*v = row[1] * 2;
+	}
+}
+
+static void convert_to_nv12(struct obs_source_frame *dst, const struct obs_source_frame *src)
+{
+	uint32_t w = src->width;
+	uint32_t h = src->height;
+	bool planar = src->format == VIDEO_FORMAT_I444 || src->format == VIDEO_FORMAT_I422;
+	size_t y_offset = src->format == VIDEO_FORMAT_UYVY ? 1 : 0;
+
+	for (uint32_t y = 0; y < h; y++) {
+		const uint8_t *in = src->data[0] + (size_t)y * src->linesize[0];
+		uint8_t *out = dst->data[0] + (size_t)y * dst->linesize[0];
+
+		if (planar) {
+			memcpy(out, in, w);
+		} else {
+			for (uint32_t x = 0; x < w; x++)
+				out[x] = in[x * 2 + y_offset];
+		}
+	}
+
+	for (uint32_t y = 0; y < (h + 1) / 2; y++) {
+		uint32_t y0 = y * 2;
+		uint32_t y1 = y0 + 1 < h ? y0 + 1 : y0;
+		uint8_t *out = dst->data[1] + (size_t)y * dst->linesize[1];
+
+		for (uint32_t x = 0; x < w; x += 2) {
+			uint32_t u0, v0, u1, v1;
+			get_chroma_pair(src, x, y0, &u0, &v0);
+			get_chroma_pair(src, x, y1, &u1, &v1);
+
+			*(out++) = (uint8_t)((u0 + u1 + 2) / 4);
+			*(out++) = (uint8_t)((v0 + v1 + 2) / 4);
+		}
+	}
+}
+
+static size_t get_frame_size(const struct obs_source_frame *frame)
+{
+	size_t size = 0;
+
+	for (size_t p = 0; p < MAX_AV_PLANES && frame->data[p]; p++) {
+		uint32_t rows = get_plane_height(frame->format, p, frame->height);
+		size += (size_t)rows * frame->linesize[p];
+	}
+
+	return size;
+}
+
 static void fill_video(void *data, struct obs_source_frame *frame)
 {
 	mp_cache_t *c = data;
-	struct obs_source_frame dup;
+	struct obs_source_frame *src = frame;
+	struct obs_source_frame nv12;
+	struct mp_cached_frame cf;
+
+	if (c->over_budget)
+		return;
 
-	obs_source_frame_init(&dup, frame->format, frame->width, frame->height);
-	obs_source_frame_copy(&dup, frame);
+	/* 4:2:0 is plenty for playback and is what most of these are
+	 * encoded as anyway */
+	if (nv12_compatible(frame->format)) {
+		ensure_frame(&c->converted, VIDEO_FORMAT_NV12, frame->width, frame->height);
+		if (!c->converted.data[0])
+			return;
 
-	dup.timestamp = frame->timestamp;
+		convert_to_nv12(&c->converted, frame);
 
+		nv12 = *frame;
+		nv12.format = VIDEO_FORMAT_NV12;
+		memcpy(nv12.data, c->converted.data, sizeof(nv12.data));
+		memcpy(nv12.linesize, c->converted.linesize, sizeof(nv12.linesize));
+		src = &nv12;
+	}
+
+	if (!pack_frame(c, &cf, src))
+		return;
+	if (!budget_reserve(c, cf.size)) {
+		c->over_budget = true;
+		return;
+	}
+
+	cf.packed = bmemdup(c->pack_buf.array, cf.size);
+
+	c->raw_size += get_frame_size(frame);
 	c->final_v_duration = c->m.v.last_duration;
 
-	da_push_back(c->video_frames, &dup);
+	da_push_back(c->video_frames, &cf);
 }
 
 static void fill_audio(void *data, struct obs_source_audio *audio)
@@ -485,7 +997,16 @@ static void fill_audio(void *data, struct obs_source_audio *audio)
 	mp_cache_t *c = data;
 	struct obs_source_audio dup = *audio;
 
+	if (c->over_budget)
+		return;
+
 	size_t size = get_total_audio_size(dup.format, dup.speakers, dup.frames);
+	if (!budget_reserve(c, size)) {
+		c->over_budget = true;
+		return;
+	}
+
+	c->raw_size += size;
 	dup.data[0] = bmalloc(size);
 
 	size_t planes = get_audio_planes(dup.format, dup.speakers);
@@ -522,6 +1043,15 @@ static inline bool mp_cache_init_internal(mp_cache_t *c, const struct mp_media_i
 
 	c->path = info->path ? bstrdup(info->path) : NULL;
 	c->format_name = info->format ? bstrdup(info->format) : NULL;
+	c->index_dir = info->index_dir ? bstrdup(info->index_dir) : NULL;
+	c->ffmpeg_options = info->ffmpeg_options ? bstrdup(info->ffmpeg_options) : NULL;
+
+	c->info = *info;
+	c->info.path = c->path;
+	c->info.format = c->format_name;
+	c->info.index_dir = c->index_dir;
+	c->info.ffmpeg_options = c->ffmpeg_options;
+	c->info.full_decode = false;
 
 	if (pthread_create(&c->thread, NULL, mp_cache_thread_start, c) != 0) {
 		blog(LOG_WARNING, "MP: Could not create media thread");
@@ -561,7 +1091,6 @@ bool mp_cache_init(mp_cache_t *c, const struct mp_media_info *info)
 	c->v_cb = info->v_cb;
 	c->a_cb = info->a_cb;
 	c->stop_cb = info->stop_cb;
-	c->ffmpeg_options = info->ffmpeg_options;
 	c->v_seek_cb = info->v_seek_cb;
 	c->v_preload_cb = info->v_preload_cb;
 	c->request_preload = info->request_preload;
@@ -602,22 +1131,17 @@ void mp_cache_free(mp_cache_t *c)
 	mp_cache_stop(c);
 	mp_kill_thread(c);
 
-	if (c->m.fmt)
+	if (c->on_demand || c->m.fmt)
 		mp_media_free(&c->m);
 
-	for (size_t i = 0; i < c->video_frames.num; i++) {
-		struct obs_source_frame *f = &c->video_frames.array[i];
-		obs_source_frame_free(f);
-	}
-	for (size_t i = 0; i < c->audio_segments.num; i++) {
-		struct obs_source_audio *a = &c->audio_segments.array[i];
-		bfree((void *)a->data[0]);
-	}
-	da_free(c->video_frames);
-	da_free(c->audio_segments);
+	/* other caches may still post the semaphore until released */
+	budget_release(c);
+	free_frames(c);
 
 	bfree(c->path);
 	bfree(c->format_name);
+	bfree(c->index_dir);
+	bfree(c->ffmpeg_options);
 	pthread_mutex_destroy(&c->mutex);
 	os_sem_destroy(c->sem);
 	memset(c, 0, sizeof(*c));
@@ -627,7 +1151,9 @@ void mp_cache_play(mp_cache_t *c, bool loop)
 {
 	pthread_mutex_lock(&c->mutex);
 
-	if (c->active)
+	if (c->on_demand)
+		mp_media_play(&c->m, loop, false);
+	else if (c->active)
 		c->reset = true;
 
 	c->looping = loop;
@@ -641,6 +1167,8 @@ void mp_cache_play(mp_cache_t *c, bool loop)
 void mp_cache_play_pause(mp_cache_t *c, bool pause)
 {
 	pthread_mutex_lock(&c->mutex);
+	if (c->on_demand)
+		mp_media_play_pause(&c->m, pause);
 	if (c->active) {
 		c->pause = pause;
 		c->reset_ts = !pause;
@@ -653,6 +1181,8 @@ void mp_cache_play_pause(mp_cache_t *c, bool pause)
 void mp_cache_stop(mp_cache_t *c)
 {
 	pthread_mutex_lock(&c->mutex);
+	if (c->on_demand)
+		mp_media_stop(&c->m);
 	if (c->active) {
 		c->reset = true;
 		c->active = false;
@@ -667,7 +1197,10 @@ void mp_cache_preload_frame(mp_cache_t *c)
 {
 	if (c->request_preload && c->thread_valid && c->v_preload_cb) {
 		pthread_mutex_lock(&c->mutex);
-		c->preload_frame = true;
+		if (c->on_demand)
+			mp_media_preload_frame(&c->m);
+		else
+			c->preload_frame = true;
 		pthread_mutex_unlock(&c->mutex);
 		os_sem_post(c->sem);
 	}
@@ -675,13 +1208,17 @@ void mp_cache_preload_frame(mp_cache_t *c)
 
 int64_t mp_cache_get_current_time(mp_cache_t *c)
 {
+	if (c->on_demand)
+		return mp_media_get_current_time(&c->m);
 	return mp_cache_get_base_pts(c) * (int64_t)c->speed / 100000000LL;
 }
 
 void mp_cache_seek(mp_cache_t *c, int64_t pos)
 {
 	pthread_mutex_lock(&c->mutex);
-	if (c->active) {
+	if (c->on_demand) {
+		mp_media_seek(&c->m, pos);
+	} else if (c->active) {
 		c->seek = true;
 		c->seek_pos = pos * 1000;
 	}
@@ -692,6 +1229,8 @@ void mp_cache_seek(mp_cache_t *c, int64_t pos)
 
 int64_t mp_cache_get_frames(mp_cache_t *c)
 {
+	if (c->on_demand)
+		return mp_media_get_frames(&c->m);
 	return c->video_frames.num;
 }
 
@@ -699,3 +1238,14 @@ int64_t mp_cache_get_duration(mp_cache_t *c)
 {
 	return c->media_duration;
 }
+
+size_t mp_cache_get_size(mp_cache_t *c)
+{
+	size_t size;
+
+	pthread_mutex_lock(&budget_mutex);
+	size = c->cache_size;
+	pthread_mutex_unlock(&budget_mutex);
+
+	return size;
+}
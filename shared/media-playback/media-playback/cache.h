@@ -22,6 +22,14 @@
 
 #include "media.h"
 
+/* frame with all of its planes packed into one allocation, the linesizes of
+ * frame are the sizes of the packed rows and its data pointers are unused */
+struct mp_cached_frame {
+	struct obs_source_frame frame;
+	uint8_t *packed;
+	size_t size;
+};
+
 struct mp_cache {
 	mp_video_cb v_preload_cb;
 	mp_video_cb v_seek_cb;
@@ -51,8 +59,11 @@ struct mp_cache {
 	bool thread_valid;
 	pthread_t thread;
 
-	DARRAY(struct obs_source_frame) video_frames;
+	DARRAY(struct mp_cached_frame) video_frames;
 	DARRAY(struct obs_source_audio) audio_segments;
+	struct obs_source_frame unpacked;
+	struct obs_source_frame converted;
+	DARRAY(uint8_t) pack_buf;
 
 	size_t cur_v_idx;
 	size_t cur_a_idx;
@@ -79,6 +90,18 @@ struct mp_cache {
 	int64_t start_time;
 	int64_t media_duration;
 
+	/* all caches share one memory budget, when it runs out the least
+	 * recently used cache is evicted and decodes on demand with m */
+	struct mp_media_info info;
+	char *index_dir;
+	volatile bool evict;
+	bool over_budget;
+	bool on_demand;
+	bool evictable;
+	size_t cache_size;
+	size_t raw_size;
+	uint64_t last_used;
+
 	mp_media_t m;
 };
 
@@ -95,3 +118,4 @@ extern int64_t mp_cache_get_current_time(mp_cache_t *c);
 extern void mp_cache_seek(mp_cache_t *c, int64_t pos);
 extern int64_t mp_cache_get_frames(mp_cache_t *c);
 extern int64_t mp_cache_get_duration(mp_cache_t *c);
+extern size_t mp_cache_get_size(mp_cache_t *c);
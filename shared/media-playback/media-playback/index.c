@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/dstr.h>
+#include <util/fnv.h>
+#include <util/base.h>
+
+#include <inttypes.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "index.h"
+
+/* a demuxer index is trusted if its last keyframe is this close to the end of
+ * the stream, otherwise the demuxer only indexed what it has read so far */
+#define MAX_INDEX_GAP_SEC 10
+
+#define INDEX_FILE_VERSION 1
+
+/* index files are never invalidated when the media file is deleted, so the
+ * directory is limited to the most recently written ones */
+#define MAX_INDEX_FILES 256
+#define MAX_INDEX_AGE_SEC (90 * 24 * 60 * 60)
+
+struct index_file_header {
+	char magic[4];
+	uint32_t version;
+	int64_t file_size;
+	int64_t file_time;
+	int32_t stream_index;
+	int32_t codec_id;
+	uint32_t byte_seek;
+	uint32_t count;
+};
+
+void mp_index_free(struct mp_index *index)
+{
+	da_free(index->keyframes);
+	memset(index, 0, sizeof(*index));
+}
+
+static int cmp_keyframes(const void *a, const void *b)
+{
+	const struct mp_keyframe *kf1 = a;
+	const struct mp_keyframe *kf2 = b;
+	return kf1->pts < kf2->pts ? -1 : (kf1->pts > kf2->pts ? 1 : 0);
+}
+
+static int64_t get_stream_end(AVFormatContext *fmt, AVStream *stream)
+{
+	int64_t start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+
+	if (stream->duration != AV_NOPTS_VALUE)
+		return start + stream->duration;
+	if (fmt->duration != AV_NOPTS_VALUE)
+		return start + av_rescale_q(fmt->duration, AV_TIME_BASE_Q, stream->time_base);
+	return AV_NOPTS_VALUE;
+}
+
+bool mp_index_from_stream(struct mp_index *index, AVFormatContext *fmt, AVStream *stream)
+{
+	int count = avformat_index_get_entries_count(stream);
+	int64_t end = get_stream_end(fmt, stream);
+
+	if (count <= 0 || end == AV_NOPTS_VALUE)
+		return false;
+
+	const AVIndexEntry *last = avformat_index_get_entry(stream, count - 1);
+	int64_t max_gap = av_rescale_q(MAX_INDEX_GAP_SEC, (AVRational){1, 1}, stream->time_base);
+	if (!last || last->timestamp < end - max_gap)
+		return false;
+
+	da_resize(index->keyframes, 0);
+	for (int i = 0; i < count; i++) {
+		const AVIndexEntry *entry = avformat_index_get_entry(stream, i);
+		if (!entry || !(entry->flags & AVINDEX_KEYFRAME))
+			continue;
+
+		struct mp_keyframe *kf = da_push_back_new(index->keyframes);
+		kf->pts = entry->timestamp;
+		kf->pos = entry->pos;
+	}
+
+	index->stream_index = stream->index;
+	index->codec_id = stream->codecpar->codec_id;
+	index->byte_seek = false;
+	return index->keyframes.num > 0;
+}
+
+static int scan_interrupt(void *data)
+{
+	volatile bool *stop = data;
+	return os_atomic_load_bool(stop);
+}
+
+bool mp_index_scan(struct mp_index *index, const char *path, const char *format, AVStream *stream,
+		   volatile bool *stop)
+{
+	const AVInputFormat *input_format = format && *format ? av_find_input_format(format) : NULL;
+	AVFormatContext *fmt = avformat_alloc_context();
+	AVPacket *pkt = NULL;
+	bool success = false;
+
+	if (!fmt)
+		return false;
+
+	fmt->interrupt_callback.callback = scan_interrupt;
+	fmt->interrupt_callback.opaque = (void *)stop;
+
+	if (avformat_open_input(&fmt, path, input_format, NULL) < 0)
+		return false;
+	if (avformat_find_stream_info(fmt, NULL) < 0)
+		goto fail;
+
+	/* stream indices are assigned in file order, so they match the media
+	 * thread's demuxer as long as the stream looks the same */
+	int idx = stream->index;
+	if ((unsigned)idx >= fmt->nb_streams || fmt->streams[idx]->codecpar->codec_id != stream->codecpar->codec_id)
+		goto fail;
+
+	for (unsigned i = 0; i < fmt->nb_streams; i++) {
+		if ((int)i != idx)
+			fmt->streams[i]->discard = AVDISCARD_ALL;
+	}
+
+	pkt = av_packet_alloc();
+	if (!pkt)
+		goto fail;
+
+	da_resize(index->keyframes, 0);
+
+	for (;;) {
+		int ret = av_read_frame(fmt, pkt);
+		if (ret == AVERROR_EOF)
+			break;
+		if (ret < 0)
+			goto fail;
+
+		int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+		if (pkt->stream_index == idx && (pkt->flags & AV_PKT_FLAG_KEY) && ts != AV_NOPTS_VALUE) {
+			struct mp_keyframe *kf = da_push_back_new(index->keyframes);
+			kf->pts = ts;
+			kf->pos = pkt->pos;
+		}
+
+		av_packet_unref(pkt);
+	}
+
+	qsort(index->keyframes.array, index->keyframes.num, sizeof(struct mp_keyframe), cmp_keyframes);
+
+	index->stream_index = idx;
+	index->codec_id = stream->codecpar->codec_id;
+	index->byte_seek = !(fmt->iformat->flags & AVFMT_NO_BYTE_SEEK);
+	success = index->keyframes.num > 0;
+
+fail:
+	av_packet_free(&pkt);
+	avformat_close_input(&fmt);
+	return success;
+}
+
+static bool get_file_info(const char *path, int64_t *size, int64_t *time)
+{
+	struct stat st;
+	if (os_stat(path, &st) != 0)
+		return false;
+
+	*size = (int64_t)st.st_size;
+	*time = (int64_t)st.st_mtime;
+	return true;
+}
+
+static void get_index_file_path(struct dstr *dst, const char *dir, const char *path)
+{
+	dstr_printf(dst, "%s/%016" PRIx64 ".idx", dir, fnv1a_str64(path));
+}
+
+bool mp_index_load(struct mp_index *index, const char *dir, const char *path, AVStream *stream)
+{
+	struct index_file_header header;
+	struct dstr index_path = {0};
+	int64_t file_size, file_time;
+	int64_t index_size;
+	bool success = false;
+	FILE *f;
+
+	if (!get_file_info(path, &file_size, &file_time))
+		return false;
+
+	get_index_file_path(&index_path, dir, path);
+	f = os_fopen(index_path.array, "rb");
+	dstr_free(&index_path);
+	if (!f)
+		return false;
+
+	if (fread(&header, sizeof(header), 1, f) != 1)
+		goto fail;
+	if (memcmp(header.magic, "MPIX", 4) != 0 || header.version != INDEX_FILE_VERSION)
+		goto fail;
+	if (header.file_size != file_size || header.file_time != file_time)
+		goto fail;
+	if (header.stream_index != stream->index || header.codec_id != (int32_t)stream->codecpar->codec_id)
+		goto fail;
+	if (!header.count)
+		goto fail;
+
+	/* the count comes from the file, make sure it has that many keyframes
+	 * before allocating them */
+	index_size = os_fgetsize(f);
+	if (index_size < (int64_t)sizeof(header) ||
+	    (uint64_t)header.count * sizeof(struct mp_keyframe) != (uint64_t)index_size - sizeof(header))
+		goto fail;
+
+	da_resize(index->keyframes, header.count);
+	if (fread(index->keyframes.array, sizeof(struct mp_keyframe), header.count, f) != header.count) {
+		da_resize(index->keyframes, 0);
+		goto fail;
+	}
+
+	index->stream_index = header.stream_index;
+	index->codec_id = stream->codecpar->codec_id;
+	index->byte_seek = !!header.byte_seek;
+	success = true;
+
+fail:
+	fclose(f);
+	return success;
+}
+
+struct index_file {
+	char *path;
+	int64_t time;
+};
+
+static int cmp_index_files(const void *a, const void *b)
+{
+	const struct index_file *file_a = a;
+	const struct index_file *file_b = b;
+
+	/* newest first */
+	return file_a->time < file_b->time ? 1 : (file_a->time > file_b->time ? -1 : 0);
+}
+
+static void prune_index_dir(const char *dir)
+{
+	DARRAY(struct index_file) files;
+	struct dstr pattern = {0};
+	os_glob_t *glob;
+	int64_t now = (int64_t)time(NULL);
+
+	dstr_printf(&pattern, "%s/*.idx", dir);
+	int ret = os_glob(pattern.array, 0, &glob);
+	dstr_free(&pattern);
+	if (ret != 0)
+		return;
+
+	da_init(files);
+
+	for (size_t i = 0; i < glob->gl_pathc; i++) {
+		struct index_file file = {glob->gl_pathv[i].path, 0};
+		int64_t size;
+
+		if (!glob->gl_pathv[i].directory && get_file_info(file.path, &size, &file.time))
+			da_push_back(files, &file);
+	}
+
+	qsort(files.array, files.num, sizeof(struct index_file), cmp_index_files);
+
+	for (size_t i = 0; i < files.num; i++) {
+		struct index_file *file = &files.array[i];
+
+		if (i >= MAX_INDEX_FILES || now - file->time > MAX_INDEX_AGE_SEC)
+			os_unlink(file->path);
+	}
+
+	da_free(files);
+	os_globfree(glob);
+}
+
+bool mp_index_save(const struct mp_index *index, const char *dir, const char *path)
+{
+	struct index_file_header header = {
+		.magic = {'M', 'P', 'I', 'X'},
+		.version = INDEX_FILE_VERSION,
+		.stream_index = index->stream_index,
+		.codec_id = (int32_t)index->codec_id,
+		.byte_seek = index->byte_seek,
+		.count = (uint32_t)index->keyframes.num,
+	};
+	struct dstr index_path = {0};
+	bool success = false;
+	FILE *f;
+
+	if (!get_file_info(path, &header.file_size, &header.file_time))
+		return false;
+	if (os_mkdirs(dir) == MKDIR_ERROR)
+		return false;
+
+	get_index_file_path(&index_path, dir, path);
+	f = os_fopen(index_path.array, "wb");
+	if (!f)
+		goto fail;
+
+	success = fwrite(&header, sizeof(header), 1, f) == 1 &&
+		  fwrite(index->keyframes.array, sizeof(struct mp_keyframe), header.count, f) == header.count;
+	fclose(f);
+
+	if (success)
+		prune_index_dir(dir);
+	else
+		os_unlink(index_path.array);
+
+fail:
+	dstr_free(&index_path);
+	return success;
+}
+
+const struct mp_keyframe *mp_index_find(const struct mp_index *index, int64_t pts)
+{
+	size_t lo = 0;
+	size_t hi = index->keyframes.num;
+
+	if (!hi)
+		return NULL;
+
+	/* first keyframe after pts */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (index->keyframes.array[mid].pts <= pts)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return &index->keyframes.array[lo ? lo - 1 : 0];
+}
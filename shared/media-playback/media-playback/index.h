@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <util/darray.h>
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#pragma warning(disable : 4204)
+#endif
+
+#include <libavformat/avformat.h>
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+/* keyframe index of the video stream of a local file.  pts are in the time
+ * base of the stream, pos is the byte position of the keyframe packet, or -1
+ * if the demuxer didn't report one. */
+struct mp_keyframe {
+	int64_t pts;
+	int64_t pos;
+};
+
+struct mp_index {
+	DARRAY(struct mp_keyframe) keyframes;
+	int stream_index;
+	enum AVCodecID codec_id;
+
+	/* built by scanning the file, so seek to the byte position of the
+	 * keyframe rather than relying on the demuxer's timestamp seek */
+	bool byte_seek;
+};
+
+extern void mp_index_free(struct mp_index *index);
+
+/* uses the index the demuxer read from the file, if it covers the stream */
+extern bool mp_index_from_stream(struct mp_index *index, AVFormatContext *fmt, AVStream *stream);
+
+/* reads every packet of the stream from a separate demuxer instance, stops
+ * early (and fails) when *stop becomes true */
+extern bool mp_index_scan(struct mp_index *index, const char *path, const char *format, AVStream *stream,
+			  volatile bool *stop);
+
+extern bool mp_index_load(struct mp_index *index, const char *dir, const char *path, AVStream *stream);
+extern bool mp_index_save(const struct mp_index *index, const char *dir, const char *path);
+
+/* returns the last keyframe at or before pts, or the first keyframe */
+extern const struct mp_keyframe *mp_index_find(const struct mp_index *index, int64_t pts);
+
+#ifdef __cplusplus
+}
+#endif
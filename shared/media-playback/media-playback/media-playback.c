@@ -153,6 +153,14 @@ int64_t media_playback_get_duration(media_playback_t *mp)
 		return mp_media_get_duration(&mp->media);
 }
 
+size_t media_playback_get_cache_size(media_playback_t *mp)
+{
+	if (!mp || !mp->is_cached)
+		return 0;
+
+	return mp_cache_get_size(&mp->cache);
+}
+
 bool media_playback_has_video(media_playback_t *mp)
 {
 	if (!mp)
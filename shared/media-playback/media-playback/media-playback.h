@@ -36,6 +36,7 @@ struct mp_media_info {
 
 	const char *path;
 	const char *format;
+	const char *index_dir;
 	char *ffmpeg_options;
 	int buffering;
 	int speed;
@@ -61,5 +62,8 @@ extern int64_t media_playback_get_current_time(media_playback_t *mp);
 extern void media_playback_seek(media_playback_t *mp, int64_t pos);
 extern int64_t media_playback_get_frames(media_playback_t *mp);
 extern int64_t media_playback_get_duration(media_playback_t *mp);
+
+/* bytes of memory used by the frame cache, 0 when decoding on demand */
+extern size_t media_playback_get_cache_size(media_playback_t *mp);
 extern bool media_playback_has_video(media_playback_t *mp);
 extern bool media_playback_has_audio(media_playback_t *mp);
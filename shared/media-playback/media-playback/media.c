@@ -15,6 +15,7 @@
  */
 
 #include <util/platform.h>
+#include <util/profiler.h>
 
 #include <assert.h>
 
@@ -261,6 +262,18 @@ static bool mp_media_init_scaling(mp_media_t *m)
 	return true;
 }
 
+static bool mp_media_check_scaling(mp_media_t *m)
+{
+	if (m->swscale)
+		return true;
+
+	m->scale_format = closest_format(m->v.frame->format);
+	if (m->scale_format != m->v.frame->format)
+		return mp_media_init_scaling(m);
+
+	return true;
+}
+
 bool mp_media_prepare_frames(mp_media_t *m)
 {
 	bool actively_seeking = m->seek_next_ts && m->pause;
@@ -293,14 +306,8 @@ bool mp_media_prepare_frames(mp_media_t *m)
 			return false;
 	}
 
-	if (m->has_video && m->v.frame_ready && !m->swscale) {
-		m->scale_format = closest_format(m->v.frame->format);
-		if (m->scale_format != m->v.frame->format) {
-			if (!mp_media_init_scaling(m)) {
-				return false;
-			}
-		}
-	}
+	if (m->has_video && m->v.frame_ready && !mp_media_check_scaling(m))
+		return false;
 
 	return true;
 }
@@ -548,6 +555,286 @@ static void seek_to(mp_media_t *m, int64_t pos)
 		mp_decode_flush(&m->a);
 }
 
+/* frames decoded on the way to a seek target are kept up to this size, so
+ * scrubbing back over them doesn't have to decode the GOP again */
+#define FRAME_POOL_MAX_SIZE (128 * 1024 * 1024)
+
+static inline int64_t stream_ts_to_ns(mp_media_t *m, const AVStream *stream, int64_t ts)
+{
+	int64_t ns = av_rescale_q(ts, stream->time_base, (AVRational){1, 1000000000});
+	if (m->speed != 100)
+		ns = av_rescale_q(ns, (AVRational){1, m->speed}, (AVRational){1, 100});
+	return ns;
+}
+
+static inline int64_t ns_to_stream_ts(mp_media_t *m, const AVStream *stream, int64_t ns)
+{
+	if (m->speed != 100)
+		ns = av_rescale_q(ns, (AVRational){1, 100}, (AVRational){1, m->speed});
+	return av_rescale_q(ns, (AVRational){1, 1000000000}, stream->time_base);
+}
+
+static size_t get_frame_size(const AVFrame *f)
+{
+	size_t size = 0;
+	for (size_t i = 0; i < AV_NUM_DATA_POINTERS && f->buf[i]; i++)
+		size += f->buf[i]->size;
+	return size;
+}
+
+static void free_pooled_frame(mp_media_t *m, size_t idx)
+{
+	struct mp_pooled_frame *pf = &m->frame_pool.array[idx];
+
+	m->frame_pool_size -= pf->size;
+	av_frame_free(&pf->frame);
+	da_erase(m->frame_pool, idx);
+}
+
+static void free_frame_pool(mp_media_t *m)
+{
+	for (size_t i = 0; i < m->frame_pool.num; i++)
+		av_frame_free(&m->frame_pool.array[i].frame);
+	da_resize(m->frame_pool, 0);
+	m->frame_pool_size = 0;
+}
+
+static void pool_video_frame(mp_media_t *m)
+{
+	struct mp_decode *d = &m->v;
+	size_t idx = 0;
+
+	while (idx < m->frame_pool.num && m->frame_pool.array[idx].pts < d->frame_pts)
+		idx++;
+	if (idx < m->frame_pool.num && m->frame_pool.array[idx].pts == d->frame_pts)
+		return;
+
+	/* only takes a reference to the decoded buffers */
+	AVFrame *frame = av_frame_clone(d->frame);
+	if (!frame)
+		return;
+
+	struct mp_pooled_frame pf = {frame, d->frame_pts, d->next_pts, get_frame_size(frame)};
+	da_insert(m->frame_pool, idx, &pf);
+	m->frame_pool_size += pf.size;
+
+	/* drop whichever end is furthest away from the playhead */
+	while (m->frame_pool_size > FRAME_POOL_MAX_SIZE && m->frame_pool.num > 1) {
+		size_t last = m->frame_pool.num - 1;
+		int64_t first_dist = d->frame_pts - m->frame_pool.array[0].pts;
+		int64_t last_dist = m->frame_pool.array[last].pts - d->frame_pts;
+
+		free_pooled_frame(m, first_dist > last_dist ? 0 : last);
+	}
+}
+
+static const struct mp_pooled_frame *find_pooled_frame(mp_media_t *m, int64_t target)
+{
+	for (size_t i = m->frame_pool.num; i > 0; i--) {
+		const struct mp_pooled_frame *pf = &m->frame_pool.array[i - 1];
+		if (pf->pts <= target)
+			return target < pf->next_pts ? pf : NULL;
+	}
+
+	return NULL;
+}
+
+static void show_pooled_frame(mp_media_t *m, const struct mp_pooled_frame *pf)
+{
+	struct mp_decode *d = &m->v;
+	AVFrame *frame = d->frame;
+	int64_t frame_pts = d->frame_pts;
+	bool frame_ready = d->frame_ready;
+
+	d->frame = pf->frame;
+	d->frame_pts = pf->pts;
+	d->frame_ready = true;
+
+	if (mp_media_check_scaling(m))
+		mp_media_next_video(m, true);
+
+	d->frame = frame;
+	d->frame_pts = frame_pts;
+	d->frame_ready = frame_ready;
+
+	/* the decoder is still wherever it was, so it has to be brought back to
+	 * this frame before playback resumes */
+	m->pooled_frame_shown = true;
+	m->pooled_frame_pts = pf->pts;
+}
+
+static bool seek_to_keyframe(mp_media_t *m, const struct mp_keyframe *kf)
+{
+	int ret;
+
+	if (m->index.byte_seek && kf->pos >= 0)
+		ret = av_seek_frame(m->fmt, -1, kf->pos, AVSEEK_FLAG_BYTE);
+	else
+		ret = av_seek_frame(m->fmt, m->index.stream_index, kf->pts, AVSEEK_FLAG_BACKWARD);
+
+	if (ret < 0) {
+		blog(LOG_WARNING, "MP: Failed to seek: %s", av_err2str(ret));
+		return false;
+	}
+
+	mp_decode_flush(&m->v);
+	if (m->has_audio)
+		mp_decode_flush(&m->a);
+	m->eof = false;
+	return true;
+}
+
+/* decodes until the frame that is on screen at target is ready, returns
+ * false if the stream ended first */
+static bool decode_to(mp_media_t *m, int64_t target)
+{
+	struct mp_decode *d = &m->v;
+
+	/* see note in mp_media_prepare_frames() */
+	m->obsframe.data[0] = NULL;
+
+	for (;;) {
+		if (d->frame_ready) {
+			if (d->next_pts > target)
+				return true;
+			pool_video_frame(m);
+		}
+		if (d->eof)
+			return false;
+
+		while (!m->eof && !d->packets.size) {
+			int ret = mp_media_next_packet(m);
+			if (ret == AVERROR_EOF || ret == AVERROR_EXIT)
+				m->eof = true;
+			else if (ret < 0)
+				return false;
+		}
+
+		if (!mp_decode_next(d))
+			return false;
+	}
+}
+
+/* audio read while decoding video up to the target would otherwise play
+ * before the target frame */
+static void drop_audio_before(mp_media_t *m, int64_t target)
+{
+	struct mp_decode *d = &m->a;
+
+	if (d->frame_ready && d->next_pts <= target)
+		d->frame_ready = false;
+
+	while (d->packets.size) {
+		AVPacket *pkt;
+
+		deque_peek_front(&d->packets, &pkt, sizeof(pkt));
+		if (pkt->pts == AV_NOPTS_VALUE || stream_ts_to_ns(m, d->stream, pkt->pts + pkt->duration) > target)
+			break;
+
+		deque_pop_front(&d->packets, NULL, sizeof(pkt));
+		mp_media_free_packet(m, pkt);
+	}
+}
+
+static bool seek_to_frame(mp_media_t *m, int64_t target)
+{
+	struct mp_decode *d = &m->v;
+	bool paused = m->seek_next_ts && m->pause && m->v_preload_cb;
+
+	if (paused) {
+		const struct mp_pooled_frame *pf = find_pooled_frame(m, target);
+		if (pf) {
+			show_pooled_frame(m, pf);
+			return true;
+		}
+	}
+
+	const struct mp_keyframe *kf = mp_index_find(&m->index, ns_to_stream_ts(m, d->stream, target));
+	int64_t kf_pts = stream_ts_to_ns(m, d->stream, kf->pts);
+
+	/* if no keyframe lies between the decoder and the target, keep
+	 * decoding from where the decoder is rather than seeking back */
+	int64_t cur_pts = d->frame_ready ? d->frame_pts : d->next_pts;
+	bool decoder_valid = !d->eof && (d->frame_ready || d->next_pts > 0);
+	bool keep_decoding = decoder_valid && kf_pts <= cur_pts && cur_pts <= target;
+
+	if (!keep_decoding && !seek_to_keyframe(m, kf))
+		return false;
+
+	bool ready = decode_to(m, target);
+
+	/* index timestamps can be decode timestamps, so the target may belong
+	 * to the GOP before the keyframe that was found */
+	if (ready && !keep_decoding && d->frame_pts > target && kf > m->index.keyframes.array)
+		ready = seek_to_keyframe(m, kf - 1) && decode_to(m, target);
+
+	if (m->has_audio)
+		drop_audio_before(m, target);
+
+	m->pooled_frame_shown = false;
+
+	if (paused) {
+		if (ready) {
+			if (mp_media_check_scaling(m))
+				mp_media_next_video(m, true);
+		} else if (m->frame_pool.num) {
+			show_pooled_frame(m, &m->frame_pool.array[m->frame_pool.num - 1]);
+		}
+	}
+
+	return true;
+}
+
+static bool seek_exact(mp_media_t *m, int64_t pos)
+{
+	static const char *seek_exact_name = "mp_media_seek_exact";
+
+	if (!m->has_video || !os_atomic_load_bool(&m->index_ready))
+		return false;
+
+	int64_t target = pos * 1000;
+	if (m->speed != 100)
+		target = av_rescale_q(target, (AVRational){1, m->speed}, (AVRational){1, 100});
+
+	profile_start(seek_exact_name);
+	bool success = seek_to_frame(m, target);
+	profile_end(seek_exact_name);
+
+	return success;
+}
+
+static void *mp_index_thread(void *data)
+{
+	mp_media_t *m = data;
+
+	os_set_thread_name("mp_index_thread");
+
+	if (!mp_index_scan(&m->index, m->path, m->format_name, m->v.stream, &m->index_stop))
+		return NULL;
+	if (m->index_dir && !mp_index_save(&m->index, m->index_dir, m->path))
+		blog(LOG_DEBUG, "MP: Failed to save keyframe index of '%s'", m->path);
+
+	os_atomic_set_bool(&m->index_ready, true);
+	return NULL;
+}
+
+static void mp_media_init_index(mp_media_t *m)
+{
+	if (!m->is_local_file || !m->has_video || !os_file_exists(m->path))
+		return;
+
+	if (mp_index_from_stream(&m->index, m->fmt, m->v.stream) ||
+	    (m->index_dir && mp_index_load(&m->index, m->index_dir, m->path, m->v.stream))) {
+		os_atomic_set_bool(&m->index_ready, true);
+		return;
+	}
+
+	/* reading the whole file takes a while, seeks fall back to seeking
+	 * with the demuxer until it's done */
+	if (pthread_create(&m->index_thread, NULL, mp_index_thread, m) == 0)
+		m->index_thread_valid = true;
+}
+
 bool mp_media_reset(mp_media_t *m)
 {
 	bool stopping;
@@ -562,6 +849,8 @@ bool mp_media_reset(mp_media_t *m)
 	m->eof = false;
 	m->base_ts += next_ts;
 	m->seek_next_ts = false;
+	m->pooled_frame_shown = false;
+	free_frame_pool(m);
 
 	seek_to(m, start_time);
 
@@ -744,6 +1033,7 @@ static inline bool mp_media_thread(mp_media_t *m)
 	if (!mp_media_init2(m)) {
 		return false;
 	}
+	mp_media_init_index(m);
 	if (!mp_media_reset(m)) {
 		return false;
 	}
@@ -795,11 +1085,14 @@ static inline bool mp_media_thread(mp_media_t *m)
 
 		if (seek) {
 			m->seek_next_ts = true;
-			seek_to(m, seek_pos);
+			if (!seek_exact(m, seek_pos))
+				seek_to(m, seek_pos);
 			continue;
 		}
 
 		if (reset_time) {
+			if (m->pooled_frame_shown)
+				seek_to_frame(m, m->pooled_frame_pts);
 			reset_ts(m);
 			continue;
 		}
@@ -815,6 +1108,11 @@ static inline bool mp_media_thread(mp_media_t *m)
 
 		/* frames are ready */
 		if (is_active && !timeout) {
+			/* pooled frames are only for scrubbing while paused,
+			 * playback moves away from them */
+			if (m->frame_pool.num && !m->pooled_frame_shown)
+				free_frame_pool(m);
+
 			if (m->has_video)
 				mp_media_next_video(m, false);
 			if (m->has_audio)
@@ -858,6 +1156,7 @@ static inline bool mp_media_init_internal(mp_media_t *m, const struct mp_media_i
 
 	m->path = info->path ? bstrdup(info->path) : NULL;
 	m->format_name = info->format ? bstrdup(info->format) : NULL;
+	m->index_dir = info->index_dir ? bstrdup(info->index_dir) : NULL;
 	m->hw = info->hardware_decoding;
 
 	if (info->full_decode)
@@ -890,6 +1189,7 @@ bool mp_media_init(mp_media_t *media, const struct mp_media_info *info)
 	media->request_preload = info->request_preload;
 	media->is_local_file = info->is_local_file;
 	da_init(media->packet_pool);
+	da_init(media->frame_pool);
 
 	if (!info->is_local_file || media->speed < 1 || media->speed > 200)
 		media->speed = 100;
@@ -922,6 +1222,11 @@ static void mp_kill_thread(mp_media_t *m)
 
 		pthread_join(m->thread, NULL);
 	}
+
+	if (m->index_thread_valid) {
+		os_atomic_set_bool(&m->index_stop, true);
+		pthread_join(m->index_thread, NULL);
+	}
 }
 
 void mp_media_free(mp_media_t *media)
@@ -936,6 +1241,9 @@ void mp_media_free(mp_media_t *media)
 	for (size_t i = 0; i < media->packet_pool.num; i++)
 		av_packet_free(&media->packet_pool.array[i]);
 	da_free(media->packet_pool);
+	free_frame_pool(media);
+	da_free(media->frame_pool);
+	mp_index_free(&media->index);
 	avformat_close_input(&media->fmt);
 	pthread_mutex_destroy(&media->mutex);
 	os_sem_destroy(media->sem);
@@ -943,6 +1251,7 @@ void mp_media_free(mp_media_t *media)
 	av_freep(&media->scale_pic[0]);
 	bfree(media->path);
 	bfree(media->format_name);
+	bfree(media->index_dir);
 	memset(media, 0, sizeof(*media));
 	pthread_mutex_init_value(&media->mutex);
 }
@@ -18,6 +18,7 @@
 
 #include <obs.h>
 #include "decode.h"
+#include "index.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -38,6 +39,13 @@ extern "C" {
 #pragma warning(pop)
 #endif
 
+struct mp_pooled_frame {
+	AVFrame *frame;
+	int64_t pts;
+	int64_t next_pts;
+	size_t size;
+};
+
 struct mp_media {
 	AVFormatContext *fmt;
 
@@ -103,6 +111,18 @@ struct mp_media {
 	bool seek;
 	bool seek_next_ts;
 	int64_t seek_pos;
+
+	char *index_dir;
+	struct mp_index index;
+	volatile bool index_ready;
+	volatile bool index_stop;
+	bool index_thread_valid;
+	pthread_t index_thread;
+
+	DARRAY(struct mp_pooled_frame) frame_pool;
+	size_t frame_pool_size;
+	bool pooled_frame_shown;
+	int64_t pooled_frame_pts;
 };
 
 typedef struct mp_media mp_media_t;
@@ -0,0 +1,207 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmocka.h>
+
+#include <media-io/audio-buffering.h>
+
+#define SAMPLE_RATE 48000
+#define TICK_NS (1024ULL * 1000000000ULL / SAMPLE_RATE)
+#define PACKET_NS 10000000ULL
+#define MS 1000000ULL
+#define SEC 1000000000ULL
+
+/* Replays a source outputting 10 ms packets with jittery arrival times, and
+ * applies the buffering controller the way the audio thread does: buffering
+ * grows right away to whatever the source needs, and is only given back
+ * through audio_buffering_should_shrink. */
+
+struct replay {
+	uint32_t seed;
+	uint64_t jitter_ns;
+
+	/* stalls the source for stall_ns every stall_period_ns, starting at
+	 * stall_start */
+	uint64_t stall_start;
+	uint64_t stall_period_ns;
+	uint64_t stall_ns;
+
+	uint64_t next_packet;
+	uint64_t next_arrival;
+	uint64_t data_end;
+
+	struct audio_buffering ab;
+	uint32_t ticks;
+	uint32_t max_ticks;
+	int growths;
+	int shrinks;
+	uint64_t last_growth;
+	uint64_t last_shrink;
+	uint64_t min_shrink_gap;
+	uint64_t first_shrink_after_growth;
+};
+
+static uint64_t next_jitter(struct replay *r)
+{
+	r->seed = r->seed * 1103515245 + 12345;
+	return (uint64_t)((r->seed >> 16) % 1000) * r->jitter_ns / 1000;
+}
+
+static bool is_stalled(const struct replay *r, uint64_t ts)
+{
+	if (!r->stall_ns || ts < r->stall_start)
+		return false;
+	if (!r->stall_period_ns)
+		return ts - r->stall_start < r->stall_ns;
+	return (ts - r->stall_start) % r->stall_period_ns < r->stall_ns;
+}
+
+static void schedule_packet(struct replay *r)
+{
+	uint64_t arrival = r->next_packet + PACKET_NS + next_jitter(r);
+
+	/* packets arrive in order */
+	if (arrival < r->next_arrival)
+		arrival = r->next_arrival;
+	r->next_arrival = arrival;
+}
+
+static uint32_t needed_ticks(struct replay *r, uint64_t now)
+{
+	while (r->next_arrival <= now) {
+		r->data_end = r->next_packet + PACKET_NS;
+		r->next_packet += PACKET_NS;
+		schedule_packet(r);
+	}
+
+	/* a stalled source delivers everything it held back once it resumes */
+	while (is_stalled(r, r->next_arrival))
+		r->next_arrival += MS;
+
+	uint64_t lateness = now > r->data_end ? now - r->data_end : 0;
+	return (uint32_t)((lateness + TICK_NS - 1) / TICK_NS);
+}
+
+static void run_replay(struct replay *r, uint64_t duration)
+{
+	uint64_t start = SEC;
+
+	r->next_packet = start;
+	r->data_end = start;
+	r->next_arrival = start;
+	r->min_shrink_gap = UINT64_MAX;
+	schedule_packet(r);
+
+	for (uint64_t now = start + TICK_NS; now < start + duration; now += TICK_NS) {
+		uint32_t needed = needed_ticks(r, now);
+
+		if (needed > r->ticks) {
+			r->ticks = needed;
+			r->growths++;
+			r->last_growth = now;
+			r->first_shrink_after_growth = 0;
+			audio_buffering_grew(&r->ab, now);
+
+		} else {
+			audio_buffering_observe(&r->ab, now, needed);
+
+			if (audio_buffering_should_shrink(&r->ab, now, r->ticks)) {
+				r->ticks--;
+				r->shrinks++;
+
+				if (r->last_shrink && now - r->last_shrink < r->min_shrink_gap)
+					r->min_shrink_gap = now - r->last_shrink;
+				if (!r->first_shrink_after_growth)
+					r->first_shrink_after_growth = now - r->last_growth;
+				r->last_shrink = now;
+			}
+		}
+
+		if (r->ticks > r->max_ticks)
+			r->max_ticks = r->ticks;
+	}
+}
+
+static void single_stall_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct replay r = {
+		.seed = 1,
+		.jitter_ns = 15 * MS,
+		.stall_start = 6 * SEC,
+		.stall_ns = 300 * MS,
+	};
+
+	run_replay(&r, 60 * SEC);
+
+	/* the stall added about 14 ticks of buffering on top of the jitter */
+	assert_true(r.max_ticks >= 14);
+	assert_true(r.last_growth < 8 * SEC);
+
+	/* nothing was given back until the window was clean for 10 seconds,
+	 * and then only a tick per second */
+	assert_true(r.first_shrink_after_growth >= 10 * SEC);
+	assert_true(r.min_shrink_gap >= SEC);
+
+	/* back to what the jitter alone needs: 10 ms packets up to 15 ms late */
+	assert_true(r.ticks >= 1 && r.ticks <= 2);
+
+	printf("single stall: max %u ticks, %d growths, %d shrinks, settled at %u ticks\n", r.max_ticks, r.growths,
+	       r.shrinks, r.ticks);
+}
+
+static void periodic_stall_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct replay r = {
+		.seed = 2,
+		.jitter_ns = 5 * MS,
+		.stall_start = 3 * SEC,
+		.stall_period_ns = 5 * SEC,
+		.stall_ns = 120 * MS,
+	};
+
+	run_replay(&r, 60 * SEC);
+
+	/* stalls recur within the window, so buffering must not oscillate:
+	 * it only grows during the first stall and is never given back */
+	assert_int_equal(r.shrinks, 0);
+	assert_true(r.last_growth < 4 * SEC);
+	assert_true(r.ticks >= 6);
+
+	printf("periodic stalls: %d growths, %d shrinks, settled at %u ticks\n", r.growths, r.shrinks, r.ticks);
+}
+
+static void on_time_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct audio_buffering ab = {0};
+	uint64_t now = SEC;
+
+	/* buffering that was added by a long gone source goes away */
+	uint32_t ticks = 20;
+	for (; now < 60 * SEC; now += TICK_NS) {
+		audio_buffering_observe(&ab, now, 0);
+		if (audio_buffering_should_shrink(&ab, now, ticks))
+			ticks--;
+	}
+
+	assert_int_equal(ticks, 0);
+	assert_false(audio_buffering_should_shrink(&ab, now + 10 * SEC, ticks));
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(single_stall_test),
+		cmocka_unit_test(periodic_stall_test),
+		cmocka_unit_test(on_time_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,261 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/deque.h>
+#include <util/platform.h>
+#include <util/spsc-ring.h>
+#include <util/threading.h>
+
+#define NUM_SOURCES 64
+#define PACKETS 200
+#define FRAMES 480
+#define CHANNELS 2
+#define PACKET_SIZE (sizeof(uint64_t) + FRAMES * CHANNELS * sizeof(float))
+#define TICK_NS 1000000ULL
+
+static void spsc_ring_wrap_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct spsc_ring ring;
+	size_t size;
+
+	spsc_ring_init(&ring, 1000);
+	assert_int_equal(ring.capacity, 1024);
+	assert_ptr_equal(spsc_ring_read_begin(&ring, &size), NULL);
+
+	/* odd sizes force padding and wrap markers at varying offsets */
+	for (uint32_t i = 0; i < 1000; i++) {
+		size_t record = 1 + (i * 37) % spsc_ring_max_record_size(&ring);
+		uint8_t *ptr = spsc_ring_write_begin(&ring, record);
+		assert_true(ptr != NULL);
+		memset(ptr, (int)(i & 0xFF), record);
+		spsc_ring_write_end(&ring);
+
+		const uint8_t *out = spsc_ring_read_begin(&ring, &size);
+		assert_true(out != NULL);
+		assert_int_equal(size, record);
+		assert_int_equal(out[0], i & 0xFF);
+		assert_int_equal(out[size - 1], i & 0xFF);
+		spsc_ring_read_end(&ring);
+	}
+
+	/* a full ring refuses records instead of overwriting unread ones */
+	size_t written = 0;
+	while (spsc_ring_write_begin(&ring, 100)) {
+		spsc_ring_write_end(&ring);
+		written++;
+	}
+	assert_true(written > 0);
+
+	while (spsc_ring_read_begin(&ring, &size)) {
+		assert_int_equal(size, 100);
+		spsc_ring_read_end(&ring);
+		written--;
+	}
+	assert_int_equal(written, 0);
+
+	spsc_ring_free(&ring);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Emulates NUM_SOURCES async audio sources outputting to the audio thread,
+ * once through per source rings and once through the per source mutex and
+ * deque the audio thread used to hold while mixing. */
+
+struct bench_source {
+	bool use_ring;
+	struct spsc_ring ring;
+	pthread_mutex_t mutex;
+	struct deque buf;
+
+	uint64_t expected_seq;
+	uint64_t worst_ns;
+	uint64_t total_ns;
+	volatile bool done;
+};
+
+static volatile bool consumer_stop = false;
+static volatile long integrity_errors = 0;
+
+static void check_packet(struct bench_source *src, const uint8_t *data)
+{
+	uint64_t seq;
+	float sample;
+
+	memcpy(&seq, data, sizeof(seq));
+	memcpy(&sample, data + sizeof(seq), sizeof(sample));
+
+	if (seq != src->expected_seq || sample != (float)seq)
+		os_atomic_inc_long(&integrity_errors);
+	src->expected_seq = seq + 1;
+}
+
+static void *producer_thread(void *param)
+{
+	struct bench_source *src = param;
+	uint8_t packet[PACKET_SIZE];
+	float *samples = (float *)(packet + sizeof(uint64_t));
+
+	for (uint64_t seq = 0; seq < PACKETS; seq++) {
+		memcpy(packet, &seq, sizeof(seq));
+		for (size_t i = 0; i < FRAMES * CHANNELS; i++)
+			samples[i] = (float)seq;
+
+		uint64_t start = os_gettime_ns();
+
+		if (src->use_ring) {
+			void *ptr;
+			while (!(ptr = spsc_ring_write_begin(&src->ring, PACKET_SIZE)))
+				os_sleep_ms(0);
+			memcpy(ptr, packet, PACKET_SIZE);
+			spsc_ring_write_end(&src->ring);
+		} else {
+			pthread_mutex_lock(&src->mutex);
+			deque_push_back(&src->buf, packet, PACKET_SIZE);
+			pthread_mutex_unlock(&src->mutex);
+		}
+
+		uint64_t elapsed = os_gettime_ns() - start;
+		src->total_ns += elapsed;
+		if (elapsed > src->worst_ns)
+			src->worst_ns = elapsed;
+
+		/* roughly the rate of a 10 ms capture period, compressed */
+		os_sleepto_ns(start + TICK_NS / 2);
+	}
+
+	os_atomic_set_bool(&src->done, true);
+	return NULL;
+}
+
+static void mix_packet(float *mix, const uint8_t *data)
+{
+	const float *samples = (const float *)(data + sizeof(uint64_t));
+	for (size_t i = 0; i < FRAMES * CHANNELS; i++)
+		mix[i] += samples[i] * 0.5f;
+}
+
+static void *consumer_thread(void *param)
+{
+	struct bench_source *sources = param;
+	float *mix = bzalloc(FRAMES * CHANNELS * sizeof(float));
+	uint8_t packet[PACKET_SIZE];
+	uint64_t tick = os_gettime_ns();
+
+	while (!os_atomic_load_bool(&consumer_stop)) {
+		for (size_t i = 0; i < NUM_SOURCES; i++) {
+			struct bench_source *src = &sources[i];
+
+			if (src->use_ring) {
+				const uint8_t *ptr;
+				size_t size;
+
+				while ((ptr = spsc_ring_read_begin(&src->ring, &size)) != NULL) {
+					check_packet(src, ptr);
+					mix_packet(mix, ptr);
+					spsc_ring_read_end(&src->ring);
+				}
+			} else {
+				pthread_mutex_lock(&src->mutex);
+				while (src->buf.size >= PACKET_SIZE) {
+					deque_pop_front(&src->buf, packet, PACKET_SIZE);
+					check_packet(src, packet);
+					mix_packet(mix, packet);
+				}
+				pthread_mutex_unlock(&src->mutex);
+			}
+		}
+
+		tick += TICK_NS;
+		if (!os_sleepto_ns(tick))
+			tick = os_gettime_ns();
+	}
+
+	bfree(mix);
+	return NULL;
+}
+
+static void run_bench(bool use_ring, uint64_t *worst, uint64_t *avg)
+{
+	struct bench_source *sources = bzalloc(sizeof(struct bench_source) * NUM_SOURCES);
+	pthread_t producers[NUM_SOURCES];
+	pthread_t consumer;
+	uint64_t total = 0;
+
+	for (size_t i = 0; i < NUM_SOURCES; i++) {
+		sources[i].use_ring = use_ring;
+		if (use_ring)
+			spsc_ring_init(&sources[i].ring, PACKET_SIZE * 16);
+		else
+			pthread_mutex_init(&sources[i].mutex, NULL);
+	}
+
+	os_atomic_set_bool(&consumer_stop, false);
+	pthread_create(&consumer, NULL, consumer_thread, sources);
+	for (size_t i = 0; i < NUM_SOURCES; i++)
+		pthread_create(&producers[i], NULL, producer_thread, &sources[i]);
+
+	for (size_t i = 0; i < NUM_SOURCES; i++)
+		pthread_join(producers[i], NULL);
+
+	/* let the consumer pick up the last packets */
+	os_sleep_ms(20);
+	os_atomic_set_bool(&consumer_stop, true);
+	pthread_join(consumer, NULL);
+
+	*worst = 0;
+	for (size_t i = 0; i < NUM_SOURCES; i++) {
+		struct bench_source *src = &sources[i];
+
+		assert_true(os_atomic_load_bool(&src->done));
+		assert_int_equal(src->expected_seq, PACKETS);
+
+		if (src->worst_ns > *worst)
+			*worst = src->worst_ns;
+		total += src->total_ns;
+
+		if (use_ring) {
+			spsc_ring_free(&src->ring);
+		} else {
+			deque_free(&src->buf);
+			pthread_mutex_destroy(&src->mutex);
+		}
+	}
+
+	*avg = total / (NUM_SOURCES * PACKETS);
+	bfree(sources);
+}
+
+static void audio_ring_contention_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	uint64_t mutex_worst, mutex_avg;
+	uint64_t ring_worst, ring_avg;
+
+	run_bench(false, &mutex_worst, &mutex_avg);
+	run_bench(true, &ring_worst, &ring_avg);
+
+	assert_int_equal(os_atomic_load_long(&integrity_errors), 0);
+
+	printf("%d sources, producer output time:\n", NUM_SOURCES);
+	printf("  mutex + deque: avg %.2f us, worst %.1f us\n", mutex_avg / 1000.0, mutex_worst / 1000.0);
+	printf("  spsc ring:     avg %.2f us, worst %.1f us\n", ring_avg / 1000.0, ring_worst / 1000.0);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(spsc_ring_wrap_test),
+		cmocka_unit_test(audio_ring_contention_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
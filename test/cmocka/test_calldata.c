@@ -0,0 +1,200 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <callback/calldata.h>
+#include <callback/proc.h>
+#include <util/dstr.h>
+
+#define PROC_COUNT 200
+
+static const char *decl = "void test(ptr source, in out float volume, int count, string name, bool flag)";
+
+enum { SLOT_SOURCE, SLOT_VOLUME, SLOT_COUNT, SLOT_NAME, SLOT_FLAG };
+
+static void layout_slot_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	calldata_layout_t *layout = calldata_layout_create(decl);
+	struct calldata data;
+	uint8_t stack[256];
+	int source;
+
+	assert_non_null(layout);
+	assert_true(calldata_layout_size(layout) < sizeof(stack));
+
+	calldata_init_layout(&data, layout, stack, sizeof(stack));
+	assert_int_equal(data.size, calldata_layout_size(layout));
+
+	/* values set by slot can be read by name */
+	calldata_set_slot_ptr(&data, layout, SLOT_SOURCE, &source);
+	calldata_set_slot_float(&data, layout, SLOT_VOLUME, 0.5);
+	calldata_set_slot_int(&data, layout, SLOT_COUNT, 42);
+	calldata_set_slot_bool(&data, layout, SLOT_FLAG, true);
+
+	assert_ptr_equal(calldata_ptr(&data, "source"), &source);
+	assert_true(calldata_float(&data, "volume") == 0.5);
+	assert_int_equal(calldata_int(&data, "count"), 42);
+	assert_true(calldata_bool(&data, "flag"));
+
+	/* and the other way around, like a signal callback would */
+	calldata_set_float(&data, "volume", 0.25);
+	calldata_set_int(&data, "count", -7);
+	assert_true(calldata_slot_float(&data, layout, SLOT_VOLUME) == 0.25);
+	assert_int_equal(calldata_slot_int(&data, layout, SLOT_COUNT), -7);
+
+	calldata_layout_destroy(layout);
+}
+
+static void layout_string_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	calldata_layout_t *layout = calldata_layout_create(decl);
+	struct calldata data;
+	uint8_t stack[256];
+	int source;
+
+	calldata_init_layout(&data, layout, stack, sizeof(stack));
+	calldata_set_slot_ptr(&data, layout, SLOT_SOURCE, &source);
+
+	/* strings have no slot, they are appended by name */
+	calldata_set_string(&data, "name", "first");
+	calldata_set_slot_int(&data, layout, SLOT_COUNT, 1);
+	calldata_set_string(&data, "name", "a much longer second name");
+	calldata_set_slot_int(&data, layout, SLOT_COUNT, 2);
+
+	assert_string_equal(calldata_string(&data, "name"), "a much longer second name");
+	assert_ptr_equal(calldata_slot_ptr(&data, layout, SLOT_SOURCE), &source);
+	assert_int_equal(calldata_int(&data, "count"), 2);
+
+	/* parameters outside of the declaration still work by name */
+	calldata_set_int(&data, "extra", 5);
+	assert_int_equal(calldata_int(&data, "extra"), 5);
+	assert_int_equal(calldata_slot_int(&data, layout, SLOT_COUNT), 2);
+
+	/* slot getters on a string or invalid slot fail without touching
+	 * the output */
+	long long val = 3;
+	assert_false(calldata_get_slot(&data, layout, SLOT_NAME, &val, sizeof(val)));
+	assert_false(calldata_get_slot(&data, layout, 100, &val, sizeof(val)));
+	assert_int_equal(val, 3);
+
+	calldata_layout_destroy(layout);
+}
+
+static void layout_resized_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	calldata_layout_t *layout = calldata_layout_create(decl);
+	struct calldata data;
+	uint8_t stack[256];
+	int value = 9;
+
+	calldata_init_layout(&data, layout, stack, sizeof(stack));
+	calldata_set_slot_int(&data, layout, SLOT_COUNT, 1);
+
+	/* a setter by name with a different size moves the parameter, slot
+	 * access has to fall back to the name */
+	calldata_set_data(&data, "count", &value, sizeof(value));
+	value = 0;
+	assert_true(calldata_get_slot(&data, layout, SLOT_COUNT, &value, sizeof(value)));
+	assert_int_equal(value, 9);
+	assert_false(calldata_get_slot(&data, layout, SLOT_COUNT, &(long long){0}, sizeof(long long)));
+
+	calldata_set_slot_float(&data, layout, SLOT_VOLUME, 2.0);
+	assert_true(calldata_float(&data, "volume") == 2.0);
+
+	calldata_layout_destroy(layout);
+}
+
+static void layout_fallback_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	calldata_layout_t *layout = calldata_layout_create(decl);
+	struct calldata data;
+
+	/* a regular calldata without the layout applied uses names */
+	calldata_init(&data);
+	calldata_set_slot_int(&data, layout, SLOT_COUNT, 11);
+	calldata_set_slot_bool(&data, layout, SLOT_FLAG, true);
+	assert_int_equal(calldata_int(&data, "count"), 11);
+	assert_true(calldata_slot_bool(&data, layout, SLOT_FLAG));
+	calldata_free(&data);
+
+	assert_null(calldata_layout_create("void broken(int"));
+	calldata_layout_destroy(layout);
+}
+
+static void add_proc(void *data, calldata_t *cd)
+{
+	long long *calls = data;
+	(*calls)++;
+	calldata_set_int(cd, "out", calldata_int(cd, "in") + 1);
+}
+
+static void proc_lookup_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	proc_handler_t *handler = proc_handler_create();
+	long long calls[PROC_COUNT] = {0};
+	long long duplicate_calls = 0;
+	struct dstr name = {0};
+	calldata_t cd;
+
+	/* enough procs to grow the index several times and make probing
+	 * chains wrap around */
+	for (size_t i = 0; i < PROC_COUNT; i++) {
+		dstr_printf(&name, "void proc_%zu(int in, out int out)", i);
+		proc_handler_add(handler, name.array, add_proc, &calls[i]);
+	}
+
+	/* adding a proc with an existing name is ignored */
+	proc_handler_add(handler, "void proc_7(int in, out int out)", add_proc, &duplicate_calls);
+
+	calldata_init(&cd);
+	for (size_t i = 0; i < PROC_COUNT; i++) {
+		dstr_printf(&name, "proc_%zu", i);
+		calldata_set_int(&cd, "in", (long long)i);
+		assert_true(proc_handler_call(handler, name.array, &cd));
+		assert_int_equal(calldata_int(&cd, "out"), i + 1);
+	}
+
+	for (size_t i = 0; i < PROC_COUNT; i++)
+		assert_int_equal(calls[i], 1);
+	assert_int_equal(duplicate_calls, 0);
+
+	/* names that hash into occupied slots must not match */
+	assert_false(proc_handler_call(handler, "proc_", &cd));
+	assert_false(proc_handler_call(handler, "proc_200", &cd));
+	assert_false(proc_handler_call(handler, "proc_07", &cd));
+	calldata_free(&cd);
+
+	dstr_free(&name);
+	proc_handler_destroy(handler);
+
+	/* an empty handler has no index yet */
+	handler = proc_handler_create();
+	calldata_init(&cd);
+	assert_false(proc_handler_call(handler, "proc_0", &cd));
+	calldata_free(&cd);
+	proc_handler_destroy(handler);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(layout_slot_test),
+		cmocka_unit_test(layout_string_test),
+		cmocka_unit_test(layout_resized_test),
+		cmocka_unit_test(layout_fallback_test),
+		cmocka_unit_test(proc_lookup_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
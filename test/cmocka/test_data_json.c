@@ -0,0 +1,135 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs-data.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+
+#define TEST_FILE "test_data_json.json"
+
+/* obs_data_get_json_pretty() goes through jansson, saving goes through the
+ * json writer in obs-data.c; both must produce the same text */
+static void assert_same_as_jansson(obs_data_t *data)
+{
+	char *saved;
+
+	assert_true(obs_data_save_json_pretty_safe(data, TEST_FILE, "tmp", NULL));
+
+	saved = os_quick_read_utf8_file(TEST_FILE);
+	assert_non_null(saved);
+	assert_string_equal(saved, obs_data_get_json_pretty(data));
+
+	bfree(saved);
+	os_unlink(TEST_FILE);
+}
+
+static void nested_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = obs_data_create();
+	obs_data_t *settings = obs_data_create();
+	obs_data_t *empty = obs_data_create();
+	obs_data_array_t *items = obs_data_array_create();
+	obs_data_array_t *none = obs_data_array_create();
+
+	obs_data_set_string(data, "name", "Scene");
+	obs_data_set_int(data, "id", -42);
+	obs_data_set_bool(data, "enabled", true);
+	obs_data_set_bool(data, "muted", false);
+
+	obs_data_set_int(settings, "width", 1920);
+	obs_data_set_obj(settings, "empty", empty);
+	obs_data_set_obj(data, "settings", settings);
+
+	for (int i = 0; i < 3; i++) {
+		obs_data_t *item = obs_data_create();
+		obs_data_set_int(item, "index", i);
+		obs_data_set_array(item, "children", none);
+		obs_data_array_push_back(items, item);
+		obs_data_release(item);
+	}
+	obs_data_set_array(data, "items", items);
+	obs_data_set_array(data, "none", none);
+
+	assert_same_as_jansson(data);
+
+	obs_data_array_release(none);
+	obs_data_array_release(items);
+	obs_data_release(empty);
+	obs_data_release(settings);
+	obs_data_release(data);
+}
+
+static void escape_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = obs_data_create();
+
+	obs_data_set_string(data, "quotes", "\"quoted\" \\ back\\slash /");
+	obs_data_set_string(data, "control", "tab\tnew\nline\rform\fback\b bell\x07 esc\x1b");
+	obs_data_set_string(data, "utf8", "caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x8e\xa5");
+	obs_data_set_string(data, "key \"with\"\tescapes", "value");
+	obs_data_set_string(data, "empty", "");
+
+	assert_same_as_jansson(data);
+	obs_data_release(data);
+}
+
+static void double_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = obs_data_create();
+
+	obs_data_set_double(data, "zero", 0.0);
+	obs_data_set_double(data, "negative_zero", -0.0);
+	obs_data_set_double(data, "whole", 3.0);
+	obs_data_set_double(data, "fraction", 0.1);
+	obs_data_set_double(data, "third", 1.0 / 3.0);
+	obs_data_set_double(data, "negative", -2.5);
+	obs_data_set_double(data, "large", 1e21);
+	obs_data_set_double(data, "small", 1.5e-7);
+	obs_data_set_double(data, "max", 1.7976931348623157e308);
+
+	assert_same_as_jansson(data);
+	obs_data_release(data);
+}
+
+static void invalid_utf8_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = obs_data_create();
+
+	/* jansson drops keys and strings that aren't valid UTF-8 */
+	obs_data_set_string(data, "valid", "yes");
+	obs_data_set_string(data, "bad value", "\xc3\x28");
+	obs_data_set_string(data, "surrogate", "\xed\xa0\x80");
+	obs_data_set_int(data, "bad key \xff", 1);
+	obs_data_set_string(data, "overlong \xc0\xaf", "value");
+
+	assert_same_as_jansson(data);
+	obs_data_release(data);
+
+	/* an object with only invalid items is written as {} */
+	data = obs_data_create();
+	obs_data_set_bool(data, "\xf5\x80\x80\x80", true);
+	assert_same_as_jansson(data);
+	obs_data_release(data);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(nested_test),
+		cmocka_unit_test(escape_test),
+		cmocka_unit_test(double_test),
+		cmocka_unit_test(invalid_utf8_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,197 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmocka.h>
+
+#include <obs-nal.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+
+/* The previous FFmpeg based implementation, kept as the reference */
+static const uint8_t *ref_find_startcode_internal(const uint8_t *p, const uint8_t *end)
+{
+	const uint8_t *a = p + 4 - ((intptr_t)p & 3);
+
+	for (end -= 3; p < a && p < end; p++) {
+		if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+			return p;
+	}
+
+	for (end -= 3; p < end; p += 4) {
+		uint32_t x = *(const uint32_t *)p;
+
+		if ((x - 0x01010101) & (~x) & 0x80808080) {
+			if (p[1] == 0) {
+				if (p[0] == 0 && p[2] == 1)
+					return p;
+				if (p[2] == 0 && p[3] == 1)
+					return p + 1;
+			}
+
+			if (p[3] == 0) {
+				if (p[2] == 0 && p[4] == 1)
+					return p + 2;
+				if (p[4] == 0 && p[5] == 1)
+					return p + 3;
+			}
+		}
+	}
+
+	for (end += 3; p < end; p++) {
+		if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+			return p;
+	}
+
+	return end + 3;
+}
+
+static const uint8_t *ref_find_startcode(const uint8_t *p, const uint8_t *end)
+{
+	const uint8_t *out = ref_find_startcode_internal(p, end);
+	if (p < out && out < end && !out[-1])
+		out--;
+	return out;
+}
+
+/* Mostly zeros and ones so that startcodes, 4 byte startcodes and near
+ * misses are common */
+static void fill_random(uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i < size; i++) {
+		int r = rand() % 10;
+		data[i] = r < 5 ? 0 : r < 8 ? 1 : (uint8_t)rand();
+	}
+}
+
+static void find_startcode_equivalence_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	uint8_t buf[320];
+	srand(1);
+
+	for (int iter = 0; iter < 20000; iter++) {
+		size_t offset = rand() % 16;
+		size_t size = rand() % (sizeof(buf) - offset);
+		const uint8_t *data = buf + offset;
+		const uint8_t *end = data + size;
+
+		fill_random(buf, sizeof(buf));
+
+		for (const uint8_t *p = data; p <= end; p++)
+			assert_ptr_equal(obs_nal_find_startcode(p, end), ref_find_startcode(p, end));
+	}
+}
+
+static void nal_index_equivalence_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct obs_nal_index index;
+	uint8_t buf[1024];
+	srand(2);
+
+	obs_nal_index_init(&index);
+
+	for (int iter = 0; iter < 20000; iter++) {
+		size_t offset = rand() % 16;
+		size_t size = rand() % (sizeof(buf) - offset);
+		const uint8_t *data = buf + offset;
+		const uint8_t *end = data + size;
+
+		fill_random(buf, sizeof(buf));
+		obs_nal_index_build(&index, data, size);
+
+		/* the loop every caller used to walk packets with */
+		const uint8_t *nal_start = ref_find_startcode(data, end);
+		size_t count = 0;
+
+		while (true) {
+			const uint8_t *startcode = nal_start;
+
+			while (nal_start < end && !*(nal_start++))
+				;
+
+			if (nal_start == end)
+				break;
+
+			const uint8_t *nal_end = ref_find_startcode(nal_start, end);
+
+			assert_true(count < index.units.num);
+			assert_ptr_equal(index.units.array[count].startcode, startcode);
+			assert_ptr_equal(index.units.array[count].data, nal_start);
+			assert_int_equal(index.units.array[count].size, nal_end - nal_start);
+
+			count++;
+			nal_start = nal_end;
+		}
+
+		assert_int_equal(index.units.num, count);
+	}
+
+	obs_nal_index_free(&index);
+}
+
+static void nal_index_benchmark(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const size_t size = 32 * 1024 * 1024;
+	const int runs = 4;
+	uint8_t *data = bmalloc(size);
+	struct obs_nal_index index;
+	uint64_t ref_ns = 0;
+	uint64_t new_ns = 0;
+	size_t ref_count = 0;
+
+	/* roughly what an intra heavy stream looks like: large slices with
+	 * sparse zero bytes, separated by startcodes */
+	srand(3);
+	for (size_t i = 0; i < size; i++)
+		data[i] = (uint8_t)(rand() % 255 + 1);
+	for (size_t i = 0; i + 4 < size; i += 64 * 1024 + rand() % 1024) {
+		data[i] = data[i + 1] = data[i + 2] = 0;
+		data[i + 3] = 1;
+	}
+	for (size_t i = 0; i < size / 512; i++)
+		data[rand() % size] = 0;
+
+	obs_nal_index_init(&index);
+
+	for (int run = 0; run < runs; run++) {
+		const uint8_t *end = data + size;
+		uint64_t start = os_gettime_ns();
+
+		ref_count = 0;
+		for (const uint8_t *p = ref_find_startcode(data, end); p < end; p = ref_find_startcode(p + 3, end))
+			ref_count++;
+
+		uint64_t mid = os_gettime_ns();
+		obs_nal_index_build(&index, data, size);
+		uint64_t stop = os_gettime_ns();
+
+		ref_ns += mid - start;
+		new_ns += stop - mid;
+	}
+
+	assert_int_equal(index.units.num, ref_count);
+
+	printf("startcode scan: reference %.0f MB/s, nal index %.0f MB/s\n",
+	       (double)size * runs / ((double)ref_ns / 1000.0), (double)size * runs / ((double)new_ns / 1000.0));
+
+	obs_nal_index_free(&index);
+	bfree(data);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(find_startcode_equivalence_test),
+		cmocka_unit_test(nal_index_equivalence_test),
+		cmocka_unit_test(nal_index_benchmark),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
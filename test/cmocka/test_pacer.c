@@ -0,0 +1,138 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <util/threading.h>
+
+#define INTERVAL_NS 5000000ULL
+#define ITERATIONS 200
+
+static volatile bool stop_load = false;
+
+static void *load_thread(void *param)
+{
+	volatile uint64_t x = 0;
+
+	while (!os_atomic_load_bool(&stop_load))
+		x += os_gettime_ns();
+
+	UNUSED_PARAMETER(param);
+	return NULL;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t val_a = *(const uint64_t *)a;
+	uint64_t val_b = *(const uint64_t *)b;
+	return val_a < val_b ? -1 : (val_a > val_b ? 1 : 0);
+}
+
+static void print_jitter(const char *name, uint64_t *lateness, size_t num)
+{
+	qsort(lateness, num, sizeof(uint64_t), compare_u64);
+	printf("%s: median %.1f us, p99 %.1f us, max %.1f us\n", name, lateness[num / 2] / 1000.0,
+	       lateness[num * 99 / 100] / 1000.0, lateness[num - 1] / 1000.0);
+}
+
+static void pacer_under_load_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	int num_threads = os_get_logical_cores();
+	pthread_t *threads = bmalloc(sizeof(pthread_t) * num_threads);
+	uint64_t *sleep_lateness = bmalloc(sizeof(uint64_t) * ITERATIONS);
+	uint64_t *pacer_lateness = bmalloc(sizeof(uint64_t) * ITERATIONS);
+	os_pacer_t *pacer = os_pacer_create(NULL);
+
+	for (int i = 0; i < num_threads; i++)
+		pthread_create(&threads[i], NULL, load_thread, NULL);
+
+	/* a target can already have passed if the thread got preempted, start
+	 * over from the current time in that case like the video thread does */
+	uint64_t target = os_gettime_ns();
+	for (size_t i = 0; i < ITERATIONS; i++) {
+		target += INTERVAL_NS;
+		if (!os_sleepto_ns(target))
+			target = os_gettime_ns();
+		sleep_lateness[i] = os_gettime_ns() - target;
+	}
+
+	target = os_gettime_ns();
+	for (size_t i = 0; i < ITERATIONS; i++) {
+		target += INTERVAL_NS;
+		if (!os_pacer_sleepto_ns(pacer, target))
+			target = os_gettime_ns();
+
+		uint64_t now = os_gettime_ns();
+		assert_true(now >= target);
+		pacer_lateness[i] = now - target;
+	}
+
+	/* targets in the past are reported, not waited for */
+	assert_false(os_pacer_sleepto_ns(pacer, os_gettime_ns() - INTERVAL_NS));
+
+	os_atomic_set_bool(&stop_load, true);
+	for (int i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	printf("%d load threads, spin window %.1f us\n", num_threads, os_pacer_get_spin_ns(pacer) / 1000.0);
+	print_jitter("os_sleepto_ns", sleep_lateness, ITERATIONS);
+	print_jitter("os_pacer_sleepto_ns", pacer_lateness, ITERATIONS);
+
+	os_pacer_destroy(pacer);
+	bfree(pacer_lateness);
+	bfree(sleep_lateness);
+	bfree(threads);
+}
+
+static bool count_root(void *context, profiler_snapshot_entry_t *entry)
+{
+	uint64_t *count = context;
+	*count += profiler_snapshot_entry_overall_count(entry);
+	return true;
+}
+
+static void pacer_profiler_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	profiler_name_store_t *store = profiler_name_store_create();
+	const char *name = profile_store_name(store, "pacer wakeup jitter");
+	os_pacer_t *pacer = os_pacer_create(name);
+	uint64_t count = 0;
+
+	profiler_start();
+
+	uint64_t target = os_gettime_ns();
+	for (size_t i = 0; i < 20; i++) {
+		target += 1000000;
+		os_pacer_sleepto_ns(pacer, target);
+	}
+
+	profiler_stop();
+
+	profiler_snapshot_t *snap = profile_snapshot_create();
+	profiler_snapshot_enumerate_roots(snap, count_root, &count);
+	assert_int_equal(count, 20);
+
+	profile_snapshot_free(snap);
+	os_pacer_destroy(pacer);
+	profiler_free();
+	profiler_name_store_free(store);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(pacer_under_load_test),
+		cmocka_unit_test(pacer_profiler_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
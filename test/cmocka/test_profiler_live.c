@@ -0,0 +1,221 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <util/threading.h>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+static const char *scope_name = "live test scope";
+
+struct find_data {
+	const char *name;
+	profiler_live_metric_t metric;
+	bool found;
+};
+
+static bool find_metric(void *param, const profiler_live_metric_t *metric)
+{
+	struct find_data *data = param;
+
+	if (strcmp(metric->name, data->name) != 0)
+		return true;
+
+	data->metric = *metric;
+	data->found = true;
+	return false;
+}
+
+static bool wait_for_metric(struct find_data *data, uint64_t min_count)
+{
+	for (int i = 0; i < 300; i++) {
+		data->found = false;
+		profiler_live_enum(find_metric, data);
+		if (data->found && data->metric.count >= min_count)
+			return true;
+		os_sleep_ms(10);
+	}
+
+	return false;
+}
+
+static void *record_thread(void *param)
+{
+	for (int i = 0; i < 490; i++)
+		profile_record(scope_name, 1000);
+	for (int i = 0; i < 10; i++)
+		profile_record(scope_name, 1000000);
+
+	UNUSED_PARAMETER(param);
+	return NULL;
+}
+
+static void collect(void *param, profiler_live_metrics_t *metrics)
+{
+	profiler_live_metrics_add(metrics, "collected", 1, 2, 3, 4);
+	UNUSED_PARAMETER(param);
+}
+
+static bool within(uint64_t val, uint64_t expected)
+{
+	/* buckets are 1/8th of a power of two wide */
+	return val >= expected - expected / 8 && val <= expected + expected / 8;
+}
+
+static void live_percentiles_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct find_data data = {.name = scope_name};
+	pthread_t threads[2];
+
+	profiler_start();
+	profiler_live_start();
+	profiler_live_add_collector(collect, NULL);
+
+	for (size_t i = 0; i < 2; i++)
+		pthread_create(&threads[i], NULL, record_thread, NULL);
+	for (size_t i = 0; i < 2; i++)
+		pthread_join(threads[i], NULL);
+
+	assert_true(wait_for_metric(&data, 1000));
+	assert_int_equal(data.metric.count, 1000);
+	assert_true(within(data.metric.p50_ns, 1000));
+	assert_true(within(data.metric.p99_ns, 1000000));
+	assert_int_equal(data.metric.max_ns, 1000000);
+
+	data.name = "collected";
+	assert_true(wait_for_metric(&data, 1));
+	assert_int_equal(data.metric.max_ns, 4);
+
+	profiler_live_stop();
+	profiler_stop();
+	profiler_free();
+}
+
+static void live_overhead_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const char *name = "live overhead";
+	const int calls = 200000;
+	uint64_t idle, listening;
+
+	profiler_start();
+
+	uint64_t start = os_gettime_ns();
+	for (int i = 0; i < calls; i++) {
+		profile_start(name);
+		profile_end(name);
+	}
+	idle = os_gettime_ns() - start;
+
+	profiler_live_start();
+
+	start = os_gettime_ns();
+	for (int i = 0; i < calls; i++) {
+		profile_start(name);
+		profile_end(name);
+	}
+	listening = os_gettime_ns() - start;
+
+	printf("profile_start/end: %.1f ns idle, %.1f ns with a listener\n", (double)idle / calls,
+	       (double)listening / calls);
+
+	profiler_live_stop();
+	profiler_stop();
+	profiler_free();
+}
+
+#ifndef _WIN32
+static void live_socket_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	char path[64];
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	char buf[4096] = {0};
+	size_t len = 0;
+
+	snprintf(path, sizeof(path), "/tmp/obs-profiler-test-%d.sock", (int)getpid());
+	strcpy(addr.sun_path, path);
+
+	profiler_start();
+	assert_true(profiler_live_serve(path));
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	assert_true(fd != -1);
+	assert_int_equal(connect(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+
+	/* calls are only recorded once the server has seen the client */
+	for (int i = 0; i < 300 && !strstr(buf, scope_name); i++) {
+		profile_record(scope_name, 5000);
+		os_sleep_ms(10);
+
+		struct timeval timeout = {0, 1000};
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		ssize_t ret = recv(fd, buf + len, sizeof(buf) - len - 1, 0);
+		if (ret > 0) {
+			len += (size_t)ret;
+			buf[len] = 0;
+			if (len > sizeof(buf) / 2)
+				len = 0;
+		}
+	}
+
+	assert_true(strstr(buf, scope_name) != NULL);
+
+	close(fd);
+	profiler_stop();
+	profiler_free();
+
+	assert_true(access(path, F_OK) != 0);
+}
+
+static void live_socket_path_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	char path[64];
+	FILE *file;
+
+	snprintf(path, sizeof(path), "/tmp/obs-profiler-test-%d.txt", (int)getpid());
+	file = fopen(path, "w");
+	assert_non_null(file);
+	fclose(file);
+
+	/* a path that isn't a socket must be left alone */
+	profiler_start();
+	assert_false(profiler_live_serve(path));
+	assert_int_equal(access(path, F_OK), 0);
+	profiler_stop();
+	profiler_free();
+
+	unlink(path);
+}
+#endif
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(live_percentiles_test),
+		cmocka_unit_test(live_overhead_test),
+#ifndef _WIN32
+		cmocka_unit_test(live_socket_test),
+		cmocka_unit_test(live_socket_path_test),
+#endif
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,208 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <callback/signal.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#define EMIT_THREADS 4
+#define EMITS_PER_THREAD 20000
+#define DEFERRED_CALLS 1000
+
+struct counter {
+	volatile long calls;
+	volatile long sum;
+	volatile bool connected;
+	volatile long late_calls;
+};
+
+static void add_long(volatile long *val, long add)
+{
+	long old_val = os_atomic_load_long(val);
+	while (!os_atomic_compare_exchange_long(val, &old_val, old_val + add))
+		;
+}
+
+static void count_cb(void *data, calldata_t *cd)
+{
+	struct counter *c = data;
+
+	os_atomic_inc_long(&c->calls);
+	add_long(&c->sum, (long)calldata_int(cd, "val"));
+
+	/* disconnect promises the callback isn't running once it returns */
+	if (!os_atomic_load_bool(&c->connected))
+		os_atomic_inc_long(&c->late_calls);
+}
+
+static void remove_self_cb(void *data, calldata_t *cd)
+{
+	struct counter *c = data;
+	os_atomic_inc_long(&c->calls);
+	signal_handler_remove_current();
+
+	UNUSED_PARAMETER(cd);
+}
+
+static void emit(signal_handler_t *handler, long long val)
+{
+	calldata_t cd;
+	calldata_init(&cd);
+	calldata_set_int(&cd, "val", val);
+	signal_handler_signal(handler, "test", &cd);
+	calldata_free(&cd);
+}
+
+static signal_handler_t *create_handler(void)
+{
+	signal_handler_t *handler = signal_handler_create();
+	assert_non_null(handler);
+	assert_true(signal_handler_add(handler, "void test(int val)"));
+	return handler;
+}
+
+static void connect_disconnect_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	signal_handler_t *handler = create_handler();
+	struct counter a = {.connected = true};
+	struct counter b = {.connected = true};
+
+	signal_handler_connect(handler, "test", count_cb, &a);
+	signal_handler_connect(handler, "test", count_cb, &b);
+
+	/* connecting the same callback and data again is ignored */
+	signal_handler_connect(handler, "test", count_cb, &a);
+
+	emit(handler, 2);
+	assert_int_equal(a.calls, 1);
+	assert_int_equal(b.calls, 1);
+	assert_int_equal(a.sum, 2);
+
+	signal_handler_disconnect(handler, "test", count_cb, &a);
+	emit(handler, 3);
+	assert_int_equal(a.calls, 1);
+	assert_int_equal(b.calls, 2);
+	assert_int_equal(b.sum, 5);
+
+	/* unknown signals are ignored */
+	signal_handler_connect(handler, "missing", count_cb, &a);
+	signal_handler_disconnect(handler, "missing", count_cb, &a);
+
+	signal_handler_destroy(handler);
+}
+
+static void remove_current_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	signal_handler_t *handler = create_handler();
+	struct counter once = {.connected = true};
+	struct counter always = {.connected = true};
+
+	signal_handler_connect(handler, "test", remove_self_cb, &once);
+	signal_handler_connect(handler, "test", count_cb, &always);
+
+	emit(handler, 1);
+	emit(handler, 1);
+
+	assert_int_equal(once.calls, 1);
+	assert_int_equal(always.calls, 2);
+
+	signal_handler_destroy(handler);
+}
+
+struct emit_thread {
+	pthread_t thread;
+	signal_handler_t *handler;
+};
+
+static void *emit_thread(void *param)
+{
+	struct emit_thread *et = param;
+
+	for (long i = 0; i < EMITS_PER_THREAD; i++)
+		emit(et->handler, 1);
+
+	return NULL;
+}
+
+static void concurrent_emit_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	signal_handler_t *handler = create_handler();
+	struct emit_thread threads[EMIT_THREADS];
+	struct counter stable = {.connected = true};
+	struct counter toggled = {0};
+
+	signal_handler_connect(handler, "test", count_cb, &stable);
+
+	for (size_t i = 0; i < EMIT_THREADS; i++) {
+		threads[i].handler = handler;
+		pthread_create(&threads[i].thread, NULL, emit_thread, &threads[i]);
+	}
+
+	/* callbacks are swapped in and out while other threads emit */
+	for (int i = 0; i < 2000; i++) {
+		os_atomic_set_bool(&toggled.connected, true);
+		signal_handler_connect(handler, "test", count_cb, &toggled);
+		signal_handler_disconnect(handler, "test", count_cb, &toggled);
+		os_atomic_set_bool(&toggled.connected, false);
+	}
+
+	for (size_t i = 0; i < EMIT_THREADS; i++)
+		pthread_join(threads[i].thread, NULL);
+
+	assert_int_equal(stable.calls, EMIT_THREADS * EMITS_PER_THREAD);
+	assert_int_equal(stable.sum, EMIT_THREADS * EMITS_PER_THREAD);
+	assert_int_equal(toggled.late_calls, 0);
+
+	signal_handler_destroy(handler);
+}
+
+static void deferred_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	signal_handler_t *handler = create_handler();
+	struct counter deferred = {.connected = true};
+	long expected_sum = 0;
+
+	signal_handler_connect_deferred(handler, "test", count_cb, &deferred);
+
+	/* calldata is copied, so the emitter can reuse it right away */
+	for (long i = 1; i <= DEFERRED_CALLS; i++) {
+		emit(handler, i);
+		expected_sum += i;
+	}
+
+	/* shutting down delivers everything still queued */
+	signal_handler_shutdown_deferred();
+
+	assert_int_equal(deferred.calls, DEFERRED_CALLS);
+	assert_int_equal(deferred.sum, expected_sum);
+
+	/* the dispatcher starts again on the next deferred call */
+	emit(handler, 1);
+	signal_handler_shutdown_deferred();
+	assert_int_equal(deferred.calls, DEFERRED_CALLS + 1);
+
+	signal_handler_disconnect(handler, "test", count_cb, &deferred);
+	signal_handler_destroy(handler);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(connect_disconnect_test),
+		cmocka_unit_test(remove_current_test),
+		cmocka_unit_test(concurrent_emit_test),
+		cmocka_unit_test(deferred_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}